@@ -0,0 +1,404 @@
+/*
+Bench runs fixed synthetic workloads through each stage of the pipeline,
+from the sensor filters to the client protocols, and writes the cost of
+each as JSON so the releases and the Pi models can be compared. It is
+run with StarPi --bench, in place of the telescope, and needs no sensors,
+GPS or clients. Each stage is timed over BENCH_RUNS runs of about
+BENCH_RUN_NS each, and the mean, spread and extremes of the runs are
+reported.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <math.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/utsname.h>
+#include "HalAccelerometer.h"
+#include "HalMagnetometer.h"
+#include "TelescopeOrientation.h"
+#include "TelescopeSocket.h"
+#include "MagModel.h"
+#include "erfa.h"
+#include "Server.hpp"
+#include "Connection.hpp"
+#include "Bench.h"
+
+#define BENCH_SAMPLES       256u    /**< synthetic sensor samples, a power of 2 */
+#define BENCH_GOTO_SIZE     20u     /**< bytes in a Stellarium goto message */
+
+/* the telescope sweeping round and up and down, with sensor noise */
+static int16_t AccelSamples[BENCH_SAMPLES][3];
+static int16_t MagSamples[BENCH_SAMPLES][3];
+static uint8_t GotoMessages[BENCH_SAMPLES][BENCH_GOTO_SIZE];
+
+/* the commands a client polls, one at a time and as one MULT */
+static const char* const SocketCommands[] = { "RA  #", "DEC #", "Unix#", "Pitc#", "Azim#", "Lati#", "MagD#", "GPSM#" };
+static const char SocketMultiRequest[] = "MULT RA  #DEC #Unix#Pitc#Azim#Lati#MagD#GPSM#\n";
+
+/** A server that only takes the goto, without a listener
+ */
+class BenchServer : public Server
+{
+    public:
+        BenchServer( void ) : Server(), Target( 0u ) {}
+        uint32_t Target;    /**< sum of the gotos received */
+    private:
+        void GotoReceived( uint32_t RAInt, int32_t DecInt )
+        {
+            Target += RAInt ^ (uint32_t)DecInt;
+        }
+};
+
+/** A connection whose read buffer is filled by the benchmark
+ */
+class BenchConnection : public Connection
+{
+    public:
+        BenchConnection( Server& Owner ) : Connection( Owner ) {}
+        void Parse( const uint8_t* Data, uint32_t Length )
+        {
+            const uint8_t* Pointer = Data;
+            DataReceived( Pointer, Data + Length );
+        }
+};
+
+const BENCH_STAGE_T Bench::Stages[] =
+{
+    { "sensor_filter",      "sample",   NULL,                       &Bench::SensorFilter },
+    { "orientation",        "sample",   NULL,                       &Bench::Orientation },
+    { "magmodel_setparams", "call",     &Bench::MagModelAvailable,  &Bench::MagModelParams },
+    { "erfa_dtf2d",         "call",     NULL,                       &Bench::ErfaDtf2d },
+    { "erfa_atoc13",        "call",     NULL,                       &Bench::ErfaAtoc13 },
+    { "erfa_a2tf",          "call",     NULL,                       &Bench::ErfaA2tf },
+    { "socket_command",     "command",  NULL,                       &Bench::SocketCommand },
+    { "socket_mult",        "request",  NULL,                       &Bench::SocketMulti },
+    { "stellarium_goto",    "message",  NULL,                       &Bench::StellariumGoto }
+};
+
+/* Run
+ * Make the synthetic input, then time every stage
+ */
+bool Bench::Run( FILE* Output )
+{
+    char Model[64] = "";
+    struct utsname Name;
+    bool Result = true;
+    uint32_t Index = 0u;
+    FILE* ModelFile = NULL;
+
+    srand( 1u );
+    for ( Index = 0u; Index < BENCH_SAMPLES; Index++ )
+    {
+        const double Angle = ( 2.0 * M_PI * Index ) / BENCH_SAMPLES;
+        const double Pitch = 0.6 + ( 0.4 * sin( Angle * 3.0 ) );
+        const double Noise[3] = { ( rand() % 64 ) - 32.0, ( rand() % 64 ) - 32.0, ( rand() % 64 ) - 32.0 };
+        AccelSamples[Index][0] = (int16_t)( ( 16384.0 * sin( Pitch ) ) + Noise[0] );
+        AccelSamples[Index][1] = (int16_t)( Noise[1] );
+        AccelSamples[Index][2] = (int16_t)( ( 16384.0 * cos( Pitch ) ) + Noise[2] );
+        MagSamples[Index][0] = (int16_t)( ( 400.0 * cos( Angle ) ) + ( Noise[0] / 8.0 ) );
+        MagSamples[Index][1] = (int16_t)( ( 400.0 * sin( Angle ) ) + ( Noise[1] / 8.0 ) );
+        MagSamples[Index][2] = (int16_t)( -300.0 + ( Noise[2] / 8.0 ) );
+        /* size, type 0, client time, RA, Dec */
+        const uint32_t Ra = (uint32_t)rand() * 2654435761u;
+        const uint32_t Dec = (uint32_t)( rand() % 0x7FFFFFFF ) - 0x40000000u;
+        uint8_t* Message = GotoMessages[Index];
+        memset( Message, 0, BENCH_GOTO_SIZE );
+        Message[0] = BENCH_GOTO_SIZE;
+        for ( uint8_t Byte = 0u; Byte < 4u; Byte++ )
+        {
+            Message[12u + Byte] = (uint8_t)( Ra >> ( 8u * Byte ) );
+            Message[16u + Byte] = (uint8_t)( Dec >> ( 8u * Byte ) );
+        }
+    }
+
+    /* the Pi model if there is one, so results from different boards can be told apart */
+    ModelFile = fopen( "/proc/device-tree/model", "r" );
+    if ( ModelFile != NULL )
+    {
+        const size_t Length = fread( Model, 1u, sizeof( Model ) - 1u, ModelFile );
+        Model[Length] = '\0';
+        fclose( ModelFile );
+    }
+    for ( Index = 0u; Model[Index] != '\0'; Index++ )
+    {
+        if ( ( Model[Index] == '"' ) || ( Model[Index] == '\\' ) || ( Model[Index] < ' ' ) )
+        {
+            Model[Index] = ' ';
+        }
+    }
+    if ( uname( &Name ) != 0 )
+    {
+        strcpy( Name.machine, "unknown" );
+        strcpy( Name.release, "unknown" );
+    }
+    fprintf( Output, "{\"bench\":\"StarPi\",\"format\":1,\"model\":\"%s\",\"machine\":\"%s\",\"kernel\":\"%s\","
+                     "\"compiled\":\"%s %s\",\"runs\":%u,\"stages\":[",
+             Model, Name.machine, Name.release, __DATE__, __TIME__, BENCH_RUNS );
+    for ( Index = 0u; Index < ( sizeof( Stages ) / sizeof( Stages[0] ) ); Index++ )
+    {
+        fprintf( Output, ( Index == 0u ) ? "\n" : ",\n" );
+        Result = RunStage( Output, &Stages[Index] ) && Result;
+    }
+    fprintf( Output, "\n]}\n" );
+    return Result;
+}
+
+/* RunStage
+ * Find how many operations take about BENCH_RUN_NS, then time BENCH_RUNS
+ * runs of that many
+ */
+bool Bench::RunStage( FILE* Output, const BENCH_STAGE_T* Stage )
+{
+    double PerOp[BENCH_RUNS];
+    double Sum = 0.0;
+    double SumSquares = 0.0;
+    uint32_t Checksum = 0u;
+    uint32_t Ops = 1u;
+    uint32_t Run = 0u;
+    int64_t Elapsed = 0;
+
+    if ( ( Stage->Available != NULL ) && !Stage->Available() )
+    {
+        fprintf( Output, "{\"name\":\"%s\",\"unit\":\"%s\",\"skipped\":true}", Stage->Name, Stage->Unit );
+        return true;
+    }
+    /* grow the run until it is long enough to scale from, which also warms up */
+    for ( ; ; )
+    {
+        const int64_t Start = NowNanos();
+        Checksum += Stage->Function( Ops );
+        Elapsed = NowNanos() - Start;
+        if ( ( Elapsed >= ( BENCH_RUN_NS / 10 ) ) || ( Ops >= BENCH_MAX_OPS ) )
+        {
+            break;
+        }
+        Ops = ( Ops < ( BENCH_MAX_OPS / 2u ) ) ? ( Ops * 2u ) : BENCH_MAX_OPS;
+    }
+    if ( Elapsed > 0 )
+    {
+        const double Scaled = ( (double)Ops * BENCH_RUN_NS ) / Elapsed;
+        Ops = ( Scaled < 1.0 ) ? 1u : ( Scaled > BENCH_MAX_OPS ) ? BENCH_MAX_OPS : (uint32_t)Scaled;
+    }
+    for ( Run = 0u; Run < BENCH_RUNS; Run++ )
+    {
+        const int64_t Start = NowNanos();
+        Checksum += Stage->Function( Ops );
+        PerOp[Run] = (double)( NowNanos() - Start ) / Ops;
+        Sum += PerOp[Run];
+    }
+    const double Mean = Sum / BENCH_RUNS;
+    double Min = PerOp[0];
+    double Max = PerOp[0];
+    for ( Run = 0u; Run < BENCH_RUNS; Run++ )
+    {
+        SumSquares += ( PerOp[Run] - Mean ) * ( PerOp[Run] - Mean );
+        Min = ( PerOp[Run] < Min ) ? PerOp[Run] : Min;
+        Max = ( PerOp[Run] > Max ) ? PerOp[Run] : Max;
+    }
+    const double StdDev = sqrt( SumSquares / ( BENCH_RUNS - 1u ) );
+    fprintf( Output, "{\"name\":\"%s\",\"unit\":\"%s\",\"ops_per_run\":%u,\"ns_per_op\":%.1f,\"stddev_ns\":%.1f,"
+                     "\"min_ns\":%.1f,\"max_ns\":%.1f,\"ops_per_sec\":%.0f,\"checksum\":%u}",
+             Stage->Name, Stage->Unit, (unsigned)Ops, Mean, StdDev, Min, Max, 1.0e9 / Mean, (unsigned)Checksum );
+    return isfinite( Mean ) && ( Mean > 0.0 );
+}
+
+/* SensorFilter
+ * A sample from each sensor through its filter, as TelescopeOrientation::Run
+ */
+uint32_t Bench::SensorFilter( uint32_t Ops )
+{
+    float X = 0.0f;
+    float Y = 0.0f;
+    float Z = 0.0f;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        const uint32_t Index = Op & ( BENCH_SAMPLES - 1u );
+        HalAccelerometer::Accelerometer.AddSample( AccelSamples[Index][0], AccelSamples[Index][1], AccelSamples[Index][2] );
+        HalMagnetometer::Magneto.AddSample( MagSamples[Index][0], MagSamples[Index][1], MagSamples[Index][2] );
+    }
+    HalAccelerometer::Accelerometer.GetAll( &X, &Y, &Z );
+    return (uint32_t)( X + Y + Z );
+}
+
+/* Orientation
+ * A sample filtered then the pitch, roll and heading worked out from it,
+ * as TelescopeManager::Run does with the latest
+ */
+uint32_t Bench::Orientation( uint32_t Ops )
+{
+    float Pitch = 0.0f;
+    float Roll = 0.0f;
+    float Heading = 0.0f;
+    float Sum = 0.0f;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        const uint32_t Index = Op & ( BENCH_SAMPLES - 1u );
+        HalAccelerometer::Accelerometer.AddSample( AccelSamples[Index][0], AccelSamples[Index][1], AccelSamples[Index][2] );
+        HalMagnetometer::Magneto.AddSample( MagSamples[Index][0], MagSamples[Index][1], MagSamples[Index][2] );
+        TelescopeOrientation::Orient.GetOrientation( &Pitch, &Roll, &Heading );
+        Sum += Pitch + Roll + Heading;
+    }
+    return (uint32_t)( Sum * 1000.0f );
+}
+
+/* MagModelAvailable
+ * SetParams reads the model from WMM.COF in the working directory
+ */
+bool Bench::MagModelAvailable( void )
+{
+    FILE* File = fopen( "WMM.COF", "r" );
+    if ( File != NULL )
+    {
+        fclose( File );
+    }
+    return ( File != NULL );
+}
+
+/* MagModelParams
+ * The magnetic declination for a place and date, as for a new GPS fix
+ */
+uint32_t Bench::MagModelParams( uint32_t Ops )
+{
+    MagModel Model;
+    float Sum = 0.0f;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        Model.SetParams( 51.5f + ( 0.01f * ( Op & 15u ) ), -0.1f, 0.05f, 1 + ( Op % 28u ), 1 + ( Op % 12u ), 2018 );
+        Sum += Model.GetDeclination();
+    }
+    return (uint32_t)( Sum * 1000.0f );
+}
+
+/* ErfaDtf2d
+ * A UTC date and time to a two part Julian date, through a day
+ */
+uint32_t Bench::ErfaDtf2d( uint32_t Ops )
+{
+    erfa Era;
+    double Utc1 = 0.0;
+    double Utc2 = 0.0;
+    double Sum = 0.0;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        (void)Era.Dtf2d( "UTC", 2018, 1 + ( Op % 12u ), 1 + ( Op % 28u ), Op % 24u, Op % 60u, (double)( Op % 60u ), &Utc1, &Utc2 );
+        Sum += Utc2;
+    }
+    return (uint32_t)( Sum * 1000.0 );
+}
+
+/* ErfaAtoc13
+ * Azimuth and zenith distance to RA and Dec, with the parameters
+ * TelescopeManager::Run uses, the telescope sweeping the sky
+ */
+uint32_t Bench::ErfaAtoc13( uint32_t Ops )
+{
+    erfa Era;
+    double Utc1 = 0.0;
+    double Utc2 = 0.0;
+    double Ra = 0.0;
+    double Dec = 0.0;
+    double Sum = 0.0;
+    (void)Era.Dtf2d( "UTC", 2018, 6, 21, 22, 30, 0.0, &Utc1, &Utc2 );
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        const double Azimuth = ( 2.0 * M_PI * ( Op & ( BENCH_SAMPLES - 1u ) ) ) / BENCH_SAMPLES;
+        const double Zenith = 0.2 + ( 1.2 * ( ( Op >> 8 ) & 15u ) ) / 16.0;
+        (void)Era.Atoc13( "A", Azimuth, Zenith, Utc1, Utc2 + ( Op * 1.0e-8 ), 0.0,
+                          -0.0018, 0.8988, 50.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, &Ra, &Dec );
+        Sum += Ra + Dec;
+    }
+    return (uint32_t)( Sum * 1000.0 );
+}
+
+/* ErfaA2tf
+ * An angle to hours, minutes and seconds, as for the RA display
+ */
+uint32_t Bench::ErfaA2tf( uint32_t Ops )
+{
+    erfa Era;
+    int Hmsf[4];
+    char Sign = '+';
+    uint32_t Sum = 0u;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        Era.A2tf( 0, ( ( 2.0 * M_PI ) * ( Op & 0xFFFFu ) ) / 65536.0, &Sign, Hmsf );
+        Sum += Hmsf[0] + Hmsf[1] + Hmsf[2] + Sign;
+    }
+    return Sum;
+}
+
+/* SocketCommand
+ * One command found and its reply formatted, as HalSocket hands them to
+ * TelescopeSocket
+ */
+uint32_t Bench::SocketCommand( uint32_t Ops )
+{
+    char Buffer[TELESCOPE_SOCKET_VALUE_SIZE];
+    const uint32_t Commands = sizeof( SocketCommands ) / sizeof( SocketCommands[0] );
+    uint32_t Sum = 0u;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        strcpy( Buffer, SocketCommands[Op % Commands] );
+        Sum += TelescopeSocket::MessageLength( Buffer );
+        TelescopeSocket::SocketCallback( Buffer );
+        Sum += (uint8_t)Buffer[5];
+    }
+    return Sum;
+}
+
+/* SocketMulti
+ * The commands as one MULT request, as the web page sends them
+ */
+uint32_t Bench::SocketMulti( uint32_t Ops )
+{
+    char Buffer[HAL_SOCKET_REPLY_SIZE];
+    uint32_t Sum = 0u;
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        memcpy( Buffer, SocketMultiRequest, sizeof( SocketMultiRequest ) );
+        Sum += TelescopeSocket::MessageLength( Buffer );
+        TelescopeSocket::SocketCallback( Buffer );
+        Sum += (uint8_t)Buffer[8];
+    }
+    return Sum;
+}
+
+/* StellariumGoto
+ * A goto message from Stellarium parsed and passed to the server
+ */
+uint32_t Bench::StellariumGoto( uint32_t Ops )
+{
+    static BenchServer Owner;
+    static BenchConnection Client( Owner );
+    for ( uint32_t Op = 0u; Op < Ops; Op++ )
+    {
+        Client.Parse( GotoMessages[Op & ( BENCH_SAMPLES - 1u )], BENCH_GOTO_SIZE );
+    }
+    return Owner.Target;
+}
+
+/* NowNanos
+ * Monotonic time in nanoseconds
+ */
+int64_t Bench::NowNanos( void )
+{
+    struct timespec Now;
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+    return ( (int64_t)Now.tv_sec * 1000000000 ) + Now.tv_nsec;
+}
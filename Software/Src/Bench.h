@@ -0,0 +1,86 @@
+/**
+Bench runs fixed synthetic workloads through each stage of the pipeline,
+from the sensor filters to the client protocols, and writes the cost of
+each as JSON so the releases and the Pi models can be compared. It is
+run with StarPi --bench, in place of the telescope, and needs no sensors,
+GPS or clients. Each stage is timed over BENCH_RUNS runs of about
+BENCH_RUN_NS each, and the mean, spread and extremes of the runs are
+reported.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Configuration */
+
+#define BENCH_RUNS       15u          /**< timed runs of each stage */
+#define BENCH_RUN_NS     20000000LL   /**< aim for each run to take 20 ms */
+#define BENCH_MAX_OPS    10000000u    /**< most operations in a run */
+
+/** One stage, Function does Ops operations and returns a checksum so
+ *  the work can not be optimised away
+ */
+typedef struct
+{
+    const char* Name;                          /**< in the JSON */
+    const char* Unit;                          /**< what one operation is */
+    bool (*Available)( void );                 /**< NULL if it can always run */
+    uint32_t (*Function)( uint32_t Ops );
+} BENCH_STAGE_T;
+
+/** Bench
+ * - The pipeline benchmarks
+ */
+class Bench
+{
+    public:
+    /** Run every stage and write the results
+     * @param Output where the JSON goes
+     * @return bool true if every stage that could run did
+     */
+        static bool Run( FILE* Output );
+
+    private:
+    /** Time a stage and write its result
+     * @return bool false if a run went wrong
+     */
+        static bool RunStage( FILE* Output, const BENCH_STAGE_T* Stage );
+    /** The stages, each with its own synthetic input
+     */
+        static uint32_t SensorFilter( uint32_t Ops );
+        static uint32_t Orientation( uint32_t Ops );
+        static bool MagModelAvailable( void );
+        static uint32_t MagModelParams( uint32_t Ops );
+        static uint32_t ErfaDtf2d( uint32_t Ops );
+        static uint32_t ErfaAtoc13( uint32_t Ops );
+        static uint32_t ErfaA2tf( uint32_t Ops );
+        static uint32_t SocketCommand( uint32_t Ops );
+        static uint32_t SocketMulti( uint32_t Ops );
+        static uint32_t StellariumGoto( uint32_t Ops );
+    /** Monotonic time in nanoseconds
+     */
+        static int64_t NowNanos( void );
+
+        static const BENCH_STAGE_T Stages[];    /**< in pipeline order */
+};
+
+#endif /* BENCH_H */
@@ -107,6 +107,31 @@
 #define CONFIG_MY_OFFSET ((float) ((CONFIG_MYMIN + CONFIG_MYMAX)/2.0))
 #define CONFIG_MZ_OFFSET ((float) ((CONFIG_MZMIN + CONFIG_MZMAX)/2.0))
 
+/*
+    Ellipsoid calibration:
+    The min/max values above are used until a calibration file has been
+    written by running a calibration. The file is read at start up.
+*/
+#define CONFIG_MAG_CALIBRATION_FILE        "MagCal.cfg"
+#define CONFIG_MAG_CALIBRATION_MIN_SAMPLES 200u          /* samples needed before the fit is solved */
+#define CONFIG_MAG_CALIBRATION_FORGETTING  ((double)1.0) /* RLS forgetting factor, 1.0 keeps every sample */
+
+/*
+    Sensor filter:
+    By default the accelerometer and magnetometer use the fixed filter the
+    calibration values above were taken with. Define CONFIG_SENSOR_FILTER_DESIGNED
+    to use a Butterworth low pass designed at start up instead, then recalibrate.
+*/
+//#define CONFIG_SENSOR_FILTER_DESIGNED
+#define CONFIG_SENSOR_FILTER_CUTOFF ((float)5.0)   /* Hz */
+#define CONFIG_SENSOR_FILTER_RATE   ((float)500.0) /* Hz, the orientation task runs every 2ms */
+#define CONFIG_SENSOR_FILTER_B0     ((float)1.0)
+#define CONFIG_SENSOR_FILTER_B1     ((float)-1.4)
+#define CONFIG_SENSOR_FILTER_B2     ((float)1.0)
+#define CONFIG_SENSOR_FILTER_A0     ((float)1.0)
+#define CONFIG_SENSOR_FILTER_A1     ((float)-1.3)
+#define CONFIG_SENSOR_FILTER_A2     ((float)0.5)
+
 
 /*
     Motor stuff
@@ -124,19 +149,20 @@
 #define MOTOR_ONE LM29X1
 #define MOTOR_TWO LM29X2
 
+/*
+    Telemetry multicast, for events with several displays. Each
+    TelescopeManager run is sent to TELEMETRY_MULTICAST_GROUP.
+*/
+//#define TELEMETRY_MULTICAST
+
 
 /*
-    Timing defines
+    Software trace of the task timing, see Trace.h. kill -USR1 StarPi
+    writes the latest few seconds to TRACE_FILE for chrome://tracing or
+    ui.perfetto.dev. Comment out TRACE to take it out of the build.
 */
-#if 0
-#include "GPIO.h"
-#define TIMING
-#define TELESCOPE_MANAGER_PIN      BCM_GPIO16
-#define TELESCOPE_ORIENTATION_PIN  BCM_GPIO19
-#define HAL_WEBSOCKETD_PIN         BCM_GPIO20
-#define HAL_GPS_PIN                BCM_GPIO13
-#define SERVER_PI_PIN              BCM_GPIO26
-#endif /* end of timing defines #if 0 */
+#define TRACE
+#define TRACE_FILE "/tmp/StarPi_trace.json"
 
 
 
@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include "HalAccelerometer.h"
 #include "Config.h"
+#include "HalCapture.h"
 #include <math.h>
 
 #ifdef MPU6050_ACCEL
@@ -47,23 +48,19 @@ LSM303DLHC_Accel Accel;
 #error no Accelerometer defined - please edit your config.h file.
 #endif
 
-static float b[] = {1,  -1.4, 1};
-static float a[] = {1, -1.3, 0.5};
-
-static float iirfilter(float x1, float* v1m1, float* v2m1) {
-    float y1 = 0;
-    y1 = ( ( b[0] * x1 ) + *v1m1) / a[0];
-    *v1m1 = ( ( b[1] * x1 ) + *v2m1 ) - ( a[1] * y1 );
-    *v2m1 = ( b[2] * x1 ) - ( a[2] * y1 );
-    return y1;
-}
-
 HalAccelerometer HalAccelerometer::Accelerometer;
 
 /* Constructor
  */
 HalAccelerometer::HalAccelerometer( void )
 {
+    /* here rather than in Init so the filter works without the device */
+#ifdef CONFIG_SENSOR_FILTER_DESIGNED
+    Filter.DesignLowPass( CONFIG_SENSOR_FILTER_CUTOFF, CONFIG_SENSOR_FILTER_RATE );
+#else
+    Filter.SetSection( 0u, CONFIG_SENSOR_FILTER_B0, CONFIG_SENSOR_FILTER_B1, CONFIG_SENSOR_FILTER_B2,
+                           CONFIG_SENSOR_FILTER_A0, CONFIG_SENSOR_FILTER_A1, CONFIG_SENSOR_FILTER_A2 );
+#endif
 }
 
 /* Initialise the Accelerometer
@@ -72,7 +69,11 @@ HalAccelerometer::HalAccelerometer( void )
 bool HalAccelerometer::Init( void )
 {
     bool Result = false;    
-    Accel.initialize();
+    if ( !HalCapture::Capture.IsReplaying() )
+    {
+        Accel.initialize();
+    }
+    Filter.Reset();
     // initialise Accelerometer specifics here
     Scaling = 32768.0F;
 #ifdef MPU6050_ACCEL
@@ -101,21 +102,19 @@ bool HalAccelerometer::Init( void )
  */
 void HalAccelerometer::Run( void )
 {
-    static float Xv1m1 = 0;
-    static float Xv2m1 = 0;
-    static float Yv1m1 = 0;
-    static float Yv2m1 = 0;
-    static float Zv1m1 = 0;
-    static float Zv2m1 = 0;
     int16_t X = 0;
     int16_t Y = 0;
     int16_t Z = 0;
     
     GetRawData( &X, &Y, &Z );
-    
-    FilterX = iirfilter(((float)X), &Xv1m1, &Xv2m1);
-    FilterY = iirfilter(((float)Y), &Yv1m1, &Yv2m1);
-    FilterZ = iirfilter(((float)Z), &Zv1m1, &Zv2m1);    
+    AddSample( X, Y, Z );
+}
+
+/* Filter a raw sample
+ */
+void HalAccelerometer::AddSample( int16_t X, int16_t Y, int16_t Z )
+{
+    Filter.Filter( (float)X, (float)Y, (float)Z, &FilterX, &FilterY, &FilterZ );
 }
     
     
@@ -143,7 +142,15 @@ void HalAccelerometer::GetRawData( int16_t* X, int16_t* Y, int16_t* Z )
     int16_t YRaw = 0;
     int16_t ZRaw = 0;
     
-    Accel.getAcceleration( &XRaw, &YRaw, &ZRaw);
+    if ( HalCapture::Capture.IsReplaying() )
+    {
+        HalCapture::Capture.GetAccel( &XRaw, &YRaw, &ZRaw );
+    }
+    else
+    {
+        Accel.getAcceleration( &XRaw, &YRaw, &ZRaw);
+        HalCapture::Capture.RecordAccel( XRaw, YRaw, ZRaw );
+    }
     
 #ifdef OBJECTIVE_END_ACCEL_X_PLUS    
     *X = XRaw;
@@ -25,6 +25,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdint.h>
 #include "Runnable.h"
+#include "SosFilter.h"
+
+#define HAL_ACCELEROMETER_FILTER_SECTIONS 1u /**< second order sections in the axis filter */
 
 /** HalAccelerometer
  * - Class to provide use of the Accelerometer
@@ -41,6 +44,10 @@ class HalAccelerometer: public Runnable {
         /** runs the filter and updates the Roll and Pitch
          */
             void  Run( void );
+        /** Filter a raw sample, Run reads one from the device and the
+         *  benchmark makes its own
+         */
+            void AddSample( int16_t X, int16_t Y, int16_t Z );
         /** Access to the Accelerometer data.
          */
             void GetAll( float* Ax, float* Ay, float* Az );
@@ -71,6 +78,7 @@ class HalAccelerometer: public Runnable {
         float FilterX;   /**< storage for X axis filter data */
         float FilterY;   /**< storage for Y axis filter data */
         float FilterZ;   /**< storage for Z axis filter data */
+        SosFilter<HAL_ACCELEROMETER_FILTER_SECTIONS> Filter; /**< filter for all three axes */
 };
 
 #endif /* HAL_ACCELEROMETER_H */
@@ -0,0 +1,472 @@
+/*
+HalCapture records the raw sensor samples, GPS fixes and scheduler events
+to an append only binary log, and can play a recorded log back through
+the HAL so a session can be reproduced away from the telescope.
+
+Author and copyright of this file:
+Chris Dick, 2016
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include "HalCapture.h"
+
+HalCapture HalCapture::Capture;
+
+/* Constructor
+ */
+HalCapture::HalCapture( void )
+{
+    Mode = HAL_CAPTURE_OFF;
+    File = -1;
+    Start = 0u;
+    Buffer = NULL;
+    BufferUsed = 0u;
+    Writing = NULL;
+    Dropped = 0u;
+    TimerFd = -1;
+    pthread_mutex_init( &BufferLock, NULL );
+    pthread_mutex_init( &FlushLock, NULL );
+    Map = NULL;
+    MapSize = 0u;
+    Position = 0u;
+    ReplayTime = 0u;
+    memset( &Accel, 0, sizeof( Accel ) );
+    memset( &Mag, 0, sizeof( Mag ) );
+    memset( &Gps, 0, sizeof( Gps ) );
+    GpsValid = false;
+}
+
+/* Start recording or replaying
+ * @return bool true if the file could be opened
+ */
+bool HalCapture::Init( HAL_CAPTURE_MODE_T NewMode, const char* FileName )
+{
+    bool Result = false;
+    HAL_CAPTURE_HEADER_T Header;
+    struct stat FileStat;
+
+    Close();
+    if ( NewMode == HAL_CAPTURE_RECORD )
+    {
+        struct timeval Now;
+        File = open( FileName, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+        Buffer = (uint8_t*)malloc( HAL_CAPTURE_BUFFER_SIZE );
+        Writing = (uint8_t*)malloc( HAL_CAPTURE_BUFFER_SIZE );
+        if ( ( File >= 0 ) && ( Buffer != NULL ) && ( Writing != NULL ) )
+        {
+            gettimeofday( &Now, NULL );
+            Header.Magic = HAL_CAPTURE_MAGIC;
+            Header.Version = HAL_CAPTURE_VERSION;
+            Header.Reserved = 0u;
+            Header.StartTime = ( (int64_t)Now.tv_sec * 1000000 ) + Now.tv_usec;
+            Result = ( write( File, &Header, sizeof( Header ) ) == (ssize_t)sizeof( Header ) );
+        }
+    }
+    else if ( ( NewMode == HAL_CAPTURE_REPLAY ) || ( NewMode == HAL_CAPTURE_REPLAY_FAST ) )
+    {
+        /* nothing from an earlier replay carries over */
+        ReplayTime = 0u;
+        memset( &Accel, 0, sizeof( Accel ) );
+        memset( &Mag, 0, sizeof( Mag ) );
+        memset( &Gps, 0, sizeof( Gps ) );
+        GpsValid = false;
+        File = open( FileName, O_RDONLY );
+        if ( ( File >= 0 ) && ( fstat( File, &FileStat ) == 0 ) && ( (size_t)FileStat.st_size >= sizeof( Header ) ) )
+        {
+            void* Mapping = mmap( NULL, FileStat.st_size, PROT_READ, MAP_PRIVATE, File, 0 );
+            if ( Mapping != MAP_FAILED )
+            {
+                Map = (const uint8_t*)Mapping;
+                MapSize = FileStat.st_size;
+                memcpy( &Header, Map, sizeof( Header ) );
+                Result = ( Header.Magic == HAL_CAPTURE_MAGIC ) && ( Header.Version == HAL_CAPTURE_VERSION );
+                Position = sizeof( Header );
+                madvise( Mapping, MapSize, MADV_SEQUENTIAL );
+            }
+        }
+    }
+    else
+    {
+        Result = true;
+    }
+
+    if ( Result )
+    {
+        Mode = NewMode;
+        Start = 0u;
+        Start = Elapsed();
+    }
+    else
+    {
+        printf( "HalCapture: unable to use %s\n", FileName );
+        Close();
+    }
+    return Result;
+}
+
+/* Write the records out from the reactor thread while recording
+ */
+bool HalCapture::StartFlushing( void )
+{
+    if ( ( Mode == HAL_CAPTURE_RECORD ) && ( TimerFd < 0 ) )
+    {
+        TimerFd = HalReactor::Reactor.AddTimer( HAL_CAPTURE_FLUSH_PERIOD, this );
+        return ( TimerFd >= 0 );
+    }
+    return true;
+}
+
+/* Write out the records recorded so far. The buffers are swapped so the
+ * tasks can carry on appending while the file is written.
+ */
+void HalCapture::Flush( void )
+{
+    pthread_mutex_lock( &FlushLock );
+    if ( Mode == HAL_CAPTURE_RECORD )
+    {
+        uint8_t* Full = NULL;
+        size_t Used = 0u;
+        size_t Written = 0u;
+        uint32_t Lost = 0u;
+        pthread_mutex_lock( &BufferLock );
+        Full = Buffer;
+        Used = BufferUsed;
+        Lost = Dropped;
+        Buffer = Writing;
+        BufferUsed = 0u;
+        Dropped = 0u;
+        Writing = Full;
+        pthread_mutex_unlock( &BufferLock );
+        if ( Lost > 0u )
+        {
+            printf( "HalCapture: %u records dropped, the log could not keep up\n", Lost );
+        }
+        while ( Written < Used )
+        {
+            ssize_t Result = write( File, &Writing[Written], Used - Written );
+            if ( Result <= 0 )
+            {
+                /* the log is best effort, never stall the telescope */
+                printf( "HalCapture: write failed, recording stopped\n" );
+                pthread_mutex_lock( &BufferLock );
+                Mode = HAL_CAPTURE_OFF;
+                pthread_mutex_unlock( &BufferLock );
+                break;
+            }
+            Written += Result;
+        }
+    }
+    pthread_mutex_unlock( &FlushLock );
+}
+
+/* Write out the records from a fatal signal handler. Nothing is locked,
+ * a record being appended or written when the signal came may be lost.
+ */
+void HalCapture::FlushFromSignal( void )
+{
+    if ( ( Mode == HAL_CAPTURE_RECORD ) && ( File >= 0 ) && ( Buffer != NULL ) )
+    {
+        (void)write( File, Buffer, BufferUsed );
+    }
+}
+
+/* Flush and close the log
+ */
+void HalCapture::Close( void )
+{
+    if ( TimerFd >= 0 )
+    {
+        HalReactor::Reactor.Remove( TimerFd );
+        close( TimerFd );
+        TimerFd = -1;
+    }
+    Flush();
+    Mode = HAL_CAPTURE_OFF;
+    if ( Map != NULL )
+    {
+        munmap( (void*)Map, MapSize );
+        Map = NULL;
+        MapSize = 0u;
+    }
+    if ( File >= 0 )
+    {
+        close( File );
+        File = -1;
+    }
+    free( Buffer );
+    free( Writing );
+    Buffer = NULL;
+    Writing = NULL;
+    BufferUsed = 0u;
+    Dropped = 0u;
+}
+
+/* Record a GPS fix, does nothing if not recording
+ */
+void HalCapture::RecordGps( double Latitude, double Longitude, double Height, time_t Time, uint8_t FixMode, uint8_t NumberOfSatellites )
+{
+    if ( Mode == HAL_CAPTURE_RECORD )
+    {
+        HAL_CAPTURE_GPS_T Record;
+        memset( &Record, 0, sizeof( Record ) );
+        Record.Stamp = HAL_CAPTURE_STAMP( Elapsed(), sizeof( Record ) / 8u, HAL_CAPTURE_GPS );
+        Record.Latitude = Latitude;
+        Record.Longitude = Longitude;
+        Record.Height = Height;
+        Record.Time = Time;
+        Record.Mode = FixMode;
+        Record.NumberOfSatellites = NumberOfSatellites;
+        Append( &Record, sizeof( Record ) );
+    }
+}
+
+/* Scheduler dispatch hook, records the task if recording
+ */
+void HalCapture::RecordTask( uint8_t Task )
+{
+    if ( Capture.Mode == HAL_CAPTURE_RECORD )
+    {
+        HAL_CAPTURE_TASK_T Record;
+        memset( &Record, 0, sizeof( Record ) );
+        Record.Stamp = HAL_CAPTURE_STAMP( Capture.Elapsed(), sizeof( Record ) / 8u, HAL_CAPTURE_TASK );
+        Record.Task = Task;
+        Capture.Append( &Record, sizeof( Record ) );
+    }
+}
+
+/* Get the replayed accelerometer sample
+ */
+void HalCapture::GetAccel( int16_t* X, int16_t* Y, int16_t* Z )
+{
+    Advance();
+    *X = Accel.X;
+    *Y = Accel.Y;
+    *Z = Accel.Z;
+}
+
+/* Get the replayed magnetometer sample
+ */
+void HalCapture::GetMag( int16_t* X, int16_t* Y, int16_t* Z )
+{
+    Advance();
+    *X = Mag.X;
+    *Y = Mag.Y;
+    *Z = Mag.Z;
+}
+
+/* Get the replayed GPS fix
+ * @return bool true if a fix has been replayed
+ */
+bool HalCapture::GetGps( double* Latitude, double* Longitude, double* Height, time_t* Time, uint8_t* FixMode, uint8_t* NumberOfSatellites )
+{
+    Advance();
+    if ( GpsValid )
+    {
+        *Latitude = Gps.Latitude;
+        *Longitude = Gps.Longitude;
+        *Height = Gps.Height;
+        *Time = (time_t)Gps.Time;
+        *FixMode = Gps.Mode;
+        *NumberOfSatellites = Gps.NumberOfSatellites;
+    }
+    return GpsValid;
+}
+
+/* Fast replay, consume the next scheduler event and the samples after it.
+ * The task is recorded as it is dispatched, so the samples it read while
+ * it ran follow it in the log and must be in place before it runs again.
+ * @return bool false at the end of the log
+ */
+bool HalCapture::ReplayNextTask( uint8_t* Task )
+{
+    bool Result = false;
+    while ( ( Result == false ) && ( Position < MapSize ) )
+    {
+        const size_t Current = Position;
+        if ( Consume() == HAL_CAPTURE_TASK )
+        {
+            HAL_CAPTURE_TASK_T Record;
+            memcpy( &Record, &Map[Current], sizeof( Record ) );
+            *Task = Record.Task;
+            Result = true;
+        }
+    }
+    while ( Result && ( ( MapSize - Position ) >= sizeof( uint64_t ) ) )
+    {
+        uint64_t Stamp;
+        memcpy( &Stamp, &Map[Position], sizeof( Stamp ) );
+        if ( HAL_CAPTURE_STAMP_TYPE( Stamp ) == HAL_CAPTURE_TASK )
+        {
+            break;
+        }
+        (void)Consume();
+    }
+    return Result;
+}
+
+/* Get the time of the last replayed record
+ */
+uint64_t HalCapture::GetReplayTime( void )
+{
+    return ReplayTime;
+}
+
+/* Append a sensor record
+ */
+void HalCapture::RecordSample( uint8_t Type, int16_t X, int16_t Y, int16_t Z )
+{
+    HAL_CAPTURE_SAMPLE_T Record;
+    Record.Stamp = HAL_CAPTURE_STAMP( Elapsed(), sizeof( Record ) / 8u, Type );
+    Record.X = X;
+    Record.Y = Y;
+    Record.Z = Z;
+    Record.Reserved = 0u;
+    Append( &Record, sizeof( Record ) );
+}
+
+/* Append a record to the buffer, the file is written by Flush on another
+ * thread, if it falls behind the record is dropped rather than wait
+ */
+void HalCapture::Append( const void* Record, size_t Size )
+{
+    pthread_mutex_lock( &BufferLock );
+    if ( Mode == HAL_CAPTURE_RECORD )
+    {
+        if ( ( BufferUsed + Size ) <= HAL_CAPTURE_BUFFER_SIZE )
+        {
+            memcpy( &Buffer[BufferUsed], Record, Size );
+            BufferUsed += Size;
+        }
+        else
+        {
+            Dropped++;
+        }
+    }
+    pthread_mutex_unlock( &BufferLock );
+}
+
+/* Flush timer on the reactor thread
+ */
+void HalCapture::HandleEvents( uint32_t Events )
+{
+    uint64_t Expirations = 0u;
+    (void)Events;
+    if ( read( TimerFd, &Expirations, sizeof( Expirations ) ) == (ssize_t)sizeof( Expirations ) )
+    {
+        Flush();
+    }
+}
+
+/* Replay the records up to the current time
+ * In fast replay the records are consumed by ReplayNextTask instead.
+ */
+void HalCapture::Advance( void )
+{
+    if ( Mode == HAL_CAPTURE_REPLAY )
+    {
+        const uint64_t Now = Elapsed();
+        while ( ( MapSize - Position ) >= sizeof( uint64_t ) )
+        {
+            uint64_t Stamp;
+            memcpy( &Stamp, &Map[Position], sizeof( Stamp ) );
+            if ( HAL_CAPTURE_STAMP_TIME( Stamp ) > Now )
+            {
+                break;
+            }
+            (void)Consume();
+        }
+    }
+}
+
+/* Apply one record to the replayed values
+ * A record shorter than its type or running past the end of the log
+ * stops the replay.
+ * @return uint8_t the record type, 0 if the replay stopped
+ */
+uint8_t HalCapture::Consume( void )
+{
+    uint64_t Stamp;
+    size_t Size;
+    size_t Needed;
+    uint8_t Type;
+
+    if ( ( MapSize - Position ) < sizeof( Stamp ) )
+    {
+        /* a partial stamp at the end of the log */
+        Position = MapSize;
+        return 0u;
+    }
+    memcpy( &Stamp, &Map[Position], sizeof( Stamp ) );
+    Size = HAL_CAPTURE_STAMP_WORDS( Stamp ) * 8u;
+    Type = HAL_CAPTURE_STAMP_TYPE( Stamp );
+    switch ( Type )
+    {
+        case HAL_CAPTURE_ACCEL:
+        case HAL_CAPTURE_MAG:
+            Needed = sizeof( HAL_CAPTURE_SAMPLE_T );
+            break;
+        case HAL_CAPTURE_GPS:
+            Needed = sizeof( HAL_CAPTURE_GPS_T );
+            break;
+        case HAL_CAPTURE_TASK:
+            Needed = sizeof( HAL_CAPTURE_TASK_T );
+            break;
+        default:
+            Needed = sizeof( Stamp );
+            break;
+    }
+    if ( ( Size < Needed ) || ( Size > ( MapSize - Position ) ) )
+    {
+        /* truncated or corrupt, stop the replay here */
+        Position = MapSize;
+        return 0u;
+    }
+    switch ( Type )
+    {
+        case HAL_CAPTURE_ACCEL:
+            memcpy( &Accel, &Map[Position], sizeof( Accel ) );
+            break;
+        case HAL_CAPTURE_MAG:
+            memcpy( &Mag, &Map[Position], sizeof( Mag ) );
+            break;
+        case HAL_CAPTURE_GPS:
+            memcpy( &Gps, &Map[Position], sizeof( Gps ) );
+            GpsValid = true;
+            break;
+        default:
+            /* scheduler events and unknown records carry no HAL data */
+            break;
+    }
+    ReplayTime = HAL_CAPTURE_STAMP_TIME( Stamp );
+    Position += Size;
+    return Type;
+}
+
+/* Microseconds since the start of the recording or replay
+ */
+uint64_t HalCapture::Elapsed( void )
+{
+    struct timespec Now;
+    clock_gettime( CLOCK_MONOTONIC, &Now );
+    return ( ( (uint64_t)Now.tv_sec * 1000000u ) + ( Now.tv_nsec / 1000u ) ) - Start;
+}
@@ -0,0 +1,240 @@
+/**
+HalCapture records the raw sensor samples, GPS fixes and scheduler events
+to an append only binary log, and can play a recorded log back through
+the HAL so a session can be reproduced away from the telescope.
+
+The log is a HAL_CAPTURE_HEADER_T followed by records. Every record
+starts with a 64 bit stamp holding the time in microseconds since the
+start of the recording, the record length in 8 byte words and the record
+type, so the file can be mapped and walked without parsing. All values
+are in the byte order of the machine that made the recording.
+
+Author and copyright of this file:
+Chris Dick, 2016
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef HALCAPTURE_H
+#define HALCAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include "HalReactor.h"
+
+/* Configuration */
+
+#define HAL_CAPTURE_MAGIC       0x50435053u /**< "SPCP" */
+#define HAL_CAPTURE_VERSION     1u
+#define HAL_CAPTURE_BUFFER_SIZE 65536u      /**< records held between flushes, any more are dropped */
+#define HAL_CAPTURE_FLUSH_PERIOD 250000u    /**< microseconds between writes from the reactor thread */
+
+/* Record stamp layout */
+#define HAL_CAPTURE_STAMP(Time, Words, Type) ( ( (uint64_t)(Time) << 16 ) | ( (uint64_t)(Words) << 8 ) | (uint64_t)(Type) )
+#define HAL_CAPTURE_STAMP_TIME(Stamp)        ( (Stamp) >> 16 )
+#define HAL_CAPTURE_STAMP_WORDS(Stamp)       ( (uint8_t)( (Stamp) >> 8 ) )
+#define HAL_CAPTURE_STAMP_TYPE(Stamp)        ( (uint8_t)(Stamp) )
+
+/** Types of record in the log */
+typedef enum
+{
+    HAL_CAPTURE_ACCEL = 1,  /**< raw accelerometer sample, HAL_CAPTURE_SAMPLE_T */
+    HAL_CAPTURE_MAG   = 2,  /**< raw magnetometer sample, HAL_CAPTURE_SAMPLE_T */
+    HAL_CAPTURE_GPS   = 3,  /**< GPS fix, HAL_CAPTURE_GPS_T */
+    HAL_CAPTURE_TASK  = 4   /**< scheduler dispatched a task, HAL_CAPTURE_TASK_T */
+} HAL_CAPTURE_TYPE_T;
+
+/** Replay modes */
+typedef enum
+{
+    HAL_CAPTURE_OFF,        /**< normal operation */
+    HAL_CAPTURE_RECORD,     /**< record to the log */
+    HAL_CAPTURE_REPLAY,     /**< replay the log at the recorded speed */
+    HAL_CAPTURE_REPLAY_FAST /**< replay the log as fast as possible */
+} HAL_CAPTURE_MODE_T;
+
+/** File header */
+typedef struct
+{
+    uint32_t Magic;
+    uint16_t Version;
+    uint16_t Reserved;
+    int64_t  StartTime;     /**< wall clock time of the start of the recording in microseconds */
+} HAL_CAPTURE_HEADER_T;
+
+/** Raw sensor sample */
+typedef struct
+{
+    uint64_t Stamp;
+    int16_t  X;
+    int16_t  Y;
+    int16_t  Z;
+    uint16_t Reserved;
+} HAL_CAPTURE_SAMPLE_T;
+
+/** GPS fix */
+typedef struct
+{
+    uint64_t Stamp;
+    double   Latitude;
+    double   Longitude;
+    double   Height;
+    int64_t  Time;
+    uint8_t  Mode;
+    uint8_t  NumberOfSatellites;
+    uint8_t  Reserved[6];
+} HAL_CAPTURE_GPS_T;
+
+/** Scheduler event */
+typedef struct
+{
+    uint64_t Stamp;
+    uint8_t  Task;          /**< index of the task in the scheduler */
+    uint8_t  Reserved[7];
+} HAL_CAPTURE_TASK_T;
+
+/** HalCapture
+ * - Class to record and replay the sensor data
+ */
+class HalCapture : public HalReactorHandler
+{
+    public:
+    /** Constructor
+     */
+        HalCapture( void );
+    /** Start recording or replaying
+     * @param Mode the capture mode
+     * @param FileName the log file
+     * @return bool true if the file could be opened
+     */
+        bool Init( HAL_CAPTURE_MODE_T Mode, const char* FileName );
+    /** Write the records out from the reactor thread while recording, so
+     *  the scheduler never waits for the file, call after the reactor Init
+     * @return bool true if not recording or the timer was added
+     */
+        bool StartFlushing( void );
+    /** Write out the records recorded so far, not on the scheduler thread
+     */
+        void Flush( void );
+    /** Write out the records from a fatal signal handler, without locking
+     */
+        void FlushFromSignal( void );
+    /** Flush and close the log
+     */
+        void Close( void );
+    /** Is a log being replayed
+     */
+        inline bool IsReplaying( void ) const
+        {
+            return ( ( Mode == HAL_CAPTURE_REPLAY ) || ( Mode == HAL_CAPTURE_REPLAY_FAST ) );
+        }
+    /** Is a log being replayed as fast as possible
+     */
+        inline bool IsFastReplay( void ) const
+        {
+            return ( Mode == HAL_CAPTURE_REPLAY_FAST );
+        }
+    /** Record a raw accelerometer sample, does nothing if not recording
+     */
+        inline void RecordAccel( int16_t X, int16_t Y, int16_t Z )
+        {
+            if ( Mode == HAL_CAPTURE_RECORD )
+            {
+                RecordSample( HAL_CAPTURE_ACCEL, X, Y, Z );
+            }
+        }
+    /** Record a raw magnetometer sample, does nothing if not recording
+     */
+        inline void RecordMag( int16_t X, int16_t Y, int16_t Z )
+        {
+            if ( Mode == HAL_CAPTURE_RECORD )
+            {
+                RecordSample( HAL_CAPTURE_MAG, X, Y, Z );
+            }
+        }
+    /** Record a GPS fix, does nothing if not recording
+     */
+        void RecordGps( double Latitude, double Longitude, double Height, time_t Time, uint8_t Mode, uint8_t NumberOfSatellites );
+    /** Scheduler dispatch hook, records the task if recording
+     * @param Task index of the task in the scheduler
+     */
+        static void RecordTask( uint8_t Task );
+    /** Get the replayed accelerometer sample
+     */
+        void GetAccel( int16_t* X, int16_t* Y, int16_t* Z );
+    /** Get the replayed magnetometer sample
+     */
+        void GetMag( int16_t* X, int16_t* Y, int16_t* Z );
+    /** Get the replayed GPS fix
+     * @return bool true if a fix has been replayed
+     */
+        bool GetGps( double* Latitude, double* Longitude, double* Height, time_t* Time, uint8_t* Mode, uint8_t* NumberOfSatellites );
+    /** Fast replay, consume records up to and including the next scheduler
+     *  event, then the samples recorded while that task ran
+     * @param Task index of the task to run
+     * @return bool false at the end of the log
+     */
+        bool ReplayNextTask( uint8_t* Task );
+    /** Get the time of the last replayed record
+     * @return uint64_t microseconds since the start of the recording
+     */
+        uint64_t GetReplayTime( void );
+
+        static HalCapture Capture;    /**< Only one is required */
+
+    private:
+    /** Append a sensor record
+     */
+        void RecordSample( uint8_t Type, int16_t X, int16_t Y, int16_t Z );
+    /** Append a record to the write buffer
+     */
+        void Append( const void* Record, size_t Size );
+    /** Flush timer on the reactor thread
+     */
+        void HandleEvents( uint32_t Events );
+    /** Replay the records up to the current time
+     */
+        void Advance( void );
+    /** Apply one record to the replayed values, a record shorter than its
+     *  type or past the end of the log stops the replay
+     * @return uint8_t the record type, 0 if the replay stopped
+     */
+        uint8_t Consume( void );
+    /** Microseconds since the start of the recording or replay
+     */
+        uint64_t Elapsed( void );
+
+        HAL_CAPTURE_MODE_T Mode;     /**< current mode */
+        int File;                    /**< log file descriptor */
+        uint64_t Start;              /**< monotonic time of the start in microseconds */
+        uint8_t* Buffer;             /**< records being appended, under BufferLock */
+        size_t BufferUsed;           /**< bytes in Buffer */
+        uint8_t* Writing;            /**< records being written, swapped with Buffer under FlushLock */
+        uint32_t Dropped;            /**< records dropped because Buffer was full */
+        int TimerFd;                 /**< flush timer, negative if none */
+        pthread_mutex_t BufferLock;  /**< held while appending or swapping the buffers */
+        pthread_mutex_t FlushLock;   /**< held while writing, there may be several flushers */
+        const uint8_t* Map;          /**< mapped log being replayed */
+        size_t MapSize;              /**< size of the mapping */
+        size_t Position;             /**< offset of the next record to replay */
+        uint64_t ReplayTime;         /**< time of the last replayed record */
+        HAL_CAPTURE_SAMPLE_T Accel;  /**< last replayed accelerometer sample */
+        HAL_CAPTURE_SAMPLE_T Mag;    /**< last replayed magnetometer sample */
+        HAL_CAPTURE_GPS_T Gps;       /**< last replayed GPS fix */
+        bool GpsValid;               /**< a GPS fix has been replayed */
+};
+
+#endif /* HALCAPTURE_H */
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "HalCapture.h"
+/*
+ HalCapture test
+ Records dispatches the way the scheduler and the tasks do, the task
+ first and then the samples it reads while it runs, and replays them as
+ fast as possible. Each replayed task must see the samples it read when
+ it was recorded, not those of the dispatch before. A record shorter than
+ its type must stop the replay rather than be read past. Then the records must
+ reach the file from the reactor thread while the recording carries on.
+ Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal Src/Hal/HalCapture_test.cpp Src/Hal/HalCapture.cpp \
+     Src/Hal/HalReactor.cpp -lpthread -o HalCapture_test
+ ./HalCapture_test
+ */
+
+#define TEST_FILE   "/tmp/HalCapture_test.log"
+
+static int failures = 0;
+
+static off_t fileSize(const char* path)
+{
+    struct stat status;
+    return (stat(path, &status) == 0) ? status.st_size : -1;
+}
+
+/* add a bare stamp to the end of the log, as a corrupt record */
+static void appendStamp(const char* path, uint8_t words, uint8_t type, size_t size)
+{
+    const uint64_t stamp = HAL_CAPTURE_STAMP(1u, words, type);
+    FILE* file = fopen(path, "ab");
+    if (file != NULL)
+    {
+        fwrite(&stamp, 1, size, file);
+        fclose(file);
+    }
+}
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+int main()
+{
+    HalCapture& capture = HalCapture::Capture;
+    int16_t x = 0;
+    int16_t y = 0;
+    int16_t z = 0;
+    uint8_t task = 0xFFu;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    double height = 0.0;
+    time_t time = 0;
+    uint8_t mode = 0u;
+    uint8_t satellites = 0u;
+
+    /* two dispatches of the orientation task and one of the GPS task */
+    check(capture.Init(HAL_CAPTURE_RECORD, TEST_FILE), "record");
+    HalCapture::RecordTask(1u);
+    capture.RecordAccel(100, 101, 102);
+    capture.RecordMag(200, 201, 202);
+    HalCapture::RecordTask(1u);
+    capture.RecordAccel(300, 301, 302);
+    capture.RecordMag(400, 401, 402);
+    HalCapture::RecordTask(0u);
+    capture.RecordGps(51.5, -0.1, 0.05, 1530000000, 3u, 9u);
+    capture.Close();
+
+    check(capture.Init(HAL_CAPTURE_REPLAY_FAST, TEST_FILE), "replay");
+    check(capture.ReplayNextTask(&task) && (task == 1u), "first dispatch");
+    capture.GetAccel(&x, &y, &z);
+    check((x == 100) && (y == 101) && (z == 102), "first dispatch sees its accelerometer sample");
+    capture.GetMag(&x, &y, &z);
+    check((x == 200) && (y == 201) && (z == 202), "first dispatch sees its magnetometer sample");
+    check(!capture.GetGps(&latitude, &longitude, &height, &time, &mode, &satellites), "no GPS fix before it was recorded");
+
+    check(capture.ReplayNextTask(&task) && (task == 1u), "second dispatch");
+    capture.GetAccel(&x, &y, &z);
+    check((x == 300) && (y == 301) && (z == 302), "second dispatch sees its accelerometer sample");
+    capture.GetMag(&x, &y, &z);
+    check((x == 400) && (y == 401) && (z == 402), "second dispatch sees its magnetometer sample");
+
+    check(capture.ReplayNextTask(&task) && (task == 0u), "third dispatch");
+    check(capture.GetGps(&latitude, &longitude, &height, &time, &mode, &satellites)
+          && (latitude == 51.5) && (time == 1530000000) && (mode == 3u) && (satellites == 9u),
+          "GPS dispatch sees its fix");
+    check(!capture.ReplayNextTask(&task), "end of the log");
+    capture.Close();
+
+    /* a GPS stamp that claims one word at the very end of the log */
+    check(capture.Init(HAL_CAPTURE_RECORD, TEST_FILE), "record a log to corrupt");
+    HalCapture::RecordTask(2u);
+    capture.Close();
+    appendStamp(TEST_FILE, 1u, HAL_CAPTURE_GPS, sizeof(uint64_t));
+    check(capture.Init(HAL_CAPTURE_REPLAY_FAST, TEST_FILE), "replay the corrupt log");
+    check(capture.ReplayNextTask(&task) && (task == 2u), "dispatch before the corrupt record");
+    check(!capture.GetGps(&latitude, &longitude, &height, &time, &mode, &satellites), "a short GPS record is not loaded as a fix");
+    check(!capture.ReplayNextTask(&task), "the replay stops at the short record");
+    capture.Close();
+
+    /* a task stamp that claims one word, then half a stamp */
+    check(capture.Init(HAL_CAPTURE_RECORD, TEST_FILE), "record a log to truncate");
+    capture.Close();
+    appendStamp(TEST_FILE, 1u, HAL_CAPTURE_TASK, sizeof(uint64_t));
+    appendStamp(TEST_FILE, 2u, HAL_CAPTURE_ACCEL, sizeof(uint32_t));
+    check(capture.Init(HAL_CAPTURE_REPLAY_FAST, TEST_FILE), "replay the truncated log");
+    check(!capture.ReplayNextTask(&task), "a short task record is not dispatched");
+    capture.Close();
+    check(capture.Init(HAL_CAPTURE_RECORD, TEST_FILE), "record a log ending part way through a stamp");
+    HalCapture::RecordTask(3u);
+    capture.Close();
+    appendStamp(TEST_FILE, 2u, HAL_CAPTURE_ACCEL, sizeof(uint32_t));
+    check(capture.Init(HAL_CAPTURE_REPLAY_FAST, TEST_FILE), "replay the log ending part way through a stamp");
+    check(capture.ReplayNextTask(&task) && (task == 3u), "dispatch before the partial stamp");
+    check(!capture.ReplayNextTask(&task), "the replay stops at the partial stamp");
+    capture.Close();
+
+    /* the reactor writes the records out without a Close */
+    check(HalReactor::Reactor.Init() && HalReactor::Reactor.Start(), "reactor");
+    check(capture.Init(HAL_CAPTURE_RECORD, TEST_FILE) && capture.StartFlushing(), "record with the flush timer");
+    HalCapture::RecordTask(1u);
+    capture.RecordAccel(1, 2, 3);
+    check(fileSize(TEST_FILE) == (off_t)sizeof(HAL_CAPTURE_HEADER_T), "records held until the flush");
+    usleep(2u * HAL_CAPTURE_FLUSH_PERIOD);
+    check(fileSize(TEST_FILE) == (off_t)(sizeof(HAL_CAPTURE_HEADER_T) + sizeof(HAL_CAPTURE_TASK_T) + sizeof(HAL_CAPTURE_SAMPLE_T)),
+          "records written by the reactor before the log is closed");
+    capture.RecordMag(4, 5, 6);
+    capture.Flush();
+    check(fileSize(TEST_FILE) == (off_t)(sizeof(HAL_CAPTURE_HEADER_T) + sizeof(HAL_CAPTURE_TASK_T) + (2u * sizeof(HAL_CAPTURE_SAMPLE_T))),
+          "records written by a flush on request");
+    HalReactor::Reactor.Stop();
+    for (uint32_t i = 0u; i < ((HAL_CAPTURE_BUFFER_SIZE / sizeof(HAL_CAPTURE_SAMPLE_T)) + 10u); i++)
+    {
+        capture.RecordAccel(7, 8, 9);
+    }
+    capture.Close();
+    check(fileSize(TEST_FILE) == (off_t)(sizeof(HAL_CAPTURE_HEADER_T) + sizeof(HAL_CAPTURE_TASK_T) + (2u * sizeof(HAL_CAPTURE_SAMPLE_T))
+                                         + HAL_CAPTURE_BUFFER_SIZE),
+          "records beyond a full buffer dropped rather than written by the task");
+    unlink(TEST_FILE);
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -21,10 +21,10 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "HalGps.h"
 #include "Config.h"
-
-#ifdef TIMING
-#include "GPIO.h"
-#endif
+#include "HalCapture.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include <math.h>
 
 HalGps   HalGps::Gps;
 double   HalGps::Longitude;          /**< longitude of the telescope       */
@@ -34,8 +34,16 @@ double   HalGps::Height;             /**< current height of the Gps        */
 uint8_t  HalGps::Mode;               /**< fix mode                         */
 uint8_t  HalGps::NumberOfSatellites; /**< the number of satellites in view */
 uint16_t HalGps::GpsdPort;           /**< port to connect to GPSD          */
+int64_t  HalGps::FixTime = 0;       /**< when the last fix arrived        */
 gpsmm* HalGps::gps_ptr;
 
+/* Sample the fix age for Metrics */
+static double SampleFixAge( void* Context )
+{
+    (void)Context;
+    return HalGps::Gps.GetFixAge();
+}
+
 /* HalGps
  *  Constructor
  */
@@ -54,11 +62,9 @@ bool HalGps::Init( void )
     bool result;
  
     result = ( gps_ptr->stream(WATCH_ENABLE|WATCH_JSON) != NULL);
-
-#ifdef TIMING
-    GPIO::gpio.SetupOutput( HAL_GPS_PIN );
-    GPIO::gpio.SetPullMode( HAL_GPS_PIN , PULL_UP );
-#endif
+    (void)Metrics::RegisterSampled( "starpi_gps_fix_age_seconds", "",
+                                    "Seconds since the last GPS position with a fix, NaN before the first",
+                                    METRIC_GAUGE, &SampleFixAge, NULL );
 
     return result;
 }
@@ -68,15 +74,20 @@ bool HalGps::Init( void )
  */
 void HalGps::Run( void )
 {
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( HAL_GPS_PIN , true );
-    #endif
+    TRACE_BEGIN( TRACE_HAL_GPS, 0u );
     /*
     Check to see if there is new data, then update if it's relevent.
     */
     struct gps_data_t* NewGpsData;
 
-    if (gps_ptr->waiting(20))
+    if ( HalCapture::Capture.IsReplaying() )
+    {
+        if ( HalCapture::Capture.GetGps( &Latitude, &Longitude, &Height, &Time, &Mode, &NumberOfSatellites ) && GetFix() )
+        {
+            FixTime = Metrics::NowMicros();
+        }
+    }
+    else if (gps_ptr->waiting(20))
     {
     if ((NewGpsData = gps_ptr->read()) != NULL) 
     {
@@ -101,11 +112,14 @@ void HalGps::Run( void )
         {    
             Mode = NewGpsData->fix.mode;
         }
+        if ( ( NewGpsData->set & LATLON_SET ) && GetFix() )
+        {
+            FixTime = Metrics::NowMicros();
+        }
+        HalCapture::Capture.RecordGps( Latitude, Longitude, Height, Time, Mode, NumberOfSatellites );
     }
     }
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( HAL_GPS_PIN , false );
-    #endif
+    TRACE_END( TRACE_HAL_GPS, 0u );
 }
 
 /* HalGpsGetHeading
@@ -189,3 +203,16 @@ double HalGps::GetHeightInkm( void )
 {
     return (Height/1000.0);
 }
+
+/* HalGpsGetFixAge
+ *  Get the time since the last position with a fix
+ * @return double seconds, NAN if there has not been one
+ */
+double HalGps::GetFixAge( void )
+{
+    if ( FixTime == 0 )
+    {
+        return NAN;
+    }
+    return ( Metrics::NowMicros() - FixTime ) * 1.0e-6;
+}
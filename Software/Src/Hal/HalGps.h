@@ -90,6 +90,10 @@ class HalGps: public Runnable
      * @return double Height
      */    
         double GetHeightInkm( void );
+    /** Get the time since the last position with a fix
+     * @return double seconds, NAN if there has not been one
+     */
+        double GetFixAge( void );
        
         static HalGps Gps;
         
@@ -101,6 +105,7 @@ class HalGps: public Runnable
         static uint8_t Mode;               /**< fix mode                         */
         static uint8_t NumberOfSatellites; /**< the number of satellites in view */
         static uint16_t GpsdPort;          /**< port to connect to GPSD */
+        static int64_t FixTime;            /**< Metrics::NowMicros of the last position with a fix, 0 if none */
 };
 
 #endif /* HALGPS_H */
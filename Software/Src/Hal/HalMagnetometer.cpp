@@ -22,6 +22,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 #include "HalMagnetometer.h"
 #include "Config.h"
+#include "HalCapture.h"
 #include <math.h>
 
 #ifdef AK8975_MAGNETOMETER
@@ -44,19 +45,6 @@ LSM303DLHC_Mag Magnetomometer;
 #error no magnetometer defined - please edit your config.h file.
 #endif
 
-static float b[] = {1,  -1.4, 1};
-static float a[] = {1, -1.3, 0.5};
-
-
-static float iirfilter(float x1, float* v1m1, float* v2m1) {
-    float y1 = 0;
-    y1 = ( ( b[0] * x1 ) + *v1m1) / a[0];
-    *v1m1 = ( ( b[1] * x1 ) + *v2m1 ) - ( a[1] * y1 );
-    *v2m1 = ( b[2] * x1 ) - ( a[2] * y1 );
-    return y1;
-}
-
-
 HalMagnetometer HalMagnetometer::Magneto;
 
 /* HalMagnetometer
@@ -64,6 +52,13 @@ HalMagnetometer HalMagnetometer::Magneto;
  */
 HalMagnetometer::HalMagnetometer( void )
 {
+    /* here rather than in Init so the filter works without the device */
+#ifdef CONFIG_SENSOR_FILTER_DESIGNED
+    Filter.DesignLowPass( CONFIG_SENSOR_FILTER_CUTOFF, CONFIG_SENSOR_FILTER_RATE );
+#else
+    Filter.SetSection( 0u, CONFIG_SENSOR_FILTER_B0, CONFIG_SENSOR_FILTER_B1, CONFIG_SENSOR_FILTER_B2,
+                           CONFIG_SENSOR_FILTER_A0, CONFIG_SENSOR_FILTER_A1, CONFIG_SENSOR_FILTER_A2 );
+#endif
 }
 
 /* HalMagnetometerInit
@@ -72,8 +67,11 @@ HalMagnetometer::HalMagnetometer( void )
  */
 bool HalMagnetometer::Init( void )
 {
-    Magnetomometer.initialize();
-    FilterCount = 0; 
+    if ( !HalCapture::Capture.IsReplaying() )
+    {
+        Magnetomometer.initialize();
+    }
+    Filter.Reset();
     // initialise Magnetoerometer specifics here
 #ifdef AK8975_MAGNETOMETER
     #error no init code for Magnetometer
@@ -98,27 +96,30 @@ void HalMagnetometer::Run( void )
     int16_t X = 0;
     int16_t Y = 0;
     int16_t Z = 0;
-    static float Xv1m1 = 0, Xv2m1 = 0, Yv1m1 = 0, Yv2m1 = 0, Zv1m1 = 0, Zv2m1 = 0;
     
     //X = GetXRawHeading();
     //Y = GetYRawHeading();
     //Z = GetZRawHeading();
 
     GetRawData( &X, &Y, &Z );
-    
-    FilterX[4] = iirfilter(((float)X), &Xv1m1, &Xv2m1);
-    FilterY[4] = iirfilter(((float)Y), &Yv1m1, &Yv2m1);
-    FilterZ[4] = iirfilter(((float)Z), &Zv1m1, &Zv2m1);
- 
+    AddSample( X, Y, Z );
+}
+
+/* HalMagnetometerAddSample
+ *  Filter a raw sample
+ */
+void HalMagnetometer::AddSample( int16_t X, int16_t Y, int16_t Z )
+{
+    Filter.Filter( (float)X, (float)Y, (float)Z, &FilterX, &FilterY, &FilterZ );
 }
 
 /* Access to the Magnetometer data.
  */
 void HalMagnetometer::GetAll( float* Mx, float* My, float* Mz )
 {
-    *Mx = FilterX[4];
-    *My = FilterY[4];
-    *Mz = FilterZ[4];
+    *Mx = FilterX;
+    *My = FilterY;
+    *Mz = FilterZ;
 }
 
 /* Get the raw value of the Accelerometer
@@ -135,7 +136,15 @@ void HalMagnetometer::GetRawData( int16_t* X, int16_t* Y, int16_t* Z )
     int16_t YRaw = 0;
     int16_t ZRaw = 0;
     
-    Magnetomometer.getHeading( &XRaw, &YRaw, &ZRaw);
+    if ( HalCapture::Capture.IsReplaying() )
+    {
+        HalCapture::Capture.GetMag( &XRaw, &YRaw, &ZRaw );
+    }
+    else
+    {
+        Magnetomometer.getHeading( &XRaw, &YRaw, &ZRaw);
+        HalCapture::Capture.RecordMag( XRaw, YRaw, ZRaw );
+    }
     
 #ifdef OBJECTIVE_END_ACCEL_X_PLUS    
     *X = XRaw;
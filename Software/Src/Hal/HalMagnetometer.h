@@ -25,6 +25,9 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdint.h>
 #include "Runnable.h"
+#include "SosFilter.h"
+
+#define HAL_MAGNETOMETER_FILTER_SECTIONS 1u /**< second order sections in the axis filter */
 
 /** HalMagnetometer
  * - Class to provide use to the magnetometer
@@ -42,6 +45,10 @@ class HalMagnetometer: public Runnable {
     /** Runs the filter
      */
         void Run( void );
+    /** Filter a raw sample, Run reads one from the device and the
+     *  benchmark makes its own
+     */
+        void AddSample( int16_t X, int16_t Y, int16_t Z );
     /** Access to the Magnetometer data.
      */
         void GetAll( float* Mx, float* My, float* Mz );
@@ -66,10 +73,10 @@ class HalMagnetometer: public Runnable {
      */
         int16_t GetZRawHeading( void );
         
-        double FilterX[5];    /**< storage for X axis filter data*/
-        double FilterY[5];    /**< storage for Y axis filter data*/
-        double FilterZ[5];    /**< storage for Z axis filter data*/
-        uint8_t FilterCount; /**< counter to keep track of where to store latest data */
+        float FilterX;        /**< storage for X axis filter data*/
+        float FilterY;        /**< storage for Y axis filter data*/
+        float FilterZ;        /**< storage for Z axis filter data*/
+        SosFilter<HAL_MAGNETOMETER_FILTER_SECTIONS> Filter; /**< filter for all three axes */
         double Scaling;       /**< scaling for the raw data */
 };
 
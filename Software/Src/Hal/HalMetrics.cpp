@@ -0,0 +1,337 @@
+/*
+HalMetrics serves the registered Metrics over HTTP for Prometheus to
+scrape, at http://<host>:9110/metrics, and the LatencyTrace samples as
+Chrome trace JSON at /trace. A scrape is one small request and one
+response, so each connection is answered and closed. It runs on
+the HalReactor thread, the sampled metrics take the dispatch lock one at
+a time so a scrape does not hold up the tasks.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "Metrics.h"
+#include "LatencyTrace.h"
+#include "HalMetrics.h"
+
+HalMetrics   HalMetrics::Endpoint;
+
+/* HalMetricsClient
+ *  Constructor
+ */
+HalMetricsClient::HalMetricsClient( void )
+{
+    State = HAL_METRICS_CLOSED;
+    OpenTime = 0;
+    Fd = -1;
+    InputCount = 0u;
+    HeaderLength = 0u;
+    OutputLength = 0u;
+    Sent = 0u;
+}
+
+/* HandleEvents
+ *  Read the request and send the response
+ */
+void HalMetricsClient::HandleEvents( uint32_t Events )
+{
+    (void)Events;
+    if ( ( State == HAL_METRICS_SENDING ) && !Flush() )
+    {
+        return;
+    }
+    if ( Read() && ( State == HAL_METRICS_SENDING ) )
+    {
+        (void)Flush();
+    }
+}
+
+/* Read
+ *  Read the request, or the end of the connection once answered
+ */
+bool HalMetricsClient::Read( void )
+{
+    char Discard[256];
+    /* edge triggered, so read until the socket stops us */
+    for ( ; ; )
+    {
+        ssize_t valread = 0;
+        if ( State == HAL_METRICS_READING )
+        {
+            if ( InputCount >= ( HAL_METRICS_INPUT_SIZE - 1u ) )
+            {
+                printf("Metrics request too long\n");
+                Close();
+                return false;
+            }
+            valread = read( Fd, &Input[InputCount], HAL_METRICS_INPUT_SIZE - 1u - InputCount );
+        }
+        else
+        {
+            /* anything after the request is not wanted */
+            valread = read( Fd, Discard, sizeof( Discard ) );
+        }
+        if ( valread > 0 )
+        {
+            if ( State == HAL_METRICS_READING )
+            {
+                InputCount += valread;
+                Input[InputCount] = '\0';
+                if ( strstr( Input, "\r\n\r\n" ) != NULL )
+                {
+                    Respond();
+                }
+            }
+        }
+        else if ( ( valread < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( valread < 0 ) && ( errno == EAGAIN ) )
+        {
+            return true;
+        }
+        else
+        {
+            /* the client has closed, or has read the response and gone */
+            Close();
+            return false;
+        }
+    }
+}
+
+/* Respond
+ *  Make the response to the request, the metrics are rendered now so the
+ *  scrape has the latest values
+ */
+void HalMetricsClient::Respond( void )
+{
+    const char* Status = "200 OK";
+    const char* Type = "text/plain; version=0.0.4";
+    int Length = 0;
+    OutputLength = 0u;
+    if ( ( strncmp( Input, "GET /metrics ", 13u ) == 0 ) || ( strncmp( Input, "GET / ", 6u ) == 0 ) )
+    {
+        OutputLength = Metrics::Render( Output, HAL_METRICS_OUTPUT_SIZE );
+        if ( OutputLength == 0u )
+        {
+            printf("Metrics do not fit in HAL_METRICS_OUTPUT_SIZE\n");
+            Status = "500 Internal Server Error";
+        }
+    }
+    else if ( strncmp( Input, "GET /trace ", 11u ) == 0 )
+    {
+        Type = "application/json";
+        OutputLength = LatencyTrace::WriteChromeTrace( Output, HAL_METRICS_OUTPUT_SIZE );
+        if ( OutputLength == 0u )
+        {
+            Status = "500 Internal Server Error";
+        }
+    }
+    else
+    {
+        Status = "404 Not Found";
+    }
+    Length = snprintf( Header, HAL_METRICS_HEADER_SIZE,
+                       "HTTP/1.1 %s\r\nContent-Type: %s\r\n"
+                       "Content-Length: %u\r\nConnection: close\r\n\r\n", Status, Type, (unsigned)OutputLength );
+    HeaderLength = ( Length > 0 ) ? (uint32_t)Length : 0u;
+    Sent = 0u;
+    State = HAL_METRICS_SENDING;
+}
+
+/* Flush
+ *  Send as much of the response as the socket will take, the headers and
+ *  the body go in one write
+ */
+bool HalMetricsClient::Flush( void )
+{
+    while ( ( Fd >= 0 ) && ( Sent < ( HeaderLength + OutputLength ) ) )
+    {
+        struct iovec Segments[2];
+        struct msghdr Message;
+        const uint32_t HeaderSent = ( Sent < HeaderLength ) ? Sent : HeaderLength;
+        Segments[0].iov_base = &Header[HeaderSent];
+        Segments[0].iov_len = HeaderLength - HeaderSent;
+        Segments[1].iov_base = &Output[Sent - HeaderSent];
+        Segments[1].iov_len = OutputLength - ( Sent - HeaderSent );
+        memset( &Message, 0, sizeof( Message ) );
+        Message.msg_iov = ( Segments[0].iov_len > 0u ) ? &Segments[0] : &Segments[1];
+        Message.msg_iovlen = ( Segments[0].iov_len > 0u ) ? 2u : 1u;
+        const ssize_t Rc = sendmsg( Fd, &Message, MSG_NOSIGNAL );
+        if ( Rc > 0 )
+        {
+            Sent += Rc;
+        }
+        else if ( ( Rc < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( Rc < 0 ) && ( errno == EAGAIN ) )
+        {
+            /* the rest goes when the socket is writable again */
+            return true;
+        }
+        else
+        {
+            Close();
+        }
+    }
+    if ( ( Fd >= 0 ) && ( State == HAL_METRICS_SENDING ) )
+    {
+        /* closing with unread data would reset the connection and the
+           client could lose the response, so wait for it to close */
+        shutdown( Fd, SHUT_WR );
+        State = HAL_METRICS_DRAINING;
+    }
+    return ( Fd >= 0 );
+}
+
+/* Open
+ *  Start using the slot for a new connection
+ */
+void HalMetricsClient::Open( int NewFd )
+{
+    Fd = NewFd;
+    InputCount = 0u;
+    HeaderLength = 0u;
+    OutputLength = 0u;
+    Sent = 0u;
+    OpenTime = Metrics::NowMicros();
+    State = HAL_METRICS_READING;
+}
+
+/* Close
+ *  Close the connection
+ */
+void HalMetricsClient::Close( void )
+{
+    if ( Fd >= 0 )
+    {
+        HalReactor::Reactor.Remove( Fd );
+        close( Fd );
+        Fd = -1;
+        State = HAL_METRICS_CLOSED;
+    }
+}
+
+/* HalMetrics
+ *  Constructor
+ */
+HalMetrics::HalMetrics( void )
+{
+    ListenFd = -1;
+}
+
+/* Init
+ *  Listen for Prometheus
+ */
+bool HalMetrics::Init( uint16_t Port )
+{
+    struct sockaddr_in Address;
+    int Opt = 1;
+    memset( &Address, 0, sizeof( Address ) );
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = INADDR_ANY;
+    Address.sin_port = htons( Port );
+    ListenFd = socket( AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+    if ( ( ListenFd < 0 )
+         || ( setsockopt( ListenFd, SOL_SOCKET, SO_REUSEADDR, (char *)&Opt, sizeof( Opt ) ) < 0 )
+         || ( bind( ListenFd, (struct sockaddr *)&Address, sizeof( Address ) ) < 0 )
+         || ( listen( ListenFd, HAL_METRICS_BACKLOG ) < 0 )
+         || !HalReactor::Reactor.Add( ListenFd, EPOLLIN, this ) )
+    {
+        perror( "HalMetrics" );
+        Close();
+        return false;
+    }
+    printf("Metrics listener on port %d \n", Port);
+    return true;
+}
+
+/* Close
+ *  Close the listening socket and all the clients
+ */
+void HalMetrics::Close( void )
+{
+    uint8_t Index = 0u;
+    for ( Index = 0u; Index < HAL_METRICS_MAX_CLIENTS; Index++ )
+    {
+        Clients[Index].Close();
+    }
+    if ( ListenFd >= 0 )
+    {
+        HalReactor::Reactor.Remove( ListenFd );
+        close( ListenFd );
+        ListenFd = -1;
+    }
+}
+
+/* HandleEvents
+ *  Accept the waiting connections
+ */
+void HalMetrics::HandleEvents( uint32_t Events )
+{
+    int NewFd = -1;
+    uint8_t Index = 0u;
+    uint8_t Slot = 0u;
+    (void)Events;
+    /* edge triggered, so accept until there are none left */
+    for ( ; ; )
+    {
+        NewFd = accept4( ListenFd, NULL, NULL, SOCK_CLOEXEC );
+        if ( NewFd < 0 )
+        {
+            if ( ( errno == EINTR ) || ( errno == ECONNABORTED ) )
+            {
+                continue;
+            }
+            if ( errno != EAGAIN )
+            {
+                perror( "accept" );
+            }
+            break;
+        }
+        /* a free slot, or the oldest connection, which is a stuck scraper */
+        Slot = 0u;
+        for ( Index = 0u; Index < HAL_METRICS_MAX_CLIENTS; Index++ )
+        {
+            if ( Clients[Index].State == HAL_METRICS_CLOSED )
+            {
+                Slot = Index;
+                break;
+            }
+            if ( Clients[Index].OpenTime < Clients[Slot].OpenTime )
+            {
+                Slot = Index;
+            }
+        }
+        Clients[Slot].Close();
+        Clients[Slot].Open( NewFd );
+        if ( !HalReactor::Reactor.Add( NewFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, &Clients[Slot] ) )
+        {
+            perror( "HalReactor" );
+            Clients[Slot].Close();
+        }
+    }
+}
@@ -0,0 +1,127 @@
+/**
+HalMetrics serves the registered Metrics over HTTP for Prometheus to
+scrape, at http://<host>:9110/metrics, and the LatencyTrace samples as
+Chrome trace JSON at /trace. A scrape is one small request and one
+response, so each connection is answered and closed. It runs on
+the HalReactor thread, the sampled metrics take the dispatch lock one at
+a time so a scrape does not hold up the tasks.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef HALMETRICS_H
+#define HALMETRICS_H
+
+#include <stdint.h>
+#include "HalReactor.h"
+
+/* Configuration */
+
+#define HAL_METRICS_PORT         9110u     /**< Prometheus scrapes http://<host>:9110/metrics */
+#define HAL_METRICS_MAX_CLIENTS  2u        /**< scrapes at once, the oldest is closed for a new one */
+#define HAL_METRICS_BACKLOG      4         /**< pending connections queued by the kernel */
+#define HAL_METRICS_INPUT_SIZE   1024u     /**< longest request */
+#define HAL_METRICS_HEADER_SIZE  160u      /**< response status line and headers */
+#define HAL_METRICS_OUTPUT_SIZE  32768u    /**< longest response body */
+
+/** State of a metrics connection
+ */
+typedef enum
+{
+    HAL_METRICS_CLOSED = 0,     /**< slot is free */
+    HAL_METRICS_READING,        /**< waiting for the request */
+    HAL_METRICS_SENDING,        /**< sending the response */
+    HAL_METRICS_DRAINING        /**< response sent, reading until the client closes */
+} HAL_METRICS_STATE_T;
+
+/** HalMetricsClient
+ * - One HTTP connection, serviced on the reactor thread
+ */
+class HalMetricsClient: public HalReactorHandler
+{
+    public:
+    /** Constructor
+     */
+        HalMetricsClient( void );
+    /** Called by the reactor when the socket can be read or written
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+    /** Start using the slot for a new connection
+     * @param NewFd the accepted socket
+     */
+        void Open( int NewFd );
+    /** Close the connection
+     */
+        void Close( void );
+
+        HAL_METRICS_STATE_T State;    /**< reactor thread only */
+        int64_t OpenTime;             /**< when it was accepted, the oldest is closed first */
+
+    private:
+    /** Read the request, or the end of the connection once answered
+     * @return bool false if the client was closed
+     */
+        bool Read( void );
+    /** Make the response to the request in Input
+     */
+        void Respond( void );
+    /** Send as much of the response as the socket will take
+     * @return bool false if the client was closed
+     */
+        bool Flush( void );
+
+        int Fd;                                   /**< socket, -1 if closed */
+        char Input[HAL_METRICS_INPUT_SIZE];       /**< the request, terminated */
+        uint32_t InputCount;                      /**< bytes in Input */
+        char Header[HAL_METRICS_HEADER_SIZE];     /**< status line and headers */
+        uint32_t HeaderLength;                    /**< bytes in Header */
+        char Output[HAL_METRICS_OUTPUT_SIZE];     /**< the body */
+        uint32_t OutputLength;                    /**< bytes in Output */
+        uint32_t Sent;                            /**< bytes of Header then Output sent */
+};
+
+/** HalMetrics
+ * - Class to provide the HTTP server for the metrics
+ */
+class HalMetrics: public HalReactorHandler
+{
+    public:
+    /** Constructor
+     */
+        HalMetrics( void );
+    /** Initialise, the listening socket is registered with HalReactor::Reactor
+     * @param Port TCP port to listen on
+     * @return bool true if successful
+     */
+        bool Init( uint16_t Port );
+    /** Close the listening socket and all the clients
+     */
+        void Close( void );
+    /** Called by the reactor for new connections
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+
+        static HalMetrics Endpoint;    /**< We only want one object serving the metrics. */
+
+    private:
+        HalMetricsClient Clients[HAL_METRICS_MAX_CLIENTS];    /**< the connections */
+        int ListenFd;                                         /**< listening socket */
+};
+
+#endif /* HALMETRICS_H */
@@ -0,0 +1,303 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <math.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "HalReactor.h"
+#include "HalMetrics.h"
+#include "Metrics.h"
+#include "LatencyTrace.h"
+/*
+ HalMetrics test
+ Threads add to a counter and a histogram at once and every update must
+ be counted. The histogram buckets are checked at their boundaries, the
+ text format is checked line by line, then the metrics are scraped over
+ loopback, with the latency trace, with a wrong path and with more scrapers than slots. Then it
+ times the updates. Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/Utils \
+     Src/Hal/HalMetrics_test.cpp Src/Hal/HalMetrics.cpp Src/Hal/HalReactor.cpp \
+     Src/Utils/Metrics.cpp Src/Utils/LatencyTrace.cpp -lpthread -latomic -o HalMetrics_test
+ ./HalMetrics_test
+ */
+
+#define TEST_PORT        19994
+#define TEST_THREADS     4
+#define TEST_ADDS        1000000
+#define TEST_TIMEOUT_MS  2000
+
+static int failures = 0;
+static MetricCounter counter;
+static MetricGauge gauge;
+static MetricHistogram histogram;
+static MetricHistogram shared;
+static int samples = 0;
+static int locks = 0;
+static int unlocked = 0;
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+static double sample(void* context)
+{
+    samples++;
+    unlocked += (locks == 1) ? 0 : 1;
+    return *(double*)context;
+}
+
+static void lock(void)
+{
+    locks++;
+}
+
+static void unlock(void)
+{
+    locks--;
+}
+
+static void* adder(void* arg)
+{
+    (void)arg;
+    for (int i = 0; i < TEST_ADDS; i++)
+    {
+        counter.Add(1);
+        shared.Observe(i & 1023);
+    }
+    return NULL;
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/* read until the server closes, the length read or -1 on timeout */
+static int readResponse(int fd, char* data, size_t size)
+{
+    struct pollfd pfd;
+    size_t got = 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (got < (size - 1))
+    {
+        if (poll(&pfd, 1, TEST_TIMEOUT_MS) != 1)
+        {
+            return -1;
+        }
+        const ssize_t rc = read(fd, data + got, size - 1 - got);
+        if (rc <= 0)
+        {
+            break;
+        }
+        got += rc;
+    }
+    data[got] = '\0';
+    return (int)got;
+}
+
+static int scrape(const char* request, char* response, size_t size)
+{
+    const int fd = connectTo(TEST_PORT);
+    int length = -1;
+    if ((fd >= 0) && (write(fd, request, strlen(request)) == (ssize_t)strlen(request)))
+    {
+        length = readResponse(fd, response, size);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+    return length;
+}
+
+int main()
+{
+    static char text[HAL_METRICS_OUTPUT_SIZE];
+    static char response[HAL_METRICS_OUTPUT_SIZE + HAL_METRICS_HEADER_SIZE];
+    double sampled = 2.5;
+    double missing = NAN;
+
+    /* every update from every thread is counted */
+    {
+        pthread_t threads[TEST_THREADS];
+        for (int i = 0; i < TEST_THREADS; i++)
+        {
+            pthread_create(&threads[i], NULL, adder, NULL);
+        }
+        for (int i = 0; i < TEST_THREADS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        uint64_t total = 0;
+        for (uint8_t bucket = 0; bucket <= METRICS_BUCKETS; bucket++)
+        {
+            total += shared.GetBucket(bucket);
+        }
+        check(counter.Get() == (uint64_t)TEST_THREADS * TEST_ADDS, "no counter update is lost");
+        check(total == (uint64_t)TEST_THREADS * TEST_ADDS, "no histogram update is lost");
+        uint64_t sum = 0;
+        for (int i = 0; i < TEST_ADDS; i++)
+        {
+            sum += i & 1023;
+        }
+        check(shared.GetSum() == (uint64_t)TEST_THREADS * sum, "the sum is exact");
+    }
+
+    /* a duration goes in the first bucket it is not above */
+    {
+        MetricHistogram buckets;
+        buckets.Observe(-5);
+        buckets.Observe(0);
+        buckets.Observe(1);
+        buckets.Observe(2);
+        buckets.Observe(3);
+        buckets.Observe(4);
+        buckets.Observe(5);
+        buckets.Observe(1 << 19);
+        buckets.Observe((1 << 19) + 1);
+        buckets.Observe(1LL << 40);
+        check((buckets.GetBucket(0) == 3) && (buckets.GetBucket(1) == 1) && (buckets.GetBucket(2) == 2)
+              && (buckets.GetBucket(3) == 1), "durations up to 2^n us are in bucket n");
+        check((buckets.GetBucket(19) == 1) && (buckets.GetBucket(METRICS_BUCKETS) == 2), "longer ones are above the last bound");
+        check(buckets.GetSum() == (1ull + 2ull + 3ull + 4ull + 5ull + (1ull << 19) + (1ull << 19) + 1ull + 0xFFFFFFFFull), "the sum is clamped");
+    }
+
+    /* the text format */
+    {
+        counter.Add(1);
+        gauge.Set(-3);
+        histogram.Observe(3);
+        histogram.Observe(1000);
+        check(Metrics::Register("test_total", "", "A counter", &counter), "a counter is registered");
+        check(Metrics::Register("test_gauge", "server=\"a\"", "A gauge", &gauge), "a gauge is registered");
+        check(Metrics::Register("test_seconds", "task=\"t\"", "A histogram", &histogram), "a histogram is registered");
+        check(Metrics::RegisterSampled("test_gauge", "server=\"b\"", "A gauge", METRIC_GAUGE, &sample, &sampled),
+              "a sampled gauge is registered");
+        check(Metrics::RegisterSampled("test_age", "", "No value yet", METRIC_GAUGE, &sample, &missing),
+              "a sampled gauge without a value is registered");
+        Metrics::SetSampleLock(&lock, &unlock);
+        const uint32_t length = Metrics::Render(text, sizeof(text));
+        check((length > 0) && (length == strlen(text)), "the metrics are rendered");
+        check(strstr(text, "# HELP test_total A counter\n# TYPE test_total counter\ntest_total 4000001\n") != NULL,
+              "a counter has its HELP, TYPE and value");
+        check(strstr(text, "# TYPE test_gauge gauge\ntest_gauge{server=\"a\"} -3\ntest_gauge{server=\"b\"} 2.5\n") != NULL,
+              "the gauges with the same name are together under one TYPE");
+        check(strstr(text, "test_age NaN\n") != NULL, "a missing value is NaN");
+        check(strstr(text, "test_seconds_bucket{task=\"t\",le=\"0.000002\"} 0\n"
+                           "test_seconds_bucket{task=\"t\",le=\"0.000004\"} 1\n") != NULL, "the buckets are in seconds");
+        check(strstr(text, "test_seconds_bucket{task=\"t\",le=\"0.001024\"} 2\n") != NULL, "the buckets are cumulative");
+        check(strstr(text, "test_seconds_bucket{task=\"t\",le=\"+Inf\"} 2\n"
+                           "test_seconds_sum{task=\"t\"} 0.001003\n"
+                           "test_seconds_count{task=\"t\"} 2\n") != NULL, "a histogram has its sum and count");
+        check((samples == 2) && (unlocked == 0) && (locks == 0), "each sample is taken with the lock held");
+        check(Metrics::Render(text, 100) == 0, "metrics that do not fit are not rendered");
+    }
+
+    /* scraped over HTTP */
+    {
+        int length = 0;
+        check(HalReactor::Reactor.Init() && HalReactor::Reactor.Start(), "the reactor starts");
+        check(HalMetrics::Endpoint.Init(TEST_PORT), "the endpoint listens");
+        length = scrape("GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: text/plain\r\n\r\n", response, sizeof(response));
+        check((length > 0) && (strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0)
+              && (strstr(response, "Content-Type: text/plain; version=0.0.4\r\n") != NULL), "a scrape is answered");
+        char* body = strstr(response, "\r\n\r\n");
+        check((body != NULL) && (strstr(body, "test_total 4000001\n") != NULL)
+              && (strtoul(strstr(response, "Content-Length: ") + 16, NULL, 10) == strlen(body + 4)),
+              "the response has the metrics and their length");
+        const uint32_t id = LatencyTrace::Begin();
+        LatencyTrace::Mark(id, LATENCY_FUSED);
+        length = scrape("GET /trace HTTP/1.1\r\n\r\n", response, sizeof(response));
+        body = strstr(response, "\r\n\r\n");
+        check((length > 0) && (strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0)
+              && (strstr(response, "Content-Type: application/json\r\n") != NULL)
+              && (body != NULL) && (strncmp(body + 4, "{\"displayTimeUnit\"", 18) == 0)
+              && (strstr(body, "\"name\":\"fused\",\"cat\":\"latency\"") != NULL), "the latency trace is served");
+        length = scrape("GET /other HTTP/1.1\r\n\r\n", response, sizeof(response));
+        check((length > 0) && (strncmp(response, "HTTP/1.1 404 Not Found\r\n", 24) == 0), "another path is not found");
+
+        /* scrapers that never send their request are closed for new ones */
+        int idle[HAL_METRICS_MAX_CLIENTS];
+        for (uint8_t i = 0; i < HAL_METRICS_MAX_CLIENTS; i++)
+        {
+            idle[i] = connectTo(TEST_PORT);
+            usleep(10000);
+        }
+        length = scrape("GET / HTTP/1.0\r\n\r\n", response, sizeof(response));
+        check((length > 0) && (strncmp(response, "HTTP/1.1 200 OK\r\n", 17) == 0), "a scrape is answered when every slot is in use");
+        check(readResponse(idle[0], response, sizeof(response)) == 0, "the oldest idle scraper is closed");
+        for (uint8_t i = 0; i < HAL_METRICS_MAX_CLIENTS; i++)
+        {
+            close(idle[i]);
+        }
+
+        const double start = seconds();
+        int scrapes = 0;
+        for (scrapes = 0; scrapes < 200; scrapes++)
+        {
+            (void)scrape("GET /metrics HTTP/1.1\r\n\r\n", response, sizeof(response));
+        }
+        fprintf(stderr, "%.1f us per scrape\n", ((seconds() - start) * 1.0e6) / scrapes);
+        HalMetrics::Endpoint.Close();
+        HalReactor::Reactor.Stop();
+    }
+
+    /* the cost of an update */
+    {
+        MetricCounter local;
+        MetricHistogram timing;
+        double start = seconds();
+        for (int i = 0; i < TEST_ADDS; i++)
+        {
+            local.Add(i);
+        }
+        const double add = (seconds() - start) * 1.0e9 / TEST_ADDS;
+        start = seconds();
+        for (int i = 0; i < TEST_ADDS; i++)
+        {
+            timing.Observe(i & 0xFFFF);
+        }
+        const double observe = (seconds() - start) * 1.0e9 / TEST_ADDS;
+        start = seconds();
+        for (int i = 0; i < TEST_ADDS; i++)
+        {
+            timing.Observe(Metrics::NowMicros() - (int64_t)i);
+        }
+        const double timed = (seconds() - start) * 1.0e9 / TEST_ADDS;
+        fprintf(stderr, "%.1f ns per Add, %.1f ns per Observe, %.1f ns per Observe with NowMicros (%llu)\n",
+                add, observe, timed, (unsigned long long)(local.Get() + timing.GetSum()));
+    }
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
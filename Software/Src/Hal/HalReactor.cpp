@@ -0,0 +1,223 @@
+/*
+HalReactor runs a single edge triggered epoll loop on its own thread.
+The listening and client sockets of every network endpoint, stdin and
+any periodic timers are registered with it, and it calls the handler of
+each descriptor when it becomes ready, so none of the I/O waits inside
+the scheduler.
+
+Author and copyright of this file:
+Chris Dick, 2016
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "HalReactor.h"
+
+HalReactor      HalReactor::Reactor;
+pthread_mutex_t HalReactor::DispatchMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Constructor
+ */
+HalReactor::HalReactor( void )
+{
+    EpollFd = -1;
+    WakeFd = -1;
+    Running = false;
+}
+
+/* Create the epoll instance
+ * @return bool true if successful
+ */
+bool HalReactor::Init( void )
+{
+    bool Result = false;
+    if ( EpollFd < 0 )
+    {
+        EpollFd = epoll_create1( EPOLL_CLOEXEC );
+        WakeFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+        if ( ( EpollFd >= 0 ) && ( WakeFd >= 0 ) )
+        {
+            struct epoll_event Event;
+            memset( &Event, 0, sizeof( Event ) );
+            Event.events = EPOLLIN;
+            Event.data.ptr = NULL;
+            Result = ( epoll_ctl( EpollFd, EPOLL_CTL_ADD, WakeFd, &Event ) == 0 );
+        }
+        if ( !Result )
+        {
+            perror( "HalReactor" );
+        }
+    }
+    else
+    {
+        Result = true;
+    }
+    return Result;
+}
+
+/* Start the reactor thread
+ * @return bool true if the thread was started
+ */
+bool HalReactor::Start( void )
+{
+    if ( !Running && ( EpollFd >= 0 ) )
+    {
+        sigset_t All;
+        sigset_t Previous;
+        /* the scheduler timer and the termination signals belong to the main thread */
+        sigfillset( &All );
+        pthread_sigmask( SIG_BLOCK, &All, &Previous );
+        Running = ( pthread_create( &Thread, NULL, &ThreadEntry, this ) == 0 );
+        pthread_sigmask( SIG_SETMASK, &Previous, NULL );
+    }
+    return Running;
+}
+
+/* Stop and join the reactor thread
+ */
+void HalReactor::Stop( void )
+{
+    if ( Running )
+    {
+        const uint64_t One = 1u;
+        if ( write( WakeFd, &One, sizeof( One ) ) < 0 )
+        {
+            perror( "HalReactor" );
+        }
+        pthread_join( Thread, NULL );
+        Running = false;
+    }
+}
+
+/* Register a descriptor
+ * @return bool true if successful
+ */
+bool HalReactor::Add( int Fd, uint32_t Events, HalReactorHandler* Handler )
+{
+    struct epoll_event Event;
+    const int Flags = fcntl( Fd, F_GETFL, 0 );
+    if ( ( Flags < 0 ) || ( fcntl( Fd, F_SETFL, Flags | O_NONBLOCK ) < 0 ) )
+    {
+        return false;
+    }
+    memset( &Event, 0, sizeof( Event ) );
+    Event.events = Events | EPOLLET;
+    Event.data.ptr = Handler;
+    return ( epoll_ctl( EpollFd, EPOLL_CTL_ADD, Fd, &Event ) == 0 );
+}
+
+/* Change the events of a registered descriptor
+ * @return bool true if successful
+ */
+bool HalReactor::Modify( int Fd, uint32_t Events, HalReactorHandler* Handler )
+{
+    struct epoll_event Event;
+    memset( &Event, 0, sizeof( Event ) );
+    Event.events = Events | EPOLLET;
+    Event.data.ptr = Handler;
+    return ( epoll_ctl( EpollFd, EPOLL_CTL_MOD, Fd, &Event ) == 0 );
+}
+
+/* Unregister a descriptor
+ */
+void HalReactor::Remove( int Fd )
+{
+    struct epoll_event Event;
+    /* older kernels want a non null event even for a delete */
+    memset( &Event, 0, sizeof( Event ) );
+    (void)epoll_ctl( EpollFd, EPOLL_CTL_DEL, Fd, &Event );
+}
+
+/* Create a periodic timer
+ * @return int the timer descriptor, negative on error
+ */
+int HalReactor::AddTimer( uint32_t PeriodMicros, HalReactorHandler* Handler )
+{
+    struct itimerspec Spec;
+    int Fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC );
+    if ( Fd >= 0 )
+    {
+        Spec.it_interval.tv_sec = PeriodMicros / 1000000u;
+        Spec.it_interval.tv_nsec = ( PeriodMicros % 1000000u ) * 1000u;
+        Spec.it_value = Spec.it_interval;
+        if ( ( timerfd_settime( Fd, 0, &Spec, NULL ) != 0 ) || !Add( Fd, EPOLLIN, Handler ) )
+        {
+            close( Fd );
+            Fd = -1;
+        }
+    }
+    return Fd;
+}
+
+/* Take the dispatch lock
+ */
+void HalReactor::Lock( void )
+{
+    pthread_mutex_lock( &DispatchMutex );
+}
+
+/* Release the dispatch lock
+ */
+void HalReactor::Unlock( void )
+{
+    pthread_mutex_unlock( &DispatchMutex );
+}
+
+/* Thread entry point
+ */
+void* HalReactor::ThreadEntry( void* Arg )
+{
+    /* so it can be told apart in top and in the Trace */
+    (void)pthread_setname_np( pthread_self(), "HalReactor" );
+    static_cast<HalReactor*>( Arg )->Loop();
+    return NULL;
+}
+
+/* Wait for and dispatch events until stopped
+ */
+void HalReactor::Loop( void )
+{
+    struct epoll_event Events[HAL_REACTOR_MAX_EVENTS];
+    bool StopRequested = false;
+    while ( !StopRequested )
+    {
+        const int Count = epoll_wait( EpollFd, Events, HAL_REACTOR_MAX_EVENTS, -1 );
+        if ( ( Count < 0 ) && ( errno != EINTR ) )
+        {
+            perror( "HalReactor epoll_wait" );
+            break;
+        }
+        for ( int Index = 0; Index < Count; Index++ )
+        {
+            HalReactorHandler* Handler = static_cast<HalReactorHandler*>( Events[Index].data.ptr );
+            if ( Handler != NULL )
+            {
+                Handler->HandleEvents( Events[Index].events );
+            }
+            else
+            {
+                /* the wake up event is only used by Stop */
+                StopRequested = true;
+            }
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/**
+HalReactor runs a single edge triggered epoll loop on its own thread.
+The listening and client sockets of every network endpoint, stdin and
+any periodic timers are registered with it, and it calls the handler of
+each descriptor when it becomes ready, so none of the I/O waits inside
+the scheduler.
+
+The scheduler holds the dispatch lock around each task (see
+TTC_Sched::SetDispatchLock). Handlers are called without it, so socket
+reads and writes never hold up a task; a handler takes the lock only
+around the code that uses data shared with the tasks, and must not make
+a system call while holding it.
+
+Because the descriptors are edge triggered a handler must read, accept
+or write until the call returns EAGAIN, otherwise it will not be told
+about the remaining data.
+
+Author and copyright of this file:
+Chris Dick, 2016
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef HALREACTOR_H
+#define HALREACTOR_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+
+/* Configuration */
+
+#define HAL_REACTOR_MAX_EVENTS 64u  /**< events collected by one epoll_wait */
+
+/** HalReactorHandler
+ * - Interface for anything registered with the reactor
+ */
+class HalReactorHandler
+{
+    public:
+        virtual ~HalReactorHandler( void ) {}
+    /** Called on the reactor thread when the descriptor is ready
+     * @param Events EPOLLIN, EPOLLOUT, EPOLLERR, EPOLLHUP etc.
+     */
+        virtual void HandleEvents( uint32_t Events ) = 0;
+};
+
+/** HalReactor
+ * - Class to wait for and dispatch the socket events
+ */
+class HalReactor
+{
+    public:
+    /** Constructor
+     */
+        HalReactor( void );
+    /** Create the epoll instance, must be called before anything is added
+     * @return bool true if successful
+     */
+        bool Init( void );
+    /** Start the reactor thread
+     * @return bool true if the thread was started
+     */
+        bool Start( void );
+    /** Stop and join the reactor thread, the descriptors stay registered
+     */
+        void Stop( void );
+    /** Register a descriptor, it is made non blocking
+     * @param Fd descriptor
+     * @param Events EPOLLIN and/or EPOLLOUT, EPOLLET is added
+     * @param Handler object to call when the descriptor is ready
+     * @return bool true if successful
+     */
+        bool Add( int Fd, uint32_t Events, HalReactorHandler* Handler );
+    /** Change the events of a registered descriptor
+     * @return bool true if successful
+     */
+        bool Modify( int Fd, uint32_t Events, HalReactorHandler* Handler );
+    /** Unregister a descriptor, call before closing it
+     */
+        void Remove( int Fd );
+    /** Create a periodic timer, the handler is called with EPOLLIN each
+     * period and must read the 8 byte expiry count from the descriptor
+     * @param PeriodMicros period in microseconds
+     * @param Handler object to call when the timer expires
+     * @return int the timer descriptor, negative on error
+     */
+        int AddTimer( uint32_t PeriodMicros, HalReactorHandler* Handler );
+    /** Take the dispatch lock
+     */
+        static void Lock( void );
+    /** Release the dispatch lock
+     */
+        static void Unlock( void );
+
+        static HalReactor Reactor;    /**< Only one is required */
+
+    private:
+    /** Thread entry point
+     */
+        static void* ThreadEntry( void* Arg );
+    /** Wait for and dispatch events until stopped
+     */
+        void Loop( void );
+
+        static pthread_mutex_t DispatchMutex;  /**< serialises the tasks and the shared data */
+        int EpollFd;                           /**< epoll instance */
+        int WakeFd;                            /**< eventfd used to stop the loop */
+        pthread_t Thread;                      /**< reactor thread */
+        bool Running;                          /**< thread has been started */
+};
+
+#endif /* HALREACTOR_H */
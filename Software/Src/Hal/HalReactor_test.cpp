@@ -0,0 +1,436 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "HalReactor.h"
+#include "HalSocket.h"
+#include "Server.hpp"
+#include "Socket.hpp"
+/*
+ HalReactor load test
+ Connects hundreds of clients to HalSocket and to a Stellarium server
+ running on the reactor, while a second thread takes the dispatch lock
+ every 500us like the scheduler. Then checks the Stellarium connections
+ are used again once they are freed, and HalSocket reassembles
+ fragmented and pipelined messages and disconnects a client that stops
+ reading without holding up the others. Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/StellariumServer -I./Src/Utils \
+     Src/Hal/HalReactor_test.cpp Src/Hal/HalReactor.cpp Src/Hal/HalSocket.cpp \
+     Src/StellariumServer/Server.cpp Src/StellariumServer/Listener.cpp \
+     Src/StellariumServer/Connection.cpp Src/StellariumServer/Socket.cpp \
+     Src/Utils/Metrics.cpp -lpthread -latomic -o HalReactor_test
+
+ The servers log every connection to stdout, the results go to stderr:
+ ./HalReactor_test > /dev/null
+ */
+
+#define TEST_SOCKET_PORT     19999
+#define TEST_SERVER_PORT     19998
+#define TEST_SOCKET_CLIENTS  500
+#define TEST_SERVER_CLIENTS  200
+#define TEST_ROUNDS          20
+#define TEST_TIMEOUT_MS      2000
+#define TEST_FLOOD_BYTES     (64 * 1024 * 1024)
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* HalSocket protocol handler, replies with the request */
+static void echoCallback(char* buffer)
+{
+    buffer[strcspn(buffer, "#")] = '\0';
+    strcat(buffer, "=OK#");
+}
+
+/* Stellarium server sending the position every 10ms */
+class TestServer : public Server, public HalReactorHandler
+{
+    public:
+        TestServer(int16_t Port) : Server(Port), gotos(0)
+        {
+            timerFd = HalReactor::Reactor.AddTimer(10000u, this);
+        }
+        void HandleEvents(uint32_t Events)
+        {
+            uint64_t expirations;
+            (void)Events;
+            if (read(timerFd, &expirations, sizeof(expirations)) == (ssize_t)sizeof(expirations))
+            {
+                RemoveClosedConnections();
+                SendPosition(0x40000000u, 0x10000000, 0, GetNow());
+            }
+        }
+        uint16_t connections(void) { return GetNumberOfConnections(); }
+        int gotos;          /**< read with the dispatch lock held */
+    private:
+        void GotoReceived(uint32_t RAInt, int32_t DecInt)
+        {
+            if ((RAInt == 0x12345678u) && (DecInt == -0x1234567))
+            {
+                gotos++;
+            }
+        }
+        int timerFd;
+};
+
+/* stand in for the scheduler, records the longest wait for the dispatch lock */
+static bool schedulerRunning = true;
+static double longestLockWait = 0.0;
+
+static void* schedulerThread(void* arg)
+{
+    (void)arg;
+    bool running = true;
+    while (running)
+    {
+        const double start = seconds();
+        HalReactor::Lock();
+        const double wait = seconds() - start;
+        running = schedulerRunning;
+        HalReactor::Unlock();
+        if (wait > longestLockWait)
+        {
+            longestLockWait = wait;
+        }
+        usleep(500);
+    }
+    return NULL;
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* read exactly length bytes, false on timeout or error */
+static bool readAll(int fd, void* data, size_t length)
+{
+    size_t got = 0;
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (got < length)
+    {
+        if (poll(&pfd, 1, TEST_TIMEOUT_MS) != 1)
+        {
+            return false;
+        }
+        const ssize_t rc = read(fd, (char*)data + got, length - got);
+        if (rc <= 0)
+        {
+            return false;
+        }
+        got += rc;
+    }
+    return true;
+}
+
+static int compareDouble(const void* a, const void* b)
+{
+    const double x = *(const double*)a;
+    const double y = *(const double*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+int main()
+{
+    static int socketClients[TEST_SOCKET_CLIENTS];
+    static int serverClients[TEST_SERVER_CLIENTS];
+    static double latency[TEST_SOCKET_CLIENTS * TEST_ROUNDS];
+    uint32_t replies = 0;
+    uint32_t errors = 0;
+    pthread_t scheduler;
+    double start = 0.0;
+    double elapsed = 0.0;
+    int i = 0;
+
+    check(HalReactor::Reactor.Init(), "reactor initialises");
+    HalSocket::Socket.Init(TEST_SOCKET_PORT, &echoCallback);
+    TestServer server(TEST_SERVER_PORT);
+    check(HalReactor::Reactor.Start(), "reactor thread starts");
+    pthread_create(&scheduler, NULL, &schedulerThread, NULL);
+
+    /* HalSocket request/reply */
+    for (i = 0; i < TEST_SOCKET_CLIENTS; i++)
+    {
+        socketClients[i] = connectTo(TEST_SOCKET_PORT);
+        if (socketClients[i] < 0)
+        {
+            errors++;
+        }
+    }
+    check(errors == 0, "HalSocket clients connect");
+    start = seconds();
+    for (int round = 0; round < TEST_ROUNDS; round++)
+    {
+        static double sent[TEST_SOCKET_CLIENTS];
+        /* every client has a request outstanding at once */
+        for (i = 0; i < TEST_SOCKET_CLIENTS; i++)
+        {
+            sent[i] = seconds();
+            if ((socketClients[i] >= 0) && (write(socketClients[i], "RA  #", 5) != 5))
+            {
+                errors++;
+            }
+        }
+        for (i = 0; i < TEST_SOCKET_CLIENTS; i++)
+        {
+            char reply[8];
+            if ((socketClients[i] < 0) || !readAll(socketClients[i], reply, 8) || (memcmp(reply, "RA  =OK#", 8) != 0))
+            {
+                errors++;
+                continue;
+            }
+            latency[replies++] = seconds() - sent[i];
+        }
+    }
+    elapsed = seconds() - start;
+    check(errors == 0, "HalSocket every request is answered");
+    if (replies > 0)
+    {
+        qsort(latency, replies, sizeof(latency[0]), &compareDouble);
+        fprintf(stderr, "HalSocket: %d clients, %u requests in %.3f s, %.0f requests/s, "
+                "reply time p50 %.0f us, p99 %.0f us\n", TEST_SOCKET_CLIENTS, replies, elapsed, replies / elapsed,
+                latency[replies / 2] * 1.0e6, latency[(replies * 99) / 100] * 1.0e6);
+    }
+
+    /* Stellarium gotos and position messages */
+    int timeErrors = 0;
+    errors = 0;
+    for (i = 0; i < TEST_SERVER_CLIENTS; i++)
+    {
+        uint8_t message[20] = { 20, 0, 0, 0 };
+        message[12] = 0x78; message[13] = 0x56; message[14] = 0x34; message[15] = 0x12;
+        int32_t dec = -0x1234567;
+        memcpy(&message[16], &dec, sizeof(dec));
+        serverClients[i] = connectTo(TEST_SERVER_PORT);
+        if ((serverClients[i] < 0) || (write(serverClients[i], message, sizeof(message)) != (ssize_t)sizeof(message)))
+        {
+            errors++;
+        }
+    }
+    check(errors == 0, "Stellarium clients connect and send a goto");
+    for (i = 0; i < TEST_SERVER_CLIENTS; i++)
+    {
+        uint8_t position[24];
+        int64_t time = 0;
+        if ((serverClients[i] < 0) || !readAll(serverClients[i], position, sizeof(position))
+            || (position[0] != 24) || (position[15] != 0x40))
+        {
+            errors++;
+        }
+        memcpy(&time, &position[4], sizeof(time));
+        /* the first message, queued since the client connected */
+        timeErrors += ((time > 0) && (time <= GetNow()) && ((GetNow() - time) < 10000000)) ? 0 : 1;
+    }
+    check(errors == 0, "Stellarium every client receives the position");
+    check(timeErrors == 0, "Stellarium position carries the time it was measured");
+    start = seconds();
+    int gotos = 0;
+    while ((gotos < TEST_SERVER_CLIENTS) && ((seconds() - start) < 2.0))
+    {
+        usleep(1000);
+        HalReactor::Lock();
+        gotos = server.gotos;
+        HalReactor::Unlock();
+    }
+    check(gotos == TEST_SERVER_CLIENTS, "Stellarium every goto is received");
+
+    /* hang up */
+    for (i = 0; i < TEST_SOCKET_CLIENTS; i++)
+    {
+        close(socketClients[i]);
+    }
+    for (i = 0; i < TEST_SERVER_CLIENTS; i++)
+    {
+        close(serverClients[i]);
+    }
+    start = seconds();
+    uint16_t connected = 1;
+    while ((connected > 0) && ((seconds() - start) < 2.0))
+    {
+        usleep(1000);
+        HalReactor::Lock();
+        connected = HalSocket::Socket.GetNumberOfClients();
+        HalReactor::Unlock();
+    }
+    check(connected == 0, "HalSocket disconnected clients are closed");
+    start = seconds();
+    while ((server.connections() > 0) && ((seconds() - start) < 2.0))
+    {
+        usleep(1000);
+    }
+    check(server.connections() == 0, "Stellarium disconnected clients are freed");
+
+    /* the freed connections are used again, and there is no room for one more */
+    {
+        static int again[SERVER_MAX_CONNECTIONS + 1];
+        uint8_t position[24];
+        errors = 0;
+        for (i = 0; i < (int)SERVER_MAX_CONNECTIONS; i++)
+        {
+            again[i] = connectTo(TEST_SERVER_PORT);
+            errors += ((again[i] >= 0) && readAll(again[i], position, sizeof(position)) && (position[0] == 24)) ? 0 : 1;
+        }
+        check(errors == 0, "Stellarium connections are used again");
+        again[i] = connectTo(TEST_SERVER_PORT);
+        check((again[i] >= 0) && (read(again[i], position, sizeof(position)) == 0), "Stellarium client is refused when all are in use");
+        for (i = 0; i <= (int)SERVER_MAX_CONNECTIONS; i++)
+        {
+            close(again[i]);
+        }
+    }
+
+    /* fragmented and pipelined messages */
+    {
+        static const char* fragments[] = { "RA", "  #DE", "C #Az", "im\n\nLo", "ng#" };
+        static const char expected[] = "RA  =OK#DEC =OK#Azim=OK#Long=OK#";
+        char reply[sizeof(expected)];
+        int fd = connectTo(TEST_SOCKET_PORT);
+        errors = 0;
+        for (i = 0; i < (int)(sizeof(fragments) / sizeof(fragments[0])); i++)
+        {
+            if ((fd < 0) || (write(fd, fragments[i], strlen(fragments[i])) != (ssize_t)strlen(fragments[i])))
+            {
+                errors++;
+            }
+            usleep(2000);
+        }
+        check((errors == 0) && readAll(fd, reply, sizeof(expected) - 1)
+              && (memcmp(reply, expected, sizeof(expected) - 1) == 0), "HalSocket reassembles fragmented messages");
+        close(fd);
+    }
+
+    /* long pipelined messages, the replies wrap round the output queue */
+    {
+        static char message[HAL_SOCKET_MESSAGE_SIZE];
+        static char reply[HAL_SOCKET_MESSAGE_SIZE + 4];
+        const size_t length = HAL_SOCKET_MESSAGE_SIZE - 1u;
+        int fd = connectTo(TEST_SOCKET_PORT);
+        memset(message, 'x', length - 1u);
+        message[length - 1u] = '#';
+        errors = 0;
+        for (i = 0; i < 8; i++)
+        {
+            if ((fd < 0) || (write(fd, message, length) != (ssize_t)length))
+            {
+                errors++;
+            }
+        }
+        for (i = 0; (errors == 0) && (i < 8); i++)
+        {
+            if (!readAll(fd, reply, length + 3u) || (memcmp(reply, message, length - 1u) != 0)
+                || (memcmp(&reply[length - 1u], "=OK#", 4) != 0))
+            {
+                errors++;
+            }
+        }
+        check(errors == 0, "HalSocket answers long pipelined messages");
+        close(fd);
+    }
+
+    /* a client that never reads is disconnected, the others are still served */
+    {
+        static char flood[64 * 1024];
+        int slow = connectTo(TEST_SOCKET_PORT);
+        int fast = connectTo(TEST_SOCKET_PORT);
+        size_t flooded = 0;
+        int small = 4096;
+        char reply[8];
+        for (size_t index = 0; index < sizeof(flood); index += 5)
+        {
+            memcpy(&flood[index], "RA  #", 5);
+        }
+        if (slow >= 0)
+        {
+            setsockopt(slow, SOL_SOCKET, SO_RCVBUF, &small, sizeof(small));
+            fcntl(slow, F_SETFL, fcntl(slow, F_GETFL, 0) | O_NONBLOCK);
+        }
+        /* fill the replies queue and both directions of the connection */
+        start = seconds();
+        while ((slow >= 0) && (flooded < TEST_FLOOD_BYTES) && ((seconds() - start) < 2.0))
+        {
+            const ssize_t rc = write(slow, flood, sizeof(flood));
+            if (rc > 0)
+            {
+                flooded += rc;
+            }
+            else
+            {
+                usleep(1000);
+            }
+        }
+        check((slow >= 0) && (flooded < TEST_FLOOD_BYTES), "HalSocket stops reading from a client that does not read");
+        fprintf(stderr, "HalSocket: %lu bytes accepted from the client that does not read\n", (unsigned long)flooded);
+        start = seconds();
+        check((fast >= 0) && (write(fast, "Azim#", 5) == 5) && readAll(fast, reply, 8)
+              && (memcmp(reply, "Azim=OK#", 8) == 0), "HalSocket answers the other clients meanwhile");
+        fprintf(stderr, "HalSocket: reply while a client is stalled %.0f us\n", (seconds() - start) * 1.0e6);
+        start = seconds();
+        connected = 2;
+        while ((connected > 1) && ((seconds() - start) < 10.0))
+        {
+            usleep(10000);
+            HalReactor::Lock();
+            connected = HalSocket::Socket.GetNumberOfClients();
+            HalReactor::Unlock();
+        }
+        check(connected == 1, "HalSocket disconnects the client that stopped reading");
+        fprintf(stderr, "HalSocket: stalled client disconnected after %.1f s\n", seconds() - start);
+        close(slow);
+        close(fast);
+    }
+
+    HalReactor::Lock();
+    schedulerRunning = false;
+    HalReactor::Unlock();
+    pthread_join(scheduler, NULL);
+    fprintf(stderr, "longest wait for the dispatch lock: %.0f us\n", longestLockWait * 1.0e6);
+    HalReactor::Reactor.Stop();
+    HalSocket::Socket.Close();
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
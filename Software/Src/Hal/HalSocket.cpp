@@ -1,6 +1,6 @@
 /**
 server side code, which passes the received message to a callback.
-Handles multiple socket connections with select and fd_set on Linux 
+Handles multiple socket connections, the sockets are serviced by HalReactor 
 Author and copyright of this file:
 Chris Dick, 2017
 
@@ -28,15 +28,373 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <sys/types.h> 
 #include <sys/socket.h> 
 #include <netinet/in.h> 
-#include <sys/time.h> //FD_SET, FD_ISSET, FD_ZERO macros 
+#include <netinet/tcp.h> 
     
 #include "HalSocket.h"
+
+/* HAL_SOCKET_REPLY_SIZE or HAL_SOCKET_BINARY_SIZE, whichever is larger */
+#define HAL_SOCKET_LONGEST_REPLY ( ( HAL_SOCKET_REPLY_SIZE > HAL_SOCKET_BINARY_SIZE ) ? HAL_SOCKET_REPLY_SIZE : HAL_SOCKET_BINARY_SIZE )
+
+static_assert( HAL_SOCKET_INPUT_SIZE > HAL_SOCKET_MESSAGE_SIZE, "the input ring must hold the longest message" );
+static_assert( HAL_SOCKET_INPUT_SIZE > HAL_SOCKET_BINARY_SIZE, "the input ring must hold the longest binary message" );
+static_assert( HAL_SOCKET_OUTPUT_SIZE >= HAL_SOCKET_LONGEST_REPLY, "the output queue must hold the longest reply" );
+static_assert( HAL_SOCKET_REPLY_SIZE >= HAL_SOCKET_MESSAGE_SIZE, "the message is replaced by its reply in place" );
     
 HalSocket          HalSocket::Socket;
-int                HalSocket::master_socket;                           /**< master_socket */
-int                HalSocket::client_socket[HAL_SOCKET_MAX_CLIENTS];   /**< client_socket */
+int                HalSocket::master_socket = -1;                      /**< master_socket */
+int                HalSocket::stall_timer = -1;                        /**< stall_timer */
+HalSocketClient    HalSocket::client_socket[HAL_SOCKET_MAX_CLIENTS];   /**< client_socket */
 struct sockaddr_in HalSocket::address;                                 /**< address */
 void               (*HalSocket::callback)(char*);
+uint32_t           (*HalSocket::message_length)(const char*) = &HalSocket::MessageLength;
+void               (*HalSocket::close_callback)(uint16_t) = NULL;
+uint32_t           (*HalSocket::binary_length)(const uint8_t*, uint32_t) = NULL;
+uint32_t           (*HalSocket::binary_callback)(const uint8_t*, uint32_t, uint8_t*) = NULL;
+uint16_t           HalSocket::current_client = 0u;
+
+/* HalSocketClient
+ *  Constructor
+ */
+HalSocketClient::HalSocketClient( void )
+{
+    Fd = -1;
+    Slot = 0u;
+    InputHead = 0u;
+    InputCount = 0u;
+    OutputHead = 0u;
+    OutputCount = 0u;
+    Progress = false;
+    StalledChecks = 0u;
+}
+
+/* HandleEvents
+ *  Read the waiting messages, send the replies
+ */
+void HalSocketClient::HandleEvents( uint32_t Events )
+{
+    (void)Events;
+    /* edge triggered, so send and read until the socket stops us or the
+       reply queue is full, a full queue is picked up again on EPOLLOUT */
+    bool Reading = Flush() && ProcessMessages();
+    while ( Reading )
+    {
+        const uint32_t Tail = ( InputHead + InputCount ) % HAL_SOCKET_INPUT_SIZE;
+        uint32_t Space = HAL_SOCKET_INPUT_SIZE - InputCount;
+        if ( Space > ( HAL_SOCKET_INPUT_SIZE - Tail ) )
+        {
+            Space = HAL_SOCKET_INPUT_SIZE - Tail;
+        }
+        const ssize_t valread = read( Fd, &Input[Tail], Space );
+        if ( valread > 0 )
+        {
+            HalSocket::Socket.BytesIn.Add( valread );
+            InputCount += valread;
+            Reading = ProcessMessages();
+        }
+        else if ( ( valread < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( valread < 0 ) && ( errno == EAGAIN ) )
+        {
+            Reading = false;
+        }
+        else
+        {
+            /* Somebody disconnected or the connection failed */
+            Close();
+            Reading = false;
+        }
+    }
+}
+
+/* ProcessMessages
+ *  Run the callback on each complete message in the input ring
+ */
+bool HalSocketClient::ProcessMessages( void )
+{
+    bool Result = true;
+    bool Complete = true;
+    bool Queued = false;
+    while ( Result && Complete && ( InputCount > 0u ) )
+    {
+        /* only take a message if the longest reply fits */
+        if ( ( HAL_SOCKET_OUTPUT_SIZE - OutputCount ) < HAL_SOCKET_LONGEST_REPLY )
+        {
+            Result = Flush() && ( ( HAL_SOCKET_OUTPUT_SIZE - OutputCount ) >= HAL_SOCKET_LONGEST_REPLY );
+            Queued = false;
+            if ( !Result )
+            {
+                break;
+            }
+        }
+        /* text never starts with a byte above 0x7F */
+        if ( ( (uint8_t)Input[InputHead] >= 0x80u ) && ( HalSocket::binary_callback != NULL ) )
+        {
+            Complete = ProcessBinary( &Queued );
+        }
+        else
+        {
+            Complete = ProcessText( &Queued );
+        }
+        Result = ( Fd >= 0 );
+    }
+    /* pipelined requests are answered together */
+    if ( Queued )
+    {
+        Result = Flush() && Result;
+    }
+    return Result;
+}
+
+/* ProcessText
+ *  Take a text message from the input ring and queue its reply
+ */
+bool HalSocketClient::ProcessText( bool* Queued )
+{
+    char buffer[HAL_SOCKET_REPLY_SIZE];
+    uint32_t Length = 0u;
+    uint32_t First = HAL_SOCKET_INPUT_SIZE - InputHead;
+    const uint32_t Index = ( InputCount < ( HAL_SOCKET_MESSAGE_SIZE - 1u ) ) ? InputCount : ( HAL_SOCKET_MESSAGE_SIZE - 1u );
+    /* copy out the start of the ring so the message is contiguous */
+    if ( First > Index )
+    {
+        First = Index;
+    }
+    memcpy( buffer, &Input[InputHead], First );
+    memcpy( &buffer[First], Input, Index - First );
+    buffer[Index] = '\0';
+    Length = HalSocket::message_length( buffer );
+    if ( ( Length == 0u ) || ( Length > Index ) )
+    {
+        if ( Index == ( HAL_SOCKET_MESSAGE_SIZE - 1u ) )
+        {
+            printf("Message too long\n");
+            Close();
+        }
+        /* otherwise wait for the rest of the message */
+        return false;
+    }
+    InputHead = ( InputHead + Length ) % HAL_SOCKET_INPUT_SIZE;
+    InputCount -= Length;
+    /* a message ending in a newline is handled as if it ended in a '#' */
+    while ( ( Length > 0u ) && ( ( buffer[Length - 1u] == '\n' ) || ( buffer[Length - 1u] == '\r' ) ) )
+    {
+        Length--;
+    }
+    if ( ( Length > 0u ) && ( buffer[Length - 1u] != '#' ) )
+    {
+        buffer[Length++] = '#';
+    }
+    buffer[Length] = '\0';
+    if ( Length > 1u )
+    {
+        HalReactor::Lock();
+        HalSocket::current_client = Slot;
+        HalSocket::callback( buffer );
+        HalReactor::Unlock();
+        if ( buffer[0] != '\0' )
+        {
+            QueueReply( buffer, strnlen( buffer, HAL_SOCKET_REPLY_SIZE ) );
+            *Queued = true;
+        }
+    }
+    return true;
+}
+
+/* ProcessBinary
+ *  Take a binary frame from the input ring and queue its reply
+ */
+bool HalSocketClient::ProcessBinary( bool* Queued )
+{
+    uint8_t Frame[HAL_SOCKET_BINARY_SIZE];
+    uint8_t Reply[HAL_SOCKET_BINARY_SIZE];
+    uint32_t Length = 0u;
+    uint32_t First = HAL_SOCKET_INPUT_SIZE - InputHead;
+    const uint32_t Index = ( InputCount < HAL_SOCKET_BINARY_SIZE ) ? InputCount : HAL_SOCKET_BINARY_SIZE;
+    /* copy out the start of the ring, in two parts if it wraps */
+    if ( First > Index )
+    {
+        First = Index;
+    }
+    memcpy( Frame, &Input[InputHead], First );
+    memcpy( &Frame[First], Input, Index - First );
+    Length = HalSocket::binary_length( Frame, Index );
+    if ( ( Length > HAL_SOCKET_BINARY_SIZE ) || ( ( Length == 0u ) && ( Index == HAL_SOCKET_BINARY_SIZE ) ) )
+    {
+        printf("Bad binary message\n");
+        Close();
+        return false;
+    }
+    if ( ( Length == 0u ) || ( Length > Index ) )
+    {
+        /* wait for the rest of the frame */
+        return false;
+    }
+    InputHead = ( InputHead + Length ) % HAL_SOCKET_INPUT_SIZE;
+    InputCount -= Length;
+    HalReactor::Lock();
+    HalSocket::current_client = Slot;
+    Length = HalSocket::binary_callback( Frame, Length, Reply );
+    HalReactor::Unlock();
+    if ( Length > 0u )
+    {
+        QueueReply( (const char*)Reply, Length );
+        *Queued = true;
+    }
+    return true;
+}
+
+/* QueueReply
+ *  Add a reply to the output queue
+ */
+void HalSocketClient::QueueReply( const char* Reply, uint32_t Length )
+{
+    const uint32_t Tail = ( OutputHead + OutputCount ) % HAL_SOCKET_OUTPUT_SIZE;
+    uint32_t First = HAL_SOCKET_OUTPUT_SIZE - Tail;
+    /* copy in two parts if it wraps */
+    if ( First > Length )
+    {
+        First = Length;
+    }
+    memcpy( &Output[Tail], Reply, First );
+    memcpy( Output, &Reply[First], Length - First );
+    OutputCount += Length;
+}
+
+/* Send
+ *  Queue a message and start sending it
+ */
+bool HalSocketClient::Send( const struct iovec* Segments, uint32_t Count )
+{
+    bool Result = false;
+    uint32_t Length = 0u;
+    uint32_t Index;
+    for ( Index = 0u; Index < Count; Index++ )
+    {
+        Length += Segments[Index].iov_len;
+    }
+    if ( ( Fd >= 0 ) && ( ( HAL_SOCKET_OUTPUT_SIZE - OutputCount ) >= Length ) )
+    {
+        for ( Index = 0u; Index < Count; Index++ )
+        {
+            QueueReply( (const char*)Segments[Index].iov_base, Segments[Index].iov_len );
+        }
+        Result = Flush();
+    }
+    return Result;
+}
+
+/* Flush
+ *  Send as much of the output queue as the socket will take
+ */
+bool HalSocketClient::Flush( void )
+{
+    while ( ( Fd >= 0 ) && ( OutputCount > 0u ) )
+    {
+        struct iovec Segments[2];
+        struct msghdr Message;
+        uint32_t Length = HAL_SOCKET_OUTPUT_SIZE - OutputHead;
+        if ( Length > OutputCount )
+        {
+            Length = OutputCount;
+        }
+        /* the queue from the head to the end of the ring, then what wrapped */
+        Segments[0].iov_base = &Output[OutputHead];
+        Segments[0].iov_len = Length;
+        Segments[1].iov_base = Output;
+        Segments[1].iov_len = OutputCount - Length;
+        memset( &Message, 0, sizeof( Message ) );
+        Message.msg_iov = Segments;
+        Message.msg_iovlen = ( Segments[1].iov_len > 0u ) ? 2u : 1u;
+        /* sendmsg is writev with the flags, a closed peer must not raise SIGPIPE */
+        const ssize_t Sent = sendmsg( Fd, &Message, MSG_NOSIGNAL );
+        if ( Sent > 0 )
+        {
+            HalSocket::Socket.BytesOut.Add( Sent );
+            OutputHead = ( OutputHead + Sent ) % HAL_SOCKET_OUTPUT_SIZE;
+            OutputCount -= Sent;
+            Progress = true;
+        }
+        else if ( ( Sent < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( Sent < 0 ) && ( errno == EAGAIN ) )
+        {
+            /* the rest goes when the socket is writable again */
+            break;
+        }
+        else
+        {
+            Close();
+        }
+    }
+    return ( Fd >= 0 );
+}
+
+/* Open
+ *  Start using the slot for a new connection
+ */
+void HalSocketClient::Open( int NewFd, uint16_t Id )
+{
+    Fd = NewFd;
+    Slot = Id;
+    InputHead = 0u;
+    InputCount = 0u;
+    OutputHead = 0u;
+    OutputCount = 0u;
+    Progress = false;
+    StalledChecks = 0u;
+}
+
+/* Close
+ *  Close the connection
+ */
+void HalSocketClient::Close( void )
+{
+    if ( Fd >= 0 )
+    {
+        struct sockaddr_in peer;
+        socklen_t addrlen = sizeof(peer);
+        if ( getpeername( Fd , (struct sockaddr*)&peer , &addrlen ) == 0 )
+        {
+            printf("Host disconnected , ip %s , port %d \n" , 
+                inet_ntoa(peer.sin_addr) , ntohs(peer.sin_port));  
+        }
+        HalReactor::Reactor.Remove( Fd );
+        close( Fd );
+        HalReactor::Lock();
+        Fd = -1;
+        if ( HalSocket::close_callback != NULL )
+        {
+            HalSocket::close_callback( Slot );
+        }
+        HalReactor::Unlock();
+    }
+}
+
+/* CheckStalled
+ *  Close the connection if the client has stopped taking its replies
+ */
+void HalSocketClient::CheckStalled( void )
+{
+    if ( ( Fd >= 0 ) && ( OutputCount > 0u ) && !Progress )
+    {
+        StalledChecks++;
+        if ( StalledChecks >= HAL_SOCKET_STALL_LIMIT )
+        {
+            printf("Client not reading, ");
+            Close();
+        }
+    }
+    else
+    {
+        StalledChecks = 0u;
+    }
+    Progress = false;
+}
+
 /* HalSocket
  *  Constructor
  */
@@ -48,19 +406,14 @@ HalSocket::HalSocket( void )
 /* Init
  *  
  */
-void HalSocket::Init( uint16_t Port, void (*callback_function)(char*))
+void HalSocket::Init( uint16_t Port, void (*callback_function)(char*), uint32_t (*length_function)(const char*) )
 {  
     int opt = 1;  
-    uint8_t i = 0u;
     HalSocket::callback = callback_function;
-    /* initialise all client_socket[] to 0 so not checked */ 
-    for (i = 0u; i < HAL_SOCKET_MAX_CLIENTS; i++)  
-    {  
-        client_socket[i] = 0u;  
-    }  
+    HalSocket::message_length = ( length_function != NULL ) ? length_function : &HalSocket::MessageLength;
         
     /* create a master socket */ 
-    if( (master_socket = socket(AF_INET , SOCK_STREAM , 0)) == 0)  
+    if( (master_socket = socket(AF_INET , SOCK_STREAM , 0)) < 0)  
     {  
         perror("socket failed");  
         exit(EXIT_FAILURE);  
@@ -86,142 +439,203 @@ void HalSocket::Init( uint16_t Port, void (*callback_function)(char*))
     }  
     printf("Listener on port %d \n", Port);  
         
-    /* try to specify maximum of 3 pending connections for the master socket */
-    if (listen(master_socket, 3) < 0)  
+    if (listen(master_socket, HAL_SOCKET_BACKLOG) < 0)  
     {  
         perror("listen");  
         exit(EXIT_FAILURE);  
     }  
         
-    //accept the incoming connection 
+    /* the reactor thread accepts the incoming connections */
+    if ( !HalReactor::Reactor.Add( master_socket, EPOLLIN, this ) )
+    {  
+        perror("HalReactor");  
+        exit(EXIT_FAILURE);  
+    }  
+    /* and looks for clients that have stopped reading their replies */
+    stall_timer = HalReactor::Reactor.AddTimer( HAL_SOCKET_STALL_CHECK, this );
+    if ( stall_timer < 0 )
+    {  
+        perror("HalReactor");  
+        exit(EXIT_FAILURE);  
+    }  
+    (void)Metrics::RegisterSampled( "starpi_clients", "server=\"telescope\"", "Clients connected to each server",
+                                    METRIC_GAUGE, &HalSocket::SampleClients, this );
+    (void)Metrics::Register( "starpi_received_bytes_total", "server=\"telescope\"", "Bytes received by each server", &BytesIn );
+    (void)Metrics::Register( "starpi_sent_bytes_total", "server=\"telescope\"", "Bytes sent by each server", &BytesOut );
     puts("Waiting for connections ...");  
 }
-/**
+
+/* HandleEvents
+ *  Accept the waiting connections and check for stalled clients
  */
-void HalSocket::Run( void )
+void HalSocket::HandleEvents( uint32_t Events )
 {  
-    static char buffer[HAL_SOCKET_BUFFER_SIZE];
-    int max_sd;  
-    int16_t new_socket;
-    int8_t activity;
-    int valread;
-    const int addrlen = sizeof(address);  
-    int sd; 
-    uint8_t i;  
-    //set of socket descriptors 
-    fd_set readfds;  
-    //a message 
-    const char* message = "StarPi! \r\n";  
-    timeval timeout;
-        
-    //clear the socket set 
-    FD_ZERO(&readfds);  
-    
-    //add master socket to set 
-    FD_SET(master_socket, &readfds);  
-    max_sd = master_socket;  
+    struct sockaddr_in peer;
+    socklen_t addrlen;
+    int new_socket;
+    uint16_t i;  
+    uint64_t expirations;
+    int opt;
+
+    (void)Events;
+    /* the listening socket and the stall timer share this handler */
+    if ( read( stall_timer, &expirations, sizeof(expirations) ) == (ssize_t)sizeof(expirations) )
+    {
+        for ( i = 0; i < HAL_SOCKET_MAX_CLIENTS; i++ )
+        {
+            client_socket[i].CheckStalled();
+        }
+    }
+    /* edge triggered, so accept until there are none left */
+    for ( ; ; )
+    {
+        addrlen = sizeof(peer);
+        new_socket = accept( master_socket, (struct sockaddr *)&peer, &addrlen );
+        if ( new_socket < 0 )
+        {
+            if ( errno == EINTR || errno == ECONNABORTED )
+            {
+                continue;
+            }
+            if ( errno != EAGAIN )
+            {
+                perror("accept");  
+            }
+            break;
+        }
             
-    //add child sockets to set 
-    for ( i = 0 ; i < HAL_SOCKET_MAX_CLIENTS ; i++)  
-    {  
-        //socket descriptor 
-        sd = client_socket[i];  
-                
-        //if valid socket descriptor then add to read list 
-        if(sd > 0)  
-        {
-            FD_SET( sd , &readfds);  
-        }                
-        //highest file descriptor number, need it for the select function 
-        if(sd > max_sd)  
-        {
-            max_sd = sd;  
-        }  
-    }    
-    /* wait for an activity on one of the sockets */ 
-    timeout.tv_sec = 0u;
-    timeout.tv_usec = 500u;
-    activity = select( max_sd + 1 , &readfds , NULL , NULL , &timeout);  
-      
-    if ((activity < 0) && (errno!=EINTR))  
-    {  
-        printf("select error");  
-    }  
-            
-    //If something happened on the master socket , 
-    //then its an incoming connection 
-    if (FD_ISSET(master_socket, &readfds))  
-    {  
-        if ((new_socket = accept(master_socket, (struct sockaddr *)&address, (socklen_t*)&addrlen)) < 0 )  
-        {  
-            perror("accept");  
-            exit(EXIT_FAILURE);  
-        }  
+        /* replies are small and already batched, so send them without waiting */
+        opt = 1;
+        setsockopt( new_socket, IPPROTO_TCP, TCP_NODELAY, (char *)&opt, sizeof(opt) );
             
         //inform user of socket number - used in send and receive commands 
-        printf("New connection , socket fd is %d , ip is : %s , port : %d \n" , new_socket , inet_ntoa(address.sin_addr) , ntohs
-              (address.sin_port));  
-      
-        //send new connection greeting message 
-        //if( send(new_socket, message, strlen(message), 0) != (int)strlen(message) )  
-        //{  
-        //    perror("send");  
-        //}  
-            
-        //puts("Welcome message sent successfully");  
+        printf("New connection , socket fd is %d , ip is : %s , port : %d \n" , new_socket , inet_ntoa(peer.sin_addr) , ntohs
+              (peer.sin_port));  
             
         //add new socket to array of sockets 
+        HalReactor::Lock();
         for (i = 0; i < HAL_SOCKET_MAX_CLIENTS; i++)  
         {  
             //if position is empty 
-            if( client_socket[i] == 0 )  
+            if( client_socket[i].Fd < 0 )  
             {  
-                client_socket[i] = new_socket;  
-                printf("Adding to list of sockets as %d\n" , i);  
-                    
+                client_socket[i].Open( new_socket, i );  
                 break;  
             }
         }
+        HalReactor::Unlock();
+        if ( i == HAL_SOCKET_MAX_CLIENTS )
+        {
+            printf("Too many connections\n");
+            close( new_socket );
+        }
+        else if ( !HalReactor::Reactor.Add( new_socket, EPOLLIN | EPOLLOUT | EPOLLRDHUP, &client_socket[i] ) )
+        {
+            perror("HalReactor");  
+            client_socket[i].Close();
+        }
     }
-    else
+}
+
+/* Close
+ *  Close the listening socket and all the clients
+ */
+void HalSocket::Close( void )
+{
+    uint16_t i;
+    for ( i = 0; i < HAL_SOCKET_MAX_CLIENTS; i++ )
     {
-        //else its some IO operation on some other socket
-        for (i = 0; i < HAL_SOCKET_MAX_CLIENTS; i++)  
+        client_socket[i].Close();
+    }
+    if ( master_socket >= 0 )
+    {
+        HalReactor::Reactor.Remove( master_socket );
+        close( master_socket );
+        master_socket = -1;
+    }
+    if ( stall_timer >= 0 )
+    {
+        HalReactor::Reactor.Remove( stall_timer );
+        close( stall_timer );
+        stall_timer = -1;
+    }
+}
+
+/* GetNumberOfClients
+ *  Get the number of connected clients
+ */
+uint16_t HalSocket::GetNumberOfClients( void )
+{
+    uint16_t i;
+    uint16_t Count = 0u;
+    for ( i = 0; i < HAL_SOCKET_MAX_CLIENTS; i++ )
+    {
+        if ( client_socket[i].Fd >= 0 )
         {
-            sd = client_socket[i];  
-            if ( sd != 0 )
-            {
-                if (FD_ISSET( sd , &readfds))  
-                {
-                    //Check if it was for closing , and also read the 
-                    //incoming message 
-                    if ((valread = read( sd , buffer, HAL_SOCKET_BUFFER_SIZE)) == 0)  
-                    {  
-                        //Somebody disconnected , get his details and print 
-                        getpeername(sd , (struct sockaddr*)&address , \
-                            (socklen_t*)&addrlen);  
-                        printf("Host disconnected , ip %s , port %d \n" , 
-                            inet_ntoa(address.sin_addr) , ntohs(address.sin_port));  
-                            
-                        //Close the socket and mark as 0 in list for reuse 
-                        close( sd );  
-                        client_socket[i] = 0;  
-                    }
-                    else
-                    {
-                        /* search the table for command and run callback */
-                        HalSocket::callback( buffer );
-                        //set the string terminating NULL byte on the end 
-                        //of the data read 
-                        //txbuffer[valread] = '\0';
-                        if ( buffer[0] != NULL )
-                        {
-                            send(sd , buffer , strlen(buffer) , 0 );  
-                        }
-                    }
-                }
-            }
+            Count++;
         }
     }
+    return Count;
 }
 
+/* SampleClients
+ *  Get the number of connected clients for Metrics
+ */
+double HalSocket::SampleClients( void* Context )
+{
+    return ( (HalSocket*)Context )->GetNumberOfClients();
+}
+
+/* MessageLength
+ *  Default message framing, a message ends with a '#' or a newline
+ */
+uint32_t HalSocket::MessageLength( const char* Buffer )
+{
+    const uint32_t Length = strcspn( Buffer, "#\n" );
+    return ( Buffer[Length] != '\0' ) ? ( Length + 1u ) : 0u;
+}
+
+/* GetCurrentClient
+ *  Get the client whose message the callback is handling
+ */
+uint16_t HalSocket::GetCurrentClient( void )
+{
+    return current_client;
+}
+
+/* Send
+ *  Send a message to a client that has not asked for it
+ */
+bool HalSocket::Send( uint16_t Client, const char* Message, uint32_t Length )
+{
+    struct iovec Segment;
+    Segment.iov_base = (void*)Message;
+    Segment.iov_len = Length;
+    return Send( Client, &Segment, 1u );
+}
+
+/* Send
+ *  Send a message made of several parts
+ */
+bool HalSocket::Send( uint16_t Client, const struct iovec* Segments, uint32_t Count )
+{
+    return ( Client < HAL_SOCKET_MAX_CLIENTS ) && client_socket[Client].Send( Segments, Count );
+}
+
+/* SetCloseCallback
+ *  Set a function to call when a client is closed
+ */
+void HalSocket::SetCloseCallback( void (*close_function)(uint16_t) )
+{
+    close_callback = close_function;
+}
+
+/* SetBinaryCallback
+ *  Accept binary messages as well as text
+ */
+void HalSocket::SetBinaryCallback( uint32_t (*length_function)(const uint8_t*, uint32_t),
+                                   uint32_t (*binary_function)(const uint8_t*, uint32_t, uint8_t*) )
+{
+    binary_length = length_function;
+    binary_callback = binary_function;
+}
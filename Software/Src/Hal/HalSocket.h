@@ -27,39 +27,177 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define HALSOCKET_H
 
 #include <stdint.h>
-#include "Runnable.h"
+#include <netinet/in.h>
+#include <sys/uio.h>
+#include "HalReactor.h"
+#include "Metrics.h"
 
 /* Configuration */
 
-#define HAL_SOCKET_MAX_CLIENTS 30
-#define HAL_SOCKET_BUFFER_SIZE 50
-        
+#define HAL_SOCKET_MAX_CLIENTS 512
+#define HAL_SOCKET_MESSAGE_SIZE 1024u /**< longest text message, including the terminator */
+#define HAL_SOCKET_REPLY_SIZE  2048u /**< longest text reply, including the terminator */
+#define HAL_SOCKET_BINARY_SIZE 1024u /**< longest binary message or reply */
+#define HAL_SOCKET_INPUT_SIZE  2048u /**< per client ring of received bytes, must exceed the longest message */
+#define HAL_SOCKET_OUTPUT_SIZE 4096u /**< per client queue of replies waiting to be sent, at least the longest reply */
+#define HAL_SOCKET_BACKLOG     128   /**< pending connections queued by the kernel */
+#define HAL_SOCKET_STALL_CHECK 1000000u /**< microseconds between checks for clients that stopped reading */
+#define HAL_SOCKET_STALL_LIMIT 5u    /**< checks without progress before a client is disconnected */
+
+/** HalSocketClient
+ * - One connected client, owned by HalSocket
+ * - Received bytes are kept in a ring until a whole message has arrived,
+ *   the replies are queued and sent as the socket becomes writable.
+ *   While the reply queue is too full for another reply no more messages
+ *   are taken from the client, so a client that does not read stops
+ *   itself and nobody else.
+ */
+class HalSocketClient: public HalReactorHandler
+{
+    public:
+    /** Constructor
+     */
+        HalSocketClient( void );
+    /** Read the waiting messages, send the replies
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+    /** Start using the slot for a new connection, the dispatch lock must be held
+     * @param NewFd client socket
+     * @param Id index of the slot
+     */
+        void Open( int NewFd, uint16_t Id );
+    /** Close the connection
+     */
+        void Close( void );
+    /** Queue a message and start sending it
+     * @param Segments the parts of the message, in order
+     * @param Count number of parts
+     * @return bool false if the client is closed or the queue has no room
+     */
+        bool Send( const struct iovec* Segments, uint32_t Count );
+    /** Called periodically, closes the connection if replies are waiting
+     *  and none have been taken for HAL_SOCKET_STALL_LIMIT checks
+     */
+        void CheckStalled( void );
+
+        int Fd;    /**< client socket, -1 if the slot is free */
+        uint16_t Slot;   /**< position in HalSocket's table, passed to the callbacks */
+    private:
+    /** Run the callback on each complete message in the input ring
+     * @return bool false if the client was closed or the reply queue is full
+     */
+        bool ProcessMessages( void );
+    /** Take a text message from the input ring and queue its reply
+     * @param Queued set if a reply was queued
+     * @return bool false if the message is incomplete or the client was closed
+     */
+        bool ProcessText( bool* Queued );
+    /** Take a binary message from the input ring and queue its reply
+     * @param Queued set if a reply was queued
+     * @return bool false if the message is incomplete or the client was closed
+     */
+        bool ProcessBinary( bool* Queued );
+    /** Add a reply to the output queue, the caller checks there is room
+     */
+        void QueueReply( const char* Reply, uint32_t Length );
+    /** Send as much of the output queue as the socket will take, the
+     *  queue is a ring so it goes as one writev of up to two segments
+     * @return bool false if the client was closed
+     */
+        bool Flush( void );
+
+        char     Input[HAL_SOCKET_INPUT_SIZE];    /**< received bytes */
+        uint32_t InputHead;                       /**< index of the oldest received byte */
+        uint32_t InputCount;                      /**< number of received bytes */
+        char     Output[HAL_SOCKET_OUTPUT_SIZE];  /**< replies to send */
+        uint32_t OutputHead;                      /**< index of the next byte to send */
+        uint32_t OutputCount;                     /**< number of bytes to send */
+        bool     Progress;                        /**< bytes were sent since the last check */
+        uint8_t  StalledChecks;                   /**< checks with replies waiting and nothing sent */
+};
+
 /** HalSocket
  * - Class to provide a socket
  */
-class HalSocket: public Runnable 
+class HalSocket: public HalReactorHandler
 {
     public:
     /** Constructor
      */
         HalSocket( void );
-    /** Initialise
-     * @return bool Initialisation status  
+    /** Initialise, registers the listening socket with HalReactor::Reactor
+     * @param Port TCP port to listen on
+     * @param callback_function called with each message, replaces it with the
+     *        reply, the buffer holds HAL_SOCKET_REPLY_SIZE bytes
+     * @param length_function returns the length of the first message in
+     *        the string or 0 if it is incomplete, NULL for MessageLength
+     */
+        void Init( uint16_t Port, void (*callback_function)(char*), uint32_t (*length_function)(const char*) = NULL );
+    /** Accept the waiting connections and check for stalled clients
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+    /** Close the listening socket and all the clients
      */
-        void Init( uint16_t Port, void (*callback_function)(char*) );
-    /** Runs the filter
+        void Close( void );
+    /** Get the number of connected clients, the dispatch lock must be held
      */
-        void Run( void );
-    /** ThreadRun
-     *  Check for any new data store in the input queue
+        uint16_t GetNumberOfClients( void );
+    /** Get the number of connected clients for Metrics, the sample lock is held
+     * @param Context the HalSocket
+     */
+        static double SampleClients( void* Context );
+    /** Get the client whose message the callback is handling
+     */
+        static uint16_t GetCurrentClient( void );
+    /** Send a message to a client that has not asked for it, reactor thread only
+     * @param Client index from GetCurrentClient
+     * @return bool false if the client is gone or is not keeping up
+     */
+        bool Send( uint16_t Client, const char* Message, uint32_t Length );
+    /** Send a message made of several parts, they are queued together and
+     *  go out in one write, reactor thread only
+     * @param Client index from GetCurrentClient
+     * @param Segments the parts of the message, in order
+     * @param Count number of parts
+     * @return bool false if the client is gone or is not keeping up
+     */
+        bool Send( uint16_t Client, const struct iovec* Segments, uint32_t Count );
+    /** Set a function to call, with the dispatch lock held, when a client
+     *  is closed, so the protocol can forget any state it keeps for it
+     */
+        void SetCloseCallback( void (*close_function)(uint16_t) );
+    /** Accept binary messages as well as text. A message whose first byte
+     *  is above 0x7F is binary, its length comes from length_function and
+     *  binary_function writes the reply, of up to HAL_SOCKET_BINARY_SIZE bytes.
+     * @param length_function returns the length of the message at the start
+     *        of the bytes, 0 if incomplete, over HAL_SOCKET_BINARY_SIZE if invalid
+     * @param binary_function called with the message, returns the reply length
+     */
+        void SetBinaryCallback( uint32_t (*length_function)(const uint8_t*, uint32_t),
+                                uint32_t (*binary_function)(const uint8_t*, uint32_t, uint8_t*) );
+
+    /** Default message framing, a message ends with a '#' or a newline
+     * @param Buffer received bytes, null terminated
+     * @return uint32_t length of the first message including its terminator, 0 if incomplete
      */
+        static uint32_t MessageLength( const char* Buffer );
 
         static HalSocket Socket; /**< We only want one object handling any stdio. */
+        MetricCounter BytesIn;   /**< received from all the clients */
+        MetricCounter BytesOut;  /**< sent to all the clients */
         static void (*callback)(char*);
+        static uint32_t (*message_length)(const char*);
+        static void (*close_callback)(uint16_t);
+        static uint32_t (*binary_length)(const uint8_t*, uint32_t);
+        static uint32_t (*binary_callback)(const uint8_t*, uint32_t, uint8_t*);
+        static uint16_t current_client;                           /**< client being handled by callback */
     private:
-        static int master_socket;                            /**<  */
-        static struct sockaddr_in address;                   /**<  */
-        static int client_socket[HAL_SOCKET_MAX_CLIENTS];    /**<  */
+        static int master_socket;                                 /**<  */
+        static int stall_timer;                                   /**< timer for CheckStalled */
+        static struct sockaddr_in address;                        /**<  */
+        static HalSocketClient client_socket[HAL_SOCKET_MAX_CLIENTS];    /**<  */
 };
 
 #endif /* HALSOCKET_H */
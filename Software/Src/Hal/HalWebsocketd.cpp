@@ -1,10 +1,8 @@
 /**
-HalWebsocketd provides an interface to the websocketd. 
-This will queue messages from websocketd ready to be used and queue 
-messages to be sent. The send queue will update messages in the queue 
-with the same Id instead of adding another item to the queue. 
-Each time the run function is called, a message will be taken from 
-the queue and sent to websocketd
+HalWebsocketd is the WebSocket (RFC 6455) server for the web page.
+This will queue messages from the clients ready to be used and keep
+the latest message to be sent for each Id. Each time the run function
+is called, the messages that have changed are sent to every client
 
 Author and copyright of this file:
 Chris Dick, 2016
@@ -25,155 +23,811 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 */
 
 #include <stdio.h>
-#include <iostream>
-#include <sys/poll.h>
+#include <unistd.h>
+#include <errno.h>
 #include <string.h>
+#include <strings.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
 #include "Config.h"
-
-#ifdef TIMING
-#include "GPIO.h"
-#endif
+#include "Sha1.h"
+#include "Trace.h"
 
 #include "HalWebsocketd.h"
 
 HalWebsocketd   HalWebsocketd::Websocket;
 
+/* appended to the client's key for the handshake, from RFC 6455 */
+static const char HandshakeGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+/* HalWebsocketClient
+ *  Constructor
+ */
+HalWebsocketClient::HalWebsocketClient( void )
+{
+    State = HAL_WEBSOCKET_CLOSED;
+    Fd = -1;
+    InputCount = 0u;
+    OutputHead = 0u;
+    OutputCount = 0u;
+    MessageLength = 0u;
+    MessageText = false;
+    MissedPings = 0u;
+    Pending = 0u;
+}
+
+/* HandleEvents
+ *  Read the waiting frames and send the queued ones
+ */
+void HalWebsocketClient::HandleEvents( uint32_t Events )
+{
+    bool Reading = Flush();
+    (void)Events;
+    /* edge triggered, so read until the socket stops us */
+    while ( Reading )
+    {
+        if ( State == HAL_WEBSOCKET_CLOSING )
+        {
+            /* read to the end, closing with unread data would reset the
+               connection and the client could lose the close frame */
+            InputCount = 0u;
+        }
+        const ssize_t valread = read( Fd, &Input[InputCount], HAL_WEBSOCKET_INPUT_SIZE - InputCount );
+        if ( valread > 0 )
+        {
+            HalWebsocketd::Websocket.BytesIn.Add( valread );
+            InputCount += valread;
+            MissedPings = 0u;
+            if ( State == HAL_WEBSOCKET_HANDSHAKE )
+            {
+                (void)ProcessHandshake();
+            }
+            if ( State == HAL_WEBSOCKET_OPEN )
+            {
+                (void)ProcessFrames();
+            }
+            Reading = Flush();
+        }
+        else if ( ( valread < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( valread < 0 ) && ( errno == EAGAIN ) )
+        {
+            Reading = false;
+        }
+        else
+        {
+            /* Somebody disconnected or the connection failed */
+            Close();
+            Reading = false;
+        }
+    }
+    /* a new page, or one that has caught up, is sent the values it is missing */
+    if ( ( State == HAL_WEBSOCKET_OPEN ) && ( Pending != 0u ) && ( OutputCount == 0u ) )
+    {
+        HalWebsocketd::Websocket.Push();
+    }
+}
+
+/* ProcessHandshake
+ *  Answer the HTTP upgrade request once it has all arrived
+ */
+bool HalWebsocketClient::ProcessHandshake( void )
+{
+    static const char KeyHeader[] = "Sec-WebSocket-Key:";
+    char Key[HAL_WEBSOCKET_KEY_SIZE + sizeof( HandshakeGuid )];
+    char Accept[SHA1_BASE64_SIZE];
+    char Reply[160];
+    uint8_t Digest[SHA1_DIGEST_SIZE];
+    uint32_t KeyLength = 0u;
+    const char* Line = Input;
+    const char* End = NULL;
+    int Length = 0;
+
+    /* the request is text, the last byte is kept for the terminator */
+    if ( InputCount >= HAL_WEBSOCKET_INPUT_SIZE )
+    {
+        printf("WebSocket request too long\n");
+        Close();
+        return false;
+    }
+    Input[InputCount] = '\0';
+    End = strstr( Input, "\r\n\r\n" );
+    if ( End == NULL )
+    {
+        /* wait for the rest of the request */
+        return false;
+    }
+    /* find the key in the headers */
+    while ( ( Line != NULL ) && ( Line < End ) && ( KeyLength == 0u ) )
+    {
+        Line = strstr( Line, "\r\n" );
+        if ( Line != NULL )
+        {
+            Line += 2;
+            if ( strncasecmp( Line, KeyHeader, sizeof( KeyHeader ) - 1u ) == 0 )
+            {
+                const char* Value = &Line[sizeof( KeyHeader ) - 1u];
+                Value += strspn( Value, " \t" );
+                KeyLength = strcspn( Value, " \t\r" );
+                if ( KeyLength > HAL_WEBSOCKET_KEY_SIZE )
+                {
+                    KeyLength = 0u;
+                    break;
+                }
+                memcpy( Key, Value, KeyLength );
+            }
+        }
+    }
+    if ( ( strncmp( Input, "GET ", 4 ) != 0 ) || ( KeyLength == 0u ) )
+    {
+        static const char BadRequest[] = "HTTP/1.1 400 Bad Request\r\nSec-WebSocket-Version: 13\r\nContent-Length: 0\r\n\r\n";
+        QueueOutput( BadRequest, sizeof( BadRequest ) - 1u );
+        State = HAL_WEBSOCKET_CLOSING;
+        return false;
+    }
+    /* the accept value proves the request was read by a WebSocket server */
+    memcpy( &Key[KeyLength], HandshakeGuid, sizeof( HandshakeGuid ) - 1u );
+    Sha1::Digest( (const uint8_t*)Key, KeyLength + sizeof( HandshakeGuid ) - 1u, Digest );
+    Sha1::Base64( Digest, sizeof( Digest ), Accept );
+    Length = snprintf( Reply, sizeof( Reply ), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\n"
+                       "Connection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", Accept );
+    QueueOutput( Reply, Length );
+    State = HAL_WEBSOCKET_OPEN;
+    /* a new page gets every value at the next push, not just the changes */
+    Pending = HAL_WEBSOCKET_ALL_FIELDS;
+    /* frames may follow the request straight away */
+    Length = ( End + 4 ) - Input;
+    InputCount -= Length;
+    memmove( Input, &Input[Length], InputCount );
+    return true;
+}
+
+/* ProcessFrames
+ *  Handle each complete frame in the input buffer
+ */
+bool HalWebsocketClient::ProcessFrames( void )
+{
+    bool Result = true;
+    uint32_t Used = 0u;
+    while ( Result && ( State == HAL_WEBSOCKET_OPEN ) && ( ( InputCount - Used ) >= 2u ) )
+    {
+        const uint8_t* Frame = (const uint8_t*)&Input[Used];
+        const uint32_t Available = InputCount - Used;
+        const uint8_t Opcode = Frame[0] & 0x0Fu;
+        const bool Final = ( ( Frame[0] & 0x80u ) != 0u );
+        uint64_t Length = Frame[1] & 0x7Fu;
+        uint32_t Header = 2u;
+        uint32_t Index = 0u;
+        if ( Length == 126u )
+        {
+            Header = 4u;
+        }
+        else if ( Length == 127u )
+        {
+            Header = 10u;
+        }
+        if ( Available < Header )
+        {
+            /* wait for the rest of the length */
+            break;
+        }
+        if ( Header > 2u )
+        {
+            Length = 0u;
+            for ( Index = 2u; Index < Header; Index++ )
+            {
+                Length = ( Length << 8 ) | Frame[Index];
+            }
+        }
+        /* clients must mask, and there are no extensions to use the reserved bits */
+        if ( ( ( Frame[1] & 0x80u ) == 0u ) || ( ( Frame[0] & 0x70u ) != 0u )
+             || ( ( Opcode >= HAL_WEBSOCKET_CLOSE ) && ( !Final || ( Length > 125u ) ) ) )
+        {
+            SendClose( 1002u );
+            Result = false;
+        }
+        else if ( Length > ( HAL_WEBSOCKET_INPUT_SIZE - Header - 4u ) )
+        {
+            SendClose( 1009u );
+            Result = false;
+        }
+        else if ( Available < ( Header + 4u + Length ) )
+        {
+            /* wait for the rest of the frame */
+            break;
+        }
+        else
+        {
+            /* unmask the payload where it is */
+            char* Payload = &Input[Used + Header + 4u];
+            for ( Index = 0u; Index < Length; Index++ )
+            {
+                Payload[Index] ^= Frame[Header + ( Index % 4u )];
+            }
+            Used += Header + 4u + Length;
+            Result = ProcessFrame( Opcode, Final, Payload, Length );
+        }
+    }
+    if ( Fd >= 0 )
+    {
+        InputCount -= Used;
+        memmove( Input, &Input[Used], InputCount );
+    }
+    return Result;
+}
+
+/* ProcessFrame
+ *  Handle the payload of one frame
+ */
+bool HalWebsocketClient::ProcessFrame( uint8_t Opcode, bool Final, char* Payload, uint32_t Length )
+{
+    bool Result = true;
+    switch ( Opcode )
+    {
+        case HAL_WEBSOCKET_TEXT:
+        case HAL_WEBSOCKET_BINARY:
+        case HAL_WEBSOCKET_CONTINUATION:
+        {
+            /* a message may come in fragments, only text that fits is kept */
+            if ( Opcode != HAL_WEBSOCKET_CONTINUATION )
+            {
+                MessageLength = 0u;
+                MessageText = ( Opcode == HAL_WEBSOCKET_TEXT );
+            }
+            if ( MessageText && ( ( MessageLength + Length ) <= DATALENGTH ) )
+            {
+                memcpy( &Message[MessageLength], Payload, Length );
+                MessageLength += Length;
+            }
+            else
+            {
+                MessageText = false;
+            }
+            if ( Final && MessageText )
+            {
+                /* websocketd passed on lines, so a trailing newline is not part of the message */
+                while ( ( MessageLength > 0u ) && ( ( Message[MessageLength - 1u] == '\n' ) || ( Message[MessageLength - 1u] == '\r' ) ) )
+                {
+                    MessageLength--;
+                }
+                Message[MessageLength] = '\0';
+                if ( MessageLength > 0u )
+                {
+                    (void)HalWebsocketd::Websocket.ReceiveMessage( Message );
+                }
+                MessageText = false;
+            }
+            break;
+        }
+        case HAL_WEBSOCKET_CLOSE:
+        {
+            /* answer with the same status, the client then closes */
+            (void)QueueFrame( HAL_WEBSOCKET_CLOSE, Payload, ( Length >= 2u ) ? 2u : 0u );
+            State = HAL_WEBSOCKET_CLOSING;
+            Result = false;
+            break;
+        }
+        case HAL_WEBSOCKET_PING:
+        {
+            if ( !QueueFrame( HAL_WEBSOCKET_PONG, Payload, Length ) )
+            {
+                printf("WebSocket client not reading, ");
+                Close();
+                Result = false;
+            }
+            break;
+        }
+        case HAL_WEBSOCKET_PONG:
+        {
+            /* anything received clears MissedPings */
+            break;
+        }
+        default:
+        {
+            SendClose( 1002u );
+            Result = false;
+            break;
+        }
+    }
+    return Result;
+}
+
+/* SendClose
+ *  Send a close frame, the client then closes
+ */
+void HalWebsocketClient::SendClose( uint16_t Status )
+{
+    char Payload[2];
+    Payload[0] = (char)( Status >> 8 );
+    Payload[1] = (char)( Status & 0xFFu );
+    if ( QueueFrame( HAL_WEBSOCKET_CLOSE, Payload, sizeof( Payload ) ) )
+    {
+        State = HAL_WEBSOCKET_CLOSING;
+    }
+    else
+    {
+        Close();
+    }
+}
+
+/* QueueFrame
+ *  Add a frame to the output queue
+ */
+bool HalWebsocketClient::QueueFrame( uint8_t Opcode, const char* Payload, uint32_t Length )
+{
+    char Header[10];
+    uint32_t HeaderLength = 2u;
+    bool Result = false;
+    /* the server does not mask its frames */
+    Header[0] = (char)( 0x80u | Opcode );
+    if ( Length < 126u )
+    {
+        Header[1] = (char)Length;
+    }
+    else if ( Length <= 0xFFFFu )
+    {
+        Header[1] = (char)126u;
+        Header[2] = (char)( Length >> 8 );
+        Header[3] = (char)( Length & 0xFFu );
+        HeaderLength = 4u;
+    }
+    else
+    {
+        uint32_t Index = 0u;
+        Header[1] = (char)127u;
+        for ( Index = 0u; Index < 8u; Index++ )
+        {
+            Header[2u + Index] = (char)( ( (uint64_t)Length >> ( 56u - ( Index * 8u ) ) ) & 0xFFu );
+        }
+        HeaderLength = 10u;
+    }
+    if ( ( State == HAL_WEBSOCKET_OPEN ) && ( ( HAL_WEBSOCKET_OUTPUT_SIZE - OutputCount ) >= ( HeaderLength + Length ) ) )
+    {
+        QueueOutput( Header, HeaderLength );
+        QueueOutput( Payload, Length );
+        Result = true;
+    }
+    return Result;
+}
+
+/* QueueOutput
+ *  Add bytes to the output queue
+ */
+void HalWebsocketClient::QueueOutput( const char* Data, uint32_t Length )
+{
+    const uint32_t Tail = ( OutputHead + OutputCount ) % HAL_WEBSOCKET_OUTPUT_SIZE;
+    uint32_t First = HAL_WEBSOCKET_OUTPUT_SIZE - Tail;
+    if ( Length > 0u )
+    {
+        /* copy in two parts if it wraps */
+        if ( First > Length )
+        {
+            First = Length;
+        }
+        memcpy( &Output[Tail], Data, First );
+        memcpy( Output, &Data[First], Length - First );
+        OutputCount += Length;
+    }
+}
+
+/* Flush
+ *  Send as much of the output queue as the socket will take
+ */
+bool HalWebsocketClient::Flush( void )
+{
+    while ( ( Fd >= 0 ) && ( OutputCount > 0u ) )
+    {
+        struct iovec Segments[2];
+        struct msghdr Header;
+        uint32_t Length = HAL_WEBSOCKET_OUTPUT_SIZE - OutputHead;
+        if ( Length > OutputCount )
+        {
+            Length = OutputCount;
+        }
+        /* the queue from the head to the end of the ring, then what wrapped */
+        Segments[0].iov_base = &Output[OutputHead];
+        Segments[0].iov_len = Length;
+        Segments[1].iov_base = Output;
+        Segments[1].iov_len = OutputCount - Length;
+        memset( &Header, 0, sizeof( Header ) );
+        Header.msg_iov = Segments;
+        Header.msg_iovlen = ( Segments[1].iov_len > 0u ) ? 2u : 1u;
+        const ssize_t Sent = sendmsg( Fd, &Header, MSG_NOSIGNAL );
+        if ( Sent > 0 )
+        {
+            HalWebsocketd::Websocket.BytesOut.Add( Sent );
+            OutputHead = ( OutputHead + Sent ) % HAL_WEBSOCKET_OUTPUT_SIZE;
+            OutputCount -= Sent;
+        }
+        else if ( ( Sent < 0 ) && ( errno == EINTR ) )
+        {
+            /* try again */
+        }
+        else if ( ( Sent < 0 ) && ( errno == EAGAIN ) )
+        {
+            /* the rest goes when the socket is writable again */
+            break;
+        }
+        else
+        {
+            Close();
+        }
+    }
+    if ( ( Fd >= 0 ) && ( State == HAL_WEBSOCKET_CLOSING ) && ( OutputCount == 0u ) )
+    {
+        /* the close frame has gone, the client closes when it has read it */
+        shutdown( Fd, SHUT_WR );
+    }
+    return ( Fd >= 0 );
+}
+
+/* Ping
+ *  Ping the client, close the connection if it has stopped answering
+ */
+void HalWebsocketClient::Ping( void )
+{
+    if ( Fd >= 0 )
+    {
+        if ( MissedPings >= HAL_WEBSOCKET_PING_LIMIT )
+        {
+            printf("WebSocket client not answering, ");
+            Close();
+        }
+        else
+        {
+            MissedPings++;
+            if ( QueueFrame( HAL_WEBSOCKET_PING, NULL, 0u ) )
+            {
+                (void)Flush();
+            }
+        }
+    }
+}
+
+/* GetOutputCount
+ *  Get the number of bytes waiting to be sent
+ */
+uint32_t HalWebsocketClient::GetOutputCount( void )
+{
+    return OutputCount;
+}
+
+/* Open
+ *  Start using the slot for a new connection
+ */
+void HalWebsocketClient::Open( int NewFd )
+{
+    Fd = NewFd;
+    InputCount = 0u;
+    OutputHead = 0u;
+    OutputCount = 0u;
+    MessageLength = 0u;
+    MessageText = false;
+    MissedPings = 0u;
+    Pending = 0u;
+    HalReactor::Lock();
+    State = HAL_WEBSOCKET_HANDSHAKE;
+    HalReactor::Unlock();
+}
+
+/* Close
+ *  Close the connection
+ */
+void HalWebsocketClient::Close( void )
+{
+    if ( Fd >= 0 )
+    {
+        printf("WebSocket client disconnected\n");
+        HalReactor::Reactor.Remove( Fd );
+        close( Fd );
+        Fd = -1;
+        HalReactor::Lock();
+        State = HAL_WEBSOCKET_CLOSED;
+        HalReactor::Unlock();
+    }
+}
+
 /* HalWebsocketd
  *  Constructor
  */
 HalWebsocketd::HalWebsocketd( void )
 {
+    ListenFd = -1;
+    WakeFd = -1;
+    PingTimer = -1;
+    Changed = 0u;
+    Valid = 0u;
 }
 
 /* HalWebsocketdInit
- *  Initialise the GPSD connection
- * @return bool Initialisation status  
+ *  Listen for the web page
+ * @return bool Initialisation status
  */
-void HalWebsocketd::Init( void )
+bool HalWebsocketd::Init( uint16_t Port )
 {
+    struct sockaddr_in Address;
+    int Opt = 1;
     /*
-        reset all queues and the buffer
+        reset the queue and the values
     */
     InputQueue.ReadIndex = 0;
     InputQueue.WriteIndex = 0;
     InputQueue.FillLevel = 0;
-    OutputQueue.ReadIndex = 0;
-    OutputQueue.WriteIndex = 0;
-    OutputQueue.FillLevel = 0;
-    
-#ifdef TIMING
-    GPIO::gpio.SetupOutput( HAL_WEBSOCKETD_PIN );
-    GPIO::gpio.SetPullMode( HAL_WEBSOCKETD_PIN , PULL_UP );
-#endif
+    Changed = 0u;
+    Valid = 0u;
 
+    memset( &Address, 0, sizeof( Address ) );
+    Address.sin_family = AF_INET;
+    Address.sin_addr.s_addr = INADDR_ANY;
+    Address.sin_port = htons( Port );
+    ListenFd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( ( ListenFd < 0 )
+         || ( setsockopt( ListenFd, SOL_SOCKET, SO_REUSEADDR, (char *)&Opt, sizeof( Opt ) ) < 0 )
+         || ( bind( ListenFd, (struct sockaddr *)&Address, sizeof( Address ) ) < 0 )
+         || ( listen( ListenFd, HAL_WEBSOCKET_BACKLOG ) < 0 ) )
+    {
+        perror( "HalWebsocketd" );
+        return false;
+    }
+    printf("WebSocket listener on port %d \n", Port);
+
+    /* the reactor thread accepts the connections, sends when Run asks and pings */
+    WakeFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    PingTimer = HalReactor::Reactor.AddTimer( HAL_WEBSOCKET_PING_PERIOD, this );
+    if ( ( WakeFd < 0 ) || ( PingTimer < 0 )
+         || !HalReactor::Reactor.Add( ListenFd, EPOLLIN, this )
+         || !HalReactor::Reactor.Add( WakeFd, EPOLLIN, this ) )
+    {
+        perror( "HalWebsocketd" );
+        return false;
+    }
+
+    (void)Metrics::RegisterSampled( "starpi_clients", "server=\"websocket\"", "Clients connected to each server",
+                                    METRIC_GAUGE, &HalWebsocketd::SampleClients, this );
+    (void)Metrics::Register( "starpi_received_bytes_total", "server=\"websocket\"", "Bytes received by each server", &BytesIn );
+    (void)Metrics::Register( "starpi_sent_bytes_total", "server=\"websocket\"", "Bytes sent by each server", &BytesOut );
+    (void)Metrics::RegisterSampled( "starpi_websocket_input_queue_messages", "", "Messages from the web page waiting to be used",
+                                    METRIC_GAUGE, &HalWebsocketd::SampleInputQueue, this );
+    (void)Metrics::RegisterSampled( "starpi_websocket_output_queue_bytes", "", "Bytes waiting to be sent to the web pages",
+                                    METRIC_GAUGE, &HalWebsocketd::SampleOutputQueue, this );
+
+    return true;
+}
+
+/* Close
+ *  Close the listening socket and all the clients
+ */
+void HalWebsocketd::Close( void )
+{
+    uint8_t Index = 0u;
+    for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
+    {
+        Clients[Index].Close();
+    }
+    if ( ListenFd >= 0 )
+    {
+        HalReactor::Reactor.Remove( ListenFd );
+        close( ListenFd );
+        ListenFd = -1;
+    }
+    if ( WakeFd >= 0 )
+    {
+        HalReactor::Reactor.Remove( WakeFd );
+        close( WakeFd );
+        WakeFd = -1;
+    }
+    if ( PingTimer >= 0 )
+    {
+        HalReactor::Reactor.Remove( PingTimer );
+        close( PingTimer );
+        PingTimer = -1;
+    }
 }
 
 /* HalWebsocketdRun
- *  Sends a single message from the output queue
+ *  Wakes the reactor thread to send the changed messages
  */
 void HalWebsocketd::Run( void )
-{    
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( HAL_WEBSOCKETD_PIN , true );
-    #endif
+{
+    TRACE_BEGIN( TRACE_HAL_WEBSOCKETD, 0u );
 
-    char OutputMessage[DATALENGTH+1] = { 0 };
-    ThreadRun();
     /*
-        Send a message if any are waiting
+        Send the messages if any have changed
     */
-    if (!QueueEmpty(&OutputQueue))
+    if ( Changed != 0u )
     {
-        //printf("FillLevel = %d ReadIndex = %d WriteIndex = %d\n", OutputQueue.FillLevel, OutputQueue.ReadIndex, OutputQueue.WriteIndex ); 
-        GetNextMessage( &OutputQueue, OutputMessage);
-        puts( OutputMessage );   
+        const uint64_t One = 1u;
+        const ssize_t Written = write( WakeFd, &One, sizeof( One ) );
+        (void)Written;
     }
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( HAL_WEBSOCKETD_PIN , false );
-    #endif
+    TRACE_END( TRACE_HAL_WEBSOCKETD, (uint32_t)__builtin_popcountll( Changed ) );
 }
 
-/* ThreadRun
- *  Check for any new data store in the input queue
+/* HandleEvents
+ *  Called by the reactor for new connections, the ping timer and Run
  */
-void HalWebsocketd::ThreadRun( void )
+void HalWebsocketd::HandleEvents( uint32_t Events )
 {
-    static uint8_t BufferIndex = 0;
-    static char InputMessage[DATALENGTH+1] = { 0 };
-    /*
-        Check for new input and add to queue
-    */
-    struct pollfd fds;
-    fds.fd = 0;//STDIN_FILENO ; /* this is STDIN */
-    fds.events = POLLIN;
-    if ( poll(&fds, 1, 0) == 1)
+    uint64_t Count = 0u;
+    uint8_t Index = 0u;
+    (void)Events;
+    /* the listening socket, the wake up and the timer share this handler */
+    if ( read( PingTimer, &Count, sizeof( Count ) ) == (ssize_t)sizeof( Count ) )
     {
-        while ( poll(&fds, 1, 0) == 1)
+        for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
         {
-            InputMessage[BufferIndex] = getchar();
-            if ( InputMessage[BufferIndex] == '\n' )
-            {
-                InputMessage[BufferIndex] = '\0';
-                AddMessage( &InputQueue, InputMessage, 0 );   
-                BufferIndex = 0;
-            }
-            else
-            {
-                BufferIndex++;
-            }
+            Clients[Index].Ping();
         }
     }
-    if ( BufferIndex > DATALENGTH )
+    if ( read( WakeFd, &Count, sizeof( Count ) ) == (ssize_t)sizeof( Count ) )
     {
-        BufferIndex = 0;
+        Push();
     }
+    Accept();
 }
 
-
-/* Add a message to the queue
- * This function is not thread safe so must only 
- * be called from the same thread as anything that
- * reads from the output queue.
- * @return bool_t if the message was added
+/* Accept
+ *  Accept the waiting connections
  */
-bool HalWebsocketd::SendMessage( char* Message, uint8_t Id )
+void HalWebsocketd::Accept( void )
 {
-    bool Result = false;
-    /*
-        check each queue location between read and write indecies
-        and update if the message id already exists
-    */
-    if (!QueueEmpty(&OutputQueue))
+    struct sockaddr_in Peer;
+    socklen_t Length;
+    int NewFd;
+    int Opt;
+    uint8_t Index;
+    /* edge triggered, so accept until there are none left */
+    for ( ; ; )
     {
-        uint8_t Index = OutputQueue.ReadIndex;
-        uint8_t I = 0;
-        for (I = 0 ; I < OutputQueue.FillLevel; I++)
+        Length = sizeof( Peer );
+        NewFd = accept( ListenFd, (struct sockaddr *)&Peer, &Length );
+        if ( NewFd < 0 )
+        {
+            if ( ( errno == EINTR ) || ( errno == ECONNABORTED ) )
+            {
+                continue;
+            }
+            if ( errno != EAGAIN )
+            {
+                perror( "accept" );
+            }
+            break;
+        }
+        /* the frames are already batched, so send them without waiting */
+        Opt = 1;
+        setsockopt( NewFd, IPPROTO_TCP, TCP_NODELAY, (char *)&Opt, sizeof( Opt ) );
+        printf("New WebSocket connection , ip is : %s , port : %d \n", inet_ntoa( Peer.sin_addr ), ntohs( Peer.sin_port ) );
+        for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
         {
-            if (OutputQueue.Message[Index].Id == Id)
-            {   
-                strcpy ( OutputQueue.Message[Index].Data, Message );
-                Result = true;
+            if ( Clients[Index].State == HAL_WEBSOCKET_CLOSED )
+            {
+                Clients[Index].Open( NewFd );
                 break;
             }
-            Index++;
-            if (Index == QUEUESIZE)
+        }
+        if ( Index == HAL_WEBSOCKET_MAX_CLIENTS )
+        {
+            printf("Too many WebSocket connections\n");
+            close( NewFd );
+        }
+        else if ( !HalReactor::Reactor.Add( NewFd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, &Clients[Index] ) )
+        {
+            perror( "HalReactor" );
+            Clients[Index].Close();
+        }
+    }
+}
+
+/* Push
+ *  Send the changed messages, and those a client is missing, to every open client
+ */
+void HalWebsocketd::Push( void )
+{
+    char Values[HAL_WEBSOCKET_FIELDS][DATALENGTH + 1u];
+    uint8_t Lengths[HAL_WEBSOCKET_FIELDS];
+    uint64_t Wanted = 0u;
+    uint64_t Fields = 0u;
+    uint8_t Index = 0u;
+    uint8_t Id = 0u;
+    for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
+    {
+        Wanted |= Clients[Index].Pending;
+    }
+    /* take a copy of the values, so the sends are made without the lock */
+    HalReactor::Lock();
+    Fields = Changed;
+    Changed = 0u;
+    Wanted = ( Wanted | Fields ) & Valid;
+    for ( Id = 0u; Id < HAL_WEBSOCKET_FIELDS; Id++ )
+    {
+        if ( ( Wanted & ( (uint64_t)1u << Id ) ) != 0u )
+        {
+            Lengths[Id] = LatestLength[Id];
+            memcpy( Values[Id], Latest[Id], Lengths[Id] );
+        }
+    }
+    HalReactor::Unlock();
+
+    for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
+    {
+        HalWebsocketClient* Client = &Clients[Index];
+        if ( Client->State != HAL_WEBSOCKET_OPEN )
+        {
+            continue;
+        }
+        /* one text frame per field as websocketd sent them, all in one write,
+           a client that is not keeping up gets the latest values when it does */
+        Client->Pending = ( Client->Pending | Fields ) & Wanted;
+        for ( Id = 0u; ( Client->Pending != 0u ) && ( Id < HAL_WEBSOCKET_FIELDS ); Id++ )
+        {
+            const uint64_t Field = ( (uint64_t)1u << Id );
+            if ( ( Client->Pending & Field ) != 0u )
             {
-                Index = 0;
+                if ( !Client->QueueFrame( HAL_WEBSOCKET_TEXT, Values[Id], Lengths[Id] ) )
+                {
+                    break;
+                }
+                Client->Pending &= ~Field;
             }
         }
+        (void)Client->Flush();
     }
+}
 
-    /*
-        If the message Id isn't waiting already
-        and there is space on the queue add the new message
-        to the queue
-    */
-    if (
-           (!QueueFull(&OutputQueue))
-        && ( !Result )
-        )
+/* ReceiveMessage
+ *  Add a message from a client to the input queue
+ */
+bool HalWebsocketd::ReceiveMessage( char* Message )
+{
+    bool Result = false;
+    /* the queue is read by the tasks */
+    HalReactor::Lock();
+    Result = AddMessage( &InputQueue, Message, 0 );
+    HalReactor::Unlock();
+    return Result;
+}
+
+/* GetNumberOfClients
+ *  Get the number of open WebSocket connections
+ */
+uint8_t HalWebsocketd::GetNumberOfClients( void )
+{
+    uint8_t Count = 0u;
+    uint8_t Index = 0u;
+    for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
+    {
+        Count += ( Clients[Index].State == HAL_WEBSOCKET_OPEN ) ? 1u : 0u;
+    }
+    return Count;
+}
+
+/* Set the latest message for an Id
+ * Called by the tasks, the dispatch lock is held so the
+ * reactor thread is not reading the values.
+ * @return bool_t if the message was stored
+ */
+bool HalWebsocketd::SendMessage( char* Message, uint8_t Id )
+{
+    bool Result = false;
+    if ( Id < HAL_WEBSOCKET_FIELDS )
     {
-        Result = AddMessage( &OutputQueue, Message, Id );
+        const uint8_t Length = strnlen( Message, DATALENGTH );
+        const uint64_t Field = ( (uint64_t)1u << Id );
+        /* only a change is sent, a new page is sent everything */
+        if ( ( ( Valid & Field ) == 0u ) || ( Length != LatestLength[Id] ) || ( memcmp( Latest[Id], Message, Length ) != 0 ) )
+        {
+            memcpy( Latest[Id], Message, Length );
+            LatestLength[Id] = Length;
+            Valid |= Field;
+            Changed |= Field;
+        }
+        Result = true;
     }
     return Result;
 }
@@ -265,3 +919,36 @@ bool HalWebsocketd::AddMessage( MESSAGEQUEUE_T* Queue, char* Message, uint8_t Id
     }
     return Result;
 }
+
+/* SampleClients
+ *  Get the number of open connections for Metrics
+ */
+double HalWebsocketd::SampleClients( void* Context )
+{
+    return ( (HalWebsocketd*)Context )->GetNumberOfClients();
+}
+
+/* SampleInputQueue
+ *  Get the number of messages from the clients waiting to be used, the
+ *  sample lock is the dispatch lock that guards the queue
+ */
+double HalWebsocketd::SampleInputQueue( void* Context )
+{
+    return ( (HalWebsocketd*)Context )->InputQueue.FillLevel;
+}
+
+/* SampleOutputQueue
+ *  Get the number of bytes waiting to be sent to the clients, the
+ *  metrics are served on the reactor thread that owns the queues
+ */
+double HalWebsocketd::SampleOutputQueue( void* Context )
+{
+    HalWebsocketd* Server = (HalWebsocketd*)Context;
+    uint32_t Count = 0u;
+    uint8_t Index = 0u;
+    for ( Index = 0u; Index < HAL_WEBSOCKET_MAX_CLIENTS; Index++ )
+    {
+        Count += Server->Clients[Index].GetOutputCount();
+    }
+    return Count;
+}
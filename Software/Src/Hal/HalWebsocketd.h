@@ -1,10 +1,14 @@
 /**
-HalWebsocketd provides an interface to the websocketd. 
-This will queue messages from websocketd ready to be used and queue 
-messages to be sent. The send queue will update messages in the queue 
-with the same Id instead of adding another item to the queue. 
-Each time the run function is called, a message will be taken from 
-the queue and sent to websocketd
+HalWebsocketd is the WebSocket (RFC 6455) server for the web page, it
+used to be a bridge to websocketd through stdin and stdout. Clients
+connect to HAL_WEBSOCKET_PORT and each text message they send is queued
+ready to be used. The latest message to be sent is kept for each Id,
+with a bit for each that has changed. Each time the run function is
+called, every changed message is sent to every client, one text frame
+each and all of them in one write.
+
+The sockets are serviced on the HalReactor thread, the queues are shared
+with the tasks under the dispatch lock.
 
 Author and copyright of this file:
 Chris Dick, 2016
@@ -28,75 +32,203 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdint.h>
 #include "Runnable.h"
-        
+#include "HalReactor.h"
+#include "Metrics.h"
+
 #define QUEUESIZE  ((uint8_t)100u)
 #define DATALENGTH ((uint8_t)50u)
 
+/* Configuration */
+
+#define HAL_WEBSOCKET_PORT         1234u    /**< the web page connects to ws://<host>:1234/ */
+#define HAL_WEBSOCKET_MAX_CLIENTS  8u       /**< web pages connected at once */
+#define HAL_WEBSOCKET_BACKLOG      8        /**< pending connections queued by the kernel */
+#define HAL_WEBSOCKET_INPUT_SIZE   2048u    /**< per client, holds the HTTP upgrade request or one frame */
+#define HAL_WEBSOCKET_KEY_SIZE     64u      /**< longest Sec-WebSocket-Key, it is normally 24 characters */
+#define HAL_WEBSOCKET_OUTPUT_SIZE  8192u    /**< per client queue of frames waiting to be sent */
+#define HAL_WEBSOCKET_PING_PERIOD  5000000u /**< microseconds between pings */
+#define HAL_WEBSOCKET_PING_LIMIT   3u       /**< pings without a reply before a client is closed */
+#define HAL_WEBSOCKET_FIELDS       64u      /**< message Ids, one bit each in a uint64_t */
+
+#define HAL_WEBSOCKET_ALL_FIELDS   ( ~(uint64_t)0u )
+
+/** State of a WebSocket connection
+ */
+typedef enum
+{
+    HAL_WEBSOCKET_CLOSED = 0,   /**< slot is free */
+    HAL_WEBSOCKET_HANDSHAKE,    /**< waiting for the HTTP upgrade request */
+    HAL_WEBSOCKET_OPEN,         /**< exchanging frames */
+    HAL_WEBSOCKET_CLOSING       /**< close frame queued, waiting for the client to close */
+} HAL_WEBSOCKET_STATE_T;
+
+/** WebSocket frame opcodes
+ */
+typedef enum
+{
+    HAL_WEBSOCKET_CONTINUATION = 0x0,
+    HAL_WEBSOCKET_TEXT         = 0x1,
+    HAL_WEBSOCKET_BINARY       = 0x2,
+    HAL_WEBSOCKET_CLOSE        = 0x8,
+    HAL_WEBSOCKET_PING         = 0x9,
+    HAL_WEBSOCKET_PONG         = 0xA
+} HAL_WEBSOCKET_OPCODE_T;
+
+/** HalWebsocketClient
+ * - One WebSocket connection, serviced on the reactor thread
+ */
+class HalWebsocketClient: public HalReactorHandler
+{
+    public:
+    /** Constructor
+     */
+        HalWebsocketClient( void );
+    /** Called by the reactor when the socket can be read or written
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+    /** Start using the slot for a new connection
+     * @param NewFd the accepted socket
+     */
+        void Open( int NewFd );
+    /** Close the connection
+     */
+        void Close( void );
+    /** Add a frame to the output queue, Flush sends it
+     * @param Opcode HAL_WEBSOCKET_OPCODE_T
+     * @return bool false if the connection is not open or the queue has no room
+     */
+        bool QueueFrame( uint8_t Opcode, const char* Payload, uint32_t Length );
+    /** Send as much of the output queue as the socket will take
+     * @return bool false if the client was closed
+     */
+        bool Flush( void );
+    /** Called every HAL_WEBSOCKET_PING_PERIOD, pings the client and closes
+     *  the connection if it has not answered for HAL_WEBSOCKET_PING_LIMIT
+     */
+        void Ping( void );
+    /** Get the number of bytes waiting to be sent, reactor thread only
+     */
+        uint32_t GetOutputCount( void );
+
+        HAL_WEBSOCKET_STATE_T State;    /**< changed on the reactor thread only */
+        uint64_t Pending;               /**< fields still to be sent, reactor thread only */
+
+    private:
+    /** Answer the HTTP upgrade request once it has all arrived
+     * @return bool false if it is incomplete or the client was closed
+     */
+        bool ProcessHandshake( void );
+    /** Handle each complete frame in the input buffer
+     * @return bool false if the client was closed
+     */
+        bool ProcessFrames( void );
+    /** Handle the payload of one frame, it has been unmasked
+     * @return bool false if the client was closed
+     */
+        bool ProcessFrame( uint8_t Opcode, bool Final, char* Payload, uint32_t Length );
+    /** Send a close frame, the connection is closed when the client closes it
+     * @param Status RFC 6455 status code
+     */
+        void SendClose( uint16_t Status );
+    /** Add bytes to the output queue, the caller checks there is room
+     */
+        void QueueOutput( const char* Data, uint32_t Length );
+
+        int Fd;                                     /**< socket, -1 if closed */
+        char Input[HAL_WEBSOCKET_INPUT_SIZE];       /**< received bytes, from the start */
+        uint32_t InputCount;                        /**< bytes in Input */
+        char Output[HAL_WEBSOCKET_OUTPUT_SIZE];     /**< ring of bytes waiting to be sent */
+        uint32_t OutputHead;                        /**< first byte to send */
+        uint32_t OutputCount;                       /**< bytes waiting */
+        char Message[DATALENGTH + 1u];              /**< text message being reassembled from its fragments */
+        uint32_t MessageLength;                     /**< bytes in Message */
+        bool MessageText;                           /**< the fragments are of a text message that fits */
+        uint8_t MissedPings;                        /**< pings sent since the client was last heard from */
+};
 
 /** HalWebsocketd
- * - Class to provide interface to websocketd
+ * - Class to provide the WebSocket server for the web page
  */
-class HalWebsocketd: public Runnable 
+class HalWebsocketd: public Runnable, public HalReactorHandler
 {
     public:
     /** Constructor
      */
         HalWebsocketd( void );
      /** Structure for the messages and Ids
-     */   
-        typedef struct 
+     */
+        typedef struct
         {
             char Data[DATALENGTH+1];         /**< data */
             uint8_t Id;                      /**< data Id */
         } MESSAGE_T;
-    /** Structure for the queues.  
-     */        
+    /** Structure for the queues.
+     */
         typedef struct
         {
-            MESSAGE_T Message[QUEUESIZE];    /**< data queue*/     
+            MESSAGE_T Message[QUEUESIZE];    /**< data queue*/
             uint8_t ReadIndex;               /**< Read location in queue */
             uint8_t WriteIndex;              /**< Write location in queue */
             uint8_t FillLevel;               /**< Number of items currently queued */
         } MESSAGEQUEUE_T;
-    /** Initialise the io  
+    /** Initialise, the listening socket is registered with HalReactor::Reactor
+     * @param Port TCP port to listen on
+     * @return bool true if successful
      */
-        void Init( void );
-    /** Runs the filter
+        bool Init( uint16_t Port );
+    /** Close the listening socket and all the clients
+     */
+        void Close( void );
+    /** Runs the filter, wakes the reactor thread to send the changed messages
      */
         void Run( void );
-    /** ThreadRun
-     *  Check for any new data store in the input queue
+    /** Called by the reactor for new connections, the ping timer and Run
+     * @param Events the epoll events
      */
-        void ThreadRun( void );
-    /** Add a message to the queue
-     * @param Message pointer to the message to be altered or added to the send queue.
-     * @param Id identifier for the message.
-     * @return bool true if item is successfully added to the queue
+        void HandleEvents( uint32_t Events );
+    /** Set the latest message for an Id, it is sent at the next run if it has changed
+     * @param Message the message, up to DATALENGTH characters are kept
+     * @param Id identifier for the message, below HAL_WEBSOCKET_FIELDS
+     * @return bool true if the message is stored
      */
         bool SendMessage( char* Message, uint8_t Id );
     /** Get the next Message in the queue
      * @param Message pointer to the message to be altered or added to the send queue.
      */
         bool GetMessage( char* Message );
+    /** Add a message from a client to the input queue, reactor thread only
+     * @param Message the text of the message, '\0' terminated
+     * @return bool true if item is successfully added to the queue
+     */
+        bool ReceiveMessage( char* Message );
+    /** Get the number of open WebSocket connections
+     */
+        uint8_t GetNumberOfClients( void );
+    /** Send the changed messages, and those a client is missing, to every open client, reactor thread only
+     */
+        void Push( void );
+
+        static HalWebsocketd Websocket; /**< We only want one object handling the web page. */
+        MetricCounter BytesIn;          /**< received from all the clients */
+        MetricCounter BytesOut;         /**< sent to all the clients */
 
-        static HalWebsocketd Websocket; /**< We only want one object handling any stdio. */
-        
     /** Is the queue empty
      * @param Queue pointer to the queue to check
      * @return bool_t true if empty
      */
-        bool QueueEmpty( MESSAGEQUEUE_T* Queue );    
+        bool QueueEmpty( MESSAGEQUEUE_T* Queue );
     /** Is the queue full
      * @param Queue pointer to the queue to check
      * @return bool_t true if full
      */
-        bool QueueFull( MESSAGEQUEUE_T* Queue );    
+        bool QueueFull( MESSAGEQUEUE_T* Queue );
     /** Get the next message
      * @param Queue pointer to the queue to retrieve from
      * @param Message pointer to storage fro message
      * @return bool_t true if successful
      */
-        bool GetNextMessage( MESSAGEQUEUE_T* Queue, char* Message );   
+        bool GetNextMessage( MESSAGEQUEUE_T* Queue, char* Message );
     /** Get the next message
      * @param Queue pointer to the queue to retrieve from
      * @param Message pointer to storage fro message
@@ -104,11 +236,30 @@ class HalWebsocketd: public Runnable
      * @return bool_t true if successful
      */
         bool AddMessage( MESSAGEQUEUE_T* Queue, char* Message, uint8_t Id );
- 
+
         private:
+    /** Accept the waiting connections
+     */
+        void Accept( void );
+    /** Get the number of open connections for Metrics
+     */
+        static double SampleClients( void* Context );
+    /** Get the number of messages from the clients waiting to be used for Metrics
+     */
+        static double SampleInputQueue( void* Context );
+    /** Get the number of bytes waiting to be sent to the clients for Metrics
+     */
+        static double SampleOutputQueue( void* Context );
+
         MESSAGEQUEUE_T InputQueue;     /**< The Input queue  */
-        MESSAGEQUEUE_T OutputQueue;    /**< The Output queue */
-        char Buffer[DATALENGTH];
+        char Latest[HAL_WEBSOCKET_FIELDS][DATALENGTH];    /**< latest message for each Id, not terminated */
+        uint8_t LatestLength[HAL_WEBSOCKET_FIELDS];       /**< length of each message */
+        uint64_t Changed;              /**< Ids changed since the last push */
+        uint64_t Valid;                /**< Ids that have a message */
+        HalWebsocketClient Clients[HAL_WEBSOCKET_MAX_CLIENTS];   /**< the connections */
+        int ListenFd;                  /**< listening socket */
+        int WakeFd;                    /**< eventfd, written by Run */
+        int PingTimer;                 /**< timer for the pings */
 };
 
 #endif /* HALWEBSOCKETD_H */
@@ -0,0 +1,391 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "HalReactor.h"
+#include "HalWebsocketd.h"
+/*
+ HalWebsocketd test
+ A minimal WebSocket client checks the opening handshake against the
+ example in RFC 6455, masked and fragmented messages from the page, the
+ pushed messages reaching several clients, only the changed ones and
+ all of them to a new client, ping and pong, the close
+ handshake and the protocol errors. Then it times the pushes. Build on
+ any machine from Software/:
+
+ g++ -O2 -I./Src -I./Src/Hal -I./Src/Utils -I./Src/Scheduler \
+     Src/Hal/HalWebsocketd_test.cpp Src/Hal/HalWebsocketd.cpp Src/Hal/HalReactor.cpp \
+     Src/Utils/Sha1.cpp Src/Utils/Metrics.cpp Src/Utils/Trace.cpp Src/Scheduler/Runnable.cpp \
+     -lpthread -latomic -o HalWebsocketd_test
+
+ The server logs every connection to stdout, the results go to stderr:
+ ./HalWebsocketd_test > /dev/null
+
+ Other clients can be tried against an echo server on the same port,
+ started with ./HalWebsocketd_test --serve, for example a browser or
+ python3 -m websockets ws://localhost:19997/
+ */
+
+#define TEST_PORT          19997
+#define TEST_CLIENTS       4
+#define TEST_TIMEOUT_MS    2000
+#define TEST_PUSHES        2000
+#define TEST_FIELDS        50
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* read exactly length bytes, false on timeout, error or end of stream */
+static bool readAll(int fd, void* data, size_t length)
+{
+    struct pollfd pfd;
+    size_t got = 0;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (got < length)
+    {
+        if (poll(&pfd, 1, TEST_TIMEOUT_MS) != 1)
+        {
+            return false;
+        }
+        const ssize_t rc = read(fd, (char*)data + got, length - got);
+        if (rc <= 0)
+        {
+            return false;
+        }
+        got += rc;
+    }
+    return true;
+}
+
+/* true if the server closes the connection */
+static bool readClosed(int fd)
+{
+    char data[64];
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (poll(&pfd, 1, TEST_TIMEOUT_MS) == 1)
+    {
+        const ssize_t rc = read(fd, data, sizeof(data));
+        if (rc <= 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* send a frame, masked as a client must unless told otherwise */
+static bool sendFrame(int fd, uint8_t first, const char* payload, size_t length, bool masked = true)
+{
+    static const uint8_t mask[4] = { 0x37, 0xFA, 0x21, 0x3D };
+    uint8_t frame[16 + 4096];
+    size_t used = 0;
+    frame[used++] = first;
+    if (length < 126)
+    {
+        frame[used++] = (masked ? 0x80 : 0x00) | (uint8_t)length;
+    }
+    else
+    {
+        frame[used++] = (masked ? 0x80 : 0x00) | 126;
+        frame[used++] = (uint8_t)(length >> 8);
+        frame[used++] = (uint8_t)length;
+    }
+    if (masked)
+    {
+        memcpy(&frame[used], mask, sizeof(mask));
+        used += sizeof(mask);
+    }
+    for (size_t index = 0; index < length; index++)
+    {
+        frame[used++] = (uint8_t)payload[index] ^ (masked ? mask[index % 4] : 0);
+    }
+    return write(fd, frame, used) == (ssize_t)used;
+}
+
+/* read one frame from the server, which must not mask, returns the opcode or -1 */
+static int readFrame(int fd, char* payload, size_t size, size_t* length)
+{
+    uint8_t header[4];
+    if (!readAll(fd, header, 2) || ((header[1] & 0x80) != 0))
+    {
+        return -1;
+    }
+    *length = header[1] & 0x7F;
+    if (*length == 126)
+    {
+        if (!readAll(fd, &header[2], 2))
+        {
+            return -1;
+        }
+        *length = ((size_t)header[2] << 8) | header[3];
+    }
+    if ((*length >= size) || !readAll(fd, payload, *length))
+    {
+        return -1;
+    }
+    payload[*length] = '\0';
+    return header[0] & 0x0F;
+}
+
+/* the opening handshake, accept receives the Sec-WebSocket-Accept value */
+static bool handshake(int fd, const char* key, char* accept)
+{
+    char request[512];
+    char reply[512];
+    size_t got = 0;
+    accept[0] = '\0';
+    snprintf(request, sizeof(request), "GET / HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\n"
+             "Connection: Upgrade\r\nSec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n", key);
+    if ((fd < 0) || (write(fd, request, strlen(request)) != (ssize_t)strlen(request)))
+    {
+        return false;
+    }
+    /* byte at a time, so none of the frames after it are taken */
+    while ((got < (sizeof(reply) - 1)) && readAll(fd, &reply[got], 1))
+    {
+        got++;
+        reply[got] = '\0';
+        if (strstr(reply, "\r\n\r\n") != NULL)
+        {
+            const char* value = strstr(reply, "Sec-WebSocket-Accept: ");
+            if ((strncmp(reply, "HTTP/1.1 101", 12) != 0) || (value == NULL))
+            {
+                return false;
+            }
+            value += strlen("Sec-WebSocket-Accept: ");
+            memcpy(accept, value, strcspn(value, "\r"));
+            accept[strcspn(value, "\r")] = '\0';
+            return true;
+        }
+    }
+    return false;
+}
+
+/* wait for a message from a client to reach the input queue */
+static bool getMessage(char* message)
+{
+    const double end = seconds() + (TEST_TIMEOUT_MS / 1000.0);
+    bool got = false;
+    while (!got && (seconds() < end))
+    {
+        HalReactor::Lock();
+        got = HalWebsocketd::Websocket.GetMessage(message);
+        HalReactor::Unlock();
+        if (!got)
+        {
+            usleep(1000);
+        }
+    }
+    return got;
+}
+
+/* queue a message and send it, as TelescopeIO and the scheduler do */
+static void push(const char* text, uint8_t id)
+{
+    char message[DATALENGTH + 1];
+    strcpy(message, text);
+    HalReactor::Lock();
+    HalWebsocketd::Websocket.SendMessage(message, id);
+    HalWebsocketd::Websocket.Run();
+    HalReactor::Unlock();
+}
+
+int main(int argc, char* argv[])
+{
+    static int clients[TEST_CLIENTS];
+    char accept[64];
+    char payload[4096];
+    char message[DATALENGTH + 1];
+    size_t length = 0;
+    int errors = 0;
+    int i = 0;
+
+    if (!HalReactor::Reactor.Init() || !HalWebsocketd::Websocket.Init(TEST_PORT) || !HalReactor::Reactor.Start())
+    {
+        fprintf(stderr, "FAIL: the server did not start\n");
+        return 1;
+    }
+    if ((argc > 1) && (strcmp(argv[1], "--serve") == 0))
+    {
+        /* echo what the clients send to all of them, a message replaces
+           the latest one with the same id so each gets its own */
+        for (uint8_t id = 1; ; id = (id % (HAL_WEBSOCKET_FIELDS - 1u)) + 1)
+        {
+            if (getMessage(message))
+            {
+                push(message, id);
+            }
+        }
+    }
+
+    /* the example key and accept value from RFC 6455 section 1.3 */
+    clients[0] = connectTo(TEST_PORT);
+    check(handshake(clients[0], "dGhlIHNhbXBsZSBub25jZQ==", accept)
+          && (strcmp(accept, "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=") == 0), "handshake accept value");
+    for (i = 1; i < TEST_CLIENTS; i++)
+    {
+        clients[i] = connectTo(TEST_PORT);
+        errors += handshake(clients[i], "x3JJHMbDL1EzLkh9GBhXDw==", accept) ? 0 : 1;
+    }
+    check(errors == 0, "several clients connect");
+
+    /* messages from the page, whole and in fragments */
+    check(sendFrame(clients[0], 0x81, "Targ 12.5\n", 10) && getMessage(message)
+          && (strcmp(message, "Targ 12.5") == 0), "text message is received");
+    check(sendFrame(clients[1], 0x01, "Fra", 3) && sendFrame(clients[1], 0x89, "in between", 10)
+          && sendFrame(clients[1], 0x80, "gment", 5) && getMessage(message)
+          && (strcmp(message, "Fragment") == 0), "fragmented message is reassembled around a ping");
+    check((readFrame(clients[1], payload, sizeof(payload), &length) == 0xA)
+          && (strcmp(payload, "in between") == 0), "ping is answered with a pong");
+    memset(payload, 'x', 300);
+    check(sendFrame(clients[2], 0x81, payload, 300) && sendFrame(clients[2], 0x81, "Next", 4)
+          && getMessage(message) && (strcmp(message, "Next") == 0), "message too long for the queue is dropped");
+
+    /* pushed messages reach every client, one text frame each */
+    push("RAH 12:30:00", 2);
+    push("DECH +45:00:00", 3);
+    for (i = 0; i < TEST_CLIENTS; i++)
+    {
+        const bool first = (readFrame(clients[i], payload, sizeof(payload), &length) == 0x1)
+                           && (strcmp(payload, "RAH 12:30:00") == 0);
+        const bool second = (readFrame(clients[i], payload, sizeof(payload), &length) == 0x1)
+                            && (strcmp(payload, "DECH +45:00:00") == 0);
+        errors += (first && second) ? 0 : 1;
+    }
+    check(errors == 0, "every client receives the pushed messages");
+
+    /* only the changes are sent, a new client is sent everything */
+    push("RAH 12:30:00", 2);
+    push("ALT +10:00:00", 4);
+    for (i = 0; i < TEST_CLIENTS; i++)
+    {
+        errors += ((readFrame(clients[i], payload, sizeof(payload), &length) == 0x1)
+                   && (strcmp(payload, "ALT +10:00:00") == 0)) ? 0 : 1;
+    }
+    check(errors == 0, "unchanged messages are not sent again");
+    {
+        int fd = connectTo(TEST_PORT);
+        bool got[3] = { false, false, false };
+        check(handshake(fd, "x3JJHMbDL1EzLkh9GBhXDw==", accept), "new client connects");
+        for (i = 0; i < 3; i++)
+        {
+            if (readFrame(fd, payload, sizeof(payload), &length) == 0x1)
+            {
+                got[0] = got[0] || (strcmp(payload, "RAH 12:30:00") == 0);
+                got[1] = got[1] || (strcmp(payload, "DECH +45:00:00") == 0);
+                got[2] = got[2] || (strcmp(payload, "ALT +10:00:00") == 0);
+            }
+        }
+        check(got[0] && got[1] && got[2], "new client receives the latest messages");
+        close(fd);
+    }
+
+    /* closing */
+    check(sendFrame(clients[3], 0x88, "\x03\xE8", 2) && (readFrame(clients[3], payload, sizeof(payload), &length) == 0x8)
+          && (length == 2) && (memcmp(payload, "\x03\xE8", 2) == 0) && readClosed(clients[3]), "close is answered and closed");
+    check(sendFrame(clients[2], 0x81, "Unmasked", 8, false) && (readFrame(clients[2], payload, sizeof(payload), &length) == 0x8)
+          && (memcmp(payload, "\x03\xEA", 2) == 0) && readClosed(clients[2]), "unmasked frame is a protocol error");
+    {
+        static const char request[] = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        int fd = connectTo(TEST_PORT);
+        check((fd >= 0) && (write(fd, request, sizeof(request) - 1) == (ssize_t)(sizeof(request) - 1))
+              && readAll(fd, payload, 12) && (strncmp(payload, "HTTP/1.1 400", 12) == 0) && readClosed(fd),
+              "request without a key is refused");
+        close(fd);
+    }
+    close(clients[2]);
+    close(clients[3]);
+    usleep(10000);
+    HalReactor::Lock();
+    check(HalWebsocketd::Websocket.GetNumberOfClients() == 2, "closed clients are freed");
+    HalReactor::Unlock();
+
+    /* every field each push, websocketd took one message per 5ms */
+    {
+        uint32_t frames = 0;
+        double start = seconds();
+        errors = 0;
+        for (i = 0; i < TEST_PUSHES; i++)
+        {
+            HalReactor::Lock();
+            for (uint8_t id = 1; id <= TEST_FIELDS; id++)
+            {
+                snprintf(message, sizeof(message), "F%03u %d", id, i);
+                HalWebsocketd::Websocket.SendMessage(message, id);
+            }
+            HalWebsocketd::Websocket.Run();
+            HalReactor::Unlock();
+            for (uint8_t id = 1; id <= TEST_FIELDS; id++)
+            {
+                if (readFrame(clients[0], payload, sizeof(payload), &length) == 0x1)
+                {
+                    frames++;
+                }
+                else
+                {
+                    errors++;
+                }
+            }
+            if (errors > 0)
+            {
+                break;
+            }
+        }
+        const double elapsed = seconds() - start;
+        check(errors == 0, "every pushed field arrives");
+        fprintf(stderr, "push: %.0f messages/s to a client, %u fields each push\n", frames / elapsed, TEST_FIELDS);
+    }
+
+    close(clients[0]);
+    close(clients[1]);
+    HalReactor::Reactor.Stop();
+    HalWebsocketd::Websocket.Close();
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -29,6 +29,7 @@ THE SOFTWARE.
 ===============================================
 */
 
+#include <string.h>
 #include "I2Cdev.h"
 
 /* Default timeout value for read operations.
@@ -36,9 +37,82 @@ THE SOFTWARE.
  */
 uint16_t I2Cdev::readTimeout = I2CDEV_DEFAULT_READ_TIMEOUT;
 
-        static uint8_t no_of_registered_devices;
-        static FILEHANDLE_TABLE_T filehandle_table[255];
- uint16_t get_filehandle(uint8_t devAddr);
+#ifndef I2CDEV_NO_WIRINGPI
+/** Bus backend using the wiringPi I2C interface.
+ * A file handle is opened for each device the first time it is used.
+ */
+class I2CBusWiringPi : public I2CBus {
+    public:
+        int readReg8(uint8_t devAddr, uint8_t regAddr) {
+            return wiringPiI2CReadReg8(get_filehandle(devAddr), regAddr);
+        }
+        int readReg16(uint8_t devAddr, uint8_t regAddr) {
+            return wiringPiI2CReadReg16(get_filehandle(devAddr), regAddr);
+        }
+        int writeReg8(uint8_t devAddr, uint8_t regAddr, uint8_t data) {
+            return wiringPiI2CWriteReg8(get_filehandle(devAddr), regAddr, data);
+        }
+        int writeReg16(uint8_t devAddr, uint8_t regAddr, uint16_t data) {
+            return wiringPiI2CWriteReg16(get_filehandle(devAddr), regAddr, data);
+        }
+    private:
+        uint16_t get_filehandle(uint8_t devAddr);
+        uint8_t no_of_registered_devices;          /**< zero as the bus is static */
+        FILEHANDLE_TABLE_T filehandle_table[255];
+};
+
+static I2CBusWiringPi wiringPiBus;
+#define I2CDEV_DEFAULT_BUS (&wiringPiBus)
+#else
+#define I2CDEV_DEFAULT_BUS NULL
+#endif
+
+static I2CBus *bus = I2CDEV_DEFAULT_BUS;
+
+/** Register shadow cache of one device */
+typedef struct
+{
+    bool inUse;                  /**< entry is in use */
+    uint8_t devAddr;             /**< device the cache belongs to */
+    uint32_t valid[8];           /**< bitmap of registers held in shadow */
+    uint32_t volatileMap[8];     /**< bitmap of registers never to cache */
+    uint8_t shadow[256];         /**< last known register values */
+} I2CDEV_CACHE_T;
+
+static I2CDEV_CACHE_T cacheTable[I2CDEV_CACHE_MAX_DEVICES];
+
+static uint32_t transactionCount = 0;   /**< register accesses on the bus */
+static uint32_t errorCount = 0;         /**< of those, the ones that failed */
+
+/* Count a register access on the bus, it may be from any thread */
+static inline int countTransaction(int result) {
+    (void)__atomic_fetch_add(&transactionCount, 1u, __ATOMIC_RELAXED);
+    if (result < 0) (void)__atomic_fetch_add(&errorCount, 1u, __ATOMIC_RELAXED);
+    return result;
+}
+
+/* Find the cache of a device, NULL if it has none */
+static I2CDEV_CACHE_T *findCache(uint8_t devAddr) {
+    for (uint8_t index = 0; index < I2CDEV_CACHE_MAX_DEVICES; index++) {
+        if (cacheTable[index].inUse && (cacheTable[index].devAddr == devAddr)) {
+            return &cacheTable[index];
+        }
+    }
+    return NULL;
+}
+
+/* Is the register held in the cache */
+static inline bool isCached(const I2CDEV_CACHE_T *cache, uint8_t regAddr) {
+    return (cache->valid[regAddr >> 5] & (1u << (regAddr & 31))) != 0;
+}
+
+/* Remember a register value unless the register is volatile */
+static inline void storeCache(I2CDEV_CACHE_T *cache, uint8_t regAddr, uint8_t data) {
+    if ((cache->volatileMap[regAddr >> 5] & (1u << (regAddr & 31))) == 0) {
+        cache->shadow[regAddr] = data;
+        cache->valid[regAddr >> 5] |= (1u << (regAddr & 31));
+    }
+}
 
 /* Default constructor.
  */
@@ -159,7 +233,6 @@ int8_t I2Cdev::readWord(uint8_t devAddr, uint8_t regAddr, uint16_t *data, uint16
 int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t *data, uint16_t timeout) {
     int8_t count = 0;
     uint32_t t1 = millis();
-    uint16_t fd = 0;
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.print("I2C (0x");
         Serial.print(devAddr, HEX);
@@ -199,9 +272,16 @@ int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8
         data[count] = wiringPiI2CReadReg8 ( fd, regAddr );
     }
 #endif
-    fd = get_filehandle(devAddr);
+    if (bus == NULL) return -1;
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
     for (count = 0; ((count < length) && ((timeout == 0) || ((millis() - t1) < timeout))); count++) {
-        data[count] = wiringPiI2CReadReg8 ( fd, regAddr );
+        if ((cache != NULL) && isCached(cache, regAddr)) {
+            data[count] = cache->shadow[regAddr];
+        } else {
+            int value = countTransaction(bus->readReg8 ( devAddr, regAddr ));
+            data[count] = value;
+            if ((cache != NULL) && (value >= 0)) storeCache(cache, regAddr, value);
+        }
         regAddr++;
     }
     
@@ -236,7 +316,6 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
         Serial.print("...");
     #endif
 
-    uint16_t fd = 0;
     int8_t count = 0;
     uint32_t t1 = millis();
 
@@ -277,9 +356,9 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint1
         this code reads (length) words from (regAddr) register on (devAddr) device and stores it in (*data) buffer 
     */
     #endif
-    fd = get_filehandle(devAddr);
+    if (bus == NULL) return -1;
     for (count = 0; ((count < length) && ((timeout == 0) || ((millis() - t1) < timeout))); count++) {
-        data[count] = wiringPiI2CReadReg16 ( fd, regAddr );
+        data[count] = countTransaction(bus->readReg16 ( devAddr, regAddr ));
         regAddr++;
     }
     
@@ -414,7 +493,6 @@ bool I2Cdev::writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data) {
 bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_t* data) {
     uint8_t status = 0;
     uint8_t count = 0;
-    uint16_t fd = 0;
     #ifdef I2CDEV_SERIAL_DEBUG
         Serial.print("I2C (0x");
         Serial.print(devAddr, HEX);
@@ -439,9 +517,15 @@ bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint8_
         this code writes (length) bytes from (*data) buffer to (regAddr) on (devAddr) device.
     */
     #endif
-    fd = get_filehandle(devAddr);
+    if (bus == NULL) return false;
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
     for (count=0; count < length; count++) {
-        wiringPiI2CWriteReg8 ( fd, regAddr, data[count]);
+        if ((countTransaction(bus->writeReg8 ( devAddr, regAddr, data[count])) >= 0) && (cache != NULL)) {
+            storeCache(cache, regAddr, data[count]);
+        } else if (cache != NULL) {
+            // the device state is unknown after a failed write
+            cache->valid[regAddr >> 5] &= ~(1u << (regAddr & 31));
+        }
         regAddr++;
     }
     
@@ -471,7 +555,6 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     #endif
     uint8_t status = 0;
     uint8_t count = 0;
-    uint16_t fd = 0;
 	#if 0
     Wire.beginTransmission(devAddr);
     Wire.write(regAddr); // send address
@@ -488,10 +571,20 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
         this code writes (length) bytes from (*data) buffer to (regAddr) register on (devAddr) device.
     */
     #endif
-    fd = get_filehandle(devAddr);
+    if (bus == NULL) return false;
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
     for (count=0; count < length; count++) {
-        wiringPiI2CWriteReg16 ( fd, regAddr, data[count]);
-        regAddr++;
+        // MSB first like the Wire version, an SMBus word write sends the low byte first
+        const uint16_t swapped = (uint16_t)((data[count] << 8) | (data[count] >> 8));
+        if ((countTransaction(bus->writeReg16 ( devAddr, regAddr, swapped)) >= 0) && (cache != NULL)) {
+            storeCache(cache, regAddr, (uint8_t)(data[count] >> 8));
+            storeCache(cache, regAddr + 1, (uint8_t)data[count]);
+        } else if (cache != NULL) {
+            // the device state is unknown after a failed write
+            cache->valid[regAddr >> 5] &= ~(1u << (regAddr & 31));
+            cache->valid[(uint8_t)(regAddr + 1) >> 5] &= ~(1u << ((uint8_t)(regAddr + 1) & 31));
+        }
+        regAddr += 2;
     }
 
     #ifdef I2CDEV_SERIAL_DEBUG
@@ -500,7 +593,81 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16
     return status == 0;
 }
 
-uint16_t get_filehandle(uint8_t devAddr)
+/* Enable the register shadow cache for a device.
+ * @param devAddr I2C slave device address
+ * @param volatileRegs Ranges of registers which must always be read from the device
+ * @param count Number of ranges
+ * @return false if there is no free cache
+ */
+bool I2Cdev::enableCache(uint8_t devAddr, const I2CDEV_REG_RANGE_T *volatileRegs, uint8_t count) {
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
+    for (uint8_t index = 0; (cache == NULL) && (index < I2CDEV_CACHE_MAX_DEVICES); index++) {
+        if (!cacheTable[index].inUse) {
+            cache = &cacheTable[index];
+        }
+    }
+    if (cache == NULL) return false;
+    memset(cache, 0, sizeof(*cache));
+    cache->devAddr = devAddr;
+    for (uint8_t range = 0; range < count; range++) {
+        uint8_t regAddr = volatileRegs[range].first;
+        do {
+            cache->volatileMap[regAddr >> 5] |= (1u << (regAddr & 31));
+        } while (regAddr++ != volatileRegs[range].last);
+    }
+    cache->inUse = true;
+    return true;
+}
+
+/* Disable the register shadow cache for a device.
+ * @param devAddr I2C slave device address
+ */
+void I2Cdev::disableCache(uint8_t devAddr) {
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
+    if (cache != NULL) cache->inUse = false;
+}
+
+/* Forget the cached register values of a device, e.g. after a reset.
+ * @param devAddr I2C slave device address
+ */
+void I2Cdev::invalidateCache(uint8_t devAddr) {
+    I2CDEV_CACHE_T *cache = findCache(devAddr);
+    if (cache != NULL) memset(cache->valid, 0, sizeof(cache->valid));
+}
+
+/* Install the bus backend used for all devices.
+ * @param bus Bus to use, NULL restores the default
+ */
+void I2Cdev::setBus(I2CBus *newBus) {
+    bus = (newBus != NULL) ? newBus : I2CDEV_DEFAULT_BUS;
+    for (uint8_t index = 0; index < I2CDEV_CACHE_MAX_DEVICES; index++) {
+        invalidateCache(cacheTable[index].devAddr);
+    }
+}
+
+/* Get the bus backend in use.
+ * @return The bus (NULL if there is none)
+ */
+I2CBus *I2Cdev::getBus() {
+    return bus;
+}
+
+/* Get the number of register accesses made on the bus.
+ * @return Accesses since start up, the cache hits are not counted
+ */
+uint32_t I2Cdev::getTransactionCount() {
+    return __atomic_load_n(&transactionCount, __ATOMIC_RELAXED);
+}
+
+/* Get the number of register accesses that failed.
+ * @return Failed accesses since start up
+ */
+uint32_t I2Cdev::getErrorCount() {
+    return __atomic_load_n(&errorCount, __ATOMIC_RELAXED);
+}
+
+#ifndef I2CDEV_NO_WIRINGPI
+uint16_t I2CBusWiringPi::get_filehandle(uint8_t devAddr)
 {
     uint16_t filehandle = 0;
     uint8_t index = 0;
@@ -524,10 +691,11 @@ uint16_t get_filehandle(uint8_t devAddr)
     {
         filehandle_table[no_of_registered_devices].devAddr = devAddr;
         filehandle_table[no_of_registered_devices].filehandle = wiringPiI2CSetup (devAddr);
-        no_of_registered_devices++;
         filehandle = filehandle_table[no_of_registered_devices].filehandle;
+        no_of_registered_devices++;
     }
     
     return filehandle;
 }
+#endif
 
@@ -37,12 +37,44 @@
 // Arduino-style "Serial.print" debug constant (uncomment to enable)
 // -----------------------------------------------------------------------------
 //#define I2CDEV_SERIAL_DEBUG
+
+// -----------------------------------------------------------------------------
+// Define I2CDEV_NO_WIRINGPI to build without wiringPi, e.g. on a build machine
+// with the I2CdevSim bus. The timing functions wiringPi provides are then
+// supplied here.
+// -----------------------------------------------------------------------------
+#include <stdint.h>
+#include <stddef.h>
+#ifndef I2CDEV_NO_WIRINGPI
 #include <wiringPiI2C.h>
 #include <wiringPi.h>
-#include <stdint.h>
+#else
+#include <time.h>
+#include <unistd.h>
+static inline unsigned int millis(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (unsigned int)((now.tv_sec * 1000u) + (now.tv_nsec / 1000000u));
+}
+static inline void delay(unsigned int howLong) {
+    usleep(howLong * 1000u);
+}
+#endif
 // 1000ms default read timeout (modify with "I2Cdev::readTimeout = [ms];")
 #define I2CDEV_DEFAULT_READ_TIMEOUT     1000
 
+// Maximum number of devices with a register shadow cache (see I2Cdev::enableCache)
+#define I2CDEV_CACHE_MAX_DEVICES        4
+
+/** I2CDEV_REG_RANGE_T
+ * An inclusive range of register addresses
+ */
+typedef struct
+{
+    uint8_t first;       /**< First register in the range */
+    uint8_t last;        /**< Last register in the range */
+} I2CDEV_REG_RANGE_T;
+
 /** FILEHANDLE_TABLE_T
  * structure containing information needed to keep track of devices
  */
@@ -51,6 +83,29 @@ typedef struct
     uint8_t devAddr;     /**< Address of the device */
     uint16_t filehandle; /**< File handle of the device */   
 } FILEHANDLE_TABLE_T;
+/** Class I2C bus backend
+ * I2Cdev performs all register accesses through a bus object. The default
+ * bus uses wiringPi; any other (e.g. I2CdevSim) can be installed with
+ * I2Cdev::setBus().
+ * The return values follow wiringPiI2C: the value read, or -1 on error.
+ */
+class I2CBus {
+    public:
+        virtual ~I2CBus() {}
+/** Read an 8-bit register
+ */
+        virtual int readReg8(uint8_t devAddr, uint8_t regAddr) = 0;
+/** Read a 16-bit register (SMBus word, low byte first)
+ */
+        virtual int readReg16(uint8_t devAddr, uint8_t regAddr) = 0;
+/** Write an 8-bit register
+ */
+        virtual int writeReg8(uint8_t devAddr, uint8_t regAddr, uint8_t data) = 0;
+/** Write a 16-bit register (SMBus word, low byte first)
+ */
+        virtual int writeReg16(uint8_t devAddr, uint8_t regAddr, uint16_t data) = 0;
+};
+
 /** Class I2C interface
  */
 class I2Cdev {
@@ -197,6 +252,45 @@ class I2Cdev {
  */
         static bool writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length, uint16_t *data);
 
+/** Enable the register shadow cache for a device.
+ * Every 8-bit register written or read is remembered, so later reads of it
+ * (including the read done by writeBit/writeBits) do not go to the bus.
+ * Data, status and self clearing registers must be listed as volatile;
+ * they are never cached. 16-bit writes store both bytes, MSB at the lower
+ * register; 16-bit reads are not cached.
+ * @param devAddr I2C slave device address
+ * @param volatileRegs Ranges of registers which must always be read from the device
+ * @param count Number of ranges
+ * @return false if there is no free cache
+ */
+        static bool enableCache(uint8_t devAddr, const I2CDEV_REG_RANGE_T *volatileRegs, uint8_t count);
+/** Disable the register shadow cache for a device.
+ * @param devAddr I2C slave device address
+ */
+        static void disableCache(uint8_t devAddr);
+/** Forget the cached register values of a device, e.g. after a reset.
+ * @param devAddr I2C slave device address
+ */
+        static void invalidateCache(uint8_t devAddr);
+
+/** Install the bus backend used for all devices.
+ * The register caches of all devices are invalidated.
+ * @param bus Bus to use, NULL restores the default
+ */
+        static void setBus(I2CBus *bus);
+/** Get the bus backend in use.
+ * @return The bus (NULL if there is none)
+ */
+        static I2CBus *getBus();
+/** Get the number of register accesses made on the bus.
+ * @return Accesses since start up, the cache hits are not counted
+ */
+        static uint32_t getTransactionCount();
+/** Get the number of register accesses that failed.
+ * @return Failed accesses since start up
+ */
+        static uint32_t getErrorCount();
+
         static uint16_t readTimeout; /**< Timeout for reading data */
         
     private:
@@ -0,0 +1,400 @@
+// I2Cdev library collection - in-memory I2C bus simulator
+// Provides an I2CBus backend holding a register map for each simulated
+// device, so the I2Cdevlib drivers and everything above them can run on a
+// machine without an I2C bus.
+//
+// Changelog:
+//      2016-06-12 - initial release
+
+/* ============================================
+ * I2Cdev device library code is placed under the MIT license
+ * Copyright (c) 2013 Jeff Rowberg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ===============================================
+ */
+
+#include <math.h>
+#include <string.h>
+#include "I2CdevSim.h"
+
+/* Register maps of the simulated devices, from the data sheets */
+#define SIM_LSM303_ACC_ADDRESS   0x19
+#define SIM_LSM303_CTRL_REG1_A   0x20
+#define SIM_LSM303_CTRL_REG4_A   0x23
+#define SIM_LSM303_STATUS_REG_A  0x27
+#define SIM_LSM303_OUT_X_L_A     0x28
+#define SIM_LSM303_MAG_ADDRESS   0x1E
+#define SIM_LSM303_CRB_REG_M     0x01
+#define SIM_LSM303_MR_REG_M      0x02
+#define SIM_LSM303_OUT_X_H_M     0x03 /* X, Z then Y, high byte first */
+#define SIM_LSM303_SR_REG_M      0x09
+#define SIM_LSM303_IRA_REG_M     0x0A
+#define SIM_HMC5883L_ADDRESS     0x1E
+#define SIM_HMC5883L_CONFIG_A    0x00
+#define SIM_HMC5883L_CONFIG_B    0x01
+#define SIM_HMC5883L_MODE        0x02
+#define SIM_HMC5883L_DATAX_H     0x03 /* X, Z then Y, high byte first */
+#define SIM_HMC5883L_STATUS      0x09
+#define SIM_HMC5883L_ID_A        0x0A
+#define SIM_MPU6050_ADDRESS      0x68
+#define SIM_MPU6050_GYRO_CONFIG  0x1B
+#define SIM_MPU6050_ACCEL_CONFIG 0x1C
+#define SIM_MPU6050_ACCEL_XOUT_H 0x3B /* accel, temperature then gyro, high byte first */
+#define SIM_MPU6050_TEMP_OUT_H   0x41
+#define SIM_MPU6050_GYRO_XOUT_H  0x43
+#define SIM_MPU6050_PWR_MGMT_1   0x6B
+#define SIM_MPU6050_WHO_AM_I     0x75
+
+/* LSB per gauss for each gain setting, X and Y then Z */
+static const double lsm303MagGain[8][2] = {
+    { 1100.0, 980.0 }, { 1100.0, 980.0 }, { 855.0, 760.0 }, { 670.0, 600.0 },
+    { 450.0, 400.0 },  { 400.0, 355.0 },  { 330.0, 295.0 }, { 230.0, 205.0 }
+};
+static const double hmc5883lGain[8] = { 1370.0, 1090.0, 820.0, 660.0, 440.0, 390.0, 330.0, 230.0 };
+static const double mpu6050GyroScale[4] = { 131.0, 65.5, 32.8, 16.4 };
+
+// -----------------------------------------------------------------------------
+// I2CSimMotion
+// -----------------------------------------------------------------------------
+
+/* Constructor, the telescope starts level, pointing north and still.
+ */
+I2CSimMotion::I2CSimMotion() {
+    I2C_SIM_MOTION_T still;
+    memset(&still, 0, sizeof(still));
+    still.fieldStrength = 0.5;
+    still.inclination = 1.15;
+    still.seed = 1;
+    setMotion(still);
+}
+
+/* Set the motion
+ */
+void I2CSimMotion::setMotion(const I2C_SIM_MOTION_T &newMotion) {
+    motion = newMotion;
+    state = (motion.seed != 0) ? motion.seed : 1;
+}
+
+/* Get the motion
+ */
+const I2C_SIM_MOTION_T &I2CSimMotion::getMotion() const {
+    return motion;
+}
+
+/* Gravity in the sensor frame in g, pointing up
+ */
+void I2CSimMotion::getGravity(double t, double *x, double *y, double *z) {
+    double pitch = motion.pitch + (motion.pitchRate * t);
+    double roll = motion.roll + (motion.rollRate * t);
+    *x = sin(pitch);
+    *y = cos(pitch) * sin(roll);
+    *z = cos(pitch) * cos(roll);
+}
+
+/* Magnetic field in the sensor frame in gauss
+ * The horizontal component points along the heading, then the vector is
+ * tilted back by the inverse of the tilt compensation.
+ */
+void I2CSimMotion::getField(double t, double *x, double *y, double *z) {
+    double pitch = motion.pitch + (motion.pitchRate * t);
+    double roll = motion.roll + (motion.rollRate * t);
+    double heading = motion.heading + (motion.headingRate * t);
+    double horizontal = motion.fieldStrength * cos(motion.inclination);
+    double vertical = -motion.fieldStrength * sin(motion.inclination);
+    double xh = horizontal * cos(heading);
+    double yh = horizontal * sin(heading);
+    double s = (xh * sin(pitch)) + (vertical * cos(pitch));
+    *x = (xh * cos(pitch)) - (vertical * sin(pitch));
+    *y = (s * sin(roll)) - (yh * cos(roll));
+    *z = (s * cos(roll)) + (yh * sin(roll));
+}
+
+/* Angular rate in the sensor frame in degrees per second
+ */
+void I2CSimMotion::getRate(double *x, double *y, double *z) {
+    *x = motion.rollRate * (180.0 / M_PI);
+    *y = motion.pitchRate * (180.0 / M_PI);
+    *z = motion.headingRate * (180.0 / M_PI);
+}
+
+/* Gaussian noise with the given standard deviation
+ * xorshift32 feeding a Box-Muller transform.
+ */
+double I2CSimMotion::noise(double sigma) {
+    double u1, u2;
+    if (sigma <= 0.0) return 0.0;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    u1 = (state + 1.0) / 4294967297.0;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    u2 = state / 4294967296.0;
+    return sigma * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+}
+
+// -----------------------------------------------------------------------------
+// I2CSimDevice
+// -----------------------------------------------------------------------------
+
+/* Constructor
+ */
+I2CSimDevice::I2CSimDevice(uint8_t address) : devAddr(address) {
+    memset(registers, 0, sizeof(registers));
+}
+
+/* Get the I2C address of the device
+ */
+uint8_t I2CSimDevice::getAddress() const {
+    return devAddr;
+}
+
+/* Read a register
+ */
+uint8_t I2CSimDevice::readRegister(uint8_t regAddr) {
+    return registers[regAddr];
+}
+
+/* Write a register
+ */
+void I2CSimDevice::writeRegister(uint8_t regAddr, uint8_t data) {
+    registers[regAddr] = data;
+}
+
+/* Store a value in two registers, high byte first
+ */
+void I2CSimDevice::putBigEndian(uint8_t regAddr, double value) {
+    int16_t raw;
+    value = floor(value + 0.5);
+    raw = (value > 32767.0) ? 32767 : ((value < -32768.0) ? -32768 : (int16_t)value);
+    registers[regAddr] = (uint8_t)((uint16_t)raw >> 8);
+    registers[(uint8_t)(regAddr + 1)] = (uint8_t)raw;
+}
+
+/* Store a value in two registers, low byte first
+ */
+void I2CSimDevice::putLittleEndian(uint8_t regAddr, double value) {
+    int16_t raw;
+    value = floor(value + 0.5);
+    raw = (value > 32767.0) ? 32767 : ((value < -32768.0) ? -32768 : (int16_t)value);
+    registers[regAddr] = (uint8_t)raw;
+    registers[(uint8_t)(regAddr + 1)] = (uint8_t)((uint16_t)raw >> 8);
+}
+
+// -----------------------------------------------------------------------------
+// I2CSimSensor
+// -----------------------------------------------------------------------------
+
+/* Constructor
+ */
+I2CSimSensor::I2CSimSensor(uint8_t address, I2CSimMotion *sensorMotion, uint8_t firstOutput)
+    : I2CSimDevice(address), motion(sensorMotion), sampleRegister(firstOutput), period(0.02), time(0.0) {
+}
+
+/* Set the time between samples
+ */
+void I2CSimSensor::setSampleRate(double rate) {
+    period = (rate > 0.0) ? (1.0 / rate) : 0.0;
+}
+
+/* Get the simulation time of the last sample in seconds
+ */
+double I2CSimSensor::getTime() const {
+    return time;
+}
+
+/* Read a register, sampling when the first output register is read
+ */
+uint8_t I2CSimSensor::readRegister(uint8_t regAddr) {
+    if (regAddr == sampleRegister) {
+        time += period;
+        sample();
+    }
+    return registers[regAddr];
+}
+
+// -----------------------------------------------------------------------------
+// Device models
+// -----------------------------------------------------------------------------
+
+/* LSM303DLHC accelerometer, 12 bit left justified, low byte first.
+ */
+I2CSimLSM303DLHCAccel::I2CSimLSM303DLHCAccel(I2CSimMotion *motion)
+    : I2CSimSensor(SIM_LSM303_ACC_ADDRESS, motion, SIM_LSM303_OUT_X_L_A) {
+    registers[SIM_LSM303_CTRL_REG1_A] = 0x07;
+}
+
+void I2CSimLSM303DLHCAccel::sample() {
+    double x, y, z;
+    double sigma = motion->getMotion().accelNoise;
+    /* +-2, 4, 8 or 16 g */
+    double scale = 32768.0 / (double)(2 << ((registers[SIM_LSM303_CTRL_REG4_A] >> 4) & 0x03));
+    motion->getGravity(time, &x, &y, &z);
+    putLittleEndian(SIM_LSM303_OUT_X_L_A,     (x + motion->noise(sigma)) * scale);
+    putLittleEndian(SIM_LSM303_OUT_X_L_A + 2, (y + motion->noise(sigma)) * scale);
+    putLittleEndian(SIM_LSM303_OUT_X_L_A + 4, (z + motion->noise(sigma)) * scale);
+    for (uint8_t i = 0; i < 6; i += 2) {
+        registers[SIM_LSM303_OUT_X_L_A + i] &= 0xF0;
+    }
+    registers[SIM_LSM303_STATUS_REG_A] = 0x0F;
+}
+
+/* LSM303DLHC magnetometer, high byte first in the order X, Z, Y.
+ */
+I2CSimLSM303DLHCMag::I2CSimLSM303DLHCMag(I2CSimMotion *motion)
+    : I2CSimSensor(SIM_LSM303_MAG_ADDRESS, motion, SIM_LSM303_OUT_X_H_M) {
+    registers[SIM_LSM303_CRB_REG_M] = 0x20;
+    registers[SIM_LSM303_MR_REG_M] = 0x03;
+    registers[SIM_LSM303_IRA_REG_M] = 0x48;
+    registers[SIM_LSM303_IRA_REG_M + 1] = 0x34;
+    registers[SIM_LSM303_IRA_REG_M + 2] = 0x33;
+    setSampleRate(220.0);
+}
+
+void I2CSimLSM303DLHCMag::sample() {
+    double x, y, z;
+    double sigma = motion->getMotion().magNoise;
+    const double *gain = lsm303MagGain[registers[SIM_LSM303_CRB_REG_M] >> 5];
+    motion->getField(time, &x, &y, &z);
+    putBigEndian(SIM_LSM303_OUT_X_H_M,     (x + motion->noise(sigma)) * gain[0]);
+    putBigEndian(SIM_LSM303_OUT_X_H_M + 2, (z + motion->noise(sigma)) * gain[1]);
+    putBigEndian(SIM_LSM303_OUT_X_H_M + 4, (y + motion->noise(sigma)) * gain[0]);
+    registers[SIM_LSM303_SR_REG_M] = 0x01;
+}
+
+/* HMC5883L magnetometer, high byte first in the order X, Z, Y.
+ */
+I2CSimHMC5883L::I2CSimHMC5883L(I2CSimMotion *motion)
+    : I2CSimSensor(SIM_HMC5883L_ADDRESS, motion, SIM_HMC5883L_DATAX_H) {
+    registers[SIM_HMC5883L_CONFIG_A] = 0x10;
+    registers[SIM_HMC5883L_CONFIG_B] = 0x20;
+    registers[SIM_HMC5883L_MODE] = 0x01;
+    registers[SIM_HMC5883L_ID_A] = 'H';
+    registers[SIM_HMC5883L_ID_A + 1] = '4';
+    registers[SIM_HMC5883L_ID_A + 2] = '3';
+    setSampleRate(15.0);
+}
+
+void I2CSimHMC5883L::sample() {
+    double x, y, z;
+    double sigma = motion->getMotion().magNoise;
+    double gain = hmc5883lGain[registers[SIM_HMC5883L_CONFIG_B] >> 5];
+    motion->getField(time, &x, &y, &z);
+    putBigEndian(SIM_HMC5883L_DATAX_H,     (x + motion->noise(sigma)) * gain);
+    putBigEndian(SIM_HMC5883L_DATAX_H + 2, (z + motion->noise(sigma)) * gain);
+    putBigEndian(SIM_HMC5883L_DATAX_H + 4, (y + motion->noise(sigma)) * gain);
+    registers[SIM_HMC5883L_STATUS] = 0x01;
+}
+
+/* MPU6050, high byte first: accel X, Y, Z, temperature, gyro X, Y, Z.
+ */
+I2CSimMPU6050::I2CSimMPU6050(I2CSimMotion *motion)
+    : I2CSimSensor(SIM_MPU6050_ADDRESS, motion, SIM_MPU6050_ACCEL_XOUT_H) {
+    registers[SIM_MPU6050_PWR_MGMT_1] = 0x40;
+    registers[SIM_MPU6050_WHO_AM_I] = SIM_MPU6050_ADDRESS;
+    setSampleRate(1000.0);
+}
+
+void I2CSimMPU6050::sample() {
+    double x, y, z;
+    double accelSigma = motion->getMotion().accelNoise;
+    double gyroSigma = motion->getMotion().gyroNoise;
+    double accelScale = 16384.0 / (double)(1 << ((registers[SIM_MPU6050_ACCEL_CONFIG] >> 3) & 0x03));
+    double gyroScale = mpu6050GyroScale[(registers[SIM_MPU6050_GYRO_CONFIG] >> 3) & 0x03];
+    motion->getGravity(time, &x, &y, &z);
+    putBigEndian(SIM_MPU6050_ACCEL_XOUT_H,     (x + motion->noise(accelSigma)) * accelScale);
+    putBigEndian(SIM_MPU6050_ACCEL_XOUT_H + 2, (y + motion->noise(accelSigma)) * accelScale);
+    putBigEndian(SIM_MPU6050_ACCEL_XOUT_H + 4, (z + motion->noise(accelSigma)) * accelScale);
+    /* 25 degrees C */
+    putBigEndian(SIM_MPU6050_TEMP_OUT_H, (25.0 - 36.53) * 340.0);
+    motion->getRate(&x, &y, &z);
+    putBigEndian(SIM_MPU6050_GYRO_XOUT_H,     (x + motion->noise(gyroSigma)) * gyroScale);
+    putBigEndian(SIM_MPU6050_GYRO_XOUT_H + 2, (y + motion->noise(gyroSigma)) * gyroScale);
+    putBigEndian(SIM_MPU6050_GYRO_XOUT_H + 4, (z + motion->noise(gyroSigma)) * gyroScale);
+}
+
+// -----------------------------------------------------------------------------
+// I2CdevSim
+// -----------------------------------------------------------------------------
+
+/* Constructor
+ */
+I2CdevSim::I2CdevSim() : noOfDevices(0), transferCount(0) {
+    memset(devices, 0, sizeof(devices));
+}
+
+/* Attach a device to the bus
+ * @return false if the bus is full or the address is in use
+ */
+bool I2CdevSim::addDevice(I2CSimDevice *device) {
+    if ((noOfDevices >= I2CDEVSIM_MAX_DEVICES) || (findDevice(device->getAddress()) != NULL)) {
+        return false;
+    }
+    devices[noOfDevices] = device;
+    noOfDevices++;
+    return true;
+}
+
+/* Number of register accesses since the bus was created
+ */
+uint32_t I2CdevSim::getTransferCount() const {
+    return transferCount;
+}
+
+int I2CdevSim::readReg8(uint8_t devAddr, uint8_t regAddr) {
+    I2CSimDevice *device = findDevice(devAddr);
+    transferCount++;
+    return (device != NULL) ? device->readRegister(regAddr) : -1;
+}
+
+int I2CdevSim::readReg16(uint8_t devAddr, uint8_t regAddr) {
+    I2CSimDevice *device = findDevice(devAddr);
+    transferCount++;
+    if (device == NULL) return -1;
+    uint8_t low = device->readRegister(regAddr);
+    return low | (device->readRegister(regAddr + 1) << 8);
+}
+
+int I2CdevSim::writeReg8(uint8_t devAddr, uint8_t regAddr, uint8_t data) {
+    I2CSimDevice *device = findDevice(devAddr);
+    transferCount++;
+    if (device == NULL) return -1;
+    device->writeRegister(regAddr, data);
+    return 0;
+}
+
+int I2CdevSim::writeReg16(uint8_t devAddr, uint8_t regAddr, uint16_t data) {
+    I2CSimDevice *device = findDevice(devAddr);
+    transferCount++;
+    if (device == NULL) return -1;
+    device->writeRegister(regAddr, (uint8_t)data);
+    device->writeRegister(regAddr + 1, (uint8_t)(data >> 8));
+    return 0;
+}
+
+I2CSimDevice *I2CdevSim::findDevice(uint8_t devAddr) {
+    for (uint8_t index = 0; index < noOfDevices; index++) {
+        if (devices[index]->getAddress() == devAddr) {
+            return devices[index];
+        }
+    }
+    return NULL;
+}
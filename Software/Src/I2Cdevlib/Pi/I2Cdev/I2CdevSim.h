@@ -0,0 +1,228 @@
+// I2Cdev library collection - in-memory I2C bus simulator
+// Provides an I2CBus backend holding a register map for each simulated
+// device, so the I2Cdevlib drivers and everything above them can run on a
+// machine without an I2C bus.
+//
+// Changelog:
+//      2016-06-12 - initial release
+
+/* ============================================
+ * I2Cdev device library code is placed under the MIT license
+ * Copyright (c) 2013 Jeff Rowberg
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ * ===============================================
+ */
+
+#ifndef _I2CDEVSIM_H_
+#define _I2CDEVSIM_H_
+
+#include <stdint.h>
+#include "I2Cdev.h"
+
+#define I2CDEVSIM_MAX_DEVICES 8 /**< devices on one simulated bus */
+
+/** I2C_SIM_MOTION_T
+ * Synthetic motion of the simulated sensors. Angles are in radians and
+ * rates in radians per second; each angle moves linearly from its start
+ * value. Noise is the standard deviation of gaussian noise added to each
+ * axis of a sample.
+ */
+typedef struct
+{
+    double pitch;          /**< start pitch */
+    double roll;           /**< start roll */
+    double heading;        /**< start heading */
+    double pitchRate;      /**< pitch rate */
+    double rollRate;       /**< roll rate */
+    double headingRate;    /**< heading rate */
+    double fieldStrength;  /**< local magnetic field in gauss */
+    double inclination;    /**< magnetic inclination, positive down */
+    double accelNoise;     /**< accelerometer noise in g */
+    double magNoise;       /**< magnetometer noise in gauss */
+    double gyroNoise;      /**< gyro noise in degrees per second */
+    uint32_t seed;         /**< noise generator seed, must not be zero */
+} I2C_SIM_MOTION_T;
+
+/** Class simulated motion
+ * Provides the ideal sensor readings for the current simulation time.
+ * The magnetic field is generated so that the tilt compensation in
+ * TelescopeOrientation recovers the heading for the simulated pitch and roll.
+ */
+class I2CSimMotion {
+    public:
+/** Constructor, the telescope starts level, pointing north and still.
+ */
+        I2CSimMotion();
+/** Set the motion
+ */
+        void setMotion(const I2C_SIM_MOTION_T &newMotion);
+/** Get the motion
+ */
+        const I2C_SIM_MOTION_T &getMotion() const;
+/** Gravity in the sensor frame in g, pointing up
+ * @param t Simulation time in seconds
+ */
+        void getGravity(double t, double *x, double *y, double *z);
+/** Magnetic field in the sensor frame in gauss
+ * @param t Simulation time in seconds
+ */
+        void getField(double t, double *x, double *y, double *z);
+/** Angular rate in the sensor frame in degrees per second
+ */
+        void getRate(double *x, double *y, double *z);
+/** Gaussian noise with the given standard deviation
+ */
+        double noise(double sigma);
+
+    private:
+        I2C_SIM_MOTION_T motion;
+        uint32_t state;         /**< xorshift state */
+};
+
+/** Class simulated device
+ * A register map that reads back what was written. Models override
+ * readRegister to refresh their output registers.
+ */
+class I2CSimDevice {
+    public:
+/** Constructor
+ * @param devAddr I2C address the device answers on
+ */
+        I2CSimDevice(uint8_t devAddr);
+        virtual ~I2CSimDevice() {}
+/** Get the I2C address of the device
+ */
+        uint8_t getAddress() const;
+/** Read a register
+ */
+        virtual uint8_t readRegister(uint8_t regAddr);
+/** Write a register
+ */
+        virtual void writeRegister(uint8_t regAddr, uint8_t data);
+
+    protected:
+/** Store a value in two registers, high byte first
+ */
+        void putBigEndian(uint8_t regAddr, double value);
+/** Store a value in two registers, low byte first
+ */
+        void putLittleEndian(uint8_t regAddr, double value);
+
+        uint8_t devAddr;
+        uint8_t registers[256];
+};
+
+/** Class simulated sensor
+ * A device which takes a new sample, advancing the simulation time by one
+ * sample period, each time the first of its output registers is read.
+ */
+class I2CSimSensor : public I2CSimDevice {
+    public:
+/** Constructor
+ * @param devAddr I2C address the device answers on
+ * @param motion Motion to sample
+ * @param sampleRegister First output register
+ */
+        I2CSimSensor(uint8_t devAddr, I2CSimMotion *motion, uint8_t sampleRegister);
+/** Set the time between samples
+ * @param rate Samples per second of simulation time
+ */
+        void setSampleRate(double rate);
+/** Get the simulation time of the last sample in seconds
+ */
+        double getTime() const;
+        uint8_t readRegister(uint8_t regAddr);
+
+    protected:
+/** Fill the output registers with a new sample
+ */
+        virtual void sample() = 0;
+
+        I2CSimMotion *motion;
+        uint8_t sampleRegister;
+        double period;
+        double time;
+};
+
+/** Class simulated LSM303DLHC accelerometer
+ */
+class I2CSimLSM303DLHCAccel : public I2CSimSensor {
+    public:
+        I2CSimLSM303DLHCAccel(I2CSimMotion *motion);
+    protected:
+        void sample();
+};
+
+/** Class simulated LSM303DLHC magnetometer
+ */
+class I2CSimLSM303DLHCMag : public I2CSimSensor {
+    public:
+        I2CSimLSM303DLHCMag(I2CSimMotion *motion);
+    protected:
+        void sample();
+};
+
+/** Class simulated HMC5883L magnetometer
+ */
+class I2CSimHMC5883L : public I2CSimSensor {
+    public:
+        I2CSimHMC5883L(I2CSimMotion *motion);
+    protected:
+        void sample();
+};
+
+/** Class simulated MPU6050 accelerometer and gyro
+ */
+class I2CSimMPU6050 : public I2CSimSensor {
+    public:
+        I2CSimMPU6050(I2CSimMotion *motion);
+    protected:
+        void sample();
+};
+
+/** Class simulated I2C bus
+ * Install with I2Cdev::setBus(). Accesses to addresses without a device
+ * fail like a missing device on a real bus.
+ */
+class I2CdevSim : public I2CBus {
+    public:
+        I2CdevSim();
+/** Attach a device to the bus
+ * @param device Device to attach, the bus does not take ownership
+ * @return false if the bus is full or the address is in use
+ */
+        bool addDevice(I2CSimDevice *device);
+/** Number of register accesses since the bus was created
+ */
+        uint32_t getTransferCount() const;
+        int readReg8(uint8_t devAddr, uint8_t regAddr);
+        int readReg16(uint8_t devAddr, uint8_t regAddr);
+        int writeReg8(uint8_t devAddr, uint8_t regAddr, uint8_t data);
+        int writeReg16(uint8_t devAddr, uint8_t regAddr, uint16_t data);
+
+    private:
+        I2CSimDevice *findDevice(uint8_t devAddr);
+
+        I2CSimDevice *devices[I2CDEVSIM_MAX_DEVICES];
+        uint8_t noOfDevices;
+        uint32_t transferCount;
+};
+
+#endif /* _I2CDEVSIM_H_ */
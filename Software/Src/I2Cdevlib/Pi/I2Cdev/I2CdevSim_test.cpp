@@ -0,0 +1,211 @@
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+#include "I2CdevSim.h"
+#include "LSM303DLHC.h"
+#include "HMC5883L.h"
+#include "MPU6050.h"
+#include "TelescopeOrientation.h"
+#include "Config.h"
+/*
+ I2C bus simulator test program
+ Runs the drivers and the orientation pipeline against simulated devices
+ and reports the samples per second. Build on any machine from Software/:
+
+ g++ -O2 -DI2CDEV_NO_WIRINGPI -I./Src -I./Src/I2Cdevlib/Pi/I2Cdev -I./Src/I2Cdevlib/Pi/LSM303DLHC \
+     -I./Src/I2Cdevlib/Pi/HMC5883L -I./Src/I2Cdevlib/Pi/MPU6050 -I./Src/Hal -I./Src/Scheduler \
+     -I./Src/TelescopeManager -I./Src/Utils \
+     Src/I2Cdevlib/Pi/I2Cdev/I2CdevSim_test.cpp Src/I2Cdevlib/Pi/I2Cdev/I2CdevSim.cpp \
+     Src/I2Cdevlib/Pi/I2Cdev/I2Cdev.cpp Src/I2Cdevlib/Pi/LSM303DLHC/LSM303DLHC.cpp \
+     Src/I2Cdevlib/Pi/HMC5883L/HMC5883L.cpp Src/I2Cdevlib/Pi/MPU6050/MPU6050.cpp \
+     Src/TelescopeManager/TelescopeOrientation.cpp Src/TelescopeManager/MagCalibration.cpp \
+     Src/Hal/HalAccelerometer.cpp Src/Hal/HalMagnetometer.cpp Src/Hal/HalCapture.cpp Src/Hal/HalReactor.cpp \
+     Src/Scheduler/Runnable.cpp Src/Utils/LatencyTrace.cpp Src/Utils/Metrics.cpp Src/Utils/Trace.cpp \
+     -lpthread -latomic -o I2CdevSim_test
+ */
+
+#define PIPELINE_SAMPLES 1000000u
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+int main()
+{
+    I2CSimMotion motion;
+    I2C_SIM_MOTION_T tilted = motion.getMotion();
+    int16_t x = 0;
+    int16_t y = 0;
+    int16_t z = 0;
+
+    /* 30 degrees nose up, 10 degrees roll, heading 40 degrees, no noise */
+    tilted.pitch = 30.0 * (M_PI / 180.0);
+    tilted.roll = 10.0 * (M_PI / 180.0);
+    tilted.heading = 40.0 * (M_PI / 180.0);
+    motion.setMotion(tilted);
+
+    /* LSM303DLHC */
+    {
+        I2CdevSim bus;
+        I2CSimLSM303DLHCAccel accelDevice(&motion);
+        I2CSimLSM303DLHCMag magDevice(&motion);
+        bus.addDevice(&accelDevice);
+        bus.addDevice(&magDevice);
+        I2Cdev::setBus(&bus);
+
+        LSM303DLHC_Accel accel;
+        LSM303DLHC_Mag mag;
+        accel.initialize();
+        mag.initialize();
+        check(mag.testConnection(), "LSM303DLHC magnetometer identifies");
+        accel.getAcceleration(&x, &y, &z);
+        check(fabs((x / 16384.0) - sin(tilted.pitch)) < 0.002, "LSM303DLHC accel X");
+        check(fabs((z / 16384.0) - (cos(tilted.pitch) * cos(tilted.roll))) < 0.002, "LSM303DLHC accel Z");
+        mag.getHeading(&x, &y, &z);
+        check((x != 0) && (y != 0) && (z != 0), "LSM303DLHC magnetometer samples");
+        I2Cdev::setBus(NULL);
+    }
+
+    /* HMC5883L */
+    {
+        I2CdevSim bus;
+        I2CSimHMC5883L magDevice(&motion);
+        bus.addDevice(&magDevice);
+        I2Cdev::setBus(&bus);
+
+        HMC5883L mag;
+        mag.initialize();
+        check(mag.testConnection(), "HMC5883L identifies");
+        mag.getHeading(&x, &y, &z);
+        /* default gain is 1090 LSB per gauss */
+        check(fabs((sqrt(((double)x * x) + ((double)y * y) + ((double)z * z)) / 1090.0) - tilted.fieldStrength) < 0.005, "HMC5883L field strength");
+        /* the tilt compensation of TelescopeOrientation gives back the heading */
+        {
+            const double xh = (x * cos(tilted.pitch)) + (y * sin(tilted.roll) * sin(tilted.pitch)) + (z * cos(tilted.roll) * sin(tilted.pitch));
+            const double yh = (z * sin(tilted.roll)) - (y * cos(tilted.roll));
+            check(fabs(atan2(yh, xh) - tilted.heading) < 0.01, "HMC5883L heading");
+        }
+        I2Cdev::setBus(NULL);
+    }
+
+    /* MPU6050 */
+    {
+        I2CdevSim bus;
+        I2CSimMPU6050 mpuDevice(&motion);
+        bus.addDevice(&mpuDevice);
+        I2Cdev::setBus(&bus);
+
+        MPU6050 mpu;
+        mpu.initialize();
+        check(mpu.testConnection(), "MPU6050 identifies");
+        mpu.getAcceleration(&x, &y, &z);
+        check(fabs(asin(x / sqrt(((double)x * x) + ((double)y * y) + ((double)z * z))) - tilted.pitch) < 0.002, "MPU6050 pitch");
+        /* the offsets are written as words and read back as bytes, through the cache */
+        (void)mpu.getXAccelOffset();
+        (void)mpu.getZGyroOffset();
+        mpu.setXAccelOffset(-1234);
+        mpu.setZGyroOffset(0x1234);
+        check(mpu.getXAccelOffset() == -1234, "MPU6050 accel offset reads back after it is set");
+        check(mpu.getZGyroOffset() == 0x1234, "MPU6050 gyro offset reads back after it is set");
+        check((mpuDevice.readRegister(0x06) == 0xFB) && (mpuDevice.readRegister(0x07) == 0x2E), "MPU6050 offset written MSB first");
+        I2Cdev::disableCache(0x68);
+        check(mpu.getXAccelOffset() == -1234, "MPU6050 accel offset read back from the device");
+        I2Cdev::setBus(NULL);
+    }
+
+    /* register shadow cache */
+    {
+        I2CdevSim bus;
+        I2CSimLSM303DLHCAccel accelDevice(&motion);
+        uint32_t cachedTransfers = 0;
+        uint32_t uncachedTransfers = 0;
+        bus.addDevice(&accelDevice);
+        I2Cdev::setBus(&bus);
+
+        LSM303DLHC_Accel accel;
+        accel.initialize();
+        cachedTransfers = bus.getTransferCount();
+        accel.setDataRateSelect(FIFTY_HZ);
+        accel.setDataRateSelect(FOUR_HUNDRED_HZ);
+        cachedTransfers = bus.getTransferCount() - cachedTransfers;
+        check(accel.getDataRateSelect() == FOUR_HUNDRED_HZ, "cache reads back the data rate");
+        check((accelDevice.readRegister(0x20) >> 4) == FOUR_HUNDRED_HZ, "cache writes through to the device");
+
+        I2Cdev::disableCache(0x19);
+        uncachedTransfers = bus.getTransferCount();
+        accel.setDataRateSelect(FIFTY_HZ);
+        accel.setDataRateSelect(FOUR_HUNDRED_HZ);
+        uncachedTransfers = bus.getTransferCount() - uncachedTransfers;
+        check(cachedTransfers < uncachedTransfers, "cache saves the read of a read-modify-write");
+        printf("reconfiguration: %u transfers cached, %u uncached\n", cachedTransfers, uncachedTransfers);
+
+        accel.getAcceleration(&x, &y, &z);
+        accel.getAcceleration(&x, &y, &z);
+        check(accelDevice.getTime() > 0.0, "output registers are never cached");
+        I2Cdev::setBus(NULL);
+    }
+
+    /* orientation pipeline with noise and a slow slew */
+    {
+        I2CdevSim bus;
+        I2CSimLSM303DLHCAccel accelDevice(&motion);
+        I2CSimLSM303DLHCMag magDevice(&motion);
+        float pitch = 0.0f;
+        float roll = 0.0f;
+        float heading = 0.0f;
+        double start = 0.0;
+        double elapsed = 0.0;
+
+        tilted.headingRate = 1.0 * (M_PI / 180.0);
+        tilted.accelNoise = 0.002;
+        tilted.magNoise = 0.001;
+        motion.setMotion(tilted);
+        accelDevice.setSampleRate(500.0);
+        magDevice.setSampleRate(500.0);
+        bus.addDevice(&accelDevice);
+        bus.addDevice(&magDevice);
+        I2Cdev::setBus(&bus);
+
+        TelescopeOrientation::Orient.Init();
+        start = seconds();
+        for (uint32_t sample = 0; sample < PIPELINE_SAMPLES; sample++)
+        {
+            TelescopeOrientation::Orient.Run();
+            TelescopeOrientation::Orient.GetOrientation(&pitch, &roll, &heading);
+        }
+        elapsed = seconds() - start;
+        /* expected values with the per axis accelerometer calibration from Config.h */
+        {
+            double gx = 0.0;
+            double gy = 0.0;
+            double gz = 0.0;
+            motion.getGravity(0.0, &gx, &gy, &gz);
+            gx /= (CONFIG_AXMAX - CONFIG_AX_OFFSET);
+            gy /= (CONFIG_AYMAX - CONFIG_AY_OFFSET);
+            gz /= (CONFIG_AZMAX - CONFIG_AZ_OFFSET);
+            check(fabs(pitch - asin(gx / sqrt((gx * gx) + (gy * gy) + (gz * gz)))) < 0.01, "pipeline pitch");
+            check(fabs(roll - atan2(gy, gz)) < 0.01, "pipeline roll");
+        }
+        printf("pipeline: %u samples in %.3f s, %.0f samples/s, %u bus transfers\n",
+               PIPELINE_SAMPLES, elapsed, PIPELINE_SAMPLES / elapsed, bus.getTransferCount());
+        I2Cdev::setBus(NULL);
+    }
+
+    printf("%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -33,6 +33,28 @@ THE SOFTWARE.
 */
 
 #include "LSM303DLHC.h"
+/** Accelerometer registers which must not be cached: reboot, status,
+ * output and interrupt/click source registers.
+ */
+static const I2CDEV_REG_RANGE_T accelVolatileRegs[] =
+{
+    { CTRL_REG5_A,    CTRL_REG5_A    },
+    { STATUS_REG_A,   OUT_Z_H_A      },
+    { FIFO_SRC_REG_A, FIFO_SRC_REG_A },
+    { INT1_SRC_A,     INT1_SRC_A     },
+    { INT2_SRC_A,     INT2_SRC_A     },
+    { CLICK_SRC_A,    CLICK_SRC_A    }
+};
+
+/** Magnetometer registers which must not be cached: output, status and
+ * temperature registers.
+ */
+static const I2CDEV_REG_RANGE_T magVolatileRegs[] =
+{
+    { OUT_X_H_M,    SR_REG_M     },
+    { TEMP_OUT_H_M, TEMP_OUT_L_M }
+};
+
 /** Default constructor, uses default I2C address.
  */
 LSM303DLHC_Accel::LSM303DLHC_Accel()
@@ -51,6 +73,7 @@ LSM303DLHC_Accel::LSM303DLHC_Accel()
  */
 void LSM303DLHC_Accel::initialize()
 {
+    I2Cdev::enableCache( accel_devAddr, accelVolatileRegs, sizeof( accelVolatileRegs ) / sizeof( accelVolatileRegs[0] ) );
     setReboot( ENABLE );
     setXEnable( ENABLE );
     setYEnable( ENABLE );
@@ -705,6 +728,8 @@ void LSM303DLHC_Accel::setReboot( lsm303lhc_enable_t enable )
     I2Cdev::readByte( accel_devAddr, CTRL_REG5_A, &Reg.all );
     Reg.bits.Reboot = (uint8_t)enable;
     I2Cdev::writeByte(  accel_devAddr, CTRL_REG5_A, Reg.all);
+    /* rebooting reloads the registers */
+    I2Cdev::invalidateCache( accel_devAddr );
 }
 
 /** set
@@ -1945,6 +1970,7 @@ LSM303DLHC_Mag::LSM303DLHC_Mag()
  */
 void LSM303DLHC_Mag::initialize()
 {
+    I2Cdev::enableCache( mag_devAddr, magVolatileRegs, sizeof( magVolatileRegs ) / sizeof( magVolatileRegs[0] ) );
 //    if ( testConnection() )
     {
         setGain( MAG_SCALE_1_9 );
@@ -2118,7 +2144,7 @@ uint8_t LSM303DLHC_Mag::getIDA()
  */
 uint8_t LSM303DLHC_Mag::getIDB()
 {
-    I2Cdev::readByte( mag_devAddr, IRC_REG_M, buffer );
+    I2Cdev::readByte( mag_devAddr, IRB_REG_M, buffer );
     return buffer[0];
 }
 
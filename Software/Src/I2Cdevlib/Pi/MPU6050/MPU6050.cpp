@@ -38,6 +38,17 @@ THE SOFTWARE.
 #include <stdlib.h>
 #include <string.h>
 
+/* Registers which must not be cached: status, sensor and FIFO data, the
+ * DMP memory window and the registers with self clearing reset bits.
+ */
+static const I2CDEV_REG_RANGE_T volatileRegs[] = {
+    { MPU6050_RA_I2C_SLV4_DI,       MPU6050_RA_MOT_DETECT_STATUS },
+    { MPU6050_RA_SIGNAL_PATH_RESET, MPU6050_RA_SIGNAL_PATH_RESET },
+    { MPU6050_RA_USER_CTRL,         MPU6050_RA_PWR_MGMT_1 },
+    { MPU6050_RA_BANK_SEL,          MPU6050_RA_MEM_R_W },
+    { MPU6050_RA_FIFO_COUNTH,       MPU6050_RA_FIFO_R_W }
+};
+
 /* Default constructor, uses default I2C address.
  * @see MPU6050_DEFAULT_ADDRESS
  */
@@ -63,6 +74,7 @@ MPU6050::MPU6050(uint8_t address) {
  * the default internal clock source.
  */
 void MPU6050::initialize() {
+    I2Cdev::enableCache(devAddr, volatileRegs, sizeof(volatileRegs) / sizeof(volatileRegs[0]));
     setClockSource(MPU6050_CLOCK_PLL_XGYRO);
     setFullScaleGyroRange(MPU6050_GYRO_FS_250);
     setFullScaleAccelRange(MPU6050_ACCEL_FS_2);
@@ -2365,6 +2377,8 @@ void MPU6050::resetSensors() {
  */
 void MPU6050::reset() {
     I2Cdev::writeBit(devAddr, MPU6050_RA_PWR_MGMT_1, MPU6050_PWR1_DEVICE_RESET_BIT, true);
+    // every register returns to its reset value
+    I2Cdev::invalidateCache(devAddr);
 }
 /* Get sleep mode status.
  * Setting the SLEEP bit in the register puts the device into very low power
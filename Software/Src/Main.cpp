@@ -21,23 +21,37 @@
 #include <string.h>
 #include <stdio.h>
 #include "ServerPi.h"
+#include "ServerLx200.h"
 #include "HalWebsocketd.h"
 #include "HalSocket.h"
 #include "HalGps.h"
+#include "HalCapture.h"
+#include "HalReactor.h"
+#include "HalMetrics.h"
+#include "Bench.h"
+#include "I2Cdev.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include "TelescopeOrientation.h"
 #include "TelescopeManager.h"
 #include "TelescopeSocket.h"
+#include "TelemetryShm.h"
+#include "TelemetryMulticast.h"
 #include "TTC_Sched_Pi_Impl.h"
 #include "Config.h"
 #include <iostream>
 using namespace std;
 
-#ifdef TIMING
-#include "GPIO.h"
-#endif
-
-
 static volatile bool continue_looping = true;
+static volatile bool flush_requested = false;
+
+/* Keep the capture of the session that crashed, then crash as before */
+static void fatal_signal_handler(int signum)
+{
+    HalCapture::Capture.FlushFromSignal();
+    signal(signum, SIG_DFL);
+    raise(signum);
+}
 
 static void signal_handler(int signum)
 {
@@ -52,12 +66,37 @@ static void signal_handler(int signum)
             printf ("End.\n");
             break;
         } 
+        case SIGUSR1:
+        {
+            /* written from the main loop, stdio is not safe here */
+            flush_requested = true;
+            break;
+        }
         default:
     //        just ignore
         break;
     }
 }
 
+/* Register how long a task runs for, labelled with its name */
+static void RegisterTaskMetrics( TTC_Sched& Scheduler, uint8_t Index, const char* Labels )
+{
+    (void)Metrics::Register( "starpi_task_run_seconds", Labels, "Time each scheduler task runs for", Scheduler.GetRunTime( Index ) );
+}
+
+/* Sample the I2C counts for Metrics */
+static double SampleI2cTransactions( void* Context )
+{
+    (void)Context;
+    return I2Cdev::getTransactionCount();
+}
+
+static double SampleI2cErrors( void* Context )
+{
+    (void)Context;
+    return I2Cdev::getErrorCount();
+}
+
 int main(int argc, char *argv[])
 {
     //cout << "This is " << argv[0] << ", built at "
@@ -72,25 +111,64 @@ int main(int argc, char *argv[])
 
     // maybe the user wants to continue after SIGHUP ?
     signal(SIGHUP,signal_handler);
+    // SIGUSR1 writes out the capture log and the trace
+    signal(SIGUSR1, signal_handler);
+    signal(SIGSEGV, fatal_signal_handler);
+    signal(SIGBUS, fatal_signal_handler);
+    signal(SIGFPE, fatal_signal_handler);
+    signal(SIGILL, fatal_signal_handler);
+    signal(SIGABRT, fatal_signal_handler);
 
     // Disable output buffering.
     setbuf(stdout, NULL);
     int Port = 0;
+    HAL_CAPTURE_MODE_T CaptureMode = HAL_CAPTURE_OFF;
+    if ( ( argc == 2 ) && ( strcmp( argv[1], "--bench" ) == 0 ) )
+    {
+        /* no sensors, GPS or servers, just the stages timed */
+        return Bench::Run( stdout ) ? 0 : 1;
+    }
     if ((argc < 2 || argc > 4) ||
         1 != sscanf(argv[1], "%d", &Port) ||
         Port < 0 || Port > 0xFFFF)
     {
-        cout << "Usage: " << argv[0] << " port" << endl;
+        cout << "Usage: " << argv[0] << " port [record|replay|replayfast file] | --bench" << endl;
         return 126;
     }
+    if ( argc == 4 )
+    {
+        if ( strcmp( argv[2], "record" ) == 0 )
+        {
+            CaptureMode = HAL_CAPTURE_RECORD;
+        }
+        else if ( strcmp( argv[2], "replay" ) == 0 )
+        {
+            CaptureMode = HAL_CAPTURE_REPLAY;
+        }
+        else if ( strcmp( argv[2], "replayfast" ) == 0 )
+        {
+            CaptureMode = HAL_CAPTURE_REPLAY_FAST;
+        }
+        /* must be before the HAL is initialised */
+        if ( ( CaptureMode == HAL_CAPTURE_OFF ) || !HalCapture::Capture.Init( CaptureMode, argv[3] ) )
+        {
+            cout << "Usage: " << argv[0] << " port [record|replay|replayfast file] | --bench" << endl;
+            return 126;
+        }
+    }
+    /* every socket is registered with the reactor, so it must be first */
+    if ( !HalReactor::Reactor.Init() )
+    {
+        return 125;
+    }
+    /* the log is written between the tasks, not by them */
+    if ( !HalCapture::Capture.StartFlushing() )
+    {
+        return 125;
+    }
     TTC_Sched_Pi_Impl   Scheduler;
     ServerPi PiServer( Port );
-    
-#ifdef TIMING
-    GPIO::gpio.Init();
-    GPIO::gpio.SetupOutput( SERVER_PI_PIN );
-    GPIO::gpio.SetPullMode( SERVER_PI_PIN , PULL_UP );
-#endif
+    ServerLx200 Lx200Server( SERVER_LX200_PORT );
 
     TelescopeManager::Telescope.Init(); 
     Scheduler.Init();   // call first to reset task table and configure timer.
@@ -99,13 +177,31 @@ int main(int argc, char *argv[])
     TelescopeOrientation::Orient.SetDelay(0); 
     TelescopeOrientation::Orient.SetPeriod(4); // run every 4 ticks (1 tick == 500us).
     
-    HalWebsocketd::Websocket.Init();
+    if ( !HalWebsocketd::Websocket.Init( HAL_WEBSOCKET_PORT ) )
+    {
+        return 125;
+    }
     HalWebsocketd::Websocket.SetDelay(0); 
     HalWebsocketd::Websocket.SetPeriod(10);
 
-    HalSocket::Socket.Init( 9999, &TelescopeSocket::TeleSocket.SocketCallback );
-    HalSocket::Socket.SetDelay(1); 
-    HalSocket::Socket.SetPeriod(50);
+    HalSocket::Socket.Init( 9999, &TelescopeSocket::TeleSocket.SocketCallback, &TelescopeSocket::MessageLength );
+    if ( !TelescopeSocket::TeleSocket.Init() )
+    {
+        return 125;
+    }
+    (void)TelescopeManager::Telescope.AddPublishHook( &TelescopeSocket::Publish );
+    /* local programs can do without it, so StarPi carries on */
+    if ( TelemetryShm::Init( TELEMETRY_SHM_NAME ) )
+    {
+        (void)TelescopeManager::Telescope.AddPublishHook( &TelemetryShm::Publish );
+    }
+#ifdef TELEMETRY_MULTICAST
+    if ( TelemetryMulticast::Init( TELEMETRY_MULTICAST_GROUP, TELEMETRY_MULTICAST_PORT, NULL ) )
+    {
+        (void)TelescopeManager::Telescope.AddPublishHook( &TelemetryMulticast::Publish );
+    }
+#endif
+    PiServer.Init( SERVER_PI_POSITION_PERIOD, SERVER_PI_CHANGE_THRESHOLD );
 
     HalGps::Gps.SetDelay(0); // run one tick after telescope mgr run.
     HalGps::Gps.SetPeriod(100); // run every 200ms.
@@ -113,34 +209,82 @@ int main(int argc, char *argv[])
     TelescopeManager::Telescope.SetDelay(1); 
     TelescopeManager::Telescope.SetPeriod(10);
     
-    PiServer.SetDelay(1);
-    PiServer.SetPeriod(10);
-    
     
     uint8_t error = 0;
     //printf ("tasks configured.\n");
     error = Scheduler.AddTask(&HalGps::Gps);
+    RegisterTaskMetrics( Scheduler, error, "task=\"HalGps\"" );
     //printf ("tasks added = %d.\n", error);
     error = Scheduler.AddTask(&TelescopeOrientation::Orient);
-    //printf ("tasks added = %d.\n", error);
-    error = Scheduler.AddTask(&PiServer);  
+    RegisterTaskMetrics( Scheduler, error, "task=\"TelescopeOrientation\"" );
     //printf ("tasks added = %d.\n", error);
     error = Scheduler.AddTask(&TelescopeManager::Telescope);
+    RegisterTaskMetrics( Scheduler, error, "task=\"TelescopeManager\"" );
     //printf ("tasks added = %d.\n", error);
-//    error = Scheduler.AddTask(&HalWebsocketd::Websocket);
-    error = Scheduler.AddTask(&HalSocket::Socket);
+    error = Scheduler.AddTask(&HalWebsocketd::Websocket);
+    RegisterTaskMetrics( Scheduler, error, "task=\"HalWebsocketd\"" );
     //printf ("tasks added = %d.\n", error);
     //error =   Scheduler.AddTask(&Runs);
     //printf ("tasks added = %d.\n", error);
     
-    Scheduler.Start();
+    (void)Metrics::Register( "starpi_task_lock_wait_seconds", "", "Time the tasks wait for the dispatch lock", Scheduler.GetLockWait() );
+    (void)Metrics::RegisterSampled( "starpi_i2c_transactions_total", "", "I2C register accesses, cache hits are not counted",
+                                    METRIC_COUNTER, &SampleI2cTransactions, NULL );
+    (void)Metrics::RegisterSampled( "starpi_i2c_errors_total", "", "I2C register accesses that failed",
+                                    METRIC_COUNTER, &SampleI2cErrors, NULL );
 
-    //printf ("scheduler started.\n");
-    
-    /* Do busy work. */
-    while (continue_looping)
+    /* the sockets are serviced on the reactor thread between the tasks */
+    Scheduler.SetDispatchLock( &HalReactor::Lock, &HalReactor::Unlock );
+    /* and the metrics are read there too, between the tasks */
+    Metrics::SetSampleLock( &HalReactor::Lock, &HalReactor::Unlock );
+    /* Prometheus can do without it, so StarPi carries on */
+    (void)HalMetrics::Endpoint.Init( HAL_METRICS_PORT );
+    if ( !HalReactor::Reactor.Start() )
     {
-        Scheduler.DispatchTasks();
+        return 125;
+    }
+
+    if ( HalCapture::Capture.IsFastReplay() )
+    {
+        /* run the tasks in the recorded order without waiting for the timer */
+        uint8_t Task = 0;
+        while ( continue_looping && HalCapture::Capture.ReplayNextTask( &Task ) )
+        {
+            Scheduler.RunTask( Task );
+        }
+        printf ("Replay finished at %llu us.\n", (unsigned long long)HalCapture::Capture.GetReplayTime() );
+    }
+    else
+    {
+        if ( CaptureMode == HAL_CAPTURE_RECORD )
+        {
+            Scheduler.SetDispatchHook( &HalCapture::RecordTask );
+        }
+        Scheduler.Start();
+
+        //printf ("scheduler started.\n");
+    
+        /* Do busy work. */
+        while (continue_looping)
+        {
+            Scheduler.DispatchTasks();
+            if (flush_requested)
+            {
+                flush_requested = false;
+                HalCapture::Capture.Flush();
+#ifdef TRACE
+                if (Trace::Dump(TRACE_FILE))
+                {
+                    printf ("Trace written to %s.\n", TRACE_FILE);
+                }
+#endif
+            }
+        }
     }
+    HalReactor::Reactor.Stop();
+    HalMetrics::Endpoint.Close();
+    TelemetryShm::Close();
+    TelemetryMulticast::Close();
+    HalCapture::Capture.Close();
     return error;
 }
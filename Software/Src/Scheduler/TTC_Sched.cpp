@@ -76,10 +76,14 @@ void TTC_Sched::DispatchTasks( void )
     // Dispatches (runs) the next task (if one is ready)
     for (Index = 0; Index < SCH_MAX_TASKS; Index++)
     {
-        if ( this->Tasks[Index]->IsRunnable() )
+        if ( ( 0 != this->Tasks[Index] ) && this->Tasks[Index]->IsRunnable() )
         {
+            if ( 0 != this->DispatchHook )
+            {
+                this->DispatchHook( Index );
+            }
             // Run the task
-            this->Tasks[Index]->Run();
+            RunLocked( Index );
 
             // Reset (or reduce) runnable flag
             this->Tasks[Index]->DecreaseRun();
@@ -94,6 +98,69 @@ void TTC_Sched::DispatchTasks( void )
     }
 }
 
+/* Set a function to be called with the task index each time a task
+ * is dispatched, e.g. to record the schedule. Pass 0 to remove it.
+ */
+void TTC_Sched::SetDispatchHook( void (*Hook)( uint8_t Index ) )
+{
+    this->DispatchHook = Hook;
+}
+
+/* Set a lock to be held while each task runs, so work done on
+ * another thread can share the task data. Pass 0 to remove it.
+ */
+void TTC_Sched::SetDispatchLock( void (*Lock)( void ), void (*Unlock)( void ) )
+{
+    this->DispatchLock = Lock;
+    this->DispatchUnlock = Unlock;
+}
+
+/* Run a task straight away, outside of the timer.
+ * Used to play back a recorded schedule.
+ */
+void TTC_Sched::RunTask( const uint8_t Index )
+{
+    if ( ( Index < SCH_MAX_TASKS ) && ( 0 != this->Tasks[Index] ) )
+    {
+        RunLocked( Index );
+    }
+}
+
+/* Get the times a task has run for, to register them with Metrics
+ */
+const MetricHistogram* TTC_Sched::GetRunTime( const uint8_t Index )
+{
+    return ( Index < SCH_MAX_TASKS ) ? &this->RunTime[Index] : 0;
+}
+
+/* Get the times the tasks waited for the dispatch lock
+ */
+const MetricHistogram* TTC_Sched::GetLockWait( void )
+{
+    return &this->LockWait;
+}
+
+/* Run a task holding the dispatch lock, if there is one, and time it
+ */
+void TTC_Sched::RunLocked( const uint8_t Index )
+{
+    const int64_t Start = Metrics::NowMicros();
+    int64_t Locked = Start;
+    if ( ( 0 != this->DispatchLock ) && ( 0 != this->DispatchUnlock ) )
+    {
+        this->DispatchLock();
+        Locked = Metrics::NowMicros();
+        this->Tasks[Index]->Run();
+        this->DispatchUnlock();
+        this->LockWait.Observe( Locked - Start );
+    }
+    else
+    {
+        this->Tasks[Index]->Run();
+    }
+    this->RunTime[Index].Observe( Metrics::NowMicros() - Locked );
+}
+
 /* This is the scheduler ISR.  It is called at a rate
  * determined by the timer settings in TTC_Sched::init().
  * This version is triggered by Timer 0 interrupts.
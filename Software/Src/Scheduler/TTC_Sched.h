@@ -1,6 +1,7 @@
 #include <stdint.h>
 
 #include "Runnable.h"
+#include "Metrics.h"
 
 /* ------Public constants-------------------------------------------*/
 
@@ -18,6 +19,14 @@ class TTC_Sched
 
 protected:
     Runnable * Tasks[SCH_MAX_TASKS]; /**<  */
+    void (*DispatchHook)( uint8_t Index ); /**< called with the index of each dispatched task */
+    void (*DispatchLock)( void );          /**< taken around each dispatched task */
+    void (*DispatchUnlock)( void );        /**< released after each dispatched task */
+    MetricHistogram RunTime[SCH_MAX_TASKS]; /**< how long each task runs for */
+    MetricHistogram LockWait;              /**< how long the dispatch lock takes to get */
+/** Run a task holding the dispatch lock, if there is one, and time it
+ */
+    void RunLocked( const uint8_t Index );
 
 public:
 /** Causes a task (function) to be executed at regular intervals
@@ -48,6 +57,26 @@ public:
  * This function must be called (repeatedly) from the main loop.
  */
     void DispatchTasks(void);
+/** Set a function to be called with the task index each time a task
+ * is dispatched, e.g. to record the schedule. Pass 0 to remove it.
+ */
+    void SetDispatchHook( void (*Hook)( uint8_t Index ) );
+/** Set a lock to be held while each task runs, so work done on
+ * another thread can share the task data. Pass 0 to remove it.
+ */
+    void SetDispatchLock( void (*Lock)( void ), void (*Unlock)( void ) );
+/** Run a task straight away, outside of the timer.
+ * Used to play back a recorded schedule.
+ * @param Index The task Index.  Provided by TTC_Sched::add_task().
+ */
+    void RunTask( const uint8_t Index );
+/** Get the times a task has run for, to register them with Metrics
+ * @param Index The task Index.  Provided by TTC_Sched::add_task().
+ */
+    const MetricHistogram* GetRunTime( const uint8_t Index );
+/** Get the times the tasks waited for the dispatch lock
+ */
+    const MetricHistogram* GetLockWait( void );
 /** This is the scheduler ISR.  It is called at a rate
  * determined by the timer settings in TTC_Sched::init().
  * This version is triggered by Timer 0 interrupts.
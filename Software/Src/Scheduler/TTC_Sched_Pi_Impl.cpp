@@ -49,6 +49,9 @@ void TTC_Sched_Pi_Impl::Init(void)
     {
         this->Tasks[i] = 0;
     }    
+    this->DispatchHook = 0;
+    this->DispatchLock = 0;
+    this->DispatchUnlock = 0;
 
     /* Get pointer to the current object */
     TheSched = this;
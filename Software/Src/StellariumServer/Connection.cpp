@@ -25,19 +25,39 @@
 #include "Connection.hpp"
 #include "Server.hpp"
 #include <math.h>
+#include <sys/uio.h>
 //#include "LogFile.hpp"
 #include <iostream>
 #include <iomanip>
 using namespace std;
 
 /* Connection
- * Constructor
+ * Constructor, the connection is closed until it is opened
  */
-Connection::Connection( Server &server, SOCKET Fd ) : Socket( server, Fd )
+Connection::Connection( Server &server ) : Socket( server, INVALID_SOCKET )
 {
     ReadBuffEnd = ReadBuff;
-    WriteBuffEnd = WriteBuff;
+    WriteHead = 0u;
+    WriteCount = 0u;
+    WriteSent = 0u;
     ServerMinusClientTime = 0x7FFFFFFFFFFFFFFFLL;
+    NextFree = NULL;
+}
+
+/* Open
+ * Start using the connection for a new client, it registers with the reactor
+ * @param NewFd the accepted socket
+ */
+void Connection::Open( SOCKET NewFd )
+{
+    ReadBuffEnd = ReadBuff;
+    ClearWriteQueue();
+    ServerMinusClientTime = 0x7FFFFFFFFFFFFFFFLL;
+    Fd = NewFd;
+    if ( !HalReactor::Reactor.Add( Fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, this ) )
+    {
+        HangUp();
+    }
 }
 
 
@@ -52,8 +72,9 @@ int64_t Connection::GetServerMinusClientTime(void)
 
 /* PerformReading
  * Receives data from a TCP/IP connection and stores it in the read buffer.
+ * @return bool true if data was read and there may be more waiting
  */
-void Connection::PerformReading( void )
+bool Connection::PerformReading( void )
 {
     const uint16_t ToRead = ReadBuff + sizeof(ReadBuff) - ReadBuffEnd;
     const int16_t Rc = readNonblocking(ReadBuffEnd, ToRead);
@@ -83,6 +104,7 @@ void Connection::PerformReading( void )
     }
     else
     {    
+        server.BytesIn.Add( Rc );
         ReadBuffEnd += Rc;
         const uint8_t* BufferPtr = ReadBuff;
         DataReceived( BufferPtr, ReadBuffEnd);
@@ -98,15 +120,22 @@ void Connection::PerformReading( void )
             ReadBuffEnd -= (BufferPtr - ReadBuff);
         }
     }
+    return ( Rc > 0 ) && !IS_INVALID_SOCKET(Fd);
 }
 
 /* PerformWriting
- * Sends the contents of the write buffer over a TCP/IP connection.
+ * Sends the queued messages over a TCP/IP connection, in one write.
  */
 void Connection::PerformWriting( void )
 {
-    const int16_t to_write = WriteBuffEnd - WriteBuff;
-    const int16_t Rc = writeNonblocking(WriteBuff, to_write);
+    struct iovec Parts[CONNECTION_WRITE_POSITIONS];
+    for ( uint8_t Index = 0u; Index < WriteCount; Index++ )
+    {
+        const uint8_t Skip = ( Index == 0u ) ? WriteSent : 0u;
+        Parts[Index].iov_base = &WriteQueue[( WriteHead + Index ) % CONNECTION_WRITE_POSITIONS]->Data[Skip];
+        Parts[Index].iov_len = CONNECTION_POSITION_SIZE - Skip;
+    }
+    const ssize_t Rc = writev( Fd, Parts, WriteCount );
     if (Rc < 0)
     {
         if (ERRNO != EINTR && ERRNO != EAGAIN)
@@ -116,65 +145,68 @@ void Connection::PerformWriting( void )
         HangUp();
         }
     }
-    else if (Rc > 0)
+    else
     {
-        if (Rc >= to_write)
+        server.BytesOut.Add( Rc );
+        /* release the messages that have been sent, the last may be partly written */
+        uint32_t Written = (uint32_t)Rc + WriteSent;
+        while ( ( WriteCount > 0u ) && ( Written >= CONNECTION_POSITION_SIZE ) )
         {
-            // everything written
-            WriteBuffEnd = WriteBuff;
-        }
-        else
-        {
-            // partly written
-            memmove(WriteBuff, WriteBuff + Rc, to_write - Rc);
-            WriteBuffEnd -= Rc;
+            Release( WriteQueue[WriteHead] );
+            WriteHead = ( WriteHead + 1u ) % CONNECTION_WRITE_POSITIONS;
+            WriteCount--;
+            Written -= CONNECTION_POSITION_SIZE;
         }
+        WriteSent = Written;
     }
 }
 
-/* PrepareSelectFds
- * Prepare the selected socket
- * @param ReadFds reference
- * @param WriteFds reference
- * @param FdMax reference
+/* ClearWriteQueue
+ * Drop the queued messages, releasing them
  */
-void Connection::PrepareSelectFds( fd_set &ReadFds, fd_set &WriteFds, int16_t &FdMax )
+void Connection::ClearWriteQueue( void )
 {
-    if (!IS_INVALID_SOCKET(Fd))
+    while ( WriteCount > 0u )
     {
-        if (FdMax < (int16_t)Fd)
-        {
-            FdMax = (int16_t)Fd;
-        }
-        if (WriteBuffEnd > WriteBuff)
-        {
-            FD_SET(Fd, &WriteFds);
-        }
-        FD_SET(Fd, &ReadFds);
+        Release( WriteQueue[WriteHead] );
+        WriteHead = ( WriteHead + 1u ) % CONNECTION_WRITE_POSITIONS;
+        WriteCount--;
     }
+    WriteHead = 0u;
+    WriteSent = 0u;
 }
 
-/* HandleSelectFds
- * handle the selected rw files
- * @param ReadFds reference to the read file
- * @param WriteFds reference to the write file
+/* Release
+ * Release a message that has been sent or dropped
+ * @param Message the message, it goes back to the server when no connection holds it
  */
-void Connection::HandleSelectFds( const fd_set &ReadFds, const fd_set &WriteFds )
+void Connection::Release( POSITION_MESSAGE_T* Message )
 {
-    if (!IS_INVALID_SOCKET(Fd))
+    Message->References--;
+    if ( Message->References == 0u )
     {
-        if (FD_ISSET(Fd, const_cast<fd_set *>(&WriteFds)))
-        {
-            PerformWriting();
-        }
-        if (!IS_INVALID_SOCKET(Fd) && FD_ISSET(Fd, const_cast<fd_set *>(&ReadFds)))
+        server.FreePosition( Message );
+    }
+}
+
+/* HandleEvents
+ * Performs the TCP/IP communication the socket is ready for.
+ * The socket is edge triggered, so read until there is nothing left.
+ * @param Events the epoll events
+ */
+void Connection::HandleEvents( uint32_t Events )
+{
+    if ( !IS_INVALID_SOCKET(Fd) && ( Events & EPOLLOUT ) && ( WriteCount > 0u ) )
+    {
+        PerformWriting();
+    }
+    if ( Events & ( EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR ) )
+    {
+        while ( PerformReading() )
         {
-            PerformReading();
         }
     }
 }
-
-    
 /* DataReceived
  * Handle the received data
  * @param BufferPtr reference tot he buffer
@@ -234,7 +266,9 @@ void Connection::DataReceived( const uint8_t* &BufferPtr, const uint8_t *ReadBuf
                                   ((uint32_t)(BufferPtr[17]) <<  8) |
                                   ((uint32_t)(BufferPtr[18]) << 16) |
                                   ((uint32_t)(BufferPtr[19]) << 24) );
+                HalReactor::Lock();
                 server.GotoReceived(RAInt, DecInt);
+                HalReactor::Unlock();
             }
             break;
             
@@ -255,56 +289,26 @@ void Connection::DataReceived( const uint8_t* &BufferPtr, const uint8_t *ReadBuf
 }
 
 /* SendPosition
- * Fill the buffer with the Position data
- * @param RAInt int_32_t version of the Right Acension
- * @param DecInt int32_t version of the declination
- * @param Status status of the server
+ * Queue a message encoded by the server and send what can be sent. When
+ * the client is not keeping up the newest queued message is replaced, so
+ * it gets the latest position once it does.
+ * @param Message the message, a reference is held until it has been sent
  */
-void Connection::SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status )
+void Connection::SendPosition( POSITION_MESSAGE_T* Message )
 {
     if ( !IS_INVALID_SOCKET( Fd ) )
     {
-        if ( ( WriteBuffEnd - WriteBuff + 24 ) < ( (uint16_t)sizeof( WriteBuff ) ))
-        {
-            // length of packet:
-            *WriteBuffEnd++ = 24;
-            *WriteBuffEnd++ = 0;
-            // type of packet:
-            *WriteBuffEnd++ = 0;
-            *WriteBuffEnd++ = 0;
-            // server_micros:
-            //long long int Now = GetNow();
-            int64_t Now = GetNow();
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now; Now>>=8;
-            *WriteBuffEnd++ = Now;
-            // ra:
-            *WriteBuffEnd++ = RAInt; RAInt>>=8;
-            *WriteBuffEnd++ = RAInt; RAInt>>=8;
-            *WriteBuffEnd++ = RAInt; RAInt>>=8;
-            *WriteBuffEnd++ = RAInt;
-            // dec:
-            *WriteBuffEnd++ = DecInt; DecInt>>=8;
-            *WriteBuffEnd++ = DecInt; DecInt>>=8;
-            *WriteBuffEnd++ = DecInt; DecInt>>=8;
-            *WriteBuffEnd++ = DecInt;
-            // Status:
-            *WriteBuffEnd++ = Status; Status>>=8;
-            *WriteBuffEnd++ = Status; Status>>=8;
-            *WriteBuffEnd++ = Status; Status>>=8;
-            *WriteBuffEnd++ = Status;
-        }
-        else
+        /* the first message may be partly sent, the newest is never */
+        if ( WriteCount == CONNECTION_WRITE_POSITIONS )
         {
-			//*log_file << Now() << "Connection::sendPosition: "
-			//                      "communication is too slow, I will ignore this command"
-			//                   << endl;
+            WriteCount--;
+            Release( WriteQueue[( WriteHead + WriteCount ) % CONNECTION_WRITE_POSITIONS] );
         }
+        Message->References++;
+        WriteQueue[( WriteHead + WriteCount ) % CONNECTION_WRITE_POSITIONS] = Message;
+        WriteCount++;
+        /* the socket is edge triggered, it will only report writable again once it has been full */
+        PerformWriting();
     }
 }
 
@@ -28,15 +28,39 @@
 #include "Socket.hpp"
 #include <stdint.h>
 
+#define CONNECTION_POSITION_SIZE   24u /**< bytes in a MessageCurrentPosition */
+#define CONNECTION_WRITE_POSITIONS 8u  /**< positions queued for a client that is not keeping up */
+
+/** A MessageCurrentPosition, encoded once by the server and shared by
+ *  every connection it is queued on. Reactor thread only.
+ */
+typedef struct POSITION_MESSAGE_S
+{
+    uint8_t Data[CONNECTION_POSITION_SIZE];   /**< the encoded message */
+    uint16_t References;                      /**< connections it is queued on */
+    struct POSITION_MESSAGE_S* NextFree;      /**< next on the server's free list, while unused */
+} POSITION_MESSAGE_T;
+
 /** Connection Class
  * TCP/IP connection to a client.
  */
 class Connection : public Socket
 {
     public:
-    /** Constructor
+    /** Constructor, the connection is closed until it is opened
+     * @param server the server the connection belongs to
+     */
+        Connection( Server &server );
+    /** Start using the connection for a new client, it registers with the reactor
+     * @param NewFd the accepted socket
      */
-        Connection( Server &server, SOCKET Fd );
+        void Open( SOCKET NewFd );
+    /** Queues a "MessageCurrentPosition" encoded by the server and sends what it can.
+     * This is a Stellarium telescope control protocol message containing
+     * the current right ascension, declination and status of the telescope mount.
+     * @param Message the message, a reference is held until it has been sent
+     */
+        void SendPosition( POSITION_MESSAGE_T* Message );
     /** A get function for the difference in server times
      * @return int64_t the difference in times
      */
@@ -44,20 +68,23 @@ class Connection : public Socket
      
     protected:
     /** Receives data from a TCP/IP connection and stores it in the read buffer.
+     * @return bool true if data was read and there may be more waiting
      */
-        void PerformReading( void );
-    /** Sends the contents of the write buffer over a TCP/IP connection.
+        bool PerformReading( void );
+    /** Sends the queued messages over a TCP/IP connection, in one write.
      */
         void PerformWriting( void );
-    /** Performs TCP/IP communication and handles new connections.
-     * If a new connection is established, creates a new Connection object
-     * and passes it to the parent Server with Server::addConnection().
-     * @param ReadFds reference
-     * @param WriteFds reference
-     * @param FdMax reference
+    /** Drop the queued messages, releasing them
      */
-        void PrepareSelectFds( fd_set &ReadFds, fd_set &WriteFds, int16_t &FdMax );
-    
+        void ClearWriteQueue( void );
+    /** Release a message that has been sent or dropped
+     * @param Message the message, it goes back to the server when no connection holds it
+     */
+        void Release( POSITION_MESSAGE_T* Message );
+    /** Performs the TCP/IP communication the socket is ready for.
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
     private:
     /** Returns true, as by default Connection implements a TCP/IP connection.
      */
@@ -65,36 +92,34 @@ class Connection : public Socket
     /** Returns false, as by default Connection implements a TCP/IP connection.
      */
         virtual bool IsAsciiConnection( void ){ return false; }
-    /** Handle the selected rw files
-     * @param ReadFds reference to the read file
-     * @param WriteFds reference to the write file
-     */
-        void HandleSelectFds( const fd_set &ReadFds, const fd_set &WriteFds );
+    
+    protected:
     /** Parses the read buffer and handles any messages contained within it.
      * If the data contains a Stellarium telescope control command,
      * dataReceived() calls the appropriate method of Server.
      * For example, "MessageGoto" (type 0) causes a call to Server::gotoReceived().
+     * Protected so the benchmark can parse without a socket.
      * @param BufferPtr reference to the buffer pointer
      * @param ReadBuffEnd pointer to the end of the buffer
      */
         virtual void DataReceived( const uint8_t* &BufferPtr, const uint8_t *ReadBuffEnd );
-    /** Composes a "MessageCurrentPosition" in the write buffer.
-     * This is a Stellarium telescope control protocol message containing
-     * the current right ascension, declination and status of the telescope mount.
-     * @param RAInt uint32_T version of the Right Ascension
-     * @param DecInt int32_t version of the Declination
-     * @param Status int32_t version of the 
-     */
-        void SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status );
-    
-    protected:
+
         uint8_t ReadBuff[120];             /**< Read buffer */
         uint8_t *ReadBuffEnd;              /**< End of read buffer */
-        uint8_t WriteBuff[120];            /**< Write buffer */
-        uint8_t *WriteBuffEnd;             /**< end of write buffer */
+        POSITION_MESSAGE_T* WriteQueue[CONNECTION_WRITE_POSITIONS];  /**< ring of messages to send */
+        uint8_t WriteHead;                 /**< first message to send */
+        uint8_t WriteCount;                /**< messages queued */
+        uint8_t WriteSent;                 /**< bytes of the first message already sent */
     
     private:
         int64_t ServerMinusClientTime;  /** difference in the client and server times */
+        Connection* NextFree;           /**< next on the server's free list, while closed */
+    /** Friend Class Server, to drop the queue of a closed connection
+     */
+        friend class Server;
+    /** Friend Class ConnectionPool, for the free list
+     */
+        template <class T, uint16_t Max> friend class ConnectionPool;
 };
 
 #endif /* CONNECTION_HPP */
@@ -0,0 +1,153 @@
+/**
+ConnectionPool is the fixed slab of connection objects a server answers
+its clients with. The slab is made once, the free ones are on an
+intrusive list linked by their NextFree and the ones in use are kept
+together in an array, so a client connecting and hanging up allocates
+nothing. Reactor thread only.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef CONNECTION_POOL_HPP
+#define CONNECTION_POOL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+#include "Socket.hpp"
+
+/** ConnectionPool
+ * - Class holding a slab of connections, those in use and those free
+ * @param T the connection, made from its Server and with a NextFree, IsClosed() and Open()
+ * @param Max the most connections in the slab
+ */
+template <class T, uint16_t Max>
+class ConnectionPool
+{
+    public:
+    /** Constructor
+     * The slab is empty until Init
+     */
+        ConnectionPool( void )
+        {
+            Slab = NULL;
+            Count = 0u;
+            FreeList = NULL;
+            ActiveCount = 0u;
+        }
+
+    /** Destructor
+     */
+        ~ConnectionPool( void )
+        {
+            for ( uint16_t Index = 0u; Index < Count; Index++ )
+            {
+                Slab[Index].~T();
+            }
+            ::operator delete( Slab );
+        }
+
+    /** Construct the connections in the slab and put them on the free list
+     * @param Owner the server the connections belong to
+     * @param SlabCount connections in the slab, up to Max
+     */
+        void Init( Server& Owner, uint16_t SlabCount )
+        {
+            Count = ( SlabCount < Max ) ? SlabCount : Max;
+            Slab = static_cast<T*>( ::operator new( Count * sizeof( T ) ) );
+            /* in reverse, so the first connection is used first */
+            for ( uint16_t Index = Count; Index > 0u; Index-- )
+            {
+                T* ConnectionPtr = new ( &Slab[Index - 1u] ) T( Owner );
+                ConnectionPtr->NextFree = FreeList;
+                FreeList = ConnectionPtr;
+            }
+        }
+
+    /** Take a free connection and open it for a new client
+     * @param Fd the accepted socket
+     * @return bool false if every connection is in use, the caller closes the socket
+     */
+        bool Open( SOCKET Fd )
+        {
+            bool Result = false;
+            T* ConnectionPtr = FreeList;
+            if ( ConnectionPtr != NULL )
+            {
+                FreeList = ConnectionPtr->NextFree;
+                ConnectionPtr->NextFree = NULL;
+                Active[ActiveCount] = ConnectionPtr;
+                ActiveCount++;
+                /* if it can not be registered it is closed, and freed with the others */
+                ConnectionPtr->Open( Fd );
+                Result = true;
+            }
+            return Result;
+        }
+
+    /** Return the connections which have been closed to the free list.
+     *  Not from a connection's own handler.
+     */
+        void RemoveClosed( void )
+        {
+            uint16_t Index = 0u;
+            while ( Index < ActiveCount )
+            {
+                T* ConnectionPtr = Active[Index];
+                if ( ConnectionPtr->IsClosed() )
+                {
+                    /* the last one takes its place, the order does not matter */
+                    ActiveCount--;
+                    Active[Index] = Active[ActiveCount];
+                    ConnectionPtr->NextFree = FreeList;
+                    FreeList = ConnectionPtr;
+                }
+                else
+                {
+                    Index++;
+                }
+            }
+        }
+
+    /** Get the number of connections in use, closed ones are counted until RemoveClosed
+     */
+        uint16_t GetCount( void ) const
+        {
+            return ActiveCount;
+        }
+
+    /** Get a connection in use
+     * @param Index from 0 to GetCount() - 1
+     */
+        T* Get( uint16_t Index ) const
+        {
+            return Active[Index];
+        }
+
+    private:
+        T* Slab;                /**< the connections, made once */
+        uint16_t Count;         /**< connections in the slab */
+        T* FreeList;            /**< first free connection, linked by NextFree */
+        T* Active[Max];         /**< the connections in use, together */
+        uint16_t ActiveCount;   /**< entries in Active */
+
+    /** no copying */
+        ConnectionPool( const ConnectionPool& );
+        const ConnectionPool &operator=( const ConnectionPool& );
+};
+
+#endif /* CONNECTION_POOL_HPP */
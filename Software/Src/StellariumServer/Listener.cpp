@@ -33,10 +33,62 @@ using namespace std;
 
 /* Listener
  * Constructor
+ * Starts listening and registers with the reactor.
+ * If it can't listen, it causes the program to exit with code 127.
  */
 Listener::Listener( Server &server, int16_t Port ) 
                   : Socket( server, INVALID_SOCKET ),  Port( Port ) 
 {
+    struct sockaddr_in SockAddr;
+    Fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if ( IS_INVALID_SOCKET( Fd ) )
+    {
+        //*log_file << Now()
+        //          << "socket() failed: "
+        //          << STRERROR(ERRNO)
+        //          << endl;
+        exit(127);
+    }
+    
+    int Yes = 1;
+    if (0 != setsockopt(Fd,
+                        SOL_SOCKET,
+                        SO_REUSEADDR,
+                        reinterpret_cast<const char*>(&Yes),
+                        sizeof(int)))
+    {
+        //*log_file << Now()
+        //          << "setsockopt(SO_REUSEADDR) failed: "
+        //          << STRERROR(ERRNO)
+        //          << endl;
+        exit(127);
+    }
+    
+    SockAddr.sin_family = AF_INET;
+    SockAddr.sin_addr.s_addr = INADDR_ANY;
+    SockAddr.sin_port = htons(Port);
+    if (bind(Fd, (struct sockaddr*)(&SockAddr), sizeof(SockAddr)))
+    {
+        //*log_file << Now()
+        //          << "bind(...) failed: "
+        //          << STRERROR(ERRNO)
+        //          << endl;
+        exit(127);
+    }
+
+    if (listen(Fd, 128))
+    {
+        //*log_file << Now()
+        //          << "listen(...) failed: "
+        //          << STRERROR(ERRNO)
+        //          << endl;
+        exit(127);
+    }        
+    if (!HalReactor::Reactor.Add(Fd, EPOLLIN, this))
+    {
+        exit(127);
+    }
+    //*log_file << Now() << "listening on port " << Port << endl;
 }
 
 
@@ -48,91 +100,18 @@ bool Listener::IsClosed( void )
 {
     return false;
 }
-    
-
-/* PrepareSelectFds
- *  Prepares TCP/IP communication and tries to start listening.
- *  If it can't listen, it causes the program to exit with code 127.
- * @param ReadFds reference
- * @param WriteFds reference
- * @param FdMax reference
- */
-void Listener::PrepareSelectFds( fd_set &ReadFds, fd_set &WriteFds, int16_t &FdMax )
-{
-    (void)WriteFds;
-    if ( IS_INVALID_SOCKET( Fd ) )
-    {
-	
-        struct sockaddr_in SockAddr;
-        Fd = socket( AF_INET, SOCK_STREAM, 0 );
-        if ( IS_INVALID_SOCKET( Fd ) )
-        {
-			//*log_file << Now()
-			//          << "socket() failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            exit(127);
-        }
-        
-        int16_t Yes = -1; // all bits set to 1
-        if (0 != setsockopt(Fd,
-                            SOL_SOCKET,
-                            SO_REUSEADDR,
-                            reinterpret_cast<const char*>(&Yes),
-                            sizeof(int)))
-        {
-			//*log_file << Now()
-			//          << "setsockopt(SO_REUSEADDR) failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            exit(127);
-        }
-        
-        SockAddr.sin_family = AF_INET;
-        SockAddr.sin_addr.s_addr = INADDR_ANY;
-        SockAddr.sin_port = htons(Port);
-        if (bind(Fd, (struct sockaddr*)(&SockAddr), sizeof(SockAddr)))
-        {
-			//*log_file << Now()
-			//          << "bind(...) failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            exit(127);
-        }
-
-        if (listen(Fd, 10))
-        {
-			//*log_file << Now()
-			 //         << "listen(...) failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            exit(127);
-        }        
-		//*log_file << Now() << "listening on port " << Port << endl;
-    }
-    else
-    {
-        if (FdMax < (int16_t)Fd)
-            FdMax = (int16_t)Fd;
-        FD_SET(Fd, &ReadFds);
-    }
-}
 
-/* HandleSelectFds
- * Performs TCP/IP communication and handles new connections.
- * If a new connection is established, creates a new Connection object
- * and passes it to the parent Server with Server::addConnection().
- * @param ReadFds reference
- * @param WriteFds reference
- * @param FdMax reference
+/* HandleEvents
+ * Accepts the waiting connections.
+ * For each new connection a free Connection is taken from the
+ * parent Server with Server::OpenConnection(), or it is closed if there is none.
+ * @param Events the epoll events
  */
-void Listener::HandleSelectFds( const fd_set &ReadFds, const fd_set &WriteFds )
+void Listener::HandleEvents( uint32_t Events )
 {
-    (void)WriteFds;
-    if (
-            ( !IS_INVALID_SOCKET(Fd) )
-         && ( FD_ISSET(Fd, const_cast<fd_set *>(&ReadFds)))
-        )
+    (void)Events;
+    /* edge triggered, so accept until there are none left */
+    while ( !IS_INVALID_SOCKET(Fd) )
     {
         struct sockaddr_in ClientAddr;
         SOCKLEN_T Length = sizeof(ClientAddr);
@@ -140,21 +119,22 @@ void Listener::HandleSelectFds( const fd_set &ReadFds, const fd_set &WriteFds )
         
         if (IS_INVALID_SOCKET(ClientSock))
         {
-			//*log_file << Now()
-			//          << "accept(...) failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            close(ClientSock);
+            if ( ERRNO == EINTR || ERRNO == ECONNABORTED )
+            {
+                continue;
+            }
+            //*log_file << Now()
+            //          << "accept(...) failed: "
+            //          << STRERROR(ERRNO)
+            //          << endl;
+            break;
         }
-		//*log_file << Now() << "connection accepted" << endl;
-        if (0 != SETNONBLOCK(ClientSock))
+        //*log_file << Now() << "connection accepted" << endl;
+        /* the connection registers itself with the reactor */
+        if ( !server.OpenConnection( ClientSock ) )
         {
-			//*log_file << Now()
-			//          << "SETNONBLOCK(...) failed: "
-			//          << STRERROR(ERRNO)
-			//          << endl;
-            close(ClientSock);
+            //*log_file << Now() << "too many connections" << endl;
+            close( ClientSock );
         }
-            server.AddConnection(new Connection(server, ClientSock));
     }
 }
@@ -39,6 +39,8 @@ class Listener : public Socket
 {
     public:
     /** Constructor
+     * Starts listening and registers with the reactor.
+     * If it can't listen, it causes the program to exit with code 127.
      * @param server reference to the server
      * @param Port TCP/IP port number
      */
@@ -50,21 +52,12 @@ class Listener : public Socket
      * it causes the program to exit with code 127.
      */
         bool IsClosed( void );
-    /** Prepares TCP/IP communication and tries to start listening.
-     *  If it can't listen, it causes the program to exit with code 127.
-     * @param ReadFds reference
-     * @param WriteFds reference
-     * @param FdMax reference
+    /** Accepts the waiting connections.
+     * For each new connection a free Connection is taken from the
+     * parent Server with Server::OpenConnection(), or it is closed if there is none.
+     * @param Events the epoll events
      */
-        void PrepareSelectFds( fd_set &ReadFds, fd_set &WriteFds, int16_t &FdMax );
-    /** Performs TCP/IP communication and handles new connections.
-     * If a new connection is established, creates a new Connection object
-     * and passes it to the parent Server with Server::addConnection().
-     * @param ReadFds reference
-     * @param WriteFds reference
-     * @param FdMax reference
-     */
-        void HandleSelectFds( const fd_set &ReadFds, const fd_set &WriteFds );
+        void HandleEvents( uint32_t Events );
     
     private:
         const int16_t Port; /** The port */
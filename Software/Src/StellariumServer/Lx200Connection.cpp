@@ -0,0 +1,367 @@
+/*
+Lx200Connection is one TCP/IP connection to a client speaking the Meade
+LX200 protocol, such as SkySafari or an INDI or ASCOM LX200 driver.
+Commands are ":XX...#", they may arrive in pieces or many to a read, and
+are parsed a byte at a time into a fixed buffer. The replies are queued
+in a fixed buffer and sent together.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include <math.h>
+#include <netinet/tcp.h>
+#include "Lx200Connection.hpp"
+#include "Server.hpp"
+#include "TelescopeManager.h"
+#include "LatencyTrace.h"
+#include "FastFormat.h"
+
+#define LX200_ACK 0x06  /**< asks for the alignment mode */
+
+/* Constructor
+ * The connection is closed until it is opened
+ */
+Lx200Connection::Lx200Connection( Server &server ) : Socket( server, INVALID_SOCKET )
+{
+    NextFree = NULL;
+    InputCount = 0u;
+    InputUsed = 0u;
+    OutputCount = 0u;
+    CommandLength = 0u;
+    InCommand = false;
+    CommandTooLong = false;
+    Snapshot = false;
+    RightAscension = 0.0;
+    Declination = 0.0;
+    TargetRightAscension = -1.0;
+    TargetDeclination = -100.0;
+}
+
+/* Open
+ * Start using the connection for a new client, it registers with the reactor
+ * @param NewFd the accepted socket
+ */
+void Lx200Connection::Open( SOCKET NewFd )
+{
+    InputCount = 0u;
+    InputUsed = 0u;
+    OutputCount = 0u;
+    CommandLength = 0u;
+    InCommand = false;
+    CommandTooLong = false;
+    TargetRightAscension = -1.0;
+    TargetDeclination = -100.0;
+    Fd = NewFd;
+    /* the replies are short and a client waits for each, so do not hold them back */
+    int Opt = 1;
+    setsockopt( Fd, IPPROTO_TCP, TCP_NODELAY, (char *)&Opt, sizeof( Opt ) );
+    if ( !HalReactor::Reactor.Add( Fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP, this ) )
+    {
+        HangUp();
+    }
+}
+
+/* HandleEvents
+ * Reads and answers the commands, sends the replies. A client sending
+ * faster than it reads the replies is not read until it catches up.
+ * @param Events the epoll events
+ */
+void Lx200Connection::HandleEvents( uint32_t Events )
+{
+    bool Progress = true;
+    (void)Events;
+    /* the position is read again for each batch of commands */
+    Snapshot = false;
+    while ( Progress && !IS_INVALID_SOCKET( Fd ) )
+    {
+        Progress = ( OutputCount > 0u ) && PerformWriting();
+        Process();
+        if ( !IS_INVALID_SOCKET( Fd ) && ( InputCount < LX200_INPUT_SIZE ) )
+        {
+            const ssize_t Rc = read( Fd, &Input[InputCount], LX200_INPUT_SIZE - InputCount );
+            if ( Rc > 0 )
+            {
+                server.BytesIn.Add( Rc );
+                InputCount += Rc;
+                Progress = true;
+            }
+            else if ( ( Rc == 0 ) || ( ( ERRNO != EINTR ) && ( ERRNO != EAGAIN ) ) )
+            {
+                /* the client has closed the connection */
+                HangUp();
+            }
+            else if ( ERRNO == EINTR )
+            {
+                Progress = true;
+            }
+        }
+    }
+    if ( !IS_INVALID_SOCKET( Fd ) && ( OutputCount > 0u ) )
+    {
+        (void)PerformWriting();
+    }
+}
+
+/* Process
+ * Parse the bytes read, while there is room for the replies
+ */
+void Lx200Connection::Process( void )
+{
+    while ( ( InputUsed < InputCount ) && ( ( LX200_OUTPUT_SIZE - OutputCount ) >= LX200_LONGEST_REPLY ) )
+    {
+        const uint8_t Byte = Input[InputUsed];
+        InputUsed++;
+        if ( !InCommand )
+        {
+            if ( Byte == ':' )
+            {
+                /* the arguments may hold a ':', so only a '#' ends a command */
+                InCommand = true;
+                CommandTooLong = false;
+                CommandLength = 0u;
+            }
+            else if ( Byte == LX200_ACK )
+            {
+                /* the orientation is measured in altitude and azimuth */
+                Reply( "A", 1u );
+            }
+            /* anything else between commands, such as the '#' clients send
+               to clear the line, is ignored */
+        }
+        else if ( Byte == '#' )
+        {
+            InCommand = false;
+            if ( !CommandTooLong )
+            {
+                Command[CommandLength] = '\0';
+                Execute();
+            }
+        }
+        else if ( CommandLength < LX200_COMMAND_SIZE )
+        {
+            Command[CommandLength] = Byte;
+            CommandLength++;
+        }
+        else
+        {
+            CommandTooLong = true;
+        }
+    }
+    if ( InputUsed >= InputCount )
+    {
+        InputCount = 0u;
+        InputUsed = 0u;
+    }
+    else if ( InputUsed > 0u )
+    {
+        memmove( Input, &Input[InputUsed], InputCount - InputUsed );
+        InputCount -= InputUsed;
+        InputUsed = 0u;
+    }
+}
+
+/* Execute
+ * Handle the command in Command. Commands for the motors, the focuser and
+ * the like are not answered, as the LX200 does with commands it does not know.
+ */
+void Lx200Connection::Execute( void )
+{
+    char Text[LX200_LONGEST_REPLY];
+    uint8_t Length = 0u;
+    double Value = 0.0;
+    switch ( Command[0] )
+    {
+        case 'G':
+            if ( Command[1] == 'R' )
+            {
+                TakeSnapshot();
+                Length = FastFormat::Hours( Text, RightAscension * ( 12.0 / M_PI ) );
+                Text[Length++] = '#';
+                Reply( Text, Length );
+            }
+            else if ( Command[1] == 'D' )
+            {
+                TakeSnapshot();
+                Length = FastFormat::Degrees( Text, Declination * ( 180.0 / M_PI ), '*', '\'' );
+                Text[Length++] = '#';
+                Reply( Text, Length );
+            }
+            else if ( ( Command[1] == 'V' ) && ( Command[2] == 'P' ) )
+            {
+                Reply( "StarPi#", 7u );
+            }
+            break;
+
+        case 'S':
+            if ( Command[1] == 'r' )
+            {
+                const bool Valid = ParseAngle( &Command[2], false, &Value ) && ( Value < 24.0 );
+                if ( Valid )
+                {
+                    TargetRightAscension = Value;
+                }
+                Reply( Valid ? "1" : "0", 1u );
+            }
+            else if ( Command[1] == 'd' )
+            {
+                const bool Valid = ParseAngle( &Command[2], true, &Value ) && ( fabs( Value ) <= 90.0 );
+                if ( Valid )
+                {
+                    TargetDeclination = Value;
+                }
+                Reply( Valid ? "1" : "0", 1u );
+            }
+            break;
+
+        case 'M':
+            if ( Command[1] == 'S' )
+            {
+                if ( ( TargetRightAscension >= 0.0 ) && ( TargetDeclination >= -90.0 ) )
+                {
+                    /* in the units of the Stellarium goto message */
+                    const uint32_t RAInt = (uint32_t)( ( TargetRightAscension / 24.0 ) * 4294967296.0 );
+                    const int32_t DecInt = (int32_t)( ( TargetDeclination / 90.0 ) * 1073741824.0 );
+                    HalReactor::Lock();
+                    server.GotoReceived( RAInt, DecInt );
+                    HalReactor::Unlock();
+                    Reply( "0", 1u );
+                }
+                else
+                {
+                    Reply( "2No target#", 11u );
+                }
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+/* Reply
+ * Add a reply to the output, the caller checks there is room
+ */
+void Lx200Connection::Reply( const char* Text, uint16_t Length )
+{
+    memcpy( &Output[OutputCount], Text, Length );
+    OutputCount += Length;
+}
+
+/* PerformWriting
+ * Send as much of the output as the socket will take
+ * @return bool true if anything was sent
+ */
+bool Lx200Connection::PerformWriting( void )
+{
+    const ssize_t Rc = write( Fd, Output, OutputCount );
+    if ( Rc > 0 )
+    {
+        server.BytesOut.Add( Rc );
+        if ( (uint16_t)Rc < OutputCount )
+        {
+            memmove( Output, &Output[Rc], OutputCount - Rc );
+        }
+        OutputCount -= Rc;
+    }
+    else if ( ( Rc < 0 ) && ( ERRNO != EINTR ) && ( ERRNO != EAGAIN ) )
+    {
+        HangUp();
+    }
+    return ( Rc > 0 );
+}
+
+/* TakeSnapshot
+ * Read the position from the TelescopeManager, once for all the
+ * commands handled together
+ */
+void Lx200Connection::TakeSnapshot( void )
+{
+    if ( !Snapshot )
+    {
+        uint32_t TraceId = 0u;
+        /* the telescope manager task may be updating the position */
+        HalReactor::Lock();
+        TelescopeManager::GetRaDec( &RightAscension, &Declination );
+        TraceId = TelescopeManager::GetTraceId();
+        HalReactor::Unlock();
+        LatencyTrace::Mark( TraceId, LATENCY_SENT_LX200 );
+        Snapshot = true;
+    }
+}
+
+/* ParseAngle
+ * Parse "HH:MM:SS", "HH:MM.T", "sDD*MM:SS" or "sDD*MM", the separators
+ * may be any of : * ' or the degree sign
+ * @param Text the text, after the command letters
+ * @param Signed true if there may be a sign
+ * @param Value the angle in hours or degrees
+ * @return bool true if it is valid
+ */
+bool Lx200Connection::ParseAngle( const char* Text, bool Signed, double* Value )
+{
+    uint32_t Fields[3] = { 0u, 0u, 0u };
+    uint8_t Digits[3] = { 0u, 0u, 0u };
+    uint8_t Field = 0u;
+    bool Negative = false;
+    bool Tenths = false;
+    while ( *Text == ' ' )
+    {
+        Text++;
+    }
+    if ( Signed && ( ( *Text == '+' ) || ( *Text == '-' ) ) )
+    {
+        Negative = ( *Text == '-' );
+        Text++;
+    }
+    for ( ; *Text != '\0'; Text++ )
+    {
+        const char Character = *Text;
+        if ( ( Character >= '0' ) && ( Character <= '9' ) )
+        {
+            if ( Digits[Field] >= 3u )
+            {
+                return false;
+            }
+            Fields[Field] = ( Fields[Field] * 10u ) + ( Character - '0' );
+            Digits[Field]++;
+        }
+        else if ( ( Field < 2u ) && ( Digits[Field] > 0u ) && !Tenths
+               && ( ( Character == ':' ) || ( Character == '*' ) || ( Character == '\'' )
+                 || ( Character == (char)0xDF ) || ( ( Character == '.' ) && ( Field == 1u ) ) ) )
+        {
+            Tenths = ( Character == '.' );
+            Field++;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    /* degrees or hours and minutes at least, and whole fields */
+    if ( ( Field == 0u ) || ( Digits[Field] == 0u ) || ( Fields[1] >= 60u ) || ( Fields[2] >= 60u )
+      || ( Tenths && ( Digits[2] != 1u ) ) )
+    {
+        return false;
+    }
+    *Value = Fields[0] + ( Fields[1] / 60.0 ) + ( Tenths ? ( Fields[2] / 600.0 ) : ( Fields[2] / 3600.0 ) );
+    if ( Negative )
+    {
+        *Value = -*Value;
+    }
+    return true;
+}
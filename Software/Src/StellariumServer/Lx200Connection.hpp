@@ -0,0 +1,107 @@
+/*
+Lx200Connection is one TCP/IP connection to a client speaking the Meade
+LX200 protocol, such as SkySafari or an INDI or ASCOM LX200 driver.
+Commands are ":XX...#", they may arrive in pieces or many to a read, and
+are parsed a byte at a time into a fixed buffer. The replies are queued
+in a fixed buffer and sent together.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef LX200_CONNECTION_HPP
+#define LX200_CONNECTION_HPP
+
+#include <stdint.h>
+#include "Socket.hpp"
+
+/* Configuration */
+
+#define LX200_COMMAND_SIZE   32u    /**< longest command between ':' and '#', longer ones are ignored */
+#define LX200_INPUT_SIZE     256u   /**< bytes read at once */
+#define LX200_OUTPUT_SIZE    1024u  /**< replies waiting to be sent */
+#define LX200_LONGEST_REPLY  16u    /**< a command is only handled when there is room for this */
+
+/** Lx200Connection Class
+ * TCP/IP connection to an LX200 client.
+ */
+class Lx200Connection : public Socket
+{
+    public:
+    /** Constructor, the connection is closed until it is opened
+     * @param server the server the connection belongs to
+     */
+        Lx200Connection( Server &server );
+    /** Start using the connection for a new client, it registers with the reactor
+     * @param NewFd the accepted socket
+     */
+        void Open( SOCKET NewFd );
+    /** Reads and answers the commands, sends the replies.
+     * The socket is edge triggered, so read until there is nothing left.
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
+
+        Lx200Connection* NextFree;      /**< next on the server's free list, while closed */
+
+    private:
+    /** Returns true, as Lx200Connection is a TCP/IP connection.
+     */
+        bool IsTcpConnection( void ) const { return true; }
+    /** Parse the bytes read, while there is room for the replies
+     */
+        void Process( void );
+    /** Handle the command in Command
+     */
+        void Execute( void );
+    /** Add a reply to the output, the caller checks there is room
+     */
+        void Reply( const char* Text, uint16_t Length );
+    /** Send as much of the output as the socket will take
+     * @return bool true if anything was sent
+     */
+        bool PerformWriting( void );
+    /** Read the position from the TelescopeManager, once for all the
+     *  commands handled together
+     */
+        void TakeSnapshot( void );
+    /** Parse "HH:MM:SS", "HH:MM.T", "sDD*MM:SS" or "sDD*MM", the separators
+     *  may be any of : * ' or the degree sign
+     * @param Text the text, after the command letters
+     * @param Signed true if there may be a sign
+     * @param Value the angle in hours or degrees
+     * @return bool true if it is valid
+     */
+        static bool ParseAngle( const char* Text, bool Signed, double* Value );
+
+        uint8_t Input[LX200_INPUT_SIZE];    /**< bytes read, from the start */
+        uint16_t InputCount;                /**< bytes in Input */
+        uint16_t InputUsed;                 /**< bytes of Input parsed */
+        char Output[LX200_OUTPUT_SIZE];     /**< replies waiting to be sent, from the start */
+        uint16_t OutputCount;               /**< bytes in Output */
+        char Command[LX200_COMMAND_SIZE + 1u];  /**< the command being received, without the ':' */
+        uint8_t CommandLength;              /**< characters in Command */
+        bool InCommand;                     /**< a ':' has been received */
+        bool CommandTooLong;                /**< the command did not fit, it is ignored */
+        bool Snapshot;                      /**< RightAscension and Declination have been read */
+        double RightAscension;              /**< radians, read with the dispatch lock held */
+        double Declination;                 /**< radians, read with the dispatch lock held */
+        double TargetRightAscension;        /**< hours, set by :Sr */
+        double TargetDeclination;           /**< degrees, set by :Sd */
+};
+
+#endif /* LX200_CONNECTION_HPP */
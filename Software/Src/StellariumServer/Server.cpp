@@ -29,18 +29,21 @@
 /* Server 
  * Constructor
  */
-//Server::Server( void )
-//{
-//}
+Server::Server( void )
+{
+    ListenerPtr = NULL;
+    InitConnections( SERVER_MAX_CONNECTIONS );
+}
 
 /* Server
  * Constructor
  * @param Port 
+ * @param MaxConnections Connection objects in the slab, up to SERVER_MAX_CONNECTIONS
  */
-Server::Server( int16_t Port )
+Server::Server( int16_t Port, uint16_t MaxConnections )
 {
-    Socket* ListenerPtr = new Listener( *this, Port );
-    ListOfSockets.push_back( ListenerPtr );
+    InitConnections( ( MaxConnections < SERVER_MAX_CONNECTIONS ) ? MaxConnections : SERVER_MAX_CONNECTIONS );
+    ListenerPtr = new Listener( *this, Port );
 }
 
 /* ~Server
@@ -48,125 +51,172 @@ Server::Server( int16_t Port )
  */     
 Server::~Server( void )
 {
+    delete ListenerPtr;
+    delete[] Positions;
 }
 
-/* Step
- * main run function
- * @param TimeoutMicros
+/* InitConnections
+ * Construct the connections in the slab and put them and the messages on the free lists
+ * @param Count Connection objects in the slab
  */
-void Server::Step( int64_t TimeoutMicros )
+void Server::InitConnections( uint16_t Count )
 {
-	fd_set ReadFds, WriteFds;
-    FD_ZERO(&ReadFds);
-    FD_ZERO(&WriteFds);
-    int16_t FdMax = -1;
-    
-    for (
-         SocketList::const_iterator It( ListOfSockets.begin() );
-         It != ListOfSockets.end();
-         It++ 
-         )
+    /* enough messages for every connection to have a full queue of different ones, and one being encoded */
+    const uint32_t PositionCount = ( Count * CONNECTION_WRITE_POSITIONS ) + 1u;
+    Connections.Init( *this, Count );
+    Positions = new POSITION_MESSAGE_T[PositionCount];
+    FreePositions = NULL;
+    for ( uint32_t Index = 0u; Index < PositionCount; Index++ )
     {
-        (*It)->PrepareSelectFds( ReadFds, WriteFds, FdMax);
+        Positions[Index].References = 0u;
+        FreePosition( &Positions[Index] );
     }
-    
-    struct timeval Tv;
-    if (TimeoutMicros < 0)
-    {
-        TimeoutMicros = 0;
-    }
-    Tv.tv_sec = TimeoutMicros / 1000000;
-    Tv.tv_usec = TimeoutMicros % 1000000;
-    const int16_t SelectRc = select( FdMax+1, &ReadFds, &WriteFds, 0, &Tv );
-    if (SelectRc > 0)
+}
+
+/* FreePosition
+ * Return a message no connection holds to the free list, called by Connection
+ * @param Message the message
+ */
+void Server::FreePosition( POSITION_MESSAGE_T* Message )
+{
+    Message->NextFree = FreePositions;
+    FreePositions = Message;
+}
+
+/* RemoveClosedConnections
+ * Return the connections which have been closed to the free list. Must
+ * be called on the reactor thread, and not from a connection's own handler.
+ */
+void Server::RemoveClosedConnections( void )
+{
+    /* the messages a closed connection still holds go back first */
+    for ( uint16_t Index = 0u; Index < Connections.GetCount(); Index++ )
     {
-        SocketList::iterator It( ListOfSockets.begin() );
-        while ( It != ListOfSockets.end() )
+        Connection* ConnectionPtr = Connections.Get( Index );
+        if ( ConnectionPtr->IsClosed() )
         {
-            (*It)->HandleSelectFds( ReadFds, WriteFds );
-            if ( (*It)->IsClosed() )
-            {
-                SocketList::iterator Tmp( It );
-                It++;
-                delete ( *Tmp );
-                ListOfSockets.erase( Tmp );
-            }
-            else
-            {
-                It++;
-            }
+            ConnectionPtr->ClearWriteQueue();
         }
     }
+    Connections.RemoveClosed();
 }
 
 /* SendPosition
- * Send the current position of the telescope to the client
+ * Encode the current position of the telescope once and send it to every client
  * @param RAInt uint32_t format of the Right Ascension
  * @param DecInt uint32_t format of the Declination
  * @param Status uint32_t system status
+ * @param Time when the position was measured, microseconds since 1970
  */
-void Server::SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status )
+void Server::SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status, int64_t Time )
 {
-    for ( 
-         SocketList::const_iterator It( ListOfSockets.begin() );
-         It != ListOfSockets.end();
-         It++
-         )
+    POSITION_MESSAGE_T* Message = FreePositions;
+    if ( ( Connections.GetCount() == 0u ) || ( Message == NULL ) )
+    {
+        /* nobody to send to, there is always a free message otherwise */
+        return;
+    }
+    SendLatency.Observe( GetNow() - Time );
+    FreePositions = Message->NextFree;
+    Message->NextFree = NULL;
+    Message->References = 0u;
+    uint8_t* Data = Message->Data;
+    // length of packet:
+    *Data++ = CONNECTION_POSITION_SIZE;
+    *Data++ = 0;
+    // type of packet:
+    *Data++ = 0;
+    *Data++ = 0;
+    // server_micros:
+    for ( uint8_t Byte = 0u; Byte < 8u; Byte++ )
+    {
+        *Data++ = (uint8_t)( (uint64_t)Time >> ( 8u * Byte ) );
+    }
+    // ra, dec and status:
+    for ( uint8_t Byte = 0u; Byte < 4u; Byte++ )
+    {
+        *Data++ = (uint8_t)( RAInt >> ( 8u * Byte ) );
+    }
+    for ( uint8_t Byte = 0u; Byte < 4u; Byte++ )
+    {
+        *Data++ = (uint8_t)( (uint32_t)DecInt >> ( 8u * Byte ) );
+    }
+    for ( uint8_t Byte = 0u; Byte < 4u; Byte++ )
+    {
+        *Data++ = (uint8_t)( (uint32_t)Status >> ( 8u * Byte ) );
+    }
+    /* each connection holds a reference while it is queued */
+    Message->References++;
+    for ( uint16_t Index = 0u; Index < Connections.GetCount(); Index++ )
+    {
+        Connections.Get( Index )->SendPosition( Message );
+    }
+    Message->References--;
+    if ( Message->References == 0u )
     {
-        (*It)->SendPosition( RAInt, DecInt, Status );
+        FreePosition( Message );
     }
 }
 
-/* AddConnection
- * Adds this object to the list of connections maintained by this server.
+/* OpenConnection
+ * Takes a Connection from the free list for a new client.
  * This method is called by Listener.
- * @param SocketPtr can be anything that inherits Socket, including Listener,
- * Connection or any custom class that implements a serial port
- * connection (such as Lx200Connection and NexStarConnection).
+ * @param Fd the accepted socket
+ * @return bool false if every Connection is in use, the caller closes the socket
  */
-void Server::AddConnection( Socket* SocketPtr )
+bool Server::OpenConnection( SOCKET Fd )
 {
-    if ( SocketPtr )
-    {
-        ListOfSockets.push_back( SocketPtr );
-    }
+    return Connections.Open( Fd );
 }
 
-
 /* CloseAcceptedConnections
- * Close all connections in list
+ * Close all connections in use
  */
 void Server::CloseAcceptedConnections( void )
 {
-    for (
-         SocketList::iterator It( ListOfSockets.begin() );
-         It != ListOfSockets.end();
-         It++
-         )
+    for ( uint16_t Index = 0u; Index < Connections.GetCount(); Index++ )
     {
-        if ( (*It)->IsTcpConnection() )
-        {
-            (*It)->HangUp();
-        }
+        Connections.Get( Index )->HangUp();
     }
 }
 
-/*  ~SocketList
- * Destructor
+/* GetNumberOfConnections
+ * Get the number of connections in use
+ */
+uint16_t Server::GetNumberOfConnections( void )
+{
+    return Connections.GetCount();
+}
+
+/* GetNumberOfClients
+ * Get the number of clients connected, for the metrics
  */
-Server::SocketList::~SocketList ( void )
+uint16_t Server::GetNumberOfClients( void )
 {
-    Clear();
+    return GetNumberOfConnections();
 }
 
-/* Clear
- * Empty the list
+/* RegisterMetrics
+ * Register the server's metrics, called once it is listening. Only a
+ * server that pushes the position has a send latency.
  */
-void Server::SocketList::Clear( void )
+void Server::RegisterMetrics( const char* Labels, bool Pushed )
 {
-    for (const_iterator It(begin()); It != end(); It++)
+    (void)Metrics::RegisterSampled( "starpi_clients", Labels, "Clients connected to each server",
+                                    METRIC_GAUGE, &Server::SampleClients, this );
+    (void)Metrics::Register( "starpi_received_bytes_total", Labels, "Bytes received by each server", &BytesIn );
+    (void)Metrics::Register( "starpi_sent_bytes_total", Labels, "Bytes sent by each server", &BytesOut );
+    if ( Pushed )
     {
-        delete (*It);
+        (void)Metrics::Register( "starpi_sample_to_send_seconds", Labels,
+                                 "Time from the position being measured to it being queued for the clients", &SendLatency );
     }
-    list<Socket*>::clear();
+}
+
+/* SampleClients
+ * Get the number of clients connected for Metrics, they are served on the reactor thread
+ */
+double Server::SampleClients( void* Context )
+{
+    return static_cast<Server*>( Context )->GetNumberOfClients();
 }
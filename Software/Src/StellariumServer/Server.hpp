@@ -26,24 +26,27 @@
 #define SERVER_HPP
 
 #include <stdint.h>
-#include <list>
-using namespace std;
+#include "Connection.hpp"
+#include "ConnectionPool.hpp"
+#include "Metrics.h"
 
-class Socket;
+/* Configuration */
+
+#define SERVER_MAX_CONNECTIONS 256u /**< Stellarium clients connected at once, the slab is made at start up */
 
 /** Server Class 
  * Base class for telescope server classes. A true telescope server class
  * should inherit Server and implement device-specific functions.
- * The class makes heavy use of polymorphism to perform all its work
- * by maintaining a list of connections in the form of Socket pointers.
- * The list actually contains objects of classes that inherit Socket, including
- * one Listener object, created in the constructor, and one or more
- * Connection objects, each representing a TCP/IP connection to a client.
- * Classes that inherit Server (such as ServerLx200) also have a special
- * device-specific connection object (such as Lx200Connection) that represents
- * a serial connection to the device. The step() method calls
- * Socket::prepareSelectFds() and Socket::handleSelectFds() for each connection
- * in the list. These methods are reimplemented for each class.
+ * The server has one Listener, created in the constructor, and a slab of
+ * up to SERVER_MAX_CONNECTIONS Connection objects in a ConnectionPool, each
+ * representing a TCP/IP connection to a client when it is in use, so
+ * a client connecting and hanging up allocates nothing. Each position is
+ * encoded once into a reference counted message that every connection
+ * queues, from a free list with room for every queue to be full. A server
+ * speaking another protocol has no Connections and reimplements
+ * OpenConnection() for its own. Every socket
+ * registers itself with HalReactor::Reactor, which calls
+ * Socket::HandleEvents() on the reactor thread when it is ready.
  */
 class Server
 {
@@ -51,42 +54,55 @@ class Server
     /** Server 
      * Constructor
      */
-        Server( void ) {}
+        Server( void );
     /** Server
      * Constructor
      * @param Port 
+     * @param MaxConnections Connection objects in the slab, up to SERVER_MAX_CONNECTIONS
      */
-        Server( int16_t Port );
+        Server( int16_t Port, uint16_t MaxConnections = SERVER_MAX_CONNECTIONS );
     /** ~Server
      * Destructor
      */     
         virtual ~Server( void );
-    /** Step
-     * main run function
-     * @param TimeoutMicros
-     */
-        virtual void Step( int64_t TimeoutMicros );
 
     protected:
     /** SendPosition
-     * Send the current position of the telescope to the client
+     * Encode the current position of the telescope once and send it to every client
      * @param RAInt uint32_t format of the Right Ascension
      * @param DecInt uint32_t format of the Declination
      * @param Status uint32_t system status
+     * @param Time when the position was measured, microseconds since 1970
      */
-        void SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status );
-    /** AddConnection
-     * Adds this object to the list of connections maintained by this server.
+        void SendPosition( uint32_t RAInt, int32_t DecInt, int32_t Status, int64_t Time );
+    /** OpenConnection
+     * Takes a Connection from the free list for a new client.
      * This method is called by Listener.
-     * @param SocketPtr can be anything that inherits Socket, including Listener,
-     * Connection or any custom class that implements a serial port
-     * connection (such as Lx200Connection and NexStarConnection).
+     * @param Fd the accepted socket
+     * @return bool false if every Connection is in use, the caller closes the socket
      */
-        void AddConnection( Socket *SocketPtr );
+        virtual bool OpenConnection( SOCKET Fd );
     /** CloseAcceptedConnections
-     * Close all connections in list
+     * Close all connections in use
      */
         void CloseAcceptedConnections( void );
+    /** RemoveClosedConnections
+     * Return the connections which have been closed to the free list. Must
+     * be called on the reactor thread, and not from a connection's own handler.
+     */
+        void RemoveClosedConnections( void );
+    /** Get the number of connections in use, closed ones are counted until
+     *  RemoveClosedConnections
+     */
+        uint16_t GetNumberOfConnections( void );
+    /** Get the number of clients connected, for the metrics, reactor thread only
+     */
+        virtual uint16_t GetNumberOfClients( void );
+    /** Register the server's metrics, called once it is listening
+     * @param Labels e.g. "server=\"stellarium\"", it must stay for as long as the metrics are served
+     * @param Pushed true if the server pushes the position with SendPosition, which times it
+     */
+        void RegisterMetrics( const char* Labels, bool Pushed );
     /** Friend Class Listener
      */
         friend class Listener;
@@ -98,26 +114,36 @@ class Server
      * @param DecInt uint32_t format of the Declination
      */
         virtual void GotoReceived( uint32_t RAInt, int32_t DecInt ) = 0;
+    /** Construct the connections in the slab and put them and the messages on the free lists
+     * @param Count Connection objects in the slab
+     */
+        void InitConnections( uint16_t Count );
+    /** Return a message no connection holds to the free list, called by Connection
+     * @param Message the message
+     */
+        void FreePosition( POSITION_MESSAGE_T* Message );
+    /** Get the number of clients connected for Metrics
+     * @param Context the Server
+     */
+        static double SampleClients( void* Context );
     /** Friend Class Connection
      */
         friend class Connection;
-    /** Class SocketList
-     * Class to handle the list of Connections
-     */
-        class SocketList : public list<Socket*>
-        {
-            public:
-                /**  ~SocketList
-                 * Destructor
-                 */
-                ~SocketList( void );
-                /** Clear
-                 * Empty the list
-                 */
-                void Clear( void );
-        };
-        
-    SocketList ListOfSockets; /** A list of the connections maintained by the server. */
+    /** Friend Class Lx200Connection, for GotoReceived
+     */
+        friend class Lx200Connection;
+
+        Socket* ListenerPtr;                            /**< accepts the clients, NULL if not listening */
+        ConnectionPool<Connection, SERVER_MAX_CONNECTIONS> Connections; /**< the slab, made once */
+        POSITION_MESSAGE_T* Positions;                  /**< the messages, made once */
+        POSITION_MESSAGE_T* FreePositions;              /**< first free message, linked by NextFree */
+        MetricCounter BytesIn;                          /**< received from all the clients, counted by the connections */
+        MetricCounter BytesOut;                         /**< sent to all the clients, counted by the connections */
+        MetricHistogram SendLatency;                    /**< from the position being measured to it being sent */
+
+    /** no copying */
+        Server( const Server& );
+        const Server &operator=( const Server& );
 };
 
 #endif /* SERVER_HPP */
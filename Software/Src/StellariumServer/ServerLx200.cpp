@@ -0,0 +1,84 @@
+/*
+ServerLx200 answers clients speaking the Meade LX200 protocol over TCP/IP,
+such as SkySafari or an INDI or ASCOM LX200 driver, with the position
+from the TelescopeManager. The connections are a fixed slab of
+Lx200Connection objects like the Stellarium ones, so a client polling
+and reconnecting allocates nothing.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <math.h>
+
+#include "ServerLx200.h"
+#include "TelescopeManager.h"
+
+/* Constructor
+ * Starts listening, the Stellarium Connection slab is not used
+ * @param Port TCP/IP port number
+ */
+ServerLx200::ServerLx200( int16_t Port )
+            :Server( Port, 0u )
+{
+    Clients.Init( *this, SERVER_LX200_MAX_CONNECTIONS );
+    /* the clients poll, nothing is pushed */
+    RegisterMetrics( "server=\"lx200\"", false );
+}
+
+/* Destructor
+ * The pool destroys the connections
+ */
+ServerLx200::~ServerLx200( void )
+{
+}
+
+/* OpenConnection
+ * Takes a free Lx200Connection for a new client, the closed ones are
+ * freed first. Nothing is deleted, so this is safe from the Listener.
+ * @param Fd the accepted socket
+ * @return bool false if every connection is in use
+ */
+bool ServerLx200::OpenConnection( SOCKET Fd )
+{
+    Clients.RemoveClosed();
+    return Clients.Open( Fd );
+}
+
+/* GetNumberOfClients
+ * Get the number of clients connected, reactor thread only
+ */
+uint16_t ServerLx200::GetNumberOfClients( void )
+{
+    uint16_t Count = 0u;
+    for ( uint16_t Index = 0u; Index < Clients.GetCount(); Index++ )
+    {
+        Count += Clients.Get( Index )->IsClosed() ? 0u : 1u;
+    }
+    return Count;
+}
+
+/* GotoReceived
+ * handler for the :MS# goto command, the dispatch lock is held
+ * @param RAInt right ascension, 0x100000000 is 24h
+ * @param DecInt declination, 0x40000000 is 90 degrees
+ */
+void ServerLx200::GotoReceived( uint32_t RAInt, int32_t DecInt )
+{
+    const double Ra = RAInt * ( M_PI / (uint32_t)0x80000000 );
+    const double Dec = DecInt * ( M_PI / (uint32_t)0x80000000 );
+    TelescopeManager::SetGotoTarget( Ra, Dec );
+}
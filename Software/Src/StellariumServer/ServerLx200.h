@@ -0,0 +1,71 @@
+/*
+ServerLx200 answers clients speaking the Meade LX200 protocol over TCP/IP,
+such as SkySafari or an INDI or ASCOM LX200 driver, with the position
+from the TelescopeManager. The connections are a fixed slab of
+Lx200Connection objects like the Stellarium ones, so a client polling
+and reconnecting allocates nothing.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef SERVER_LX200_H
+#define SERVER_LX200_H
+
+#include "Server.hpp"
+#include "Lx200Connection.hpp"
+#include "ConnectionPool.hpp"
+
+/* Configuration */
+
+#define SERVER_LX200_PORT            4030   /**< the port SkySafari uses by default */
+#define SERVER_LX200_MAX_CONNECTIONS 32u    /**< LX200 clients connected at once */
+
+/** Class LX200 server.
+ * Accepts LX200 clients, each is answered on the reactor thread.
+ */
+class ServerLx200 : public Server
+{
+    public:
+    /** Constructor, starts listening
+     * @param Port TCP/IP port number
+     */
+        ServerLx200( int16_t Port );
+    /** Destructor
+     */
+        ~ServerLx200( void );
+    /** Get the number of clients connected, reactor thread only
+     */
+        uint16_t GetNumberOfClients( void );
+
+    private:
+    /** Takes a free Lx200Connection for a new client, the closed ones are
+     *  freed first. Called by Listener.
+     * @param Fd the accepted socket
+     * @return bool false if every connection is in use
+     */
+        bool OpenConnection( SOCKET Fd );
+    /** handler for the :MS# goto command
+     * @param RAInt right ascension, 0x100000000 is 24h
+     * @param DecInt declination, 0x40000000 is 90 degrees
+     */
+        void GotoReceived( uint32_t RAInt, int32_t DecInt );
+
+        ConnectionPool<Lx200Connection, SERVER_LX200_MAX_CONNECTIONS> Clients; /**< the slab, made once */
+};
+
+#endif /* SERVER_LX200_H */
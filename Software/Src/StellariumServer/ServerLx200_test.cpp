@@ -0,0 +1,241 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "HalReactor.h"
+#include "ServerLx200.h"
+#include "Metrics.h"
+#include "TelescopeManager.h"
+/*
+ ServerLx200 test
+ An LX200 client checks the position replies, pipelined and fragmented
+ commands, the goto commands and bad commands, against a TelescopeManager
+ that returns a fixed position. Then several clients poll :GR#:GD# as fast
+ as they can. Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/StellariumServer -I./Src/TelescopeManager \
+     -I./Src/Scheduler -I./Src/Utils \
+     Src/StellariumServer/ServerLx200_test.cpp Src/StellariumServer/ServerLx200.cpp \
+     Src/StellariumServer/Lx200Connection.cpp Src/StellariumServer/Server.cpp \
+     Src/StellariumServer/Listener.cpp Src/StellariumServer/Connection.cpp \
+     Src/StellariumServer/Socket.cpp Src/Hal/HalReactor.cpp Src/Utils/FastFormat.cpp \
+     Src/Utils/Metrics.cpp Src/Utils/LatencyTrace.cpp -lpthread -latomic -o ServerLx200_test
+ ./ServerLx200_test
+ */
+
+#define TEST_PORT          19996
+#define TEST_CLIENTS       8
+#define TEST_TIMEOUT_MS    2000
+#define TEST_SECONDS       2.0
+#define TEST_PIPELINE      50     /**< :GR#:GD# pairs in each write */
+
+static int failures = 0;
+static double targetRa = 0.0;
+static double targetDec = 0.0;
+
+/* the position is 12h30m00s +45*30'15", the goto target is recorded */
+void TelescopeManager::GetRaDec(double* Ra, double* Dec)
+{
+    *Ra = 12.5 * (M_PI / 12.0);
+    *Dec = (45.0 + (30.0 / 60.0) + (15.0 / 3600.0)) * (M_PI / 180.0);
+}
+
+uint32_t TelescopeManager::GetTraceId(void)
+{
+    return 0u;
+}
+
+void TelescopeManager::SetGotoTarget(double Ra, double Dec)
+{
+    targetRa = Ra;
+    targetDec = Dec;
+}
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* read exactly length bytes, false on timeout or error */
+static bool readAll(int fd, char* data, size_t length)
+{
+    size_t got = 0;
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    while (got < length)
+    {
+        if (poll(&pfd, 1, TEST_TIMEOUT_MS) != 1)
+        {
+            return false;
+        }
+        const ssize_t rc = read(fd, data + got, length - got);
+        if (rc <= 0)
+        {
+            return false;
+        }
+        got += rc;
+    }
+    data[got] = '\0';
+    return true;
+}
+
+/* send the commands and check the replies */
+static bool exchange(int fd, const char* commands, const char* expected)
+{
+    char reply[256];
+    return (write(fd, commands, strlen(commands)) == (ssize_t)strlen(commands))
+           && readAll(fd, reply, strlen(expected)) && (strcmp(reply, expected) == 0);
+}
+
+int main()
+{
+    static const char position[] = "12:30:00#+45*30'15#";
+    char reply[256];
+    int fd = -1;
+    int i = 0;
+
+    if (!HalReactor::Reactor.Init())
+    {
+        fprintf(stderr, "FAIL: the reactor did not start\n");
+        return 1;
+    }
+    ServerLx200 server(TEST_PORT);
+    if (!HalReactor::Reactor.Start())
+    {
+        fprintf(stderr, "FAIL: the reactor did not start\n");
+        return 1;
+    }
+
+    {
+        static char metrics[16384];
+        check((Metrics::Render(metrics, sizeof(metrics)) > 0u) && (strstr(metrics, "starpi_clients{server=\"lx200\"}") != NULL)
+              && (strstr(metrics, "starpi_sample_to_send_seconds") == NULL), "no send latency for a server that is polled");
+    }
+
+    fd = connectTo(TEST_PORT);
+    check(exchange(fd, "\x06", "A"), "ACK is answered with the alignment mode");
+    check(exchange(fd, ":GR#:GD#", position), "pipelined position commands");
+    check(exchange(fd, "#:GVP#", "StarPi#"), "product name after a clearing #");
+    {
+        static const char command[] = ":GD#";
+        bool ok = true;
+        for (i = 0; command[i] != '\0'; i++)
+        {
+            ok = ok && (write(fd, &command[i], 1) == 1);
+            usleep(1000);
+        }
+        check(ok && readAll(fd, reply, 10) && (strcmp(reply, "+45*30'15#") == 0), "command in single bytes");
+    }
+    check(exchange(fd, ":Sr 06:45:09#:Sd -16*42:58#:MS#", "110"), "goto is accepted");
+    usleep(10000);
+    HalReactor::Lock();
+    check((fabs(targetRa - ((6.0 + (45.0 / 60.0) + (9.0 / 3600.0)) * (M_PI / 12.0))) < 1.0e-6)
+          && (fabs(targetDec + ((16.0 + (42.0 / 60.0) + (58.0 / 3600.0)) * (M_PI / 180.0))) < 1.0e-6),
+          "goto target reaches the telescope manager");
+    HalReactor::Unlock();
+    check(exchange(fd, ":Sr 12:34.5#:Sd+45*30#", "11"), "low precision targets");
+    check(exchange(fd, ":Sr 24:00:00#:Sr 12:60:00#:Sd +91*00:00#:Sdx#", "0000"), "bad targets are refused");
+    check(exchange(fd, ":Q#:RS#:Me#:GR#", "12:30:00#"), "motor commands are not answered");
+    memset(reply, 'G', 100);
+    reply[0] = ':';
+    strcpy(&reply[100], "#:GR#");
+    check(exchange(fd, reply, "12:30:00#"), "command too long is ignored");
+    close(fd);
+
+    /* high rate polling */
+    {
+        static int clients[TEST_CLIENTS];
+        char request[TEST_PIPELINE * 8 + 1] = "";
+        char expected[TEST_PIPELINE * (sizeof(position) - 1) + 1] = "";
+        uint32_t queries = 0;
+        int errors = 0;
+        for (i = 0; i < TEST_PIPELINE; i++)
+        {
+            strcat(request, ":GR#:GD#");
+            strcat(expected, position);
+        }
+        for (i = 0; i < TEST_CLIENTS; i++)
+        {
+            clients[i] = connectTo(TEST_PORT);
+        }
+        const double start = seconds();
+        while ((seconds() - start) < TEST_SECONDS)
+        {
+            for (i = 0; i < TEST_CLIENTS; i++)
+            {
+                errors += (write(clients[i], request, strlen(request)) == (ssize_t)strlen(request)) ? 0 : 1;
+            }
+            for (i = 0; i < TEST_CLIENTS; i++)
+            {
+                static char answer[sizeof(expected)];
+                errors += (readAll(clients[i], answer, strlen(expected)) && (strcmp(answer, expected) == 0)) ? 0 : 1;
+            }
+            queries += TEST_CLIENTS * TEST_PIPELINE * 2;
+        }
+        const double elapsed = seconds() - start;
+        check(errors == 0, "every polled query is answered");
+        fprintf(stderr, "LX200: %d clients, %.0f queries/s\n", TEST_CLIENTS, queries / elapsed);
+        for (i = 0; i < TEST_CLIENTS; i++)
+        {
+            close(clients[i]);
+        }
+    }
+
+    /* every connection is used again once it is closed */
+    {
+        int errors = 0;
+        for (i = 0; i < (int)(SERVER_LX200_MAX_CONNECTIONS * 2); i++)
+        {
+            fd = connectTo(TEST_PORT);
+            errors += exchange(fd, ":GR#", "12:30:00#") ? 0 : 1;
+            close(fd);
+            usleep(1000);
+        }
+        check(errors == 0, "closed connections are used again");
+    }
+
+    HalReactor::Reactor.Stop();
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -30,34 +30,51 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "ServerPi.h"
 #include "Socket.hpp" // GetNow
 #include "TelescopeManager.h"
+#include "LatencyTrace.h"
 #include "Config.h"
-
-#ifdef TIMING
-#include "GPIO.h"
-#endif
+#include "Trace.h"
 
 /* Constructor
 */
 ServerPi::ServerPi(int Port)
             :Server(Port)
 {
-#if 0
-    current_pos[0] = desired_pos[0] = 1.0;
-    current_pos[1] = desired_pos[1] = 0.0;
-    current_pos[2] = desired_pos[2] = 0.0;
-#endif
+    TimerFd = -1;
+    Period = SERVER_PI_POSITION_PERIOD;
+    Threshold = 0.0;
+    RightAscension = 0.0;
+    Declination = 0.0;
+    SentRightAscension = 0.0;
+    SentDeclination = 0.0;
+    SentTime = 0;
+}
 
-    next_pos_time = -0x8000000000000000LL;
+/* Init
+ * Start sending the position
+ * @param Period longest time between position messages, microseconds
+ * @param Threshold a move further than this is sent at once, radians, 0 for none
+*/
+bool ServerPi::Init( uint32_t Period, double Threshold )
+{
+    this->Period = Period;
+    this->Threshold = Threshold;
+    if ( TimerFd < 0 )
+    {
+        /* with a threshold look for a change as often as the position is calculated */
+        const uint32_t TimerPeriod = ( ( Threshold > 0.0 ) && ( Period > SERVER_PI_CHANGE_PERIOD ) ) ? SERVER_PI_CHANGE_PERIOD : Period;
+        TimerFd = HalReactor::Reactor.AddTimer( TimerPeriod, this );
+        RegisterMetrics( "server=\"stellarium\"", true );
+    }
+    return ( TimerFd >= 0 );
 }
 
 /*
 server->client:
 MessageCurrentPosition (type = 0):
-
 LENGTH (2 bytes,integer): length of the message
 TYPE   (2 bytes,integer): 0
 TIME   (8 bytes,integer): current time on the server computer in microseconds
-           since 1970.01.01 UT. Currently unused.
+           since 1970.01.01 UT. Sent as the time the position was measured.
 RA     (4 bytes,unsigned integer): right ascension of the telescope (J2000)
            a value of 0x100000000 = 0x0 means 24h=0h,
            a value of 0x80000000 means 12h
@@ -68,99 +85,72 @@ DEC    (4 bytes,signed integer): declination of the telescope (J2000)
 STATUS (4 bytes,signed integer): status of the telescope, currently unused.
            status=0 means ok, status<0 means some error
 */
-void ServerPi::Step(int64_t TimeoutMicros)
+void ServerPi::HandleEvents( uint32_t Events )
 {
-#if 0
-    int64_t now = GetNow();
-    if (now >= next_pos_time)
+    uint64_t Expirations;
+    (void)Events;
+    TRACE_BEGIN( TRACE_SERVER_PI, 0u );
+    if ( read( TimerFd, &Expirations, sizeof( Expirations ) ) == (ssize_t)sizeof( Expirations ) )
     {
-        next_pos_time = now + 500000;
-        current_pos[0] = 3*current_pos[0] + desired_pos[0];
-        current_pos[1] = 3*current_pos[1] + desired_pos[1];
-        current_pos[2] = 3*current_pos[2] + desired_pos[2];
-        double h = current_pos[0]*current_pos[0]
-                 + current_pos[1]*current_pos[1]
-                + current_pos[2]*current_pos[2];
-        if (h > 0.0)
+        int64_t SampleTime = 0;
+        uint32_t TraceId = 0u;
+        const int64_t Now = GetNow();
+        /* the telescope manager task may be updating the position */
+        HalReactor::Lock();
+        TelescopeManager::GetRaDec( &RightAscension, &Declination );
+        SampleTime = TelescopeManager::GetSampleTime();
+        TraceId = TelescopeManager::GetTraceId();
+        HalReactor::Unlock();
+        if ( SampleTime == 0 )
         {
-            h = 1.0 / sqrt(h);
-            current_pos[0] *= h;
-            current_pos[1] *= h;
-            current_pos[2] *= h;
+            /* not calculated yet */
+            SampleTime = Now;
         }
-        else
+        /* without a threshold the timer is the period, otherwise send when the
+           period is up (allowing for the timer jitter) or it has moved further */
+        if ( ( Threshold <= 0.0 )
+          || ( ( Now - SentTime ) >= ( (int64_t)Period - ( SERVER_PI_CHANGE_PERIOD / 2 ) ) )
+          || HasMoved() )
         {
-            current_pos[0] = desired_pos[0];
-            current_pos[1] = desired_pos[1];
-            current_pos[2] = desired_pos[2];
-        }
-        
-        const double ra = atan2(current_pos[1],current_pos[0]);
-        const double dec = atan2(current_pos[2],
-                                 sqrt(current_pos[0]*current_pos[0]+current_pos[1]*current_pos[1]));
-        const uint32_t ra_int = (uint32_t)floor(
-                                       0.5 +  ra*(((uint32_t)0x80000000)/M_PI));
-        const int32_t dec_int = (int32_t)floor(0.5 + dec*(((uint32_t)0x80000000)/M_PI));
-        const int32_t status = 0;
-        SendPosition(ra_int,dec_int,status);
-    }
-    
-    Server::Step(TimeoutMicros);
-#endif
-    int64_t now = GetNow();
-    if (now >= next_pos_time)
-    {
-        next_pos_time = now + 500000;
-        /*
-            convert to integer format to send to stellarium
-            server->client:
-            MessageCurrentPosition (type = 0):
-
-            LENGTH (2 bytes,integer): length of the message
-            TYPE   (2 bytes,integer): 0
-            TIME   (8 bytes,integer): current time on the server computer in microseconds
-                       since 1970.01.01 UT. Currently unused.
-            RA     (4 bytes,unsigned integer): right ascension of the telescope (J2000)
-                       a value of 0x100000000 = 0x0 means 24h=0h,
-                       a value of 0x80000000 means 12h
-            DEC    (4 bytes,signed integer): declination of the telescope (J2000)
-                       a value of -0x40000000 means -90degrees,
-                       a value of 0x0 means 0degrees,
-                       a value of 0x40000000 means 90degrees
-            STATUS (4 bytes,signed integer): status of the telescope, currently unused.
-                       status=0 means ok, status<0 means some error
-        */
+            SentRightAscension = RightAscension;
+            SentDeclination = Declination;
+            SentTime = Now;
+            /* clients which hung up since the last message */
+            RemoveClosedConnections();
 // ToDo; check this, doesn't match the above.
 //        const unsigned int ra_int = (unsigned int)floor(
 //                                       (0.5 +  RightAscension)*(((unsigned int)0x80000000)/M_PI));
 //        const int dec_int = (int)floor((0.5 + Declination)*(((unsigned int)0x80000000)/M_PI));
-        const unsigned int ra_int = (unsigned int)((RightAscension/(2.0*M_PI))*0xFFFFFFFF);
-        const int dec_int = (int)((Declination/(M_PI/2.0))*1073741824.0);
-        const int status = 0;
-        SendPosition(ra_int,dec_int,status);
+            const unsigned int ra_int = (unsigned int)((RightAscension/(2.0*M_PI))*0xFFFFFFFF);
+            const int dec_int = (int)((Declination/(M_PI/2.0))*1073741824.0);
+            const int status = 0;
+            SendPosition(ra_int,dec_int,status,SampleTime);
+            if ( GetNumberOfConnections() > 0u )
+            {
+                LatencyTrace::Mark( TraceId, LATENCY_SENT_STELLARIUM );
+            }
+        }
     }
-    Server::Step(TimeoutMicros);
+    TRACE_END( TRACE_SERVER_PI, GetNumberOfConnections() );
 }
 
-void ServerPi::SetRaDec (double Ra, double Dec )
+/* HasMoved
+ * Has the telescope moved further than the threshold since the last message
+ * @return bool true if it has
+ */
+bool ServerPi::HasMoved( void )
 {
-    RightAscension = Ra;
-    Declination = Dec;
+    /* the haversine is accurate for the small moves */
+    const double SinDec = sin( ( Declination - SentDeclination ) / 2.0 );
+    const double SinRa = sin( ( RightAscension - SentRightAscension ) / 2.0 );
+    const double SinThreshold = sin( Threshold / 2.0 );
+    return ( ( SinDec * SinDec ) + ( cos( Declination ) * cos( SentDeclination ) * SinRa * SinRa ) ) > ( SinThreshold * SinThreshold );
 }
 
-void ServerPi::Run( void )
+void ServerPi::SetRaDec (double Ra, double Dec )
 {
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( SERVER_PI_PIN , true );
-    #endif
-
-    TelescopeManager::GetRaDec( &RightAscension, &Declination );
-    //SetRaDec( RightAscension, Declination );
-    Step( 10000 );
-
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( SERVER_PI_PIN , false );
-    #endif
+    RightAscension = Ra;
+    Declination = Dec;
 }
 
 /*
@@ -28,43 +28,61 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #ifndef SERVER_PI_H
 #define SERVER_PI_H
 
+#include <math.h>
 #include "Server.hpp"
-#include "Runnable.h"
+#include "HalReactor.h"
 #include "TelescopeManager.h"
 
+/* Configuration */
+
+#define SERVER_PI_POSITION_PERIOD  500000u  /**< longest time between position messages, microseconds */
+#define SERVER_PI_CHANGE_PERIOD    5000u    /**< microseconds between looks for a change, TelescopeManager runs every 5ms */
+#define SERVER_PI_CHANGE_THRESHOLD ( 30.0 * ( M_PI / 648000.0 ) ) /**< a move of 30 arcseconds is sent at once, radians */
+
 /** Class Telescope server.
+ * Sends the position to every client from a reactor timer, every period
+ * and, with a threshold, as soon as the telescope has moved further than it.
 */
-class ServerPi : public Server, public Runnable
+class ServerPi : public Server, public HalReactorHandler
 {
     public:
     /** Constructor
      */
         ServerPi(int Port);
-    /** 
+    /** Start sending the position, HalReactor::Reactor must be initialised
+     * @param Period longest time between position messages, microseconds
+     * @param Threshold a move further than this is sent within SERVER_PI_CHANGE_PERIOD,
+     *        radians, 0 to send every period only
+     * @return bool true if the timer could be created
      */
-        void Run ( void );
+        bool Init( uint32_t Period, double Threshold );
     /** 
      */
         void SetRaDec (double Ra, double Dec );
-    /** perform one step of the server
-     * @param timeout_micros
-     * @param ra
-     * @param dec
-     */    
-        void Step(int64_t TimeoutMicros);
-    
+    /** Position timer, sends the position to every client
+     * @param Events the epoll events
+     */
+        void HandleEvents( uint32_t Events );
 private:
     /** handler for the goto message
      * @param ra_int
      * @param dec_int
      */
     void GotoReceived(uint32_t ra_int, int32_t dec_int);
+    /** Has the telescope moved further than the threshold since the last message
+     * @return bool true if it has
+     */
+    bool HasMoved( void );
     /**
      */
-
-    int64_t next_pos_time; /**< variable to prevent over sending of the messages */
+    int TimerFd;                  /**< position timer */
+    uint32_t Period;              /**< longest time between position messages, microseconds */
+    double Threshold;             /**< move that is sent at once, radians, 0 for none */
     double RightAscension;        /**< Right ascension */
     double Declination;           /**< Declination */
+    double SentRightAscension;    /**< Right ascension of the last message */
+    double SentDeclination;       /**< Declination of the last message */
+    int64_t SentTime;             /**< when the last message was sent, microseconds since 1970 */
 };
 
 #endif /* SERVER_ASTRO_PI_H */
@@ -36,6 +36,7 @@ void Socket::HangUp(void)
 {
     if (!IS_INVALID_SOCKET(Fd))
     {
+        HalReactor::Reactor.Remove(Fd);
         close(Fd);
         Fd = INVALID_SOCKET;
     }
@@ -32,6 +32,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <string.h> // strerror
+#include "HalReactor.h"
 
 #define ERRNO errno
 #define SETNONBLOCK(s) fcntl(s,F_SETFL,O_NONBLOCK)
@@ -45,8 +46,10 @@ int64_t GetNow(void);
 
 class Server;
 /** Class handler for the sockets
+ * Every socket is registered with HalReactor::Reactor, which calls
+ * HandleEvents() on the reactor thread when it is ready.
  */
-class Socket
+class Socket : public HalReactorHandler
 {
     public:
 /** Destructor
@@ -55,21 +58,12 @@ class Socket
 /** Close connection
  */
         void HangUp( void );
-    /** PrepareSelectFds
+    /** HandleEvents
      * Performs TCP/IP communication and handles new connections.
-     * If a new connection is established, creates a new Connection object
-     * and passes it to the parent Server with Server::addConnection().
-     * @param ReadFds reference
-     * @param WriteFds reference
-     * @param FdMax reference
+     * The socket is edge triggered, so everything waiting must be handled.
+     * @param Events the epoll events
      */
-        virtual void PrepareSelectFds(fd_set &ReadFds, fd_set &WriteFds, int16_t &FdMax) = 0;
-    /** HandleSelectFds
-     * handle the selected rw files
-     * @param ReadFds reference to the read file
-     * @param WriteFds reference to the write file
-     */
-        virtual void HandleSelectFds(const fd_set &ReadFds, const fd_set &WriteFds) = 0;
+        virtual void HandleEvents( uint32_t Events ) = 0;
     /** Check status of socket
      */
         virtual bool IsClosed( void )
@@ -79,15 +73,6 @@ class Socket
     /** Check to see if the connection is a TCP socket.
      */    
         virtual bool IsTcpConnection(void) const { return false; }
-    /** SendPosition
-     * Composes a "MessageCurrentPosition" in the write buffer.
-     * This is a Stellarium telescope control protocol message containing
-     * the current right ascension, declination and status of the telescope mount.
-     * @param RAInt uint32_T version of the Right Ascension
-     * @param DecInt int32_t version of the Declination
-     * @param Status int32_t version of the 
-     */
-        virtual void SendPosition( uint32_t /* RAInt */, int32_t /* DecInt */, int32_t /* Status */) {}
         
     protected:
     /** Constructor
@@ -0,0 +1,397 @@
+/*
+Magnetometer calibration engine.
+Fits an ellipsoid to the raw magnetometer samples with recursive least
+squares as they stream in. The fitted ellipsoid gives the hard iron
+offset and the soft iron matrix, which are combined into one matrix
+and bias so applying the calibration is a single matrix-vector multiply.
+The result can be saved to and loaded from a calibration file.
+
+Author and copyright of this file:
+Chris Dick, 2015
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <math.h>
+#include "MagCalibration.h"
+#include "Config.h"
+
+/*
+    The fit is of the quadric
+    Ax^2 + By^2 + Cz^2 + 2Dxy + 2Exz + 2Fyz + 2Gx + 2Hy + 2Iz = 1
+    which can describe any ellipsoid that does not pass through the origin.
+*/
+#define MAG_CAL_INITIAL_COVARIANCE ((double)1.0e4)
+#define MAG_CAL_JACOBI_SWEEPS      16u
+#define MAG_CAL_MIN_SPREAD         ((double)0.01) /* least variance of the samples in any direction, relative to the most */
+
+/* Eigen decomposition of a symmetric 3x3 matrix using Jacobi rotations.
+ * @param M matrix to decompose, row major, destroyed
+ * @param Values eigenvalues
+ * @param Vectors eigenvectors as columns, row major
+ */
+static void JacobiEigen( double M[9], double Values[3], double Vectors[9] )
+{
+    uint8_t Sweep = 0u;
+    uint8_t i = 0u;
+    for ( i = 0u; i < 9u; i++ )
+    {
+        Vectors[i] = ( ( i % 4u ) == 0u ) ? 1.0 : 0.0;
+    }
+    for ( Sweep = 0u; Sweep < MAG_CAL_JACOBI_SWEEPS; Sweep++ )
+    {
+        double OffDiagonal = fabs( M[1] ) + fabs( M[2] ) + fabs( M[5] );
+        if ( OffDiagonal < 1.0e-15 )
+        {
+            break;
+        }
+        for ( uint8_t p = 0u; p < 2u; p++ )
+        {
+            for ( uint8_t q = p + 1u; q < 3u; q++ )
+            {
+                double Mpq = M[(p*3u)+q];
+                if ( fabs( Mpq ) < 1.0e-300 )
+                {
+                    continue;
+                }
+                double Theta = ( M[(q*3u)+q] - M[(p*3u)+p] ) / ( 2.0 * Mpq );
+                double t = ( ( Theta >= 0.0 ) ? 1.0 : -1.0 ) / ( fabs( Theta ) + sqrt( ( Theta * Theta ) + 1.0 ) );
+                double c = 1.0 / sqrt( ( t * t ) + 1.0 );
+                double s = t * c;
+                for ( uint8_t k = 0u; k < 3u; k++ )
+                {
+                    /* rotate columns p and q */
+                    double Mkp = M[(k*3u)+p];
+                    double Mkq = M[(k*3u)+q];
+                    M[(k*3u)+p] = ( c * Mkp ) - ( s * Mkq );
+                    M[(k*3u)+q] = ( s * Mkp ) + ( c * Mkq );
+                }
+                for ( uint8_t k = 0u; k < 3u; k++ )
+                {
+                    /* rotate rows p and q */
+                    double Mpk = M[(p*3u)+k];
+                    double Mqk = M[(q*3u)+k];
+                    M[(p*3u)+k] = ( c * Mpk ) - ( s * Mqk );
+                    M[(q*3u)+k] = ( s * Mpk ) + ( c * Mqk );
+                }
+                for ( uint8_t k = 0u; k < 3u; k++ )
+                {
+                    double Vkp = Vectors[(k*3u)+p];
+                    double Vkq = Vectors[(k*3u)+q];
+                    Vectors[(k*3u)+p] = ( c * Vkp ) - ( s * Vkq );
+                    Vectors[(k*3u)+q] = ( s * Vkp ) + ( c * Vkq );
+                }
+            }
+        }
+    }
+    Values[0] = M[0];
+    Values[1] = M[4];
+    Values[2] = M[8];
+}
+
+/* Constructor
+ */
+MagCalibration::MagCalibration( void )
+{
+    SetFromMinMax( -1.0f, 1.0f, -1.0f, 1.0f, -1.0f, 1.0f );
+    Reset( 1.0f );
+}
+
+/* Reset the fit ready for a new calibration run
+ * @param Scale approximate field magnitude in raw units, used to condition the fit
+ */
+void MagCalibration::Reset( float Scale )
+{
+    uint8_t Row = 0u;
+    uint8_t Col = 0u;
+    InputScale = ( Scale > 0.0f ) ? ( 1.0 / Scale ) : 1.0;
+    Samples = 0u;
+    Weight = 0.0;
+    for ( Row = 0u; Row < 3u; Row++ )
+    {
+        Sum[Row] = 0.0;
+    }
+    for ( Row = 0u; Row < 9u; Row++ )
+    {
+        Scatter[Row] = 0.0;
+    }
+    for ( Row = 0u; Row < MAG_CAL_PARAMS; Row++ )
+    {
+        Theta[Row] = 0.0;
+        for ( Col = 0u; Col < MAG_CAL_PARAMS; Col++ )
+        {
+            P[Row][Col] = ( Row == Col ) ? MAG_CAL_INITIAL_COVARIANCE : 0.0;
+        }
+    }
+}
+
+/* Add a raw sample to the fit
+ * Standard recursive least squares update with a forgetting factor.
+ */
+void MagCalibration::AddSample( float Mx, float My, float Mz )
+{
+    const double Lambda = CONFIG_MAG_CALIBRATION_FORGETTING;
+    const double x = Mx * InputScale;
+    const double y = My * InputScale;
+    const double z = Mz * InputScale;
+    const double Phi[MAG_CAL_PARAMS] = { x*x, y*y, z*z, 2.0*x*y, 2.0*x*z, 2.0*y*z, 2.0*x, 2.0*y, 2.0*z };
+    const double Sample[3] = { x, y, z };
+    double PPhi[MAG_CAL_PARAMS];
+    double Denominator = Lambda;
+    double Error = 1.0;
+    uint8_t Row = 0u;
+    uint8_t Col = 0u;
+
+    for ( Row = 0u; Row < MAG_CAL_PARAMS; Row++ )
+    {
+        PPhi[Row] = 0.0;
+        for ( Col = 0u; Col < MAG_CAL_PARAMS; Col++ )
+        {
+            PPhi[Row] += P[Row][Col] * Phi[Col];
+        }
+        Denominator += Phi[Row] * PPhi[Row];
+        Error -= Phi[Row] * Theta[Row];
+    }
+    if ( Denominator <= 0.0 )
+    {
+        return;
+    }
+    for ( Row = 0u; Row < MAG_CAL_PARAMS; Row++ )
+    {
+        Theta[Row] += ( PPhi[Row] / Denominator ) * Error;
+    }
+    /* P is symmetric so only the upper triangle is calculated */
+    for ( Row = 0u; Row < MAG_CAL_PARAMS; Row++ )
+    {
+        for ( Col = Row; Col < MAG_CAL_PARAMS; Col++ )
+        {
+            P[Row][Col] = ( P[Row][Col] - ( ( PPhi[Row] * PPhi[Col] ) / Denominator ) ) / Lambda;
+            P[Col][Row] = P[Row][Col];
+        }
+    }
+    /* the spread of the samples, forgotten at the same rate as the fit */
+    Weight = ( Lambda * Weight ) + 1.0;
+    for ( Row = 0u; Row < 3u; Row++ )
+    {
+        Sum[Row] = ( Lambda * Sum[Row] ) + Sample[Row];
+        for ( Col = 0u; Col < 3u; Col++ )
+        {
+            Scatter[(Row*3u)+Col] = ( Lambda * Scatter[(Row*3u)+Col] ) + ( Sample[Row] * Sample[Col] );
+        }
+    }
+    Samples++;
+}
+
+/* Solve the current fit for the offset and soft iron matrix.
+ * Samples that are nearly all in one plane are refused.
+ * @return bool true if the calibration was updated
+ */
+bool MagCalibration::Solve( void )
+{
+    const double* t = Theta;
+    const double A[9] = { t[0], t[3], t[4],
+                          t[3], t[1], t[5],
+                          t[4], t[5], t[2] };
+    double Inverse[9];
+    double Centre[3];
+    double M[9];
+    double Values[3];
+    double Vectors[9];
+    double Determinant = 0.0;
+    double k = 1.0;
+    uint8_t i = 0u;
+    uint8_t j = 0u;
+
+    if ( Samples < CONFIG_MAG_CALIBRATION_MIN_SAMPLES )
+    {
+        return false;
+    }
+    /* samples close to a plane fit any number of ellipsoids, the
+       magnetometer must have been turned about more than one axis */
+    for ( i = 0u; i < 3u; i++ )
+    {
+        for ( j = 0u; j < 3u; j++ )
+        {
+            M[(i*3u)+j] = ( Scatter[(i*3u)+j] / Weight ) - ( ( Sum[i] / Weight ) * ( Sum[j] / Weight ) );
+        }
+    }
+    JacobiEigen( M, Values, Vectors );
+    if ( fmin( Values[0], fmin( Values[1], Values[2] ) ) < ( MAG_CAL_MIN_SPREAD * fmax( Values[0], fmax( Values[1], Values[2] ) ) ) )
+    {
+        return false;
+    }
+    /* invert A */
+    Inverse[0] =   ( A[4] * A[8] ) - ( A[5] * A[7] );
+    Inverse[1] = -(( A[1] * A[8] ) - ( A[2] * A[7] ));
+    Inverse[2] =   ( A[1] * A[5] ) - ( A[2] * A[4] );
+    Inverse[3] = -(( A[3] * A[8] ) - ( A[5] * A[6] ));
+    Inverse[4] =   ( A[0] * A[8] ) - ( A[2] * A[6] );
+    Inverse[5] = -(( A[0] * A[5] ) - ( A[2] * A[3] ));
+    Inverse[6] =   ( A[3] * A[7] ) - ( A[4] * A[6] );
+    Inverse[7] = -(( A[0] * A[7] ) - ( A[1] * A[6] ));
+    Inverse[8] =   ( A[0] * A[4] ) - ( A[1] * A[3] );
+    Determinant = ( A[0] * Inverse[0] ) + ( A[1] * Inverse[3] ) + ( A[2] * Inverse[6] );
+    if ( fabs( Determinant ) < 1.0e-12 )
+    {
+        return false;
+    }
+    /* centre = -inverse(A) * g */
+    for ( i = 0u; i < 3u; i++ )
+    {
+        Centre[i] = -( ( Inverse[(i*3u)] * t[6] ) + ( Inverse[(i*3u)+1u] * t[7] ) + ( Inverse[(i*3u)+2u] * t[8] ) ) / Determinant;
+    }
+    /* (x-c)' A (x-c) = 1 + c' A c */
+    for ( i = 0u; i < 3u; i++ )
+    {
+        for ( j = 0u; j < 3u; j++ )
+        {
+            k += Centre[i] * A[(i*3u)+j] * Centre[j];
+        }
+    }
+    if ( k <= 0.0 )
+    {
+        return false;
+    }
+    for ( i = 0u; i < 9u; i++ )
+    {
+        M[i] = A[i] / k;
+    }
+    /* the soft iron matrix is the symmetric square root of M */
+    JacobiEigen( M, Values, Vectors );
+    for ( i = 0u; i < 3u; i++ )
+    {
+        if ( Values[i] <= 0.0 )
+        {
+            return false;
+        }
+        Values[i] = sqrt( Values[i] );
+    }
+    for ( i = 0u; i < 3u; i++ )
+    {
+        for ( j = 0u; j < 3u; j++ )
+        {
+            double Sum = 0.0;
+            for ( uint8_t n = 0u; n < 3u; n++ )
+            {
+                Sum += Vectors[(i*3u)+n] * Values[n] * Vectors[(j*3u)+n];
+            }
+            /* undo the input scaling */
+            SoftIron[(i*3u)+j] = (float)( Sum * InputScale );
+        }
+        Offset[i] = (float)( Centre[i] / InputScale );
+    }
+    Precompute();
+    return true;
+}
+
+/* Set a per axis calibration from the min and max values of each axis
+ */
+void MagCalibration::SetFromMinMax( float MxMin, float MxMax, float MyMin, float MyMax, float MzMin, float MzMax )
+{
+    uint8_t i = 0u;
+    Offset[0] = ( MxMin + MxMax ) / 2.0f;
+    Offset[1] = ( MyMin + MyMax ) / 2.0f;
+    Offset[2] = ( MzMin + MzMax ) / 2.0f;
+    for ( i = 0u; i < 9u; i++ )
+    {
+        SoftIron[i] = 0.0f;
+    }
+    SoftIron[0] = 1.0f / ( MxMax - Offset[0] );
+    SoftIron[4] = 1.0f / ( MyMax - Offset[1] );
+    SoftIron[8] = 1.0f / ( MzMax - Offset[2] );
+    Precompute();
+}
+
+/* Load the calibration from a file
+ * @return bool true if the file was loaded
+ */
+bool MagCalibration::Load( const char* FileName )
+{
+    bool Result = false;
+    float NewOffset[3];
+    float NewSoftIron[9];
+    FILE* File = fopen( FileName, "r" );
+    if ( File != NULL )
+    {
+        if (
+               ( fscanf( File, " offset %f %f %f", &NewOffset[0], &NewOffset[1], &NewOffset[2] ) == 3 )
+            && ( fscanf( File, " matrix %f %f %f %f %f %f %f %f %f",
+                         &NewSoftIron[0], &NewSoftIron[1], &NewSoftIron[2],
+                         &NewSoftIron[3], &NewSoftIron[4], &NewSoftIron[5],
+                         &NewSoftIron[6], &NewSoftIron[7], &NewSoftIron[8] ) == 9 )
+           )
+        {
+            uint8_t i = 0u;
+            for ( i = 0u; i < 3u; i++ )
+            {
+                Offset[i] = NewOffset[i];
+            }
+            for ( i = 0u; i < 9u; i++ )
+            {
+                SoftIron[i] = NewSoftIron[i];
+            }
+            Precompute();
+            Result = true;
+        }
+        fclose( File );
+    }
+    return Result;
+}
+
+/* Save the calibration to a file
+ * @return bool true if the file was written
+ */
+bool MagCalibration::Save( const char* FileName )
+{
+    bool Result = false;
+    FILE* File = fopen( FileName, "w" );
+    if ( File != NULL )
+    {
+        fprintf( File, "offset %.9g %.9g %.9g\n", Offset[0], Offset[1], Offset[2] );
+        fprintf( File, "matrix %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n",
+                 SoftIron[0], SoftIron[1], SoftIron[2],
+                 SoftIron[3], SoftIron[4], SoftIron[5],
+                 SoftIron[6], SoftIron[7], SoftIron[8] );
+        Result = ( fclose( File ) == 0 );
+    }
+    return Result;
+}
+
+/* Get the number of samples in the current fit
+ */
+uint32_t MagCalibration::GetSampleCount( void )
+{
+    return Samples;
+}
+
+/* Get the hard iron offset
+ */
+void MagCalibration::GetOffset( float* Ox, float* Oy, float* Oz )
+{
+    *Ox = Offset[0];
+    *Oy = Offset[1];
+    *Oz = Offset[2];
+}
+
+/* Build the bias used by Apply from the offset and soft iron matrix
+ */
+void MagCalibration::Precompute( void )
+{
+    uint8_t i = 0u;
+    for ( i = 0u; i < 3u; i++ )
+    {
+        Bias[i] = ( SoftIron[(i*3u)] * Offset[0] ) + ( SoftIron[(i*3u)+1u] * Offset[1] ) + ( SoftIron[(i*3u)+2u] * Offset[2] );
+    }
+}
@@ -0,0 +1,104 @@
+/**
+Magnetometer calibration engine.
+Fits an ellipsoid to the raw magnetometer samples with recursive least
+squares as they stream in. The fitted ellipsoid gives the hard iron
+offset and the soft iron matrix, which are combined into one matrix
+and bias so applying the calibration is a single matrix-vector multiply.
+The result can be saved to and loaded from a calibration file.
+
+Author and copyright of this file:
+Chris Dick, 2015
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef MAGCALIBRATION_H
+#define MAGCALIBRATION_H
+
+#include <stdint.h>
+
+#define MAG_CAL_PARAMS 9u /**< number of parameters in the ellipsoid fit */
+
+/** MagCalibration
+ * - Class to fit and apply the hard and soft iron calibration
+ */
+class MagCalibration
+{
+    public:
+    /** Constructor
+     */
+        MagCalibration( void );
+    /** Reset the fit ready for a new calibration run
+     * @param Scale approximate field magnitude in raw units, used to condition the fit
+     */
+        void Reset( float Scale );
+    /** Add a raw sample to the fit
+     * @param Mx raw X value
+     * @param My raw Y value
+     * @param Mz raw Z value
+     */
+        void AddSample( float Mx, float My, float Mz );
+    /** Solve the current fit for the offset and soft iron matrix.
+     * The calibration in use is only replaced if the fit is a valid ellipsoid
+     * of samples spread in every direction.
+     * @return bool true if the calibration was updated
+     */
+        bool Solve( void );
+    /** Set a per axis calibration from the min and max values of each axis
+     */
+        void SetFromMinMax( float MxMin, float MxMax, float MyMin, float MyMax, float MzMin, float MzMax );
+    /** Load the calibration from a file
+     * @param FileName name of the calibration file
+     * @return bool true if the file was loaded
+     */
+        bool Load( const char* FileName );
+    /** Save the calibration to a file
+     * @param FileName name of the calibration file
+     * @return bool true if the file was written
+     */
+        bool Save( const char* FileName );
+    /** Get the number of samples in the current fit
+     */
+        uint32_t GetSampleCount( void );
+    /** Get the hard iron offset
+     */
+        void GetOffset( float* Ox, float* Oy, float* Oz );
+    /** Apply the calibration to a raw sample
+     * The output is normalised so the local field has a magnitude of 1.
+     */
+        inline void Apply( float Mx, float My, float Mz, float* Cx, float* Cy, float* Cz ) const
+        {
+            *Cx = ( SoftIron[0] * Mx ) + ( SoftIron[1] * My ) + ( SoftIron[2] * Mz ) - Bias[0];
+            *Cy = ( SoftIron[3] * Mx ) + ( SoftIron[4] * My ) + ( SoftIron[5] * Mz ) - Bias[1];
+            *Cz = ( SoftIron[6] * Mx ) + ( SoftIron[7] * My ) + ( SoftIron[8] * Mz ) - Bias[2];
+        }
+
+    private:
+    /** Build the bias used by Apply from the offset and soft iron matrix
+     */
+        void Precompute( void );
+
+        double Theta[MAG_CAL_PARAMS];                  /**< quadric parameters being fitted */
+        double P[MAG_CAL_PARAMS][MAG_CAL_PARAMS];      /**< RLS covariance */
+        double InputScale;                             /**< scaling applied to the samples during the fit */
+        uint32_t Samples;                              /**< samples in the current fit */
+        double Weight;                                 /**< samples in the spread, after forgetting */
+        double Sum[3];                                 /**< sum of the scaled samples */
+        double Scatter[9];                             /**< sum of the outer products of the scaled samples */
+        float Offset[3];                               /**< hard iron offset */
+        float SoftIron[9];                             /**< soft iron matrix, row major */
+        float Bias[3];                                 /**< soft iron matrix times offset, precomputed for Apply */
+};
+
+#endif /* MAGCALIBRATION_H */
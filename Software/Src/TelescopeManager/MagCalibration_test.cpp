@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <math.h>
+#include <unistd.h>
+#include "MagCalibration.h"
+#include "Config.h"
+/*
+ MagCalibration test
+ Feeds the fit a field seen through a known hard iron offset and soft
+ iron matrix and checks it is taken back out, then checks a fit with too
+ few samples or with every sample in one plane is refused, and that a
+ saved calibration loads back the same. Build on any machine from
+ Software/:
+
+ g++ -O2 -I./Src -I./Src/TelescopeManager \
+     Src/TelescopeManager/MagCalibration_test.cpp Src/TelescopeManager/MagCalibration.cpp \
+     -o MagCalibration_test
+ ./MagCalibration_test
+ */
+
+#define TEST_FILE       "/tmp/MagCalibration_test.cfg"
+#define TEST_SAMPLES    2000u
+
+static int failures = 0;
+
+/* the distortion, symmetric so the fit gives its inverse back */
+static const double softIron[9] = { 400.0,  30.0,   0.0,
+                                     30.0, 350.0,  20.0,
+                                      0.0,  20.0, 300.0 };
+static const double offset[3] = { 120.0, -80.0, 45.0 };
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+/* a direction spread evenly over the sphere, or around the equator if flat */
+static void direction(uint32_t n, uint32_t count, bool flat, double u[3])
+{
+    const double z = flat ? 0.0 : (1.0 - ((2.0 * (n + 0.5)) / count));
+    const double r = sqrt(1.0 - (z * z));
+    const double angle = flat ? ((2.0 * M_PI * n) / count) : (n * M_PI * (3.0 - sqrt(5.0)));
+    u[0] = r * cos(angle);
+    u[1] = r * sin(angle);
+    u[2] = z;
+}
+
+/* the raw sample the magnetometer reads for a unit field along u */
+static void distort(const double u[3], float raw[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        raw[i] = (float)((softIron[(i * 3)] * u[0]) + (softIron[(i * 3) + 1] * u[1]) + (softIron[(i * 3) + 2] * u[2]) + offset[i]);
+    }
+}
+
+static void addSamples(MagCalibration* calibration, uint32_t count, bool flat)
+{
+    double u[3];
+    float raw[3];
+    for (uint32_t n = 0u; n < count; n++)
+    {
+        direction(n, count, flat, u);
+        distort(u, raw);
+        calibration->AddSample(raw[0], raw[1], raw[2]);
+    }
+}
+
+int main()
+{
+    MagCalibration calibration;
+    MagCalibration loaded;
+    double u[3];
+    float raw[3];
+    float cx = 0.0f;
+    float cy = 0.0f;
+    float cz = 0.0f;
+    float ox = 0.0f;
+    float oy = 0.0f;
+    float oz = 0.0f;
+    double worstField = 0.0;
+    double worstMagnitude = 0.0;
+    uint32_t n = 0u;
+
+    /* too few samples, the calibration in use is kept */
+    calibration.Reset(350.0f);
+    addSamples(&calibration, CONFIG_MAG_CALIBRATION_MIN_SAMPLES - 1u, false);
+    check(!calibration.Solve(), "a fit with too few samples is refused");
+    calibration.GetOffset(&ox, &oy, &oz);
+    check((ox == 0.0f) && (oy == 0.0f) && (oz == 0.0f), "the calibration in use is kept");
+
+    /* every sample in one plane says nothing about the third axis */
+    calibration.Reset(350.0f);
+    addSamples(&calibration, TEST_SAMPLES, true);
+    check(calibration.GetSampleCount() == TEST_SAMPLES, "the samples are counted");
+    check(!calibration.Solve(), "a fit of samples in one plane is refused");
+
+    /* the offset and soft iron are taken out */
+    calibration.Reset(350.0f);
+    addSamples(&calibration, TEST_SAMPLES, false);
+    check(calibration.Solve(), "the fit is solved");
+    calibration.GetOffset(&ox, &oy, &oz);
+    check((fabs(ox - offset[0]) < 0.1) && (fabs(oy - offset[1]) < 0.1) && (fabs(oz - offset[2]) < 0.1), "the hard iron offset is found");
+    for (n = 0u; n < 100u; n++)
+    {
+        direction(n * 7u, 700u, false, u);
+        distort(u, raw);
+        calibration.Apply(raw[0], raw[1], raw[2], &cx, &cy, &cz);
+        worstField = fmax(worstField, fmax(fabs(cx - u[0]), fmax(fabs(cy - u[1]), fabs(cz - u[2]))));
+        worstMagnitude = fmax(worstMagnitude, fabs(sqrt((cx * cx) + (cy * cy) + (cz * cz)) - 1.0));
+    }
+    fprintf(stderr, "offset %f %f %f, worst field error %g, worst magnitude error %g\n", ox, oy, oz, worstField, worstMagnitude);
+    check(worstMagnitude < 0.001, "the calibrated field has a magnitude of 1");
+    check(worstField < 0.002, "the calibrated field points the way the field does");
+
+    /* saved and loaded back */
+    check(calibration.Save(TEST_FILE), "the calibration is saved");
+    check(loaded.Load(TEST_FILE), "the calibration is loaded");
+    loaded.GetOffset(&ox, &oy, &oz);
+    calibration.GetOffset(&cx, &cy, &cz);
+    check((ox == cx) && (oy == cy) && (oz == cz), "the loaded offset is the same");
+    {
+        float lx = 0.0f;
+        float ly = 0.0f;
+        float lz = 0.0f;
+        distort(u, raw);
+        calibration.Apply(raw[0], raw[1], raw[2], &cx, &cy, &cz);
+        loaded.Apply(raw[0], raw[1], raw[2], &lx, &ly, &lz);
+        check((lx == cx) && (ly == cy) && (lz == cz), "the loaded calibration gives the same field");
+    }
+    unlink(TEST_FILE);
+    check(!loaded.Load(TEST_FILE), "a missing file is not loaded");
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+/*
+TelemetryMulticast sends the pointing to a UDP multicast group after
+each TelescopeManager run, for events with many displays. It is one
+small TELEMETRY_BROADCAST frame per run whatever the number of
+receivers, where each TelescopeSocket client costs a connection and its
+own replies. The sequence number in the frame header counts the
+broadcasts, TelemetryReceiver uses it to count the ones it missed.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "TelemetryMulticast.h"
+#include "TelescopeSocket.h"
+
+/* what a display needs to show the pointing, in the order they are sent */
+const uint8_t TelemetryMulticast::Fields[] =
+{
+    TELEMETRY_SAMPLE_TIME,
+    TELEMETRY_RIGHT_ASCENSION,
+    TELEMETRY_DECLINATION,
+    TELEMETRY_TARGET_RIGHT_ASCENSION,
+    TELEMETRY_TARGET_DECLINATION,
+    TELEMETRY_ALTITUDE,
+    TELEMETRY_AZIMUTH,
+    TELEMETRY_ROLL,
+    TELEMETRY_GPS_MODE
+};
+int                TelemetryMulticast::Fd = -1;
+struct sockaddr_in TelemetryMulticast::Destination;
+uint16_t           TelemetryMulticast::Sequence = 0u;
+uint32_t           TelemetryMulticast::Dropped = 0u;
+
+/* Init
+ * Open the socket
+ */
+bool TelemetryMulticast::Init( const char* Group, uint16_t Port, const char* Interface )
+{
+    const int Ttl = TELEMETRY_MULTICAST_TTL;
+    const int Loop = 1;
+    struct in_addr Address;
+    bool Result = true;
+    memset( &Destination, 0, sizeof( Destination ) );
+    Destination.sin_family = AF_INET;
+    Destination.sin_port = htons( Port );
+    if ( inet_pton( AF_INET, Group, &Destination.sin_addr ) != 1 )
+    {
+        printf( "TelemetryMulticast: %s is not an address\n", Group );
+        return false;
+    }
+    Fd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( Fd < 0 )
+    {
+        perror( "TelemetryMulticast socket" );
+        return false;
+    }
+    /* a display on the Pi itself receives it too */
+    Result = ( setsockopt( Fd, IPPROTO_IP, IP_MULTICAST_TTL, &Ttl, sizeof( Ttl ) ) == 0 )
+          && ( setsockopt( Fd, IPPROTO_IP, IP_MULTICAST_LOOP, &Loop, sizeof( Loop ) ) == 0 );
+    if ( Result && ( Interface != NULL ) )
+    {
+        Result = ( inet_pton( AF_INET, Interface, &Address ) == 1 )
+              && ( setsockopt( Fd, IPPROTO_IP, IP_MULTICAST_IF, &Address, sizeof( Address ) ) == 0 );
+    }
+    if ( !Result )
+    {
+        perror( "TelemetryMulticast setsockopt" );
+        Close();
+    }
+    return Result;
+}
+
+/* Close
+ * Close the socket
+ */
+void TelemetryMulticast::Close( void )
+{
+    if ( Fd >= 0 )
+    {
+        close( Fd );
+        Fd = -1;
+    }
+}
+
+/* Publish
+ * Publish hook for the TelescopeManager, sends the latest values
+ */
+void TelemetryMulticast::Publish( void )
+{
+    uint8_t Datagram[TELEMETRY_MULTICAST_SIZE];
+    TelemetryEncoder Encoder( Datagram, sizeof( Datagram ) );
+    TELEMETRY_VALUE_T Value;
+    uint8_t Index = 0u;
+    if ( Fd < 0 )
+    {
+        return;
+    }
+    Encoder.Begin( TELEMETRY_BROADCAST, Sequence );
+    for ( Index = 0u; Index < ( sizeof( Fields ) / sizeof( Fields[0] ) ); Index++ )
+    {
+        if ( TelescopeSocket::GetTelemetryValue( Fields[Index], &Value ) )
+        {
+            (void)Encoder.AddValue( &Value );
+        }
+    }
+    const uint32_t Length = Encoder.Finish();
+    /* counted even if it is not sent, so the receivers see it is missing */
+    Sequence++;
+    if ( sendto( Fd, Datagram, Length, MSG_DONTWAIT, (struct sockaddr*)&Destination, sizeof( Destination ) ) != (ssize_t)Length )
+    {
+        Dropped++;
+    }
+}
+
+/* GetDropped
+ * Get the number of datagrams the socket did not take
+ */
+uint32_t TelemetryMulticast::GetDropped( void )
+{
+    return Dropped;
+}
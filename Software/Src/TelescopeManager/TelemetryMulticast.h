@@ -0,0 +1,75 @@
+/**
+TelemetryMulticast sends the pointing to a UDP multicast group after
+each TelescopeManager run, for events with many displays. It is one
+small TELEMETRY_BROADCAST frame per run whatever the number of
+receivers, where each TelescopeSocket client costs a connection and its
+own replies. The sequence number in the frame header counts the
+broadcasts, TelemetryReceiver uses it to count the ones it missed.
+
+It is a publish hook of the TelescopeManager, the datagram is sent on
+the scheduler thread without waiting, one that does not fit in the
+socket buffer is dropped and the receivers see the gap.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TELEMETRY_MULTICAST_H
+#define TELEMETRY_MULTICAST_H
+
+#include <stdint.h>
+#include <netinet/in.h>
+#include "TelemetryProtocol.h"
+
+/* Configuration */
+
+#define TELEMETRY_MULTICAST_GROUP  "239.255.76.80"  /**< administratively scoped, stays on the site */
+#define TELEMETRY_MULTICAST_PORT   4032u            /**< receivers bind to this port */
+#define TELEMETRY_MULTICAST_TTL    1                /**< routers it may cross, 1 keeps it on the local network */
+#define TELEMETRY_MULTICAST_SIZE   128u             /**< largest datagram, the fields need 79 bytes */
+
+/** TelemetryMulticast
+ * - Sends a telemetry frame to the multicast group for each new set of values
+ */
+class TelemetryMulticast
+{
+    public:
+    /** Open the socket
+     * @param Group multicast address, TELEMETRY_MULTICAST_GROUP
+     * @param Port TELEMETRY_MULTICAST_PORT
+     * @param Interface address of the interface to send on, NULL for the one the routes choose
+     * @return bool true if successful
+     */
+        static bool Init( const char* Group, uint16_t Port, const char* Interface );
+    /** Close the socket
+     */
+        static void Close( void );
+    /** Publish hook for the TelescopeManager, sends the latest values
+     */
+        static void Publish( void );
+    /** Get the number of datagrams the socket did not take
+     */
+        static uint32_t GetDropped( void );
+
+    private:
+        static const uint8_t Fields[];           /**< TELEMETRY_FIELD_T sent in each datagram */
+        static int Fd;                           /**< UDP socket, -1 if not open */
+        static struct sockaddr_in Destination;   /**< the group and port */
+        static uint16_t Sequence;                /**< of the next datagram */
+        static uint32_t Dropped;                 /**< datagrams not sent */
+};
+
+#endif /* TELEMETRY_MULTICAST_H */
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "TelemetryMulticast.h"
+#include "TelemetryReceiver.h"
+#include "TelescopeSocket.h"
+/*
+ TelemetryMulticast test
+ Several receivers join the group on the loopback interface. They check
+ the broadcasts from TelemetryMulticast arrive with their values, then
+ frames sent with chosen sequence numbers check the counts of lost and
+ late broadcasts, the wrap of the sequence and a restart. Build on any
+ machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/TelescopeManager -I./Src/Utils \
+     Src/TelescopeManager/TelemetryMulticast_test.cpp Src/TelescopeManager/TelemetryMulticast.cpp \
+     Src/TelescopeManager/TelemetryReceiver.cpp Src/TelescopeManager/TelemetryProtocol.cpp \
+     Src/Utils/Metrics.cpp -lpthread -latomic -o TelemetryMulticast_test
+ ./TelemetryMulticast_test
+ */
+
+#define TEST_GROUP       "239.255.76.81"
+#define TEST_PORT        19995
+#define TEST_INTERFACE   "127.0.0.1"
+#define TEST_RECEIVERS   4
+#define TEST_BROADCASTS  1000
+#define TEST_TIMEOUT_MS  500
+
+static int failures = 0;
+static uint32_t run = 0;
+
+/* the values TelemetryMulticast sends are made from the run number */
+bool TelescopeSocket::GetTelemetryValue(uint8_t Id, TELEMETRY_VALUE_T* Value)
+{
+    Value->Id = Id;
+    Value->Type = TELEMETRY_F32;
+    Value->Integer = 0;
+    Value->Real = 0.0;
+    switch (Id)
+    {
+        case TELEMETRY_SAMPLE_TIME:     Value->Type = TELEMETRY_I64; Value->Integer = 1530000000000000LL + run; break;
+        case TELEMETRY_RIGHT_ASCENSION: Value->Type = TELEMETRY_F64; Value->Real = run * 1.0e-3; break;
+        case TELEMETRY_DECLINATION:     Value->Type = TELEMETRY_F64; Value->Real = run * -1.0e-3; break;
+        case TELEMETRY_GPS_MODE:        Value->Type = TELEMETRY_U8; Value->Integer = 3; break;
+        default:                        break;
+    }
+    return true;
+}
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* wait for a broadcast, false if none arrives */
+static bool receive(TelemetryReceiver* receiver)
+{
+    struct pollfd pfd;
+    pfd.fd = receiver->GetFd();
+    pfd.events = POLLIN;
+    while (!receiver->Receive())
+    {
+        if (poll(&pfd, 1, TEST_TIMEOUT_MS) != 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* send a broadcast with a chosen sequence number */
+static void sendSequence(int fd, uint16_t sequence)
+{
+    uint8_t frame[TELEMETRY_MULTICAST_SIZE];
+    TelemetryEncoder encoder(frame, sizeof(frame));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(TEST_PORT);
+    inet_pton(AF_INET, TEST_GROUP, &address.sin_addr);
+    encoder.Begin(TELEMETRY_BROADCAST, sequence);
+    (void)encoder.AddInteger(TELEMETRY_GPS_MODE, TELEMETRY_U8, sequence & 0xFF);
+    const uint32_t length = encoder.Finish();
+    (void)sendto(fd, frame, length, 0, (struct sockaddr*)&address, sizeof(address));
+}
+
+int main()
+{
+    static TelemetryReceiver receivers[TEST_RECEIVERS];
+    int i = 0;
+
+    for (i = 0; i < TEST_RECEIVERS; i++)
+    {
+        if (!receivers[i].Open(TEST_GROUP, TEST_PORT, TEST_INTERFACE))
+        {
+            fprintf(stderr, "FAIL: could not join the group on the loopback interface\n");
+            return 1;
+        }
+    }
+    check(TelemetryMulticast::Init(TEST_GROUP, TEST_PORT, TEST_INTERFACE), "the sender opens");
+
+    /* every receiver gets every broadcast, with its values */
+    {
+        int errors = 0;
+        double elapsed = 0.0;
+        for (run = 0; run < TEST_BROADCASTS; run++)
+        {
+            const double start = seconds();
+            TelemetryMulticast::Publish();
+            elapsed += seconds() - start;
+            for (i = 0; i < TEST_RECEIVERS; i++)
+            {
+                TelemetryDecoder& decoder = receivers[i].GetDecoder();
+                const TELEMETRY_VALUE_T* time = NULL;
+                const TELEMETRY_VALUE_T* ra = NULL;
+                if (receive(&receivers[i]))
+                {
+                    time = decoder.Find(TELEMETRY_SAMPLE_TIME);
+                    ra = decoder.Find(TELEMETRY_RIGHT_ASCENSION);
+                }
+                errors += ((time != NULL) && (time->Integer == (1530000000000000LL + run))
+                           && (ra != NULL) && (ra->Real == run * 1.0e-3)) ? 0 : 1;
+            }
+        }
+        check(errors == 0, "every receiver decodes every broadcast");
+        check(TelemetryMulticast::GetDropped() == 0, "the sender dropped none");
+        for (i = 0; i < TEST_RECEIVERS; i++)
+        {
+            check((receivers[i].GetReceived() == TEST_BROADCASTS) && (receivers[i].GetLost() == 0)
+                  && (receivers[i].GetLate() == 0), "nothing lost or late");
+        }
+        fprintf(stderr, "%u byte datagrams, %.2f us to publish each to %d receivers\n",
+                (unsigned)(8 + 4 * 10 + 10 + 3 * 6 + 3), (elapsed * 1.0e6) / TEST_BROADCASTS, TEST_RECEIVERS);
+    }
+    TelemetryMulticast::Close();
+
+    /* the counts, from frames with chosen sequence numbers */
+    {
+        TelemetryReceiver& receiver = receivers[0];
+        const int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        struct in_addr loopback;
+        inet_pton(AF_INET, TEST_INTERFACE, &loopback);
+        setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &loopback, sizeof(loopback));
+        uint32_t received = receiver.GetReceived();
+
+        sendSequence(fd, 10);
+        check(receive(&receiver) && (receiver.GetLost() == 0), "a restarted sender is followed");
+        sendSequence(fd, 11);
+        sendSequence(fd, 14);
+        check(receive(&receiver) && receive(&receiver) && (receiver.GetLost() == 2), "a gap counts as lost");
+        sendSequence(fd, 13);
+        sendSequence(fd, 15);
+        check(receive(&receiver) && (receiver.GetLate() == 1) && (receiver.GetLost() == 1)
+              && (receiver.GetDecoder().GetSequence() == 15), "a late one is dropped and no longer lost");
+        sendSequence(fd, 30016);
+        check(receive(&receiver) && (receiver.GetLost() == 30001u), "a big gap is counted");
+        sendSequence(fd, 60000);
+        sendSequence(fd, 65535);
+        sendSequence(fd, 0);
+        sendSequence(fd, 1);
+        check(receive(&receiver) && receive(&receiver) && receive(&receiver) && receive(&receiver)
+              && (receiver.GetLost() == (30001u + 29983u + 5534u)), "the sequence wraps");
+        sendSequence(fd, 0);
+        sendSequence(fd, 1000);
+        check(receive(&receiver) && (receiver.GetDecoder().GetSequence() == 1000) && (receiver.GetLate() == 2)
+              && (receiver.GetLost() == (30001u + 29983u + 5534u + 998u)), "a duplicate is dropped as late");
+        sendSequence(fd, 5);
+        check(receive(&receiver) && (receiver.GetDecoder().GetSequence() == 5), "a restart far behind is followed");
+        check(receiver.GetReceived() == (received + 11u), "the accepted broadcasts are counted");
+        close(fd);
+    }
+
+    for (i = 0; i < TEST_RECEIVERS; i++)
+    {
+        receivers[i].Close();
+    }
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+/*
+TelemetryProtocol is the binary form of the TelescopeSocket protocol,
+this is the encoder and decoder shared by the server and the clients.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "TelemetryProtocol.h"
+
+/* write a little endian value of Size bytes */
+static void WriteLittleEndian( uint8_t* Buffer, uint64_t Value, uint8_t Size )
+{
+    uint8_t Index;
+    for ( Index = 0u; Index < Size; Index++ )
+    {
+        Buffer[Index] = (uint8_t)Value;
+        Value >>= 8;
+    }
+}
+
+/* read a little endian value of Size bytes */
+static uint64_t ReadLittleEndian( const uint8_t* Buffer, uint8_t Size )
+{
+    uint64_t Value = 0u;
+    uint8_t Index = Size;
+    while ( Index > 0u )
+    {
+        Index--;
+        Value = ( Value << 8 ) | Buffer[Index];
+    }
+    return Value;
+}
+
+/* Constructor
+ */
+TelemetryEncoder::TelemetryEncoder( uint8_t* Buffer, uint32_t Size )
+    : Buffer( Buffer ), Size( Size ), Length( 0u ), Count( 0u )
+{
+}
+
+/* Start a new frame
+ */
+void TelemetryEncoder::Begin( uint8_t Type, uint16_t Sequence )
+{
+    Buffer[0] = TELEMETRY_MAGIC;
+    Buffer[1] = TELEMETRY_VERSION;
+    Buffer[4] = Type;
+    WriteLittleEndian( &Buffer[6], Sequence, 2u );
+    Length = TELEMETRY_HEADER_SIZE;
+    Count = 0u;
+}
+
+/* Add a field id to a request
+ */
+bool TelemetryEncoder::AddRequest( uint8_t Id )
+{
+    bool Result = false;
+    if ( ( ( Length + 1u ) <= Size ) && ( Count < TELEMETRY_MAX_FIELDS ) )
+    {
+        Buffer[Length++] = Id;
+        Count++;
+        Result = true;
+    }
+    return Result;
+}
+
+/* Add an integer value
+ */
+bool TelemetryEncoder::AddInteger( uint8_t Id, uint8_t Type, int64_t Value )
+{
+    const uint8_t ValueSize = TypeSize( Type );
+    bool Result = false;
+    if ( ( ValueSize > 0u ) && ( Type != TELEMETRY_F32 ) && ( Type != TELEMETRY_F64 )
+      && ( ( Length + 2u + ValueSize ) <= Size ) && ( Count < TELEMETRY_MAX_FIELDS ) )
+    {
+        Buffer[Length] = Id;
+        Buffer[Length + 1u] = Type;
+        WriteLittleEndian( &Buffer[Length + 2u], (uint64_t)Value, ValueSize );
+        Length += 2u + ValueSize;
+        Count++;
+        Result = true;
+    }
+    return Result;
+}
+
+/* Add a float value
+ */
+bool TelemetryEncoder::AddReal( uint8_t Id, uint8_t Type, double Value )
+{
+    const uint8_t ValueSize = TypeSize( Type );
+    bool Result = false;
+    if ( ( ( Type == TELEMETRY_F32 ) || ( Type == TELEMETRY_F64 ) )
+      && ( ( Length + 2u + ValueSize ) <= Size ) && ( Count < TELEMETRY_MAX_FIELDS ) )
+    {
+        Buffer[Length] = Id;
+        Buffer[Length + 1u] = Type;
+        if ( Type == TELEMETRY_F32 )
+        {
+            const float Single = (float)Value;
+            uint32_t Bits;
+            memcpy( &Bits, &Single, sizeof( Bits ) );
+            WriteLittleEndian( &Buffer[Length + 2u], Bits, ValueSize );
+        }
+        else
+        {
+            uint64_t Bits;
+            memcpy( &Bits, &Value, sizeof( Bits ) );
+            WriteLittleEndian( &Buffer[Length + 2u], Bits, ValueSize );
+        }
+        Length += 2u + ValueSize;
+        Count++;
+        Result = true;
+    }
+    return Result;
+}
+
+/* Add a decoded value
+ */
+bool TelemetryEncoder::AddValue( const TELEMETRY_VALUE_T* Value )
+{
+    bool Result = false;
+    if ( ( Value->Type == TELEMETRY_F32 ) || ( Value->Type == TELEMETRY_F64 ) )
+    {
+        Result = AddReal( Value->Id, Value->Type, Value->Real );
+    }
+    else
+    {
+        Result = AddInteger( Value->Id, Value->Type, Value->Integer );
+    }
+    return Result;
+}
+
+/* Complete the header
+ */
+uint32_t TelemetryEncoder::Finish( void )
+{
+    WriteLittleEndian( &Buffer[2], Length, 2u );
+    Buffer[5] = Count;
+    return Length;
+}
+
+/* Size of a value
+ */
+uint8_t TelemetryEncoder::TypeSize( uint8_t Type )
+{
+    static const uint8_t Sizes[] = { 0u, 1u, 1u, 2u, 2u, 4u, 4u, 8u, 4u, 8u };
+    return ( Type < sizeof( Sizes ) ) ? Sizes[Type] : 0u;
+}
+
+/* Constructor
+ */
+TelemetryDecoder::TelemetryDecoder( void )
+{
+    Type = 0u;
+    Sequence = 0u;
+    Count = 0u;
+}
+
+/* Find the length of the frame at the start of a stream
+ */
+uint32_t TelemetryDecoder::FrameLength( const uint8_t* Data, uint32_t Count )
+{
+    uint32_t Length = 0u;
+    if ( ( Count >= 1u ) && ( Data[0] != TELEMETRY_MAGIC ) )
+    {
+        Length = TELEMETRY_MAX_FRAME + 1u;
+    }
+    else if ( Count >= 4u )
+    {
+        Length = (uint32_t)ReadLittleEndian( &Data[2], 2u );
+        if ( ( Data[1] != TELEMETRY_VERSION ) || ( Length < TELEMETRY_HEADER_SIZE ) )
+        {
+            Length = TELEMETRY_MAX_FRAME + 1u;
+        }
+        else if ( ( Length <= TELEMETRY_MAX_FRAME ) && ( Length > Count ) )
+        {
+            /* wait for the rest */
+            Length = 0u;
+        }
+    }
+    return Length;
+}
+
+/* Unpack a whole frame
+ */
+bool TelemetryDecoder::Decode( const uint8_t* Frame, uint32_t Length )
+{
+    uint32_t Offset = TELEMETRY_HEADER_SIZE;
+    uint8_t Index = 0u;
+    bool Result = ( FrameLength( Frame, Length ) == Length ) && ( Length <= TELEMETRY_MAX_FRAME );
+    Count = 0u;
+    if ( Result )
+    {
+        Type = Frame[4];
+        Sequence = (uint16_t)ReadLittleEndian( &Frame[6], 2u );
+        for ( Index = 0u; Result && ( Index < Frame[5] ); Index++ )
+        {
+            TELEMETRY_VALUE_T* Field = &Fields[Index];
+            memset( Field, 0, sizeof( *Field ) );
+            if ( Type == TELEMETRY_REQUEST )
+            {
+                Result = ( Offset < Length );
+                if ( Result )
+                {
+                    Field->Id = Frame[Offset++];
+                }
+            }
+            else
+            {
+                uint8_t ValueSize = 0u;
+                Result = ( ( Offset + 2u ) <= Length );
+                if ( Result )
+                {
+                    Field->Id = Frame[Offset];
+                    Field->Type = Frame[Offset + 1u];
+                    ValueSize = TelemetryEncoder::TypeSize( Field->Type );
+                    Offset += 2u;
+                    Result = ( ValueSize > 0u ) && ( ( Offset + ValueSize ) <= Length );
+                }
+                if ( Result )
+                {
+                    const uint64_t Bits = ReadLittleEndian( &Frame[Offset], ValueSize );
+                    switch ( Field->Type )
+                    {
+                        case TELEMETRY_I8:  Field->Integer = (int8_t)Bits; break;
+                        case TELEMETRY_I16: Field->Integer = (int16_t)Bits; break;
+                        case TELEMETRY_I32: Field->Integer = (int32_t)Bits; break;
+                        case TELEMETRY_F32:
+                        {
+                            const uint32_t Single = (uint32_t)Bits;
+                            float Value;
+                            memcpy( &Value, &Single, sizeof( Value ) );
+                            Field->Real = Value;
+                            break;
+                        }
+                        case TELEMETRY_F64:
+                        {
+                            memcpy( &Field->Real, &Bits, sizeof( Field->Real ) );
+                            break;
+                        }
+                        default:            Field->Integer = (int64_t)Bits; break;
+                    }
+                    Offset += ValueSize;
+                }
+            }
+        }
+        Result = Result && ( Offset == Length );
+    }
+    if ( Result )
+    {
+        Count = Index;
+    }
+    return Result;
+}
+
+/* Get the frame type
+ */
+uint8_t TelemetryDecoder::GetType( void )
+{
+    return Type;
+}
+
+/* Get the sequence number
+ */
+uint16_t TelemetryDecoder::GetSequence( void )
+{
+    return Sequence;
+}
+
+/* Get the number of fields
+ */
+uint8_t TelemetryDecoder::GetCount( void )
+{
+    return Count;
+}
+
+/* Get a field
+ */
+const TELEMETRY_VALUE_T* TelemetryDecoder::GetField( uint8_t Index )
+{
+    return ( Index < Count ) ? &Fields[Index] : NULL;
+}
+
+/* Find a field by id
+ */
+const TELEMETRY_VALUE_T* TelemetryDecoder::Find( uint8_t Id )
+{
+    const TELEMETRY_VALUE_T* Field = NULL;
+    uint8_t Index;
+    for ( Index = 0u; ( Field == NULL ) && ( Index < Count ); Index++ )
+    {
+        if ( Fields[Index].Id == Id )
+        {
+            Field = &Fields[Index];
+        }
+    }
+    return Field;
+}
@@ -0,0 +1,245 @@
+/**
+TelemetryProtocol is the binary form of the TelescopeSocket protocol.
+The frames are served on the same port as the text commands, a binary
+frame is told apart by its first byte, which is never a text character.
+Clients build their requests with TelemetryEncoder and read the replies
+with TelemetryDecoder, neither depends on the rest of StarPi.
+
+Frame layout, all values are little endian:
+  0  uint8   TELEMETRY_MAGIC
+  1  uint8   TELEMETRY_VERSION
+  2  uint16  length of the whole frame in bytes
+  4  uint8   frame type, TELEMETRY_FRAME_T
+  5  uint8   number of fields
+  6  uint16  sequence number, a reply carries the one from its request,
+          a broadcast carries one more than the last so a receiver can
+          tell when it has missed one
+  8          the fields
+
+A request field is a field id, a request with no fields asks for all of
+them. A data field is the field id, the value type and the value, so a
+client can skip the fields it does not know.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TELEMETRYPROTOCOL_H
+#define TELEMETRYPROTOCOL_H
+
+#include <stdint.h>
+
+/* Configuration */
+
+#define TELEMETRY_MAGIC        0xB5u   /**< first byte of every frame, above any text character */
+#define TELEMETRY_VERSION      1u      /**< changed when the layout changes */
+#define TELEMETRY_HEADER_SIZE  8u      /**< bytes before the first field */
+#define TELEMETRY_MAX_FRAME    1024u   /**< longest frame either side will send */
+#define TELEMETRY_MAX_FIELDS   255u    /**< the field count is one byte */
+
+/** Frame types
+ */
+typedef enum
+{
+    TELEMETRY_REQUEST = 1,   /**< client asks for fields */
+    TELEMETRY_DATA    = 2,   /**< server sends values */
+    TELEMETRY_ERROR   = 3,   /**< request was not understood, no fields */
+    TELEMETRY_BROADCAST = 4  /**< server sends values unasked, see TelemetryMulticast */
+} TELEMETRY_FRAME_T;
+
+/** Value types, the size of each is given by TelemetryEncoder::TypeSize
+ */
+typedef enum
+{
+    TELEMETRY_I8  = 1,
+    TELEMETRY_U8  = 2,
+    TELEMETRY_I16 = 3,
+    TELEMETRY_U16 = 4,
+    TELEMETRY_I32 = 5,
+    TELEMETRY_U32 = 6,
+    TELEMETRY_I64 = 7,
+    TELEMETRY_F32 = 8,
+    TELEMETRY_F64 = 9
+} TELEMETRY_TYPE_T;
+
+/** Field ids, new fields are added at the end so the ids never change
+ */
+typedef enum
+{
+    TELEMETRY_RIGHT_ASCENSION = 0,        /**< F64 radians */
+    TELEMETRY_DECLINATION,                /**< F64 radians */
+    TELEMETRY_TARGET_RIGHT_ASCENSION,     /**< F64 radians */
+    TELEMETRY_TARGET_DECLINATION,         /**< F64 radians */
+    TELEMETRY_UNIX_TIME,                  /**< I64 seconds */
+    TELEMETRY_YEAR,                       /**< U16 */
+    TELEMETRY_MONTH,                      /**< U16 */
+    TELEMETRY_DAY,                        /**< U16 */
+    TELEMETRY_HOUR,                       /**< U16 */
+    TELEMETRY_MINUTE,                     /**< U16 */
+    TELEMETRY_SECOND,                     /**< U16 */
+    TELEMETRY_BST,                        /**< U8 1 in British summer time */
+    TELEMETRY_ALTITUDE,                   /**< F32 pitch in degrees */
+    TELEMETRY_AZIMUTH,                    /**< F32 degrees */
+    TELEMETRY_ROLL,                       /**< F32 radians */
+    TELEMETRY_MAGNETIC_HEADING,           /**< F32 degrees */
+    TELEMETRY_MAGNETIC_DECLINATION,       /**< F32 degrees */
+    TELEMETRY_HEIGHT,                     /**< F32 km */
+    TELEMETRY_RIGHT_ASCENSION_HOURS,      /**< I8 */
+    TELEMETRY_RIGHT_ASCENSION_MINUTES,    /**< I8 */
+    TELEMETRY_RIGHT_ASCENSION_SECONDS,    /**< I8 */
+    TELEMETRY_DECLINATION_DEGREES,        /**< I8 */
+    TELEMETRY_DECLINATION_MINUTES,        /**< I8 */
+    TELEMETRY_DECLINATION_SECONDS,        /**< I8 */
+    TELEMETRY_GPS_MODE,                   /**< U8 */
+    TELEMETRY_LATITUDE,                   /**< F32 degrees */
+    TELEMETRY_LONGITUDE,                  /**< F32 degrees */
+    TELEMETRY_LATITUDE_DEGREES,           /**< I8 */
+    TELEMETRY_LATITUDE_MINUTES,           /**< I8 */
+    TELEMETRY_LATITUDE_SECONDS,           /**< I8 */
+    TELEMETRY_LONGITUDE_DEGREES,          /**< I8 */
+    TELEMETRY_LONGITUDE_MINUTES,          /**< I8 */
+    TELEMETRY_LONGITUDE_SECONDS,          /**< I8 */
+    TELEMETRY_ACCEL_X,                    /**< F32 raw accelerometer */
+    TELEMETRY_ACCEL_Y,
+    TELEMETRY_ACCEL_Z,
+    TELEMETRY_ACCEL_MIN_X,                /**< F32 */
+    TELEMETRY_ACCEL_MIN_Y,
+    TELEMETRY_ACCEL_MIN_Z,
+    TELEMETRY_ACCEL_MAX_X,                /**< F32 */
+    TELEMETRY_ACCEL_MAX_Y,
+    TELEMETRY_ACCEL_MAX_Z,
+    TELEMETRY_MAG_X,                      /**< F32 raw magnetometer */
+    TELEMETRY_MAG_Y,
+    TELEMETRY_MAG_Z,
+    TELEMETRY_MAG_MIN_X,                  /**< F32 */
+    TELEMETRY_MAG_MIN_Y,
+    TELEMETRY_MAG_MIN_Z,
+    TELEMETRY_MAG_MAX_X,                  /**< F32 */
+    TELEMETRY_MAG_MAX_Y,
+    TELEMETRY_MAG_MAX_Z,
+    TELEMETRY_MAGNETIC_OFFSET,            /**< F32 degrees */
+    TELEMETRY_ACCEL_OFFSET,               /**< F32 degrees */
+    TELEMETRY_SAMPLE_TIME,                /**< I64 microseconds since 1970 the orientation was read */
+    TELEMETRY_FIELD_COUNT
+} TELEMETRY_FIELD_T;
+
+/** One decoded field
+ */
+typedef struct
+{
+    uint8_t Id;            /**< TELEMETRY_FIELD_T */
+    uint8_t Type;          /**< TELEMETRY_TYPE_T */
+    int64_t Integer;       /**< value of the integer types */
+    double  Real;          /**< value of the float types */
+} TELEMETRY_VALUE_T;
+
+/** TelemetryEncoder
+ * - Builds a frame in a caller's buffer
+ */
+class TelemetryEncoder
+{
+    public:
+    /** Constructor
+     * @param Buffer where the frame is built
+     * @param Size size of the buffer
+     */
+        TelemetryEncoder( uint8_t* Buffer, uint32_t Size );
+    /** Start a new frame
+     * @param Type TELEMETRY_FRAME_T
+     * @param Sequence sequence number
+     */
+        void Begin( uint8_t Type, uint16_t Sequence );
+    /** Add a field id to a request
+     * @return bool false if the frame is full
+     */
+        bool AddRequest( uint8_t Id );
+    /** Add an integer value
+     * @param Type one of the integer TELEMETRY_TYPE_T
+     * @return bool false if the frame is full
+     */
+        bool AddInteger( uint8_t Id, uint8_t Type, int64_t Value );
+    /** Add a float value
+     * @param Type TELEMETRY_F32 or TELEMETRY_F64
+     * @return bool false if the frame is full
+     */
+        bool AddReal( uint8_t Id, uint8_t Type, double Value );
+    /** Add a decoded value
+     * @return bool false if the frame is full
+     */
+        bool AddValue( const TELEMETRY_VALUE_T* Value );
+    /** Complete the header
+     * @return uint32_t length of the frame
+     */
+        uint32_t Finish( void );
+    /** Size of a value
+     * @return uint8_t bytes, 0 for an unknown type
+     */
+        static uint8_t TypeSize( uint8_t Type );
+
+    private:
+        uint8_t* Buffer;       /**< the frame */
+        uint32_t Size;         /**< size of the buffer */
+        uint32_t Length;       /**< bytes used */
+        uint8_t  Count;        /**< fields added */
+};
+
+/** TelemetryDecoder
+ * - Checks a received frame and unpacks its fields
+ */
+class TelemetryDecoder
+{
+    public:
+    /** Constructor
+     */
+        TelemetryDecoder( void );
+    /** Find the length of the frame at the start of a stream
+     * @param Data received bytes
+     * @param Count number of received bytes
+     * @return uint32_t length of the frame, 0 if more bytes are needed,
+     *         more than TELEMETRY_MAX_FRAME if it is not a valid frame
+     */
+        static uint32_t FrameLength( const uint8_t* Data, uint32_t Count );
+    /** Unpack a whole frame
+     * @return bool false if the frame is not valid
+     */
+        bool Decode( const uint8_t* Frame, uint32_t Length );
+    /** Get the frame type
+     */
+        uint8_t GetType( void );
+    /** Get the sequence number
+     */
+        uint16_t GetSequence( void );
+    /** Get the number of fields
+     */
+        uint8_t GetCount( void );
+    /** Get a field
+     * @param Index 0 to GetCount() - 1
+     * @return const TELEMETRY_VALUE_T* the field, for a request only Id is set
+     */
+        const TELEMETRY_VALUE_T* GetField( uint8_t Index );
+    /** Find a field by id
+     * @return const TELEMETRY_VALUE_T* the field, NULL if it is not in the frame
+     */
+        const TELEMETRY_VALUE_T* Find( uint8_t Id );
+
+    private:
+        uint8_t  Type;                                /**< frame type */
+        uint16_t Sequence;                            /**< sequence number */
+        uint8_t  Count;                               /**< number of fields */
+        TELEMETRY_VALUE_T Fields[TELEMETRY_MAX_FIELDS];   /**< unpacked fields */
+};
+
+#endif /* TELEMETRYPROTOCOL_H */
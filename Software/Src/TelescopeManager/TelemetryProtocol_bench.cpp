@@ -0,0 +1,325 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "HalReactor.h"
+#include "HalSocket.h"
+#include "TelemetryProtocol.h"
+/*
+ Binary telemetry benchmark
+ Compares the text protocol with the binary one for a refresh of every
+ field: the cost of encoding and decoding, the bytes on the wire, the
+ precision of the right ascension, and the refreshes per second through
+ HalSocket on the loopback interface. Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/TelescopeManager -I./Src/Utils \
+     Src/TelescopeManager/TelemetryProtocol_bench.cpp Src/TelescopeManager/TelemetryProtocol.cpp \
+     Src/Hal/HalReactor.cpp Src/Hal/HalSocket.cpp Src/Utils/Metrics.cpp \
+     -lpthread -latomic -o TelemetryProtocol_bench
+
+ HalSocket logs the connection to stdout, the results go to stderr:
+ ./TelemetryProtocol_bench > /dev/null
+ */
+
+#define BENCH_PORT          19996
+#define BENCH_CODEC_LOOPS   100000
+#define BENCH_REFRESHES     2000
+#define BENCH_TIMEOUT_MS    2000
+
+static TELEMETRY_VALUE_T values[TELEMETRY_FIELD_COUNT];
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* the same types as TelescopeSocket, with values that change a little each refresh */
+static void updateValues(uint32_t refresh)
+{
+    for (uint8_t id = 0; id < TELEMETRY_FIELD_COUNT; id++)
+    {
+        TELEMETRY_VALUE_T* value = &values[id];
+        value->Id = id;
+        if (id <= TELEMETRY_TARGET_DECLINATION)
+        {
+            value->Type = TELEMETRY_F64;
+            value->Real = 1.2345678901234 + (id * 0.1) + (refresh * 1.0e-9);
+        }
+        else if ((id == TELEMETRY_UNIX_TIME) || (id == TELEMETRY_SAMPLE_TIME))
+        {
+            value->Type = TELEMETRY_I64;
+            value->Integer = 1530000000 + refresh;
+        }
+        else if (id <= TELEMETRY_SECOND)
+        {
+            value->Type = TELEMETRY_U16;
+            value->Integer = 2018 - (id * 100);
+        }
+        else if ((id == TELEMETRY_BST) || (id == TELEMETRY_GPS_MODE))
+        {
+            value->Type = TELEMETRY_U8;
+            value->Integer = 1;
+        }
+        else if (((id >= TELEMETRY_RIGHT_ASCENSION_HOURS) && (id <= TELEMETRY_DECLINATION_SECONDS))
+                 || ((id >= TELEMETRY_LATITUDE_DEGREES) && (id <= TELEMETRY_LONGITUDE_SECONDS)))
+        {
+            value->Type = TELEMETRY_I8;
+            value->Integer = (id * 7) % 60;
+        }
+        else
+        {
+            value->Type = TELEMETRY_F32;
+            value->Real = (float)(sin(id + (refresh * 0.001)) * 180.0);
+        }
+    }
+}
+
+/* text protocol, one "Fnnn=value#" record per field as the handlers write them */
+static uint32_t encodeText(uint8_t id, char* buffer)
+{
+    const TELEMETRY_VALUE_T* value = &values[id];
+    if ((value->Type == TELEMETRY_F32) || (value->Type == TELEMETRY_F64))
+    {
+        return sprintf(buffer, "F%03u=%f#", id, (float)value->Real);
+    }
+    return sprintf(buffer, "F%03u=%d#", id, (int)value->Integer);
+}
+
+/* what a text client does with the records */
+static uint32_t decodeText(const char* text, uint32_t length, double* decoded)
+{
+    uint32_t count = 0;
+    const char* end = text + length;
+    while (text < end)
+    {
+        const unsigned id = ((text[1] - '0') * 100) + ((text[2] - '0') * 10) + (text[3] - '0');
+        char* next = NULL;
+        const double value = strtod(&text[5], &next);
+        if ((id < TELEMETRY_FIELD_COUNT) && (next != NULL) && (*next == '#'))
+        {
+            decoded[id] = value;
+            count++;
+        }
+        text = (next != NULL) ? next + 1 : end;
+    }
+    return count;
+}
+
+static uint32_t encodeBinary(uint8_t* frame, uint16_t sequence)
+{
+    TelemetryEncoder encoder(frame, TELEMETRY_MAX_FRAME);
+    encoder.Begin(TELEMETRY_DATA, sequence);
+    for (uint8_t id = 0; id < TELEMETRY_FIELD_COUNT; id++)
+    {
+        encoder.AddValue(&values[id]);
+    }
+    return encoder.Finish();
+}
+
+/* HalSocket protocol handlers */
+static void textCallback(char* buffer)
+{
+    const unsigned id = ((buffer[1] - '0') * 100) + ((buffer[2] - '0') * 10) + (buffer[3] - '0');
+    if ((buffer[0] == 'F') && (id < TELEMETRY_FIELD_COUNT))
+    {
+        encodeText(id, buffer);
+    }
+    else
+    {
+        strcpy(buffer, "Not Supported#");
+    }
+}
+
+static uint32_t binaryLength(const uint8_t* data, uint32_t count)
+{
+    return TelemetryDecoder::FrameLength(data, count);
+}
+
+static uint32_t binaryCallback(const uint8_t* request, uint32_t length, uint8_t* reply)
+{
+    TelemetryDecoder decoder;
+    if (!decoder.Decode(request, length))
+    {
+        return 0;
+    }
+    return encodeBinary(reply, decoder.GetSequence());
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+/* read until the buffer holds a whole reply, false on timeout or error */
+static bool readReply(int fd, char* data, uint32_t size, uint32_t* got, bool (*complete)(const char*, uint32_t))
+{
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = POLLIN;
+    *got = 0;
+    while (!complete(data, *got))
+    {
+        if ((*got >= size) || (poll(&pfd, 1, BENCH_TIMEOUT_MS) != 1))
+        {
+            return false;
+        }
+        const ssize_t rc = read(fd, data + *got, size - *got);
+        if (rc <= 0)
+        {
+            return false;
+        }
+        *got += rc;
+    }
+    return true;
+}
+
+static bool textComplete(const char* data, uint32_t length)
+{
+    uint32_t records = 0;
+    for (uint32_t index = 0; index < length; index++)
+    {
+        records += (data[index] == '#') ? 1 : 0;
+    }
+    return records == TELEMETRY_FIELD_COUNT;
+}
+
+static bool binaryComplete(const char* data, uint32_t length)
+{
+    const uint32_t frame = TelemetryDecoder::FrameLength((const uint8_t*)data, length);
+    return (frame > 0) && (frame <= length);
+}
+
+int main()
+{
+    static char text[HAL_SOCKET_REPLY_SIZE];
+    static uint8_t frame[TELEMETRY_MAX_FRAME];
+    static double decoded[TELEMETRY_FIELD_COUNT];
+    TelemetryDecoder decoder;
+    uint32_t textLength = 0;
+    uint32_t frameLength = 0;
+    uint32_t fields = 0;
+    double start = 0.0;
+    double textTime = 0.0;
+    double binaryTime = 0.0;
+    int failures = 0;
+
+    /* encode and decode a refresh of every field */
+    start = seconds();
+    for (uint32_t loop = 0; loop < BENCH_CODEC_LOOPS; loop++)
+    {
+        updateValues(loop);
+        textLength = 0;
+        for (uint8_t id = 0; id < TELEMETRY_FIELD_COUNT; id++)
+        {
+            textLength += encodeText(id, &text[textLength]);
+        }
+        fields += decodeText(text, textLength, decoded);
+    }
+    textTime = seconds() - start;
+    start = seconds();
+    for (uint32_t loop = 0; loop < BENCH_CODEC_LOOPS; loop++)
+    {
+        updateValues(loop);
+        frameLength = encodeBinary(frame, (uint16_t)loop);
+        if (decoder.Decode(frame, frameLength))
+        {
+            fields += decoder.GetCount();
+        }
+    }
+    binaryTime = seconds() - start;
+    if (fields != (2u * BENCH_CODEC_LOOPS * TELEMETRY_FIELD_COUNT))
+    {
+        fprintf(stderr, "FAIL: fields lost in the codec loops\n");
+        failures++;
+    }
+    fprintf(stderr, "codec: text %.0f refreshes/s %u bytes, binary %.0f refreshes/s %u bytes, %.1fx faster\n",
+            BENCH_CODEC_LOOPS / textTime, textLength, BENCH_CODEC_LOOPS / binaryTime, frameLength, textTime / binaryTime);
+    fprintf(stderr, "right ascension error: text %.3g rad, binary %.3g rad\n",
+            fabs(decoded[TELEMETRY_RIGHT_ASCENSION] - values[TELEMETRY_RIGHT_ASCENSION].Real),
+            fabs(decoder.Find(TELEMETRY_RIGHT_ASCENSION)->Real - values[TELEMETRY_RIGHT_ASCENSION].Real));
+
+    /* the same refresh through HalSocket, every text request is pipelined */
+    if (!HalReactor::Reactor.Init())
+    {
+        return 1;
+    }
+    HalSocket::Socket.Init(BENCH_PORT, &textCallback);
+    HalSocket::Socket.SetBinaryCallback(&binaryLength, &binaryCallback);
+    HalReactor::Reactor.Start();
+    int fd = connectTo(BENCH_PORT);
+    {
+        char requests[TELEMETRY_FIELD_COUNT * 5];
+        for (uint8_t id = 0; id < TELEMETRY_FIELD_COUNT; id++)
+        {
+            sprintf(&requests[id * 5], "F%03u#", id);
+        }
+        start = seconds();
+        for (uint32_t refresh = 0; (fd >= 0) && (refresh < BENCH_REFRESHES); refresh++)
+        {
+            if ((write(fd, requests, sizeof(requests)) != (ssize_t)sizeof(requests))
+                || !readReply(fd, text, sizeof(text), &textLength, &textComplete)
+                || (decodeText(text, textLength, decoded) != TELEMETRY_FIELD_COUNT))
+            {
+                fprintf(stderr, "FAIL: text refresh %u\n", refresh);
+                failures++;
+                break;
+            }
+        }
+        textTime = seconds() - start;
+    }
+    {
+        uint8_t request[TELEMETRY_HEADER_SIZE];
+        uint32_t got = 0;
+        start = seconds();
+        for (uint32_t refresh = 0; (fd >= 0) && (refresh < BENCH_REFRESHES); refresh++)
+        {
+            TelemetryEncoder encoder(request, sizeof(request));
+            encoder.Begin(TELEMETRY_REQUEST, (uint16_t)refresh);
+            const uint32_t length = encoder.Finish();
+            if ((write(fd, request, length) != (ssize_t)length)
+                || !readReply(fd, (char*)frame, sizeof(frame), &got, &binaryComplete)
+                || !decoder.Decode(frame, got) || (decoder.GetCount() != TELEMETRY_FIELD_COUNT)
+                || (decoder.GetSequence() != (uint16_t)refresh))
+            {
+                fprintf(stderr, "FAIL: binary refresh %u\n", refresh);
+                failures++;
+                break;
+            }
+        }
+        binaryTime = seconds() - start;
+    }
+    fprintf(stderr, "loopback: text %.0f refreshes/s, binary %.0f refreshes/s, %.1fx faster\n",
+            BENCH_REFRESHES / textTime, BENCH_REFRESHES / binaryTime, textTime / binaryTime);
+    close(fd);
+    HalReactor::Reactor.Stop();
+    HalSocket::Socket.Close();
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+/*
+TelemetryReceiver joins the TelemetryMulticast group and decodes the
+broadcasts, for the displays. It counts the broadcasts it missed from the
+gaps in the sequence numbers, and drops any that arrive after a later one
+or twice. Like TelemetryDecoder, it does not depend on the rest of StarPi.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include "TelemetryReceiver.h"
+
+/* Constructor
+ */
+TelemetryReceiver::TelemetryReceiver( void )
+{
+    Fd = -1;
+    Synchronised = false;
+    Expected = 0u;
+    Window = 0u;
+    Received = 0u;
+    Lost = 0u;
+    Late = 0u;
+}
+
+/* Open
+ * Join the group, several receivers on one machine may share the port
+ */
+bool TelemetryReceiver::Open( const char* Group, uint16_t Port, const char* Interface )
+{
+    const int Reuse = 1;
+    struct sockaddr_in Address;
+    struct ip_mreq Membership;
+    bool Result = false;
+    memset( &Address, 0, sizeof( Address ) );
+    memset( &Membership, 0, sizeof( Membership ) );
+    Address.sin_family = AF_INET;
+    Address.sin_port = htons( Port );
+    Membership.imr_interface.s_addr = htonl( INADDR_ANY );
+    /* bound to the group, so only its datagrams arrive on the port */
+    if ( ( inet_pton( AF_INET, Group, &Membership.imr_multiaddr ) != 1 )
+      || ( ( Interface != NULL ) && ( inet_pton( AF_INET, Interface, &Membership.imr_interface ) != 1 ) ) )
+    {
+        printf( "TelemetryReceiver: not an address\n" );
+        return false;
+    }
+    Address.sin_addr = Membership.imr_multiaddr;
+    Fd = socket( AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+    if ( Fd >= 0 )
+    {
+        Result = ( setsockopt( Fd, SOL_SOCKET, SO_REUSEADDR, &Reuse, sizeof( Reuse ) ) == 0 )
+              && ( bind( Fd, (struct sockaddr*)&Address, sizeof( Address ) ) == 0 )
+              && ( setsockopt( Fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &Membership, sizeof( Membership ) ) == 0 );
+    }
+    if ( !Result )
+    {
+        perror( "TelemetryReceiver" );
+        Close();
+    }
+    Synchronised = false;
+    return Result;
+}
+
+/* Close
+ * Leave the group
+ */
+void TelemetryReceiver::Close( void )
+{
+    if ( Fd >= 0 )
+    {
+        close( Fd );
+        Fd = -1;
+    }
+}
+
+/* GetFd
+ * Get the socket, to wait for it to be readable
+ */
+int TelemetryReceiver::GetFd( void )
+{
+    return Fd;
+}
+
+/* Receive
+ * Read datagrams until there is a new broadcast or none are left
+ */
+bool TelemetryReceiver::Receive( void )
+{
+    uint8_t Datagram[TELEMETRY_MAX_FRAME];
+    while ( Fd >= 0 )
+    {
+        const ssize_t Rc = recv( Fd, Datagram, sizeof( Datagram ), 0 );
+        if ( Rc < 0 )
+        {
+            if ( errno != EINTR )
+            {
+                return false;
+            }
+        }
+        else if ( ( TelemetryDecoder::FrameLength( Datagram, Rc ) == (uint32_t)Rc )
+               && ( Datagram[4] == TELEMETRY_BROADCAST ) )
+        {
+            /* the sequence is checked first so a late one leaves the last values */
+            const uint16_t Sequence = (uint16_t)( Datagram[6] | ( Datagram[7] << 8 ) );
+            if ( CheckSequence( Sequence ) && Decoder.Decode( Datagram, Rc ) )
+            {
+                Received++;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/* GetDecoder
+ * Get the values of the last broadcast received
+ */
+TelemetryDecoder& TelemetryReceiver::GetDecoder( void )
+{
+    return Decoder;
+}
+
+/* GetReceived
+ */
+uint32_t TelemetryReceiver::GetReceived( void )
+{
+    return Received;
+}
+
+/* GetLost
+ */
+uint32_t TelemetryReceiver::GetLost( void )
+{
+    return Lost;
+}
+
+/* GetLate
+ */
+uint32_t TelemetryReceiver::GetLate( void )
+{
+    return Late;
+}
+
+/* CheckSequence
+ * Count the broadcasts missed before this one
+ */
+bool TelemetryReceiver::CheckSequence( uint16_t Sequence )
+{
+    const uint16_t Ahead = (uint16_t)( Sequence - Expected );
+    const uint16_t Behind = (uint16_t)( Expected - Sequence );
+    if ( Synchronised && ( Ahead != 0u ) )
+    {
+        if ( Ahead < 0x8000u )
+        {
+            Lost += Ahead;
+            Window = ( Ahead < 63u ) ? ( Window << Ahead ) : 0u;
+        }
+        else if ( Behind <= TELEMETRY_RECEIVER_REORDER )
+        {
+            const uint64_t Bit = (uint64_t)1u << ( Behind - 1u );
+            if ( ( Window & Bit ) == 0u )
+            {
+                /* it was counted as missed when a later one arrived */
+                Window |= Bit;
+                Lost--;
+            }
+            Late++;
+            return false;
+        }
+        else
+        {
+            /* StarPi has restarted, start again from this one */
+            Synchronised = false;
+        }
+    }
+    if ( !Synchronised )
+    {
+        /* any from before this one are not counted as missed */
+        Window = ~(uint64_t)0u;
+    }
+    Synchronised = true;
+    Expected = Sequence + 1u;
+    Window = ( Window << 1u ) | 1u;
+    return true;
+}
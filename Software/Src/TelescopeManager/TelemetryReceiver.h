@@ -0,0 +1,91 @@
+/**
+TelemetryReceiver joins the TelemetryMulticast group and decodes the
+broadcasts, for the displays. It counts the broadcasts it missed from the
+gaps in the sequence numbers, and drops any that arrive after a later one
+or twice. Like TelemetryDecoder, it does not depend on the rest of StarPi.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TELEMETRY_RECEIVER_H
+#define TELEMETRY_RECEIVER_H
+
+#include <stdint.h>
+#include "TelemetryProtocol.h"
+
+/* Configuration */
+
+#define TELEMETRY_RECEIVER_REORDER  64u   /**< a broadcast further behind than this means StarPi restarted, at most 64 */
+
+/** TelemetryReceiver
+ * - Receives the telemetry broadcasts
+ */
+class TelemetryReceiver
+{
+    public:
+    /** Constructor
+     */
+        TelemetryReceiver( void );
+    /** Join the group, several receivers on one machine may share the port
+     * @param Group multicast address, TELEMETRY_MULTICAST_GROUP
+     * @param Port TELEMETRY_MULTICAST_PORT
+     * @param Interface address of the interface to join on, NULL for the one the routes choose
+     * @return bool true if successful
+     */
+        bool Open( const char* Group, uint16_t Port, const char* Interface );
+    /** Leave the group
+     */
+        void Close( void );
+    /** Get the socket, to wait for it to be readable
+     * @return int the socket, -1 if not open
+     */
+        int GetFd( void );
+    /** Read one datagram if there is one, it does not wait
+     * @return bool true if it was a new broadcast, its values are in GetDecoder
+     */
+        bool Receive( void );
+    /** Get the values of the last broadcast received
+     */
+        TelemetryDecoder& GetDecoder( void );
+    /** Get the number of broadcasts received
+     */
+        uint32_t GetReceived( void );
+    /** Get the number of broadcasts missed
+     */
+        uint32_t GetLost( void );
+    /** Get the number of broadcasts dropped as they arrived after a later one, or twice
+     */
+        uint32_t GetLate( void );
+
+    private:
+    /** Count the broadcasts missed before this one
+     * @param Sequence its sequence number
+     * @return bool false if it arrived after a later one
+     */
+        bool CheckSequence( uint16_t Sequence );
+
+        int Fd;                      /**< UDP socket, -1 if not open */
+        bool Synchronised;           /**< a broadcast has been received */
+        uint16_t Expected;           /**< sequence number of the next broadcast */
+        uint64_t Window;             /**< bit n is set if Expected - 1 - n has been received */
+        uint32_t Received;           /**< broadcasts received */
+        uint32_t Lost;               /**< broadcasts missed */
+        uint32_t Late;               /**< broadcasts dropped as late */
+        TelemetryDecoder Decoder;    /**< the last broadcast */
+};
+
+#endif /* TELEMETRY_RECEIVER_H */
@@ -0,0 +1,141 @@
+/*
+TelemetryShm writes the TelescopeManager values into a POSIX shared
+memory segment, for local programs that read them with
+TelemetryShmReader.h. It is a publish hook of the TelescopeManager, so
+it runs on the scheduler thread with the dispatch lock held and is the
+only writer. A write is the sequence made odd, the snapshot copied in and
+the sequence made even again, readers never hold it up.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "TelemetryShm.h"
+#include "TelescopeManager.h"
+
+TELEMETRY_SHM_T* TelemetryShm::Segment = NULL;
+
+/* Init
+ * Create the segment, or open the one left by the last run so the
+ * readers that have it mapped carry on
+ */
+bool TelemetryShm::Init( const char* Name )
+{
+    void* Mapping = MAP_FAILED;
+    const int Fd = shm_open( Name, O_RDWR | O_CREAT, 0644 );
+    if ( Fd < 0 )
+    {
+        perror( "TelemetryShm shm_open" );
+        return false;
+    }
+    if ( ftruncate( Fd, sizeof( TELEMETRY_SHM_T ) ) == 0 )
+    {
+        Mapping = mmap( NULL, sizeof( TELEMETRY_SHM_T ), PROT_READ | PROT_WRITE, MAP_SHARED, Fd, 0 );
+    }
+    if ( Mapping == MAP_FAILED )
+    {
+        perror( "TelemetryShm mmap" );
+        close( Fd );
+        return false;
+    }
+    close( Fd );
+    Segment = (TELEMETRY_SHM_T*)Mapping;
+    if ( ( Segment->Magic != TELEMETRY_SHM_MAGIC ) || ( Segment->Version != TELEMETRY_SHM_VERSION )
+      || ( Segment->Size != sizeof( TELEMETRY_SNAPSHOT_T ) ) )
+    {
+        /* new, or from a StarPi with a different layout */
+        __atomic_store_n( &Segment->Magic, 0u, __ATOMIC_RELEASE );
+        memset( &Segment->Snapshot, 0, sizeof( Segment->Snapshot ) );
+        Segment->Version = TELEMETRY_SHM_VERSION;
+        Segment->Size = sizeof( TELEMETRY_SNAPSHOT_T );
+        Segment->Sequence = 0u;
+        Segment->Reserved = 0u;
+        __atomic_store_n( &Segment->Magic, TELEMETRY_SHM_MAGIC, __ATOMIC_RELEASE );
+    }
+    else if ( ( Segment->Sequence & 1u ) != 0u )
+    {
+        /* the last run stopped part way through a write, the snapshot may
+           be half written so it is cleared and marked as never written.
+           The sequence stays odd while it is cleared */
+        memset( &Segment->Snapshot, 0, sizeof( Segment->Snapshot ) );
+        __atomic_store_n( &Segment->Sequence, 0u, __ATOMIC_RELEASE );
+    }
+    return true;
+}
+
+/* Close
+ * Unmap the segment, it is left for the next run
+ */
+void TelemetryShm::Close( void )
+{
+    if ( Segment != NULL )
+    {
+        munmap( Segment, sizeof( TELEMETRY_SHM_T ) );
+        Segment = NULL;
+    }
+}
+
+/* Publish
+ * Publish hook for the TelescopeManager, writes its latest values
+ */
+void TelemetryShm::Publish( void )
+{
+    TELEMETRY_SNAPSHOT_T Snapshot;
+    if ( Segment == NULL )
+    {
+        return;
+    }
+    memset( &Snapshot, 0, sizeof( Snapshot ) );
+    Snapshot.SampleTime = TelescopeManager::GetSampleTime();
+    Snapshot.UnixTime = TelescopeManager::Telescope.GetUnixTime();
+    TelescopeManager::GetRaDec( &Snapshot.RightAscension, &Snapshot.Declination );
+    TelescopeManager::GetTargetRaDec( &Snapshot.TargetRightAscension, &Snapshot.TargetDeclination );
+    Snapshot.Azimuth = TelescopeManager::Telescope.GetAzimuth();
+    Snapshot.Latitude = TelescopeManager::Telescope.GetLatitude();
+    Snapshot.Longitude = TelescopeManager::Telescope.GetLongitude();
+    Snapshot.Altitude = TelescopeManager::Telescope.GetPitch();
+    Snapshot.Heading = TelescopeManager::Telescope.GetHeading();
+    Snapshot.Roll = TelescopeManager::Telescope.GetRoll();
+    Snapshot.MagneticDeclination = TelescopeManager::Telescope.GetMagneticDeclination();
+    Snapshot.Height = TelescopeManager::Telescope.GetHieghtAboveGround();
+    Snapshot.GpsMode = TelescopeManager::Telescope.Getmode();
+    Write( &Snapshot );
+}
+
+/* Write
+ * Write a snapshot for the readers, single writer only
+ */
+void TelemetryShm::Write( const TELEMETRY_SNAPSHOT_T* Snapshot )
+{
+    if ( Segment == NULL )
+    {
+        return;
+    }
+    const uint32_t Sequence = Segment->Sequence;
+    /* 0 is kept for a segment that has never been written */
+    const uint32_t Next = ( ( Sequence + 2u ) == 0u ) ? 2u : ( Sequence + 2u );
+    __atomic_store_n( &Segment->Sequence, Sequence + 1u, __ATOMIC_RELAXED );
+    /* a reader that sees any of the new snapshot sees the odd sequence */
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+    memcpy( &Segment->Snapshot, Snapshot, sizeof( TELEMETRY_SNAPSHOT_T ) );
+    __atomic_store_n( &Segment->Sequence, Next, __ATOMIC_RELEASE );
+}
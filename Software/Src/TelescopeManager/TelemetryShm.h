@@ -0,0 +1,59 @@
+/**
+TelemetryShm writes the TelescopeManager values into a POSIX shared
+memory segment, for local programs that read them with
+TelemetryShmReader.h. It is a publish hook of the TelescopeManager, so
+it runs on the scheduler thread with the dispatch lock held and is the
+only writer. A write is the sequence made odd, the snapshot copied in and
+the sequence made even again, readers never hold it up.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TELEMETRY_SHM_H
+#define TELEMETRY_SHM_H
+
+#include <stdint.h>
+#include "TelemetryShmReader.h"
+
+/** TelemetryShm
+ * - Writer of the telemetry shared memory segment
+ */
+class TelemetryShm
+{
+    public:
+    /** Create the segment, or open the one left by the last run so the
+     *  readers that have it mapped carry on
+     * @param Name shm_open name, TELEMETRY_SHM_NAME
+     * @return bool true if successful
+     */
+        static bool Init( const char* Name );
+    /** Unmap the segment, it is left for the next run
+     */
+        static void Close( void );
+    /** Publish hook for the TelescopeManager, writes its latest values
+     */
+        static void Publish( void );
+    /** Write a snapshot for the readers, single writer only
+     * @param Snapshot the values
+     */
+        static void Write( const TELEMETRY_SNAPSHOT_T* Snapshot );
+
+    private:
+        static TELEMETRY_SHM_T* Segment;    /**< the mapping, NULL if not open */
+};
+
+#endif /* TELEMETRY_SHM_H */
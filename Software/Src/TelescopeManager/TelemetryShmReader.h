@@ -0,0 +1,177 @@
+/**
+TelemetryShmReader is the layout of the telemetry shared memory segment
+and a small reader for it, for local programs that want the pointing
+without a socket. StarPi writes a snapshot into the segment each time the
+TelescopeManager runs. The snapshot is guarded by a sequence lock, so a
+read is a copy of the snapshot between two loads of the sequence, with no
+system calls and without ever blocking StarPi.
+
+It is a C header as well as C++, and needs nothing else from StarPi:
+
+    TELEMETRY_SHM_READER_T Reader;
+    TELEMETRY_SNAPSHOT_T Snapshot;
+    if ( TelemetryShmOpen( &Reader, TELEMETRY_SHM_NAME ) && TelemetryShmRead( &Reader, &Snapshot ) )
+    {
+        ... Snapshot.RightAscension, Snapshot.Declination ...
+    }
+    TelemetryShmClose( &Reader );
+
+Link with -lrt on older C libraries.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TELEMETRY_SHM_READER_H
+#define TELEMETRY_SHM_READER_H
+
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* Configuration */
+
+#define TELEMETRY_SHM_NAME      "/StarPiTelemetry"  /**< shm_open name, the segment is /dev/shm/StarPiTelemetry */
+#define TELEMETRY_SHM_RETRIES   1000u               /**< reads attempted while the snapshot is being written */
+
+#define TELEMETRY_SHM_MAGIC     0x53505431u         /**< "SPT1" */
+#define TELEMETRY_SHM_VERSION   1u                  /**< changed when the snapshot layout changes */
+
+/** One set of values from a TelescopeManager run. The members are in
+ *  order of size so the layout is the same for every compiler.
+ */
+typedef struct
+{
+    int64_t SampleTime;             /**< when the orientation was read, microseconds since 1970 */
+    int64_t UnixTime;               /**< seconds since 1970, from the GPS when it has a fix */
+    double RightAscension;          /**< radians */
+    double Declination;             /**< radians */
+    double TargetRightAscension;    /**< radians, the last goto */
+    double TargetDeclination;       /**< radians, the last goto */
+    double Azimuth;                 /**< radians, corrected for the magnetic declination */
+    double Latitude;                /**< radians */
+    double Longitude;               /**< radians */
+    float Altitude;                 /**< radians, the pitch of the telescope */
+    float Heading;                  /**< radians, magnetic */
+    float Roll;                     /**< radians */
+    float MagneticDeclination;      /**< degrees */
+    float Height;                   /**< above sea level, km */
+    uint8_t GpsMode;                /**< gpsd fix mode */
+    uint8_t Reserved[3];
+} TELEMETRY_SNAPSHOT_T;
+
+/** The shared memory segment
+ */
+typedef struct
+{
+    uint32_t Magic;                 /**< TELEMETRY_SHM_MAGIC once the segment has been set up */
+    uint16_t Version;               /**< TELEMETRY_SHM_VERSION */
+    uint16_t Size;                  /**< sizeof( TELEMETRY_SNAPSHOT_T ) */
+    uint32_t Sequence;              /**< odd while the snapshot is being written, 0 before the first */
+    uint32_t Reserved;
+    TELEMETRY_SNAPSHOT_T Snapshot;
+} TELEMETRY_SHM_T;
+
+/** A reader's mapping of the segment
+ */
+typedef struct
+{
+    const TELEMETRY_SHM_T* Segment; /**< NULL if it is not open */
+} TELEMETRY_SHM_READER_T;
+
+/** Map the segment read only. It must have been created by StarPi, which
+ *  keeps it across restarts, so a reader can stay open.
+ * @param Reader the reader to open
+ * @param Name TELEMETRY_SHM_NAME
+ * @return int 1 if successful, 0 if there is no segment or it is a different version
+ */
+static inline int TelemetryShmOpen( TELEMETRY_SHM_READER_T* Reader, const char* Name )
+{
+    void* Mapping = MAP_FAILED;
+    const int Fd = shm_open( Name, O_RDONLY, 0 );
+    Reader->Segment = NULL;
+    if ( Fd >= 0 )
+    {
+        Mapping = mmap( NULL, sizeof( TELEMETRY_SHM_T ), PROT_READ, MAP_SHARED, Fd, 0 );
+        close( Fd );
+    }
+    if ( Mapping != MAP_FAILED )
+    {
+        const TELEMETRY_SHM_T* Segment = (const TELEMETRY_SHM_T*)Mapping;
+        if ( ( __atomic_load_n( &Segment->Magic, __ATOMIC_ACQUIRE ) == TELEMETRY_SHM_MAGIC )
+          && ( Segment->Version == TELEMETRY_SHM_VERSION )
+          && ( Segment->Size == sizeof( TELEMETRY_SNAPSHOT_T ) ) )
+        {
+            Reader->Segment = Segment;
+        }
+        else
+        {
+            munmap( Mapping, sizeof( TELEMETRY_SHM_T ) );
+        }
+    }
+    return ( Reader->Segment != NULL );
+}
+
+/** Copy the latest snapshot. If StarPi is writing it the copy is made
+ *  again, up to TELEMETRY_SHM_RETRIES times. SampleTime tells how old it is.
+ * @param Reader an open reader
+ * @param Snapshot where to copy it
+ * @return int 1 if successful, 0 if nothing has been written yet or it was always being written
+ */
+static inline int TelemetryShmRead( const TELEMETRY_SHM_READER_T* Reader, TELEMETRY_SNAPSHOT_T* Snapshot )
+{
+    uint32_t Try = 0u;
+    if ( Reader->Segment == NULL )
+    {
+        return 0;
+    }
+    for ( Try = 0u; Try < TELEMETRY_SHM_RETRIES; Try++ )
+    {
+        const uint32_t Before = __atomic_load_n( &Reader->Segment->Sequence, __ATOMIC_ACQUIRE );
+        if ( Before == 0u )
+        {
+            return 0;
+        }
+        if ( ( Before & 1u ) == 0u )
+        {
+            memcpy( Snapshot, (const void*)&Reader->Segment->Snapshot, sizeof( TELEMETRY_SNAPSHOT_T ) );
+            /* the copy must be finished before the sequence is checked again */
+            __atomic_thread_fence( __ATOMIC_ACQUIRE );
+            if ( __atomic_load_n( &Reader->Segment->Sequence, __ATOMIC_RELAXED ) == Before )
+            {
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/** Unmap the segment
+ * @param Reader the reader to close
+ */
+static inline void TelemetryShmClose( TELEMETRY_SHM_READER_T* Reader )
+{
+    if ( Reader->Segment != NULL )
+    {
+        munmap( (void*)Reader->Segment, sizeof( TELEMETRY_SHM_T ) );
+        Reader->Segment = NULL;
+    }
+}
+
+#endif /* TELEMETRY_SHM_READER_H */
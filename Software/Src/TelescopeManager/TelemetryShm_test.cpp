@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include "TelemetryShm.h"
+#include "TelemetryShmReader.h"
+#include "TelescopeManager.h"
+/*
+ TelemetryShm test
+ Checks opening the segment before and after it is written, and after a
+ run that stopped part way through a write, then the writer writes as fast as it can while reader processes check that no
+ snapshot they read is torn and time the reads. Build on any machine
+ from Software/:
+
+ g++ -O2 -I./Src/TelescopeManager -I./Src/Scheduler -I./Src/Utils \
+     Src/TelescopeManager/TelemetryShm_test.cpp Src/TelescopeManager/TelemetryShm.cpp \
+     Src/Scheduler/Runnable.cpp -lrt -o TelemetryShm_test
+ ./TelemetryShm_test
+ */
+
+#define TEST_NAME       "/StarPiTelemetryTest"
+#define TEST_READERS    2
+#define TEST_SECONDS    2.0
+
+static int failures = 0;
+
+/* TelemetryShm::Publish reads these, the test writes its own snapshots */
+TelescopeManager TelescopeManager::Telescope;
+TelescopeManager::TelescopeManager() {}
+void TelescopeManager::Run(void) {}
+void TelescopeManager::GetRaDec(double* Ra, double* Dec) { *Ra = 1.0; *Dec = 0.5; }
+void TelescopeManager::GetTargetRaDec(double* Ra, double* Dec) { *Ra = 2.0; *Dec = -0.5; }
+int64_t TelescopeManager::GetSampleTime(void) { return 1234; }
+time_t TelescopeManager::GetUnixTime(void) { return 5678; }
+double TelescopeManager::GetAzimuth(void) { return 3.0; }
+double TelescopeManager::GetLatitude(void) { return 0.9; }
+double TelescopeManager::GetLongitude(void) { return -0.1; }
+float TelescopeManager::GetPitch(void) { return 0.25f; }
+float TelescopeManager::GetHeading(void) { return 3.5f; }
+float TelescopeManager::GetRoll(void) { return 0.125f; }
+float TelescopeManager::GetMagneticDeclination(void) { return -1.5f; }
+float TelescopeManager::GetHieghtAboveGround(void) { return 0.1f; }
+int8_t TelescopeManager::Getmode(void) { return 3; }
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* every value is made from n, so a torn snapshot has values from two */
+static void makeSnapshot(TELEMETRY_SNAPSHOT_T* snapshot, int64_t n)
+{
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->SampleTime = n;
+    snapshot->UnixTime = n * 3;
+    snapshot->RightAscension = (double)n;
+    snapshot->Declination = -(double)n;
+    snapshot->TargetRightAscension = n * 2.0;
+    snapshot->TargetDeclination = n * -2.0;
+    snapshot->Azimuth = n * 0.5;
+    snapshot->Latitude = n * 0.25;
+    snapshot->Longitude = n * 0.125;
+    snapshot->Altitude = (float)n;
+    snapshot->Heading = (float)(n * 2);
+    snapshot->Roll = (float)(n * 4);
+    snapshot->MagneticDeclination = (float)(n * 8);
+    snapshot->Height = (float)(n * 16);
+    snapshot->GpsMode = (uint8_t)n;
+}
+
+static bool consistent(const TELEMETRY_SNAPSHOT_T* snapshot)
+{
+    TELEMETRY_SNAPSHOT_T expected;
+    makeSnapshot(&expected, snapshot->SampleTime);
+    return memcmp(&expected, snapshot, sizeof(expected)) == 0;
+}
+
+/* a reader process, it reports through its exit status */
+static int reader(double until)
+{
+    TELEMETRY_SHM_READER_T shm;
+    TELEMETRY_SNAPSHOT_T snapshot;
+    uint64_t reads = 0;
+    uint64_t torn = 0;
+    uint64_t busy = 0;
+    int64_t last = 0;
+    bool backwards = false;
+    if (!TelemetryShmOpen(&shm, TEST_NAME))
+    {
+        return 2;
+    }
+    const double start = seconds();
+    while (seconds() < until)
+    {
+        for (int i = 0; i < 1000; i++)
+        {
+            if (TelemetryShmRead(&shm, &snapshot))
+            {
+                torn += consistent(&snapshot) ? 0 : 1;
+                backwards = backwards || (snapshot.SampleTime < last);
+                last = snapshot.SampleTime;
+                reads++;
+            }
+            else
+            {
+                busy++;
+            }
+        }
+    }
+    const double elapsed = seconds() - start;
+    TelemetryShmClose(&shm);
+    fprintf(stderr, "reader %d: %llu reads, %.1f ns/read, %llu torn, %llu gave up, last %lld\n",
+            (int)getpid(), (unsigned long long)reads, (elapsed * 1.0e9) / (reads + busy),
+            (unsigned long long)torn, (unsigned long long)busy, (long long)last);
+    return ((torn == 0) && !backwards && (reads > 0)) ? 0 : 1;
+}
+
+int main()
+{
+    TELEMETRY_SHM_READER_T shm;
+    TELEMETRY_SNAPSHOT_T snapshot;
+    pid_t readers[TEST_READERS];
+    int64_t n = 0;
+    int i = 0;
+
+    shm_unlink(TEST_NAME);
+    check(!TelemetryShmOpen(&shm, TEST_NAME), "no segment before StarPi creates it");
+    check(TelemetryShm::Init(TEST_NAME), "the segment is created");
+    check(TelemetryShmOpen(&shm, TEST_NAME), "a reader opens it");
+    check(!TelemetryShmRead(&shm, &snapshot), "nothing to read before the first write");
+
+    TelemetryShm::Publish();
+    check(TelemetryShmRead(&shm, &snapshot) && (snapshot.SampleTime == 1234) && (snapshot.UnixTime == 5678)
+          && (snapshot.RightAscension == 1.0) && (snapshot.Declination == 0.5)
+          && (snapshot.TargetRightAscension == 2.0) && (snapshot.TargetDeclination == -0.5)
+          && (snapshot.Azimuth == 3.0) && (snapshot.Altitude == 0.25f) && (snapshot.Roll == 0.125f)
+          && (snapshot.Height == 0.1f) && (snapshot.GpsMode == 3), "the published values are read");
+
+    /* StarPi restarts, the reader carries on with the same mapping */
+    TelemetryShm::Close();
+    check(TelemetryShm::Init(TEST_NAME), "the segment is opened again");
+    check(TelemetryShmRead(&shm, &snapshot) && (snapshot.SampleTime == 1234), "the last snapshot is kept");
+    makeSnapshot(&snapshot, 42);
+    TelemetryShm::Write(&snapshot);
+    check(TelemetryShmRead(&shm, &snapshot) && (snapshot.SampleTime == 42), "the open reader sees the new run");
+
+    /* StarPi stops part way through a write, the next run must not let the
+       half written snapshot be read */
+    TelemetryShm::Close();
+    const int fd = shm_open(TEST_NAME, O_RDWR, 0);
+    TELEMETRY_SHM_T* segment = (TELEMETRY_SHM_T*)mmap(NULL, sizeof(TELEMETRY_SHM_T), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    check(segment != MAP_FAILED, "the segment is mapped to interrupt a write");
+    if (segment != MAP_FAILED)
+    {
+        segment->Sequence++;
+        segment->Snapshot.SampleTime = 43;
+        check(TelemetryShm::Init(TEST_NAME), "the segment is opened after an interrupted write");
+        check((segment->Sequence == 0u) && (segment->Snapshot.SampleTime == 0), "the half written snapshot is cleared");
+        check(!TelemetryShmRead(&shm, &snapshot), "nothing to read until the next write");
+        munmap(segment, sizeof(TELEMETRY_SHM_T));
+    }
+    makeSnapshot(&snapshot, 42);
+    TelemetryShm::Write(&snapshot);
+    check(TelemetryShmRead(&shm, &snapshot) && (snapshot.SampleTime == 42), "the next write is read");
+    TelemetryShmClose(&shm);
+
+    /* readers in other processes while the writer runs flat out */
+    const double until = seconds() + TEST_SECONDS;
+    for (i = 0; i < TEST_READERS; i++)
+    {
+        readers[i] = fork();
+        if (readers[i] == 0)
+        {
+            _exit(reader(until));
+        }
+    }
+    const double start = seconds();
+    for (n = 43; seconds() < until; n++)
+    {
+        makeSnapshot(&snapshot, n);
+        TelemetryShm::Write(&snapshot);
+    }
+    fprintf(stderr, "writer: %lld writes, %.1f ns/write\n", (long long)(n - 43),
+            ((seconds() - start) * 1.0e9) / (n - 43));
+    for (i = 0; i < TEST_READERS; i++)
+    {
+        int status = 0;
+        waitpid(readers[i], &status, 0);
+        check(WIFEXITED(status) && (WEXITSTATUS(status) == 0), "a reader saw no torn snapshots");
+    }
+
+    TelemetryShm::Close();
+    shm_unlink(TEST_NAME);
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
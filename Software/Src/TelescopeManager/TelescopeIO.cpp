@@ -24,8 +24,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "Config.h"
 
 #include "TelescopeIO.h"
+#include "FastFormat.h"
 TelescopeIO TelescopeIO::TeleIO;
 
+static_assert( NUMBEROFDATA <= HAL_WEBSOCKET_FIELDS, "the web page keeps the latest message for each DATAID_T" );
+
 
 
 typedef enum
@@ -194,52 +197,57 @@ void TelescopeIO::WebRecieve( )
 bool TelescopeIO::UpdateData( DATAID_T Id, void* Data )
 {
     char Message[DATALENGTH+HEADERLENGTH] = { 0u };
+    char* Text = TelescopeData[Id].Data;
+    uint8_t Length = 0u;
     bool SendMessage = false;
     /*
-        Format the data into a string
+        Format the data into a string, the leading space separates it from the header
     */
+    Text[0] = ' ';
     switch ( TelescopeData[Id].DataFormat )
     {
         case UINT8_2:
         {
-            sprintf ( TelescopeData[Id].Data, " %2d", (int32_t)*((uint8_t*)Data) );
+            Length = FastFormat::Integer( &Text[1], (int32_t)*((uint8_t*)Data), 2u );
             SendMessage = true;
             break;
         }
         case UINT16_4:
         {
-            sprintf ( TelescopeData[Id].Data, " %4d", (uint32_t)*((uint16_t*)Data) );
+            Length = FastFormat::Integer( &Text[1], (int32_t)*((uint16_t*)Data), 4u );
             SendMessage = true;
             break;
         }
         case INT8_2:
         {
-            sprintf ( TelescopeData[Id].Data, " %2d", (uint32_t)*((int8_t*)Data) );
+            Length = FastFormat::Integer( &Text[1], (int32_t)*((int8_t*)Data), 2u );
             SendMessage = true;
             break;
         }
         case INT16_4:
         {
-            sprintf ( TelescopeData[Id].Data, " %4d", (uint32_t)*((int16_t*)Data) );
+            Length = FastFormat::Integer( &Text[1], (int32_t)*((int16_t*)Data), 4u );
             SendMessage = true;
             break;
         }
         case UINT32:
         {
-            sprintf ( TelescopeData[Id].Data, " %8d", *((uint32_t*)Data) );
+            Length = FastFormat::Integer( &Text[1], *((int32_t*)Data), 8u );
             SendMessage = true;
             break;
         }
         case FLOAT:
         case DOUBLE:
         {
-            sprintf ( TelescopeData[Id].Data, " %4f", *((float*)Data) );
+            Length = FastFormat::Fixed( &Text[1], *((float*)Data), 6u, 4u );
             SendMessage = true;
             break;
         }
         case STRING:
         {
-            sprintf ( TelescopeData[Id].Data, " %s", ((char*)Data) );
+            Length = strnlen( (char*)Data, DATALENGTH - 2u );
+            memcpy( &Text[1], Data, Length );
+            Text[Length + 1u] = '\0';
             SendMessage = true;
             break;
         }
@@ -254,8 +262,9 @@ bool TelescopeIO::UpdateData( DATAID_T Id, void* Data )
         /*
             Add the header and send the message
         */
-        strcat(Message, TelescopeData[Id].Header);
-        strcat(Message, TelescopeData[Id].Data);
+        const uint8_t HeaderLength = strlen( TelescopeData[Id].Header );
+        memcpy( Message, TelescopeData[Id].Header, HeaderLength );
+        memcpy( &Message[HeaderLength], Text, Length + 2u );
         HalWebsocketd::Websocket.SendMessage(Message, Id );
    }
    return SendMessage;
@@ -25,10 +25,8 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "MagModel.h"
 #include "erfa.h"
 #include "Config.h"
-
-#ifdef TIMING
-#include "GPIO.h"
-#endif
+#include "LatencyTrace.h"
+#include "Trace.h"
 
 #include "TelescopeManager.h"
 
@@ -68,6 +66,11 @@ float TelescopeManager::Roll;
 float TelescopeManager::PitchDegrees;
 float TelescopeManager::MagneticOffset;
 float TelescopeManager::AccelOffset;
+void (*TelescopeManager::PublishHooks[TELESCOPE_MANAGER_PUBLISH_HOOKS])( void );
+uint8_t TelescopeManager::NumberOfPublishHooks = 0u;
+int64_t TelescopeManager::SampleTime = 0;
+uint32_t TelescopeManager::TraceId = 0u;
+MetricHistogram TelescopeManager::PublishLatency;
 
 
 
@@ -84,6 +87,8 @@ void TelescopeManager::Init()
 {
     RightAscension = 0.0f;
     Declination = 0.0f;
+    SampleTime = 0;
+    TraceId = 0u;
     TargetRightAscension = 0.0f;
     TargetDeclination = 0.0f;
     MagneticDeclination = 0.0f;
@@ -106,12 +111,9 @@ void TelescopeManager::Init()
 
     TelescopeOrientation::Orient.Init();
     HalGps::Gps.Init();
-    
-#ifdef TIMING
-    GPIO::gpio.SetupOutput( TELESCOPE_MANAGER_PIN );
-    GPIO::gpio.SetPullMode( TELESCOPE_MANAGER_PIN , PULL_UP );
-#endif
-    
+    (void)Metrics::Register( "starpi_sample_to_publish_seconds", "",
+                             "Time from the orientation being read to every publish hook having run", &PublishLatency );
+    LatencyTrace::RegisterMetrics();
 }
 
 
@@ -119,9 +121,7 @@ void TelescopeManager::Init()
 */
 void TelescopeManager::Run()
 {
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( TELESCOPE_MANAGER_PIN , true );
-    #endif
+    TRACE_BEGIN( TRACE_TELESCOPE_MANAGER, 0u );
 
     MagModel MagCorrect;
     erfa era; 
@@ -129,6 +129,11 @@ void TelescopeManager::Run()
         Get the Position, Orientation and time of the telescope
     */
     TelescopeOrientation::Orient.GetOrientation( &Pitch, &Roll, &Heading );
+    timeval SampleTimeval;
+    gettimeofday( &SampleTimeval, NULL );
+    SampleTime = ( SampleTimeval.tv_sec * 1000000LL ) + SampleTimeval.tv_usec;
+    TraceId = TelescopeOrientation::Orient.GetTraceId();
+    LatencyTrace::Mark( TraceId, LATENCY_FUSED );
     PitchDegrees = (180.0f*(Pitch/M_PI));
         
     if (HalGps::Gps.GetFix())
@@ -258,13 +263,37 @@ void TelescopeManager::Run()
         remaining GPS data
     */
     mode = HalGps::Gps.GetMode(); 
+    /*
+        tell the subscribers there are new values
+    */
+    for ( uint8_t Hook = 0u; Hook < NumberOfPublishHooks; Hook++ )
+    {
+        PublishHooks[Hook]();
+    }
+    timeval PublishTimeval;
+    gettimeofday( &PublishTimeval, NULL );
+    PublishLatency.Observe( ( PublishTimeval.tv_sec * 1000000LL ) + PublishTimeval.tv_usec - SampleTime );
+    LatencyTrace::Mark( TraceId, LATENCY_PUBLISHED );
 
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( TELESCOPE_MANAGER_PIN , false );
-    #endif
+    TRACE_END( TRACE_TELESCOPE_MANAGER, TraceId );
 }
 
 
+/* Add a function to call when a new set of values is ready
+ * @param Hook function to call
+ * @return bool false if there are already TELESCOPE_MANAGER_PUBLISH_HOOKS
+ */
+bool TelescopeManager::AddPublishHook( void (*Hook)( void ) )
+{
+    if ( NumberOfPublishHooks >= TELESCOPE_MANAGER_PUBLISH_HOOKS )
+    {
+        return false;
+    }
+    PublishHooks[NumberOfPublishHooks] = Hook;
+    NumberOfPublishHooks++;
+    return true;
+}
+
 /* interface to set the target
  * @param Ra
  * @param Dec     
@@ -283,6 +312,29 @@ void TelescopeManager::GetRaDec ( double* Ra, double* Dec )
     *Dec = Declination;
 }
 
+/* Export when the orientation for the RightAscension and Declination was read
+ */
+int64_t TelescopeManager::GetSampleTime( void )
+{
+    return SampleTime;
+}
+
+/* Export the LatencyTrace Id of the sensor sample the RightAscension and Declination came from
+ * @return uint32_t Id, 0 before the first run
+ */
+uint32_t TelescopeManager::GetTraceId( void )
+{
+    return TraceId;
+}
+
+/* Export the target RightAscension and Declination
+ */
+void TelescopeManager::GetTargetRaDec ( double* Ra, double* Dec )
+{
+    *Ra = TargetRightAscension;
+    *Dec = TargetDeclination;
+}
+
 /* Export the RightAscension
  */
 float TelescopeManager::GetRightAscension( void )
@@ -24,6 +24,11 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include <sys/time.h>
 #include <stdint.h>
 #include "Runnable.h"
+#include "Metrics.h"
+
+/* Configuration */
+
+#define TELESCOPE_MANAGER_PUBLISH_HOOKS 4u  /**< functions called when new values are ready */
 
 /** TelescopeManager
  * Class to manage the functionality of the telescope.
@@ -42,6 +47,13 @@ class TelescopeManager : public Runnable
     /** main run function of the telescope manager
     */
         void Run( void );
+    /** Add a function to call at the end of each Run, when a new set of
+     *  values is ready. They are called in the order they were added, from
+     *  the scheduler with the dispatch lock held.
+     * @param Hook function to call
+     * @return bool false if there are already TELESCOPE_MANAGER_PUBLISH_HOOKS
+     */
+        bool AddPublishHook( void (*Hook)( void ) );
     /** interface to set the target
      * @param Ra
      * @param Dec     
@@ -51,6 +63,17 @@ class TelescopeManager : public Runnable
     /** Export the RightAscension and Declination
      */
         static void GetRaDec ( double* Ra, double* Dec );
+    /** Export when the orientation for the RightAscension and Declination was read
+     * @return int64_t microseconds since 1970, 0 before the first run
+     */
+        static int64_t GetSampleTime( void );
+    /** Export the LatencyTrace Id of the sensor sample the RightAscension and Declination came from
+     * @return uint32_t Id, 0 before the first run
+     */
+        static uint32_t GetTraceId( void );
+    /** Export the target RightAscension and Declination
+     */
+        static void GetTargetRaDec ( double* Ra, double* Dec );
     /* Export the RightAscension
      */
         float GetRightAscension( void );
@@ -178,6 +201,8 @@ class TelescopeManager : public Runnable
     private:
         static double RightAscension;         /**< Right ascension */
         static double Declination;            /**< Declination */
+        static int64_t SampleTime;            /**< when the orientation was read, microseconds since 1970 */
+        static uint32_t TraceId;              /**< LatencyTrace Id of the sensor sample */
         static double TargetRightAscension;   /**< Target right ascension */
         static double TargetDeclination;      /**< Target declination */
         static float MagneticDeclination;
@@ -211,6 +236,9 @@ class TelescopeManager : public Runnable
         static float PitchDegrees;
         static float MagneticOffset;
         static float AccelOffset;
+        static void (*PublishHooks[TELESCOPE_MANAGER_PUBLISH_HOOKS])( void );   /**< called when new values are ready */
+        static uint8_t NumberOfPublishHooks;  /**< entries used in PublishHooks */
+        static MetricHistogram PublishLatency;  /**< from the orientation being read to the hooks returning */
 };
 
 #endif /* TELESCOPE_MANAGER_H */
\ No newline at end of file
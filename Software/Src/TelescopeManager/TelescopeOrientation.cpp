@@ -23,15 +23,13 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #include "HalMagnetometer.h"
 #include "HalAccelerometer.h"
 #include "Config.h"
+#include "LatencyTrace.h"
+#include "Trace.h"
 
 #if ( defined CALIBRATE_MAG_DEBUG) || ( defined CALIBRATE_ACC_DEBUG )
 #include <stdio.h>
 #endif
 
-#ifdef TIMING
-#include "GPIO.h"
-#endif
-
 TelescopeOrientation TelescopeOrientation::Orient;
 
 /* TelescopeOrientation
@@ -48,6 +46,7 @@ bool TelescopeOrientation::Init( void )
     HalAccelerometer::Accelerometer.Init();
     HalMagnetometer::Magneto.Init();
     Calibrating = false;
+    TraceId = 0u;
     MxMax = 0.0f;
     MxMin = 0.0f;
     MyMax = 0.0f;
@@ -68,11 +67,9 @@ bool TelescopeOrientation::Init( void )
     Ax = 0.0f;
     Ay = 0.0f;
     Az = 0.0f;
-
-#ifdef TIMING
-    GPIO::gpio.SetupOutput( TELESCOPE_ORIENTATION_PIN );
-    GPIO::gpio.SetPullMode( TELESCOPE_ORIENTATION_PIN , PULL_UP );
-#endif
+    /* start from the configured min/max then use the calibration file if there is one */
+    MagCal.SetFromMinMax( CONFIG_MXMIN, CONFIG_MXMAX, CONFIG_MYMIN, CONFIG_MYMAX, CONFIG_MZMIN, CONFIG_MZMAX );
+    (void)MagCal.Load( CONFIG_MAG_CALIBRATION_FILE );
 
     return true;
 }
@@ -83,16 +80,21 @@ bool TelescopeOrientation::Init( void )
  */
 void TelescopeOrientation::Run( void )
 {
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( TELESCOPE_ORIENTATION_PIN , true );
-    #endif
+    TRACE_BEGIN( TRACE_TELESCOPE_ORIENTATION, 0u );
 
     HalMagnetometer::Magneto.Run();
     HalAccelerometer::Accelerometer.Run();
+    TraceId = LatencyTrace::Begin();
 
-    #ifdef TIMING
-    GPIO::gpio.SetPinState( TELESCOPE_ORIENTATION_PIN , false );
-    #endif
+    TRACE_END( TRACE_TELESCOPE_ORIENTATION, TraceId );
+}
+
+/* GetTraceId
+ *  Get the LatencyTrace Id of the latest sensor sample
+ */
+uint32_t TelescopeOrientation::GetTraceId( void )
+{
+    return TraceId;
 }
 
 /*
@@ -124,15 +126,8 @@ void TelescopeOrientation::GetOrientation( float* Pitch, float* Roll, float* Hea
     {
         Calibration();
     }
-    /* remove Hard Iron effects */
-    Mxo = Mx - CONFIG_MX_OFFSET;
-    Myo = My - CONFIG_MY_OFFSET;
-    Mzo = Mz - CONFIG_MZ_OFFSET;
-    
-    /* Normalise */
-    Mxo = Mxo / (CONFIG_MXMAX - CONFIG_MX_OFFSET);
-    Myo = Myo / (CONFIG_MYMAX - CONFIG_MY_OFFSET);
-    Mzo = Mzo / (CONFIG_MZMAX - CONFIG_MZ_OFFSET);
+    /* remove Hard and Soft Iron effects and normalise */
+    MagCal.Apply( Mx, My, Mz, &Mxo, &Myo, &Mzo );
 #ifdef CALC_DEBUG
     printf ("Mxo: %f Myo: %f Mzo: %f ", Mxo, Myo, Mzo ); // debug
 #endif
@@ -180,6 +175,18 @@ void TelescopeOrientation::GetOrientation( float* Pitch, float* Roll, float* Hea
  */
 void TelescopeOrientation::EnableCalibration ( bool Enable )
 {
+    if ( Enable && !Calibrating )
+    {
+        /* condition the fit with the field size from the configured calibration */
+        MagCal.Reset( ( ( CONFIG_MXMAX - CONFIG_MXMIN ) + ( CONFIG_MYMAX - CONFIG_MYMIN ) + ( CONFIG_MZMAX - CONFIG_MZMIN ) ) / 6.0f );
+    }
+    else if ( !Enable && Calibrating )
+    {
+        if ( MagCal.Solve() )
+        {
+            (void)MagCal.Save( CONFIG_MAG_CALIBRATION_FILE );
+        }
+    }
     Calibrating = Enable;
 }    
 
@@ -187,6 +194,8 @@ void TelescopeOrientation::EnableCalibration ( bool Enable )
  */
 void TelescopeOrientation::Calibration( void )
 {
+    /* feed the ellipsoid fit */
+    MagCal.AddSample( Mx, My, Mz );
     /*
        keep track of the Magnetometer calibration values
     */
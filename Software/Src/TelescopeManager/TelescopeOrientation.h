@@ -23,6 +23,7 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <stdint.h>
 #include "Runnable.h"
+#include "MagCalibration.h"
 
 /** TelescopeOrientation
  * - Class to provide use to the magnetometer
@@ -44,7 +45,13 @@ class TelescopeOrientation: public Runnable {
      * @return double heading 
      */
         void GetOrientation( float* Pitch, float* Roll, float* Heading );
+    /** Get the LatencyTrace Id of the latest sensor sample
+     * @return uint32_t Id, 0 before the first run
+     */
+        uint32_t GetTraceId( void );
     /** EnableCalibration
+     * Enabling starts a new ellipsoid fit, disabling solves it and saves
+     * the result to the calibration file.
      * @Param Enable or disable calibration 
      */
         void EnableCalibration ( bool Enable );
@@ -145,6 +152,7 @@ class TelescopeOrientation: public Runnable {
      */
         void Calibration( void );
         bool Calibrating;
+        uint32_t TraceId;    /**< LatencyTrace Id of the latest sensor sample */
     /** raw magneto values */
         float Mx;
         float My;
@@ -167,6 +175,9 @@ class TelescopeOrientation: public Runnable {
         float AyMin;
         float AzMax;
         float AzMin;
+    /** Hard and soft iron calibration of the magnetometer
+     */
+        MagCalibration MagCal;
 
 };
 
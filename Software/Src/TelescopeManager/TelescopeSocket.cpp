@@ -21,80 +21,33 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "TelescopeManager.h"
 #include "TelescopeOrientation.h"
+#include "FastFormat.h"
+#include "LatencyTrace.h"
 
 #include "TelescopeSocket.h"
 TelescopeSocket TelescopeSocket::TeleSocket;
+SUBSCRIPTION_T  TelescopeSocket::Subscriptions[HAL_SOCKET_MAX_CLIENTS];
+uint64_t        TelescopeSocket::SubscribedFields = 0u;
+uint64_t        TelescopeSocket::ChangedFields = 0u;
+char            TelescopeSocket::Encoded[TELESCOPE_SOCKET_HANDLERS][TELESCOPE_SOCKET_VALUE_SIZE];
+uint8_t         TelescopeSocket::EncodedLength[TELESCOPE_SOCKET_HANDLERS];
+int             TelescopeSocket::PublishFd = -1;
+uint32_t        TelescopeSocket::PublishedTraceId = 0u;
 
-#define BUFFER_SIZE 50
 /*
     Command table - Each callback must update the return buffer and return how much data has been added.
 */
-TELEDATA_T TelescopeSocket::TelescopeData[60] =
-{
-/* Id                     Header  Handler                                                                      */
-/* Multi Item            */ { "MULT", &MultiHandler                 }, /**< any debug string                   */
-/* RightAscension        */ { "RA  ", &RightAscensionHandler        }, /**< Target Declination                 */
-/* Declination           */ { "DEC ", &DeclinationHandler           }, /**< Target Declination                 */
-/* TargetRightAscension  */ { "TRA ", &TargetRightAscensionHandler  }, /**< Target Declination                 */
-/* TargetDeclination     */ { "TDEC", &TargetDeclinationHandler     }, /**< Target Declination                 */
-/* Unixtime              */ { "Unix", &UnixTimeHandler              }, /**< UnixTime                           */
-/* GreenwichMeanTimeDay  */ { "GMTD", &GreenwichMeanTimeDayHandler  }, /**< gmt->tm_mday                       */
-/* GreenwichMeanTimeMon  */ { "GMTM", &GreenwichMeanTimeMonHandler  }, /**< gmt->tm_mon                        */
-/* GreenwichMeanTimeYear */ { "GMTY", &GreenwichMeanTimeYearHandler }, /**< (gmt->tm_year + 1900)              */
-/* GreenwichMeanTimeHour */ { "GMTH", &GreenwichMeanTimeHourHandler }, /**< gmt->tm_hour                       */
-/* GreenwichMeanTimeMin  */ { "GMTm", &GreenwichMeanTimeMinHandler  }, /**< gmt->tm_min                        */
-/* GreenwichMeanTimeSec  */ { "GMTS", &GreenwichMeanTimeSecHandler  }, /**< gmt->tm_sec                        */
-/* BritishStandardTime   */ { "BST ", &BritishStandardTimeHandler   }, /**< gmt->tm_isdst                      */
-/* Altitude              */ { "Pitc", &AltitudeHandler              }, /**< AltitudePitch in degrees           */
-/* Azimuth               */ { "Azim", &AzimuthHandler               }, /**< Azimuth/Heading in degrees         */
-/* Roll                  */ { "Roll", &RollHandler                  }, /**< Roll in degrees                    */
-/* Height                */ { "High", &HieghtAboveGroundHandler     }, /**< Hieght Above Ground (km)           */
-/* MagneticDeclination   */ { "MagD", &MagneticDeclinationHandler   }, /**< Magnetic Declination               */
-/* MagneticHeading       */ { "MagH", &MagneticHeadingHandler       }, /**< (180*(Heading/M_PI))               */
-/* LocalSidrealTimehour  */ { "LSTH", &LocalSidrealTimeHourHandler  }, /**< Local Sidereal Time Hours          */
-/* LocalSidrealTimemin   */ { "LSTm", &LocalSidrealTimeMinHandler   }, /**< Local Sidereal Time Minutes        */
-/* LocalSidrealTimesec   */ { "LSTS", &LocalSidrealTimeSecHandler   }, /**< Local Sidereal Time Seconds        */
-/* RightAscensionHours   */ { "RAH ", &RightAscensionHoursHandler   }, /**< Right Ascension Degrees            */
-/* RightAscensionMin     */ { "RAm ", &RightAscensionMinHandler     }, /**< Right Ascension Minutes            */
-/* RightAscensionSec     */ { "RAS ", &RightAscensionSecHandler     }, /**< Right Ascension Seconds            */
-/* DeclinationHours      */ { "DECH", &DeclinationHoursHandler      }, /**< Declination Hours                  */
-/* DeclinationMinutes    */ { "DECm", &DeclinationMinutesHandler    }, /**< Declination Minutes                */
-/* DeclinationSeconds    */ { "DECS", &DeclinationSecondsHandler    }, /**< Declination Seconds                */
-/* Juliandate            */ { "JDAT", &JuliandateHandler            }, /**< JulianDate                         */
-/* Gpsmode               */ { "GPSM", &GpsmodeHandler               }, /**< Gps Fix Mode                       */
-/* Latitude              */ { "Lati", &LatitudeHandler              }, /**< (180*(Angles.Latitude/M_PI))       */
-/* Longitude             */ { "Long", &LongitudeHandler             }, /**< (180*(Angles.LongitudeWest/M_PI))  */
-/* GpsLatitudeHours      */ { "GLAH", &GpsLatitudeHoursHandler      }, /**< Gps source latitude degrees        */
-/* GpsLatitudeMinutes    */ { "GLAm", &GpsLatitudeMinutesHandler    }, /**< Gps source latitude minutes        */
-/* GpsLatitudeSeconds    */ { "GLAS", &GpsLatitudeSecondsHandler    }, /**< Gps source latitude seconds        */
-/* GpsLongitudeHours     */ { "GLOH", &GpsLongitudeHoursHandler     }, /**< Gps source longitude hours         */
-/* GpsLongitudeMinutes   */ { "GLOm", &GpsLongitudeMinutesHandler   }, /**< Gps source longitude minutes       */
-/* GpsLongitudeSeconds   */ { "GLOS", &GpsLongitudeSecondsHandler   }, /**< Gps source longitude seconds       */
-/* RawAccelerometerX     */ { "RwAx", &RawAccelerometerXHandler     }, /**< Raw data from the Accelerometer    */
-/* RawAccelerometerY     */ { "RwAy", &RawAccelerometerYHandler     }, /**< Raw data from the Accelerometer    */
-/* RawAccelerometerZ     */ { "RwAz", &RawAccelerometerZHandler     }, /**< Raw data from the Accelerometer    */
-/* MinAccelerometerX     */ { "MiAx", &MinAccelerometerXHandler     }, /**< Min data from the Accelerometer    */
-/* MinAccelerometerY     */ { "MiAy", &MinAccelerometerYHandler     }, /**< Min data from the Accelerometer    */
-/* MinAccelerometerZ     */ { "MiAz", &MinAccelerometerZHandler     }, /**< Min data from the Accelerometer    */
-/* MaxAccelerometerX     */ { "MaAx", &MaxAccelerometerXHandler     }, /**< Max data from the Accelerometer    */
-/* MaxAccelerometerY     */ { "MaAy", &MaxAccelerometerYHandler     }, /**< Max data from the Accelerometer    */
-/* MaxAccelerometerZ     */ { "MaAz", &MaxAccelerometerZHandler     }, /**< Max data from the Accelerometer    */
-/* RawMagnetometerX      */ { "RwMx", &RawMagnetometerXHandler      }, /**< Raw data from the Magnetometer     */
-/* RawMagnetometerY      */ { "RwMy", &RawMagnetometerYHandler      }, /**< Raw data from the Magnetometer     */
-/* RawMagnetometerZ      */ { "RwMz", &RawMagnetometerZHandler      }, /**< Raw data from the Magnetometer     */
-/* MinMagnetometerX      */ { "MiMx", &MinMagnetometerXHandler      }, /**< Min data from the Magnetometer     */
-/* MinMagnetometerY      */ { "MiMy", &MinMagnetometerYHandler      }, /**< Min data from the Magnetometer     */
-/* MinMagnetometerZ      */ { "MiMz", &MinMagnetometerZHandler      }, /**< Min data from the Magnetometer     */
-/* MaxMagnetometerX      */ { "MaMx", &MaxMagnetometerXHandler      }, /**< Max data from the Magnetometer     */
-/* MaxMagnetometerY      */ { "MaMy", &MaxMagnetometerYHandler      }, /**< Max data from the Magnetometer     */
-/* MaxMagnetometerZ      */ { "MaMz", &MaxMagnetometerZHandler      }, /**< Max data from the Magnetometer     */
-/* Calibration Enable    */ { "CALE", &CalibrationEnableHandler     }, /**< Calibration enable                 */
-/* MagneticOffset        */ { "MAGO", &MagneticOffsetHandler        }, /**< user offset to Azimuth             */
-/* AccelOffset           */ { "ACCO", &AccelOffsetHandler           }, /**< user offsset to Altitude           */
-/* Default               */ { "DFLT", &DefaultHandler               }, /**< any debug string                   */
+#define TELESCOPE_COMMAND_ENTRY( Name, Header, Handler ) { Header, &Handler },
+TELEDATA_T TelescopeSocket::TelescopeData[TELESCOPE_SOCKET_HANDLERS] =
+{
+    TELESCOPE_COMMANDS( TELESCOPE_COMMAND_ENTRY )
 };
+#undef TELESCOPE_COMMAND_ENTRY
 
 #define HEADERLENGTH sizeof(TelescopeData[0].Header)
 #define NUMBER_OF_HANDLERS  ((uint8_t)(sizeof(TelescopeData)/sizeof(TelescopeData[0])))
@@ -103,304 +56,645 @@ TelescopeSocket::TelescopeSocket()
     
 }
 
+/* Initialise the subscriptions
+*/
+bool TelescopeSocket::Init( void )
+{
+    memset( Subscriptions, 0, sizeof( Subscriptions ) );
+    memset( EncodedLength, 0, sizeof( EncodedLength ) );
+    HalSocket::Socket.SetCloseCallback( &ClientClosed );
+    HalSocket::Socket.SetBinaryCallback( &BinaryLength, &BinaryCallback );
+    PublishFd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+    return ( PublishFd >= 0 ) && HalReactor::Reactor.Add( PublishFd, EPOLLIN, this );
+}
+
 /* callback to handle which message has been sent
  */
 void TelescopeSocket::SocketCallback ( char* Buffer )
 {
+    uint8_t Id = FindHandler( Buffer );
+    if (Id >= NUMBER_OF_HANDLERS )
+    {
+        Id = NUMBER_OF_HANDLERS - 1;
+    }
+    (void)TelescopeData[Id].handler(  Buffer );
+}
+/* Find the command at the start of a message
+ */
+uint8_t TelescopeSocket::FindHandler ( const char* Message )
+{
+    uint8_t Id = NUMBER_OF_HANDLERS;
+    switch ( TelescopeMessageKey( Message ) )
+    {
+        TELESCOPE_COMMANDS( TELESCOPE_COMMAND_CASE )
+        default: break;
+    }
+    return Id;
+}
+/* binary message framing for HalSocket
+*/
+uint32_t TelescopeSocket::BinaryLength ( const uint8_t* Data, uint32_t Count )
+{
+    return TelemetryDecoder::FrameLength( Data, Count );
+}
+/* callback for a binary request
+*/
+uint32_t TelescopeSocket::BinaryCallback ( const uint8_t* Request, uint32_t Length, uint8_t* Reply )
+{
+    TelemetryDecoder Decoder;
+    TelemetryEncoder Encoder( Reply, HAL_SOCKET_BINARY_SIZE );
+    TELEMETRY_VALUE_T Value;
+    uint8_t Index = 0u;
+    if ( Decoder.Decode( Request, Length ) && ( Decoder.GetType() == TELEMETRY_REQUEST ) )
+    {
+        Encoder.Begin( TELEMETRY_DATA, Decoder.GetSequence() );
+        if ( Decoder.GetCount() == 0u )
+        {
+            /* no fields asks for all of them */
+            for ( Index = 0u; Index < TELEMETRY_FIELD_COUNT; Index++ )
+            {
+                if ( GetTelemetryValue( Index, &Value ) )
+                {
+                    (void)Encoder.AddValue( &Value );
+                }
+            }
+        }
+        for ( Index = 0u; Index < Decoder.GetCount(); Index++ )
+        {
+            if ( GetTelemetryValue( Decoder.GetField( Index )->Id, &Value ) )
+            {
+                (void)Encoder.AddValue( &Value );
+            }
+        }
+    }
+    else
+    {
+        Encoder.Begin( TELEMETRY_ERROR, Decoder.GetSequence() );
+    }
+    return Encoder.Finish();
+}
+/* message framing for HalSocket
+*/
+uint32_t TelescopeSocket::MessageLength ( const char* Buffer )
+{
+    uint32_t Length = 0u;
+    if ( TelescopeMessageKey( Buffer ) == TelescopeKey( TelescopeData[MultiItemCommand].Header ) )
+    {
+        const char* End = strchr( Buffer, '\n' );
+        if ( End == NULL )
+        {
+            End = strrchr( Buffer, '#' );
+        }
+        if ( End != NULL )
+        {
+            Length = ( End - Buffer ) + 1u;
+        }
+    }
+    else
+    {
+        Length = HalSocket::MessageLength( Buffer );
+    }
+    return Length;
+}
+/* Handler for a subscription
+*/
+uint16_t TelescopeSocket::SubscribeHandler( char* Buffer )
+{
+    SUBSCRIPTION_T* Subscription = &Subscriptions[HalSocket::GetCurrentClient()];
+    unsigned int Period = 0u;
+    int Used = 0;
+    uint8_t Count = 0u;
     uint8_t Id = 0u;
+    if ( ( sscanf( Buffer, "SUB =%u,%n", &Period, &Used ) == 1 ) && ( Used > 0 ) )
+    {
+        const char* Header = &Buffer[Used];
+        /* the headers follow each other, 4 characters each */
+        while ( strcspn( Header, "#" ) >= 4u )
+        {
+            Id = FindHandler( Header );
+            if ( ( Id < NUMBER_OF_HANDLERS ) && IsSubscribable( Id ) )
+            {
+                /* the current value goes straight away */
+                Subscription->Fields |= ( (uint64_t)1u << Id );
+                Subscription->Pending |= ( (uint64_t)1u << Id );
+            }
+            Header += 4;
+        }
+        Subscription->Period = Period;
+        Subscription->NextUpdate = 0u;
+    }
+    else
+    {
+        Subscription->Fields = 0u;
+        Subscription->Pending = 0u;
+    }
+    UpdateSubscribedFields();
     for ( Id = 0u; Id < NUMBER_OF_HANDLERS; Id++ )
     {
-        if ( strncmp ( Buffer, TelescopeData[Id].Header, 4 ) == 0)
+        if ( ( Subscription->Fields & ( (uint64_t)1u << Id ) ) != 0u )
         {
-            break;
+            Count++;
         }
     }
-    if (Id >= NUMBER_OF_HANDLERS )
+    return ReplyInteger( Buffer, "SUB ", Count );
+}
+/* encode each subscribed value once and wake the reactor
+*/
+void TelescopeSocket::Publish( void )
+{
+    if ( SubscribedFields != 0u )
     {
-        Id = NUMBER_OF_HANDLERS - 1;
+        char Value[TELESCOPE_SOCKET_VALUE_SIZE];
+        uint8_t Id = 0u;
+        for ( Id = 0u; Id < NUMBER_OF_HANDLERS; Id++ )
+        {
+            const uint64_t Field = ( (uint64_t)1u << Id );
+            if ( ( SubscribedFields & Field ) != 0u )
+            {
+                /* just the header, so the setters only read */
+                memcpy( Value, TelescopeData[Id].Header, sizeof( TelescopeData[Id].Header ) );
+                const uint8_t Length = TelescopeData[Id].handler( Value );
+                if ( ( Length != EncodedLength[Id] ) || ( memcmp( Value, Encoded[Id], Length ) != 0 ) )
+                {
+                    memcpy( Encoded[Id], Value, Length );
+                    EncodedLength[Id] = Length;
+                    ChangedFields |= Field;
+                }
+            }
+            else
+            {
+                EncodedLength[Id] = 0u;
+            }
+        }
+        PublishedTraceId = TelescopeManager::GetTraceId();
+        /* the rate subscribers need waking even if nothing changed */
+        const uint64_t One = 1u;
+        const ssize_t Written = write( PublishFd, &One, sizeof( One ) );
+        (void)Written;
     }
-    (void)TelescopeData[Id].handler(  Buffer );
 }
+/* forget the subscription of a closed client
+*/
+void TelescopeSocket::ClientClosed( uint16_t Client )
+{
+    Subscriptions[Client].Fields = 0u;
+    Subscriptions[Client].Pending = 0u;
+    UpdateSubscribedFields();
+}
+/* push the new values to the subscribers
+*/
+void TelescopeSocket::HandleEvents( uint32_t Events )
+{
+    char Values[TELESCOPE_SOCKET_HANDLERS][TELESCOPE_SOCKET_VALUE_SIZE];
+    uint8_t Lengths[TELESCOPE_SOCKET_HANDLERS];
+    struct iovec Segments[TELESCOPE_SOCKET_HANDLERS];
+    uint64_t Available = 0u;
+    uint64_t Changed = 0u;
+    uint64_t Count = 0u;
+    uint64_t Now = 0u;
+    struct timespec Time;
+    uint32_t TraceId = 0u;
+    bool Sent = false;
+    uint8_t Id = 0u;
+    uint16_t Client = 0u;
 
+    (void)Events;
+    if ( read( PublishFd, &Count, sizeof( Count ) ) != (ssize_t)sizeof( Count ) )
+    {
+        return;
+    }
+    /* take a copy of the values, so the sends are made without the lock */
+    HalReactor::Lock();
+    Changed = ChangedFields;
+    ChangedFields = 0u;
+    TraceId = PublishedTraceId;
+    for ( Id = 0u; Id < NUMBER_OF_HANDLERS; Id++ )
+    {
+        Lengths[Id] = EncodedLength[Id];
+        if ( Lengths[Id] > 0u )
+        {
+            memcpy( Values[Id], Encoded[Id], Lengths[Id] );
+            Available |= ( (uint64_t)1u << Id );
+        }
+    }
+    HalReactor::Unlock();
 
+    clock_gettime( CLOCK_MONOTONIC, &Time );
+    Now = ( (uint64_t)Time.tv_sec * 1000u ) + ( Time.tv_nsec / 1000000 );
+    for ( Client = 0u; Client < HAL_SOCKET_MAX_CLIENTS; Client++ )
+    {
+        SUBSCRIPTION_T* Subscription = &Subscriptions[Client];
+        uint64_t Due = 0u;
+        uint32_t SegmentCount = 0u;
+        if ( Subscription->Fields == 0u )
+        {
+            continue;
+        }
+        Subscription->Pending |= ( Changed & Subscription->Fields );
+        if ( Subscription->Period == 0u )
+        {
+            Due = Subscription->Pending;
+        }
+        else if ( Now >= Subscription->NextUpdate )
+        {
+            Due = Subscription->Fields;
+            Subscription->NextUpdate = Now + Subscription->Period;
+        }
+        Due &= Available;
+        for ( Id = 0u; ( Due != 0u ) && ( Id < NUMBER_OF_HANDLERS ); Id++ )
+        {
+            if ( ( Due & ( (uint64_t)1u << Id ) ) != 0u )
+            {
+                Segments[SegmentCount].iov_base = Values[Id];
+                Segments[SegmentCount].iov_len = Lengths[Id];
+                SegmentCount++;
+            }
+        }
+        /* a client that is not keeping up gets the latest values when it does */
+        if ( ( SegmentCount > 0u ) && HalSocket::Socket.Send( Client, Segments, SegmentCount ) )
+        {
+            Subscription->Pending &= ~Due;
+            Sent = true;
+        }
+    }
+    if ( Sent )
+    {
+        LatencyTrace::Mark( TraceId, LATENCY_SENT_SOCKET );
+    }
+}
+/* get the value of a binary field
+*/
+bool TelescopeSocket::GetTelemetryValue( uint8_t Id, TELEMETRY_VALUE_T* Value )
+{
+    TelescopeManager& Telescope = TelescopeManager::Telescope;
+    TelescopeOrientation& Orient = TelescopeOrientation::Orient;
+    double Ra = 0.0;
+    double Dec = 0.0;
+    bool Result = true;
+    Value->Id = Id;
+    Value->Type = TELEMETRY_F32;
+    Value->Integer = 0;
+    Value->Real = 0.0;
+    switch ( Id )
+    {
+        case TELEMETRY_RIGHT_ASCENSION:          TelescopeManager::GetRaDec( &Ra, &Dec ); Value->Type = TELEMETRY_F64; Value->Real = Ra; break;
+        case TELEMETRY_DECLINATION:              TelescopeManager::GetRaDec( &Ra, &Dec ); Value->Type = TELEMETRY_F64; Value->Real = Dec; break;
+        case TELEMETRY_TARGET_RIGHT_ASCENSION:   TelescopeManager::GetTargetRaDec( &Ra, &Dec ); Value->Type = TELEMETRY_F64; Value->Real = Ra; break;
+        case TELEMETRY_TARGET_DECLINATION:       TelescopeManager::GetTargetRaDec( &Ra, &Dec ); Value->Type = TELEMETRY_F64; Value->Real = Dec; break;
+        case TELEMETRY_UNIX_TIME:                Value->Type = TELEMETRY_I64; Value->Integer = Telescope.GetUnixTime(); break;
+        case TELEMETRY_YEAR:                     Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetYear(); break;
+        case TELEMETRY_MONTH:                    Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetMonth(); break;
+        case TELEMETRY_DAY:                      Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetDay(); break;
+        case TELEMETRY_HOUR:                     Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetHour(); break;
+        case TELEMETRY_MINUTE:                   Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetMinute(); break;
+        case TELEMETRY_SECOND:                   Value->Type = TELEMETRY_U16; Value->Integer = Telescope.GetSecond(); break;
+        case TELEMETRY_BST:                      Value->Type = TELEMETRY_U8;  Value->Integer = Telescope.GetBST() ? 1 : 0; break;
+        case TELEMETRY_ALTITUDE:                 Value->Real = Telescope.GetPitchDegrees(); break;
+        case TELEMETRY_AZIMUTH:                  Value->Real = Telescope.GetAzimuthDegrees(); break;
+        case TELEMETRY_ROLL:                     Value->Real = Telescope.GetRoll(); break;
+        case TELEMETRY_MAGNETIC_HEADING:         Value->Real = Telescope.GetHeadingDegrees(); break;
+        case TELEMETRY_MAGNETIC_DECLINATION:     Value->Real = Telescope.GetMagneticDeclination(); break;
+        case TELEMETRY_HEIGHT:                   Value->Real = Telescope.GetHieghtAboveGround(); break;
+        case TELEMETRY_RIGHT_ASCENSION_HOURS:    Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetRightAscensionHours(); break;
+        case TELEMETRY_RIGHT_ASCENSION_MINUTES:  Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetRightAscensionMinutes(); break;
+        case TELEMETRY_RIGHT_ASCENSION_SECONDS:  Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetRightAscensionSeconds(); break;
+        case TELEMETRY_DECLINATION_DEGREES:      Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetDeclinationHours(); break;
+        case TELEMETRY_DECLINATION_MINUTES:      Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetDeclinationMinutes(); break;
+        case TELEMETRY_DECLINATION_SECONDS:      Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetDeclinationSeconds(); break;
+        case TELEMETRY_GPS_MODE:                 Value->Type = TELEMETRY_U8; Value->Integer = Telescope.Getmode(); break;
+        case TELEMETRY_LATITUDE:                 Value->Real = Telescope.GetLatitudeDegrees(); break;
+        case TELEMETRY_LONGITUDE:                Value->Real = Telescope.GetLongitudeDegrees(); break;
+        case TELEMETRY_LATITUDE_DEGREES:         Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLatitudeHours(); break;
+        case TELEMETRY_LATITUDE_MINUTES:         Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLatitudeMinutes(); break;
+        case TELEMETRY_LATITUDE_SECONDS:         Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLatitudeSeconds(); break;
+        case TELEMETRY_LONGITUDE_DEGREES:        Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLongitudeHours(); break;
+        case TELEMETRY_LONGITUDE_MINUTES:        Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLongitudeMinutes(); break;
+        case TELEMETRY_LONGITUDE_SECONDS:        Value->Type = TELEMETRY_I8; Value->Integer = Telescope.GetLongitudeSeconds(); break;
+        case TELEMETRY_ACCEL_X:                  Value->Real = Orient.GetAx(); break;
+        case TELEMETRY_ACCEL_Y:                  Value->Real = Orient.GetAy(); break;
+        case TELEMETRY_ACCEL_Z:                  Value->Real = Orient.GetAz(); break;
+        case TELEMETRY_ACCEL_MIN_X:              Value->Real = Orient.GetAxMin(); break;
+        case TELEMETRY_ACCEL_MIN_Y:              Value->Real = Orient.GetAyMin(); break;
+        case TELEMETRY_ACCEL_MIN_Z:              Value->Real = Orient.GetAzMin(); break;
+        case TELEMETRY_ACCEL_MAX_X:              Value->Real = Orient.GetAxMax(); break;
+        case TELEMETRY_ACCEL_MAX_Y:              Value->Real = Orient.GetAyMax(); break;
+        case TELEMETRY_ACCEL_MAX_Z:              Value->Real = Orient.GetAzMax(); break;
+        case TELEMETRY_MAG_X:                    Value->Real = Orient.GetMx(); break;
+        case TELEMETRY_MAG_Y:                    Value->Real = Orient.GetMy(); break;
+        case TELEMETRY_MAG_Z:                    Value->Real = Orient.GetMz(); break;
+        case TELEMETRY_MAG_MIN_X:                Value->Real = Orient.GetMxMin(); break;
+        case TELEMETRY_MAG_MIN_Y:                Value->Real = Orient.GetMyMin(); break;
+        case TELEMETRY_MAG_MIN_Z:                Value->Real = Orient.GetMzMin(); break;
+        case TELEMETRY_MAG_MAX_X:                Value->Real = Orient.GetMxMax(); break;
+        case TELEMETRY_MAG_MAX_Y:                Value->Real = Orient.GetMyMax(); break;
+        case TELEMETRY_MAG_MAX_Z:                Value->Real = Orient.GetMzMax(); break;
+        case TELEMETRY_MAGNETIC_OFFSET:          Value->Real = Telescope.GetMagneticOffset(); break;
+        case TELEMETRY_ACCEL_OFFSET:             Value->Real = Telescope.GetAccelOffset(); break;
+        case TELEMETRY_SAMPLE_TIME:              Value->Type = TELEMETRY_I64; Value->Integer = TelescopeManager::GetSampleTime(); break;
+        default:                                 Result = false; break;
+    }
+    return Result;
+}
+/* write "<Header>=<Value>#", with the value as "%f" would write it
+*/
+uint8_t TelescopeSocket::ReplyReal( char* Buffer, const char* Header, double Value )
+{
+    uint8_t Length = 5u;
+    memcpy( Buffer, Header, 4u );
+    Buffer[4] = '=';
+    Length += FastFormat::Fixed( &Buffer[Length], Value, 6u );
+    Buffer[Length++] = '#';
+    Buffer[Length] = '\0';
+    return Length;
+}
+/* write "<Header>=<Value>#", with the value as "%d" would write it
+*/
+uint8_t TelescopeSocket::ReplyInteger( char* Buffer, const char* Header, int32_t Value )
+{
+    uint8_t Length = 5u;
+    memcpy( Buffer, Header, 4u );
+    Buffer[4] = '=';
+    Length += FastFormat::Integer( &Buffer[Length], Value );
+    Buffer[Length++] = '#';
+    Buffer[Length] = '\0';
+    return Length;
+}
+/* whether a command can be subscribed to
+*/
+bool TelescopeSocket::IsSubscribable( uint8_t Id )
+{
+    return ( TelescopeData[Id].handler != &MultiHandler )
+        && ( TelescopeData[Id].handler != &SubscribeHandler )
+        && ( TelescopeData[Id].handler != &CalibrationEnableHandler )
+        && ( TelescopeData[Id].handler != &DefaultHandler );
+}
+/* recalculate SubscribedFields
+*/
+void TelescopeSocket::UpdateSubscribedFields( void )
+{
+    uint16_t Client = 0u;
+    SubscribedFields = 0u;
+    for ( Client = 0u; Client < HAL_SOCKET_MAX_CLIENTS; Client++ )
+    {
+        SubscribedFields |= Subscriptions[Client].Fields;
+    }
+}
 /* Handler for an multiple message
  */
-uint8_t TelescopeSocket::MultiHandler( char* Buffer )
+uint16_t TelescopeSocket::MultiHandler( char* Buffer )
 {
-//    printf(" Multi handler ");
-    char ReturnBuffer[BUFFER_SIZE];
-    uint8_t ReturnIndex = 0u;
+    char Request[HAL_SOCKET_MESSAGE_SIZE];
+    /* we can ignore the "MULT" command, the replies follow it */
+    const uint32_t Start = sizeof( TelescopeData[0].Header );
+    uint32_t Index = Start;
+    uint32_t ReplyIndex = Start;
+    uint32_t Length = 0u;
+    bool Overflow = false;
     uint8_t Id = 0u;
+
+    /* the replies are written over the request, so work from a copy */
+    strncpy( Request, Buffer, sizeof( Request ) - 1u );
+    Request[sizeof( Request ) - 1u] = '\0';
+    if ( strlen( Request ) < Start )
+    {
+        Request[Start] = '\0';
+    }
     /*
-       we need to iterate through the received string and pick out each command
+       we need to iterate through the received string and pick out each command,
+       a MULT inside a MULT is not run
     */
-    bool looking = true;
-    /* we can ignore the "MULT" command */
-    uint8_t Index = sizeof( TelescopeData[0].Header );
-    while ( looking )
+    Id = FindHandler( &Request[Index] );
+    if ( ( Id >= NUMBER_OF_HANDLERS ) || ( Id == MultiItemCommand ) )
     {
-        /* look for a matching command */
-        for ( Id = 0u; Id < NUMBER_OF_HANDLERS; Id++ )
+        /* call the default callback */
+        ReplyIndex += TelescopeData[(NUMBER_OF_HANDLERS - 1)].handler( &Buffer[ReplyIndex] );
+    }
+    while ( ( Id < NUMBER_OF_HANDLERS ) && ( Id != MultiItemCommand ) && !Overflow )
+    {
+        Length = strcspn( &Request[Index], "#" );
+        if ( ( Length >= TELESCOPE_SOCKET_VALUE_SIZE ) || ( ( ReplyIndex + TELESCOPE_SOCKET_VALUE_SIZE ) >= HAL_SOCKET_REPLY_SIZE ) )
         {
-            if ( strncmp ( &Buffer[Index], TelescopeData[Id].Header, 4 ) == 0)
-            {
-                break;
-            }
-        }
-        /* if no handler is found stop looking */
-        if (Id >= NUMBER_OF_HANDLERS )
-        {
-            looking = false;
-            /* If this was the first time call the default callback */
-            if( Index == sizeof( TelescopeData[0].Header ) )
-            {
-                ReturnIndex += TelescopeData[(NUMBER_OF_HANDLERS - 1)].handler( &ReturnBuffer[ReturnIndex] );
-            }
+            Overflow = true;
         }
         else
         {
-            /* copy the command to the return buffer in case it's a setter */
-            strncpy( &ReturnBuffer[ReturnIndex], &Buffer[Index], strcspn( &Buffer[Index], "#" ) );
+            /* copy the command to the reply in case it's a setter, on its own so the setter sees just its value */
+            memcpy( &Buffer[ReplyIndex], &Request[Index], Length );
+            Buffer[ReplyIndex + Length] = '\0';
             /* call the callback */
-            ReturnIndex += TelescopeData[Id].handler( &ReturnBuffer[ReturnIndex] );
-            /* increase the index to the next command, including the # */
-            Index += strcspn( &Buffer[Index], "#" ) + 1u; 
-        }
-        if ( ReturnIndex >= BUFFER_SIZE - sizeof( TelescopeData[0].Header ) )
-        {
-            looking = false;
+            ReplyIndex += TelescopeData[Id].handler( &Buffer[ReplyIndex] );
+            /* move to the next command, including the # */
+            Index += Length + ( ( Request[Index + Length] == '#' ) ? 1u : 0u );
+            Id = FindHandler( &Request[Index] );
         }
     }
     /* check for too much data */
-    if ( ReturnIndex < BUFFER_SIZE - sizeof( TelescopeData[0].Header )  )
+    if ( Overflow )
     {
-        strncpy ( &Buffer[sizeof( TelescopeData[0].Header )], ReturnBuffer, ReturnIndex );
+        ReplyIndex = Start + sprintf( &Buffer[Start], "Not Supported#" );
     }
-    else
-    {
-        sprintf( &Buffer[sizeof( TelescopeData[0].Header )], "Not Supported#" );
-    }
-    return ReturnIndex;
+    Buffer[ReplyIndex] = '\0';
+    /* less than HAL_SOCKET_REPLY_SIZE, checked for each command */
+    return (uint16_t)ReplyIndex;
 }
 
 /* Handler for TargetRightAscension
  */
-uint8_t TelescopeSocket::RightAscensionHandler( char* Buffer )
+uint16_t TelescopeSocket::RightAscensionHandler( char* Buffer )
 {
 //    printf(" RightAscensionHandler ");
-    sprintf( Buffer, "RA  =%f.2#", (float)TelescopeManager::Telescope.TelescopeManager::GetRightAscension( ));   
-    return ( strcspn (Buffer, "#") + 1u );
+    const uint8_t Length = ReplyReal( Buffer, "RA  ", (float)TelescopeManager::Telescope.TelescopeManager::GetRightAscension( ) );
+    /* clients have always been sent the ".2" */
+    memcpy( &Buffer[Length - 1u], ".2#", 4u );
+    return ( Length + 2u );
 }
 
 /* Handler for TargetDeclination
  */
-uint8_t TelescopeSocket::DeclinationHandler( char* Buffer )
+uint16_t TelescopeSocket::DeclinationHandler( char* Buffer )
 {
 //    printf(" DeclinationHandler ");
-    sprintf( Buffer, "DEC =%f#", (float)TelescopeManager::Telescope.TelescopeManager::GetDeclination( ));   
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "DEC ", (float)TelescopeManager::Telescope.TelescopeManager::GetDeclination( ) );
 }
 
 /* Handler for TargetRightAscension
  */
-uint8_t TelescopeSocket::TargetRightAscensionHandler( char* Buffer )
+uint16_t TelescopeSocket::TargetRightAscensionHandler( char* Buffer )
 {
 //    printf(" TargetRightAscensionHandler ");
-    sprintf( Buffer, "TRA =%f#", (float)TelescopeManager::Telescope.TelescopeManager::GetRightAscension( ));   
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "TRA ", (float)TelescopeManager::Telescope.TelescopeManager::GetRightAscension( ) );
 }
 
 /* Handler for TargetDeclination
  */
-uint8_t TelescopeSocket::TargetDeclinationHandler( char* Buffer )
+uint16_t TelescopeSocket::TargetDeclinationHandler( char* Buffer )
 {
 //    printf(" TargetDeclinationHandler ");
-    sprintf( Buffer, "TDEC=%f#", (float)TelescopeManager::Telescope.TelescopeManager::GetDeclination( ));   
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "TDEC", (float)TelescopeManager::Telescope.TelescopeManager::GetDeclination( ) );
 }
 
 /* Handler for UnixTime
  */
-uint8_t TelescopeSocket::UnixTimeHandler( char* Buffer )
+uint16_t TelescopeSocket::UnixTimeHandler( char* Buffer )
 {
 //    printf(" UnixTimeHandler ");
-    sprintf( Buffer, "Unix=%d#", (int32_t)TelescopeManager::Telescope.TelescopeManager::GetUnixTime( ));   
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "Unix", (int32_t)TelescopeManager::Telescope.TelescopeManager::GetUnixTime( ) );
 }
 
 /* Handler for GreenwichMeanTime
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeDayHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeDayHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeDayHandler ");
-    sprintf( Buffer, "GMTD=%d#", TelescopeManager::Telescope.TelescopeManager::GetDay( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTD", TelescopeManager::Telescope.TelescopeManager::GetDay( ) );
 }
 
 /* Handler for GreenwichMeanTimeMon
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeMonHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeMonHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeMonHandler ");
-    sprintf( Buffer, "GMTM=%d#", TelescopeManager::Telescope.TelescopeManager::GetMonth( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTM", TelescopeManager::Telescope.TelescopeManager::GetMonth( ) );
 }
 
 /* Handler for GreenwichMeanTimeYear
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeYearHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeYearHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeYearHandler ");
-    sprintf( Buffer, "GMTY=%d#", TelescopeManager::Telescope.TelescopeManager::GetYear( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTY", TelescopeManager::Telescope.TelescopeManager::GetYear( ) );
 }
 
 /* Handler for GreenwichMeanTimeHour
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeHourHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeHourHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeHourHandler ");
-    sprintf( Buffer, "GMTH=%d#", TelescopeManager::Telescope.TelescopeManager::GetHour( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTH", TelescopeManager::Telescope.TelescopeManager::GetHour( ) );
 }
 
 /* Handler for GreenwichMeanTimeMin
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeMinHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeMinHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeMinHandler ");
-    sprintf( Buffer, "GMTm=%d#", TelescopeManager::Telescope.TelescopeManager::GetMinute( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTm", TelescopeManager::Telescope.TelescopeManager::GetMinute( ) );
 }
 
 /* Handler for GreenwichMeanTimeSec
  */
-uint8_t TelescopeSocket::GreenwichMeanTimeSecHandler( char* Buffer )
+uint16_t TelescopeSocket::GreenwichMeanTimeSecHandler( char* Buffer )
 {
 //    printf(" GreenwichMeanTimeSecHandler ");
-    sprintf( Buffer, "GMTS=%d#", TelescopeManager::Telescope.TelescopeManager::GetSecond( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GMTS", TelescopeManager::Telescope.TelescopeManager::GetSecond( ) );
 }
 
 /* Handler for BritishStandardTime
  */
-uint8_t TelescopeSocket::BritishStandardTimeHandler( char* Buffer )
+uint16_t TelescopeSocket::BritishStandardTimeHandler( char* Buffer )
 {
 //    printf(" BritishStandardTimeHandler ");
-    sprintf( Buffer, "BST =%d#", (uint8_t)TelescopeManager::Telescope.TelescopeManager::GetBST( )); 
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "BST ", (uint8_t)TelescopeManager::Telescope.TelescopeManager::GetBST( ) );
 }
 
 /* Handler for Roll
  */
-uint8_t TelescopeSocket::RollHandler( char* Buffer )
+uint16_t TelescopeSocket::RollHandler( char* Buffer )
 {
 //    printf(" RollHandler ");
-    sprintf( Buffer, "Roll=%f#", TelescopeManager::Telescope.GetRoll( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "Roll", TelescopeManager::Telescope.GetRoll( ) );
 }
 /* Handler for Altitude/Pitch
  */
-uint8_t TelescopeSocket::AltitudeHandler( char* Buffer )
+uint16_t TelescopeSocket::AltitudeHandler( char* Buffer )
 {
 //    printf(" AltitudeHandler ");
-    sprintf( Buffer, "Pitc=%f#", TelescopeManager::Telescope.GetPitchDegrees( ));    
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "Pitc", TelescopeManager::Telescope.GetPitchDegrees( ) );
 }
 
 /* Handler for AzimuthHandler
  */
-uint8_t TelescopeSocket::AzimuthHandler( char* Buffer )
+uint16_t TelescopeSocket::AzimuthHandler( char* Buffer )
 {
 //    printf(" AzimuthHandler ");
-    sprintf( Buffer, "Azim=%f#", (float)TelescopeManager::Telescope.GetAzimuthDegrees( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "Azim", (float)TelescopeManager::Telescope.GetAzimuthDegrees( ) );
 }
 
 /* Handler for MagneticHeading in degrees
  */
-uint8_t TelescopeSocket::MagneticHeadingHandler( char* Buffer )
+uint16_t TelescopeSocket::MagneticHeadingHandler( char* Buffer )
 {
 //    printf(" MagneticHeadingHandler ");
-    sprintf( Buffer, "MagH=%f#", TelescopeManager::Telescope.GetHeadingDegrees( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MagH", TelescopeManager::Telescope.GetHeadingDegrees( ) );
 }
 
 /* Handler for MagneticDeclination
  */
-uint8_t TelescopeSocket::MagneticDeclinationHandler( char* Buffer )
+uint16_t TelescopeSocket::MagneticDeclinationHandler( char* Buffer )
 {
 //    printf(" MagneticDeclinationHandler ");
-    sprintf( Buffer, "MagD=%f#", TelescopeManager::Telescope.GetMagneticDeclination( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MagD", TelescopeManager::Telescope.GetMagneticDeclination( ) );
 }
 
 /* Handler for HieghtAboveGround
  */
-uint8_t TelescopeSocket::HieghtAboveGroundHandler( char* Buffer )
+uint16_t TelescopeSocket::HieghtAboveGroundHandler( char* Buffer )
 {
 //    printf(" HieghtAboveGroundHandler ");
-    sprintf( Buffer, "High=%f#", TelescopeManager::Telescope.GetHieghtAboveGround( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "High", TelescopeManager::Telescope.GetHieghtAboveGround( ) );
 }
 
 /* Handler for RightAscensionHours
  */
-uint8_t TelescopeSocket::RightAscensionHoursHandler( char* Buffer )
+uint16_t TelescopeSocket::RightAscensionHoursHandler( char* Buffer )
 {
 //    printf(" RightAscensionHoursHandler ");
-    sprintf( Buffer, "RAH =%d#", TelescopeManager::Telescope.GetRightAscensionHours( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "RAH ", TelescopeManager::Telescope.GetRightAscensionHours( ) );
 }
 
 /* Handler for RightAscensionMin
  */
-uint8_t TelescopeSocket::RightAscensionMinHandler( char* Buffer )
+uint16_t TelescopeSocket::RightAscensionMinHandler( char* Buffer )
 {
 //    printf(" RightAscensionMinHandler ");
-    sprintf( Buffer, "RAm =%d#", TelescopeManager::Telescope.GetRightAscensionMinutes( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "RAm ", TelescopeManager::Telescope.GetRightAscensionMinutes( ) );
 }
 
 /* Handler for RightAscensionSec
  */
-uint8_t TelescopeSocket::RightAscensionSecHandler( char* Buffer )
+uint16_t TelescopeSocket::RightAscensionSecHandler( char* Buffer )
 {
 //    printf(" RightAscensionSecHandler ");
-    sprintf( Buffer, "RAS =%d#", TelescopeManager::Telescope.GetRightAscensionSeconds( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "RAS ", TelescopeManager::Telescope.GetRightAscensionSeconds( ) );
 }
 
 /* Handler for DeclinationHours
  */
-uint8_t TelescopeSocket::DeclinationHoursHandler( char* Buffer )
+uint16_t TelescopeSocket::DeclinationHoursHandler( char* Buffer )
 {
 //    printf(" DeclinationHoursHandler ");
-    sprintf( Buffer, "DECH=%d#", TelescopeManager::Telescope.TelescopeManager::GetDeclinationHours( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "DECH", TelescopeManager::Telescope.TelescopeManager::GetDeclinationHours( ) );
 }
 
 /* Handler for DeclinationMinutes
  */
-uint8_t TelescopeSocket::DeclinationMinutesHandler( char* Buffer )
+uint16_t TelescopeSocket::DeclinationMinutesHandler( char* Buffer )
 {
 //    printf(" DeclinationMinutesHandler ");
-    sprintf( Buffer, "DECm=%d#", TelescopeManager::Telescope.TelescopeManager::GetDeclinationMinutes( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "DECm", TelescopeManager::Telescope.TelescopeManager::GetDeclinationMinutes( ) );
 }
 
 /* Handler for DeclinationSeconds
  */
-uint8_t TelescopeSocket::DeclinationSecondsHandler( char* Buffer )
+uint16_t TelescopeSocket::DeclinationSecondsHandler( char* Buffer )
 {
 //    printf(" DeclinationSecondsHandler ");
-    sprintf( Buffer, "DECS=%d#", TelescopeManager::Telescope.TelescopeManager::GetDeclinationSeconds( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "DECS", TelescopeManager::Telescope.TelescopeManager::GetDeclinationSeconds( ) );
 }
 
 /* Handler for Juliandate
  */
-uint8_t TelescopeSocket::JuliandateHandler( char* Buffer )
+uint16_t TelescopeSocket::JuliandateHandler( char* Buffer )
 {
 //    printf(" JuliandateHandler ");
     DefaultHandler( Buffer );
@@ -409,86 +703,77 @@ uint8_t TelescopeSocket::JuliandateHandler( char* Buffer )
 
 /* Handler for Gpsmode
  */
-uint8_t TelescopeSocket::GpsmodeHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsmodeHandler( char* Buffer )
 {
 //    printf(" GpsmodeHandler ");
-    sprintf( Buffer, "GPSM=%d#", TelescopeManager::Telescope.TelescopeManager::Getmode( ));     
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GPSM", TelescopeManager::Telescope.TelescopeManager::Getmode( ) );
 }
 /* Handler for Latitude
  */
-uint8_t TelescopeSocket::LatitudeHandler( char* Buffer )
+uint16_t TelescopeSocket::LatitudeHandler( char* Buffer )
 {
 //    printf(" LatitudeHandler ");
-    sprintf( Buffer, "Lati=%f#", (float)TelescopeManager::Telescope.GetLatitudeDegrees( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "Lati", (float)TelescopeManager::Telescope.GetLatitudeDegrees( ) );
 }
 
 /* Handler for LongitudeHandler
  */
-uint8_t TelescopeSocket::LongitudeHandler( char* Buffer )
+uint16_t TelescopeSocket::LongitudeHandler( char* Buffer )
 {
 //    printf(" LongitudeHandler ");
-    sprintf( Buffer, "Long=%f#", (float)TelescopeManager::Telescope.GetLongitudeDegrees( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "Long", (float)TelescopeManager::Telescope.GetLongitudeDegrees( ) );
 }
 
 /* Handler for latitude hours  
  */
-uint8_t TelescopeSocket::GpsLatitudeHoursHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLatitudeHoursHandler( char* Buffer )
 {
 //    printf(" GpsLatitudeHoursHandler ");
-    sprintf( Buffer, "GLAH=%d#", TelescopeManager::Telescope.GetLatitudeHours( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLAH", TelescopeManager::Telescope.GetLatitudeHours( ) );
 }
 
 /* Handler for GpsLatitudeMinutes
  */
-uint8_t TelescopeSocket::GpsLatitudeMinutesHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLatitudeMinutesHandler( char* Buffer )
 {
 //    printf(" GpsLatitudeMinutesHandler ");
-    sprintf( Buffer, "GLAm=%d#", TelescopeManager::Telescope.GetLatitudeMinutes( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLAm", TelescopeManager::Telescope.GetLatitudeMinutes( ) );
 }
 
 /* Handler for GpsLatitudeSeconds
  */
-uint8_t TelescopeSocket::GpsLatitudeSecondsHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLatitudeSecondsHandler( char* Buffer )
 {
 //    printf(" GpsLatitudeSecondsHandler ");
-    sprintf( Buffer, "GLAS=%d#", TelescopeManager::Telescope.GetLatitudeSeconds( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLAS", TelescopeManager::Telescope.GetLatitudeSeconds( ) );
 }
 
 /* Handler for GpsLongitudeHours
  */
-uint8_t TelescopeSocket::GpsLongitudeHoursHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLongitudeHoursHandler( char* Buffer )
 {
 //    printf(" GpsLongitudeHoursHandler ");
-    sprintf( Buffer, "GLOH=%d#", TelescopeManager::Telescope.GetLongitudeHours( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLOH", TelescopeManager::Telescope.GetLongitudeHours( ) );
 }
 
 /* Handler for GpsLongitudeMinutes
  */
-uint8_t TelescopeSocket::GpsLongitudeMinutesHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLongitudeMinutesHandler( char* Buffer )
 {
 //    printf(" GpsLongitudeMinutesHandler ");
-    sprintf( Buffer, "GLOm=%d#", TelescopeManager::Telescope.GetLongitudeMinutes( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLOm", TelescopeManager::Telescope.GetLongitudeMinutes( ) );
 }
 
 /* Handler for GpsLongitudeMinutes
  */
-uint8_t TelescopeSocket::GpsLongitudeSecondsHandler( char* Buffer )
+uint16_t TelescopeSocket::GpsLongitudeSecondsHandler( char* Buffer )
 {
 //    printf(" GpsLongitudeSecondsHandler ");
-    sprintf( Buffer, "GLOS=%d#", TelescopeManager::Telescope.GetLongitudeSeconds( ));
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyInteger( Buffer, "GLOS", TelescopeManager::Telescope.GetLongitudeSeconds( ) );
 }
 /* Handler for LocalSidrealTimeHour
  */
-uint8_t TelescopeSocket::LocalSidrealTimeHourHandler( char* Buffer )
+uint16_t TelescopeSocket::LocalSidrealTimeHourHandler( char* Buffer )
 {
 //    printf(" LocalSidrealTimeHourHandler ");
     DefaultHandler( Buffer );
@@ -497,7 +782,7 @@ uint8_t TelescopeSocket::LocalSidrealTimeHourHandler( char* Buffer )
 
 /* Handler for LocalSidrealTimeMin
  */
-uint8_t TelescopeSocket::LocalSidrealTimeMinHandler( char* Buffer )
+uint16_t TelescopeSocket::LocalSidrealTimeMinHandler( char* Buffer )
 {
 //    printf(" LocalSidrealTimeMinHandler ");
     DefaultHandler( Buffer );
@@ -506,7 +791,7 @@ uint8_t TelescopeSocket::LocalSidrealTimeMinHandler( char* Buffer )
 
 /* Handler for LocalSidrealTimeSec
  */
-uint8_t TelescopeSocket::LocalSidrealTimeSecHandler( char* Buffer )
+uint16_t TelescopeSocket::LocalSidrealTimeSecHandler( char* Buffer )
 {
 //    printf(" LocalSidrealTimeSecHandler ");
     DefaultHandler( Buffer );
@@ -515,214 +800,196 @@ uint8_t TelescopeSocket::LocalSidrealTimeSecHandler( char* Buffer )
 
 /* Handler for RawAccelerometerX
  */
-uint8_t TelescopeSocket::RawAccelerometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::RawAccelerometerXHandler( char* Buffer )
 {
 //    printf(" RawAccelerometerXHandler ");
-    sprintf( Buffer, "RwAx=%f#", TelescopeOrientation::Orient.GetAx());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwAx", TelescopeOrientation::Orient.GetAx() );
 }
 
 /* Handler for RawAccelerometerY
  */
-uint8_t TelescopeSocket::RawAccelerometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::RawAccelerometerYHandler( char* Buffer )
 {
 //    printf(" RawAccelerometerYHandler ");
-    sprintf( Buffer, "RwAy=%f#", TelescopeOrientation::Orient.GetAy());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwAy", TelescopeOrientation::Orient.GetAy() );
 }
 
 /* Handler for RawAccelerometerZ
  */
-uint8_t TelescopeSocket::RawAccelerometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::RawAccelerometerZHandler( char* Buffer )
 {
 //    printf(" RawAccelerometerZHandler ");
-    sprintf( Buffer, "RwAz=%f#", TelescopeOrientation::Orient.GetAz());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwAz", TelescopeOrientation::Orient.GetAz() );
 }
 
 /* Handler for MinAccelerometerX
  */
-uint8_t TelescopeSocket::MinAccelerometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::MinAccelerometerXHandler( char* Buffer )
 {
 //    printf(" MinAccelerometerXHandler ");
     if ( strncmp( Buffer, "MiAxReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAxMin();
     }
-    sprintf( Buffer, "MiAx=%f#", TelescopeOrientation::Orient.GetAxMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiAx", TelescopeOrientation::Orient.GetAxMin() );
 }
 /* Handler for MinAccelerometerY
  */
-uint8_t TelescopeSocket::MinAccelerometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::MinAccelerometerYHandler( char* Buffer )
 {
 //    printf(" MinAccelerometerYHandler ");
     if ( strncmp( Buffer, "MiAyReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAyMin();
     }
-    sprintf( Buffer, "MiAy=%f#", TelescopeOrientation::Orient.GetAyMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiAy", TelescopeOrientation::Orient.GetAyMin() );
 }
 
 /* Handler for MinAccelerometerZHandler
  */
-uint8_t TelescopeSocket::MinAccelerometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::MinAccelerometerZHandler( char* Buffer )
 {
 //    printf(" MinAccelerometerZHandler ");
     if ( strncmp( Buffer, "MiAzReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAzMin();
     }
-    sprintf( Buffer, "MiAz=%f#", TelescopeOrientation::Orient.GetAzMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiAz", TelescopeOrientation::Orient.GetAzMin() );
 }
 
 /* Handler for MaxAccelerometerX
  */
-uint8_t TelescopeSocket::MaxAccelerometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxAccelerometerXHandler( char* Buffer )
 {
 //    printf(" MaxAccelerometerXHandler ");
     if ( strncmp( Buffer, "MaAxReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAxMax();
     }
-    sprintf( Buffer, "MaAx=%f#", TelescopeOrientation::Orient.GetAxMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaAx", TelescopeOrientation::Orient.GetAxMax() );
 }
 
 /* Handler for MaxAccelerometerY
  */
-uint8_t TelescopeSocket::MaxAccelerometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxAccelerometerYHandler( char* Buffer )
 {
 //    printf(" MaxAccelerometerYHandler ");
     if ( strncmp( Buffer, "MaAyReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAyMax();
     }
-    sprintf( Buffer, "MaAy=%f#", TelescopeOrientation::Orient.GetAyMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaAy", TelescopeOrientation::Orient.GetAyMax() );
 }
 
 /* Handler for MaxAccelerometerZ
  */
-uint8_t TelescopeSocket::MaxAccelerometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxAccelerometerZHandler( char* Buffer )
 {
 //    printf(" MaxAccelerometerZHandler ");
     if ( strncmp( Buffer, "MaAzReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetAzMax();
     }
-    sprintf( Buffer, "MaAz=%f#", TelescopeOrientation::Orient.GetAzMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaAz", TelescopeOrientation::Orient.GetAzMax() );
 }
 /* Handler for RawMagnetometerX
  */
-uint8_t TelescopeSocket::RawMagnetometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::RawMagnetometerXHandler( char* Buffer )
 {
 //    printf(" RawMagnetometerXHandler ");
-    sprintf( Buffer, "RwMx=%f#", TelescopeOrientation::Orient.GetMx());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwMx", TelescopeOrientation::Orient.GetMx() );
 }
 
 /* Handler for RawMagnetometerY
  */
-uint8_t TelescopeSocket::RawMagnetometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::RawMagnetometerYHandler( char* Buffer )
 {
 //    printf(" RawMagnetometerYHandler ");
-    sprintf( Buffer, "RwMy=%f#", TelescopeOrientation::Orient.GetMy());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwMy", TelescopeOrientation::Orient.GetMy() );
 }
 
 /* Handler for RawMagnetometerZ
  */
-uint8_t TelescopeSocket::RawMagnetometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::RawMagnetometerZHandler( char* Buffer )
 {
 //    printf(" RawMagnetometerZHandler ");
-    sprintf( Buffer, "RwMz=%f#", TelescopeOrientation::Orient.GetMz());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "RwMz", TelescopeOrientation::Orient.GetMz() );
 }
 
 /* Handler for MinMagnetometerX
  */
-uint8_t TelescopeSocket::MinMagnetometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::MinMagnetometerXHandler( char* Buffer )
 {
 //    printf(" MinMagnetometerXHandler ");
     if ( strncmp( Buffer, "MiMxReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMxMin();
     }
-    sprintf( Buffer, "MiMx=%f#", TelescopeOrientation::Orient.GetMxMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiMx", TelescopeOrientation::Orient.GetMxMin() );
 }
 /* Handler for MinMagnetometerY
  */
-uint8_t TelescopeSocket::MinMagnetometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::MinMagnetometerYHandler( char* Buffer )
 {
 //    printf(" MinMagnetometerYHandler ");
     if ( strncmp( Buffer, "MiMyReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMyMin();
     }
-    sprintf( Buffer, "MiMy=%f#", TelescopeOrientation::Orient.GetMyMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiMy", TelescopeOrientation::Orient.GetMyMin() );
 }
 
 /* Handler for MinMagnetometerZHandler
  */
-uint8_t TelescopeSocket::MinMagnetometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::MinMagnetometerZHandler( char* Buffer )
 {
 //    printf(" MinMagnetometerZHandler ");
     if ( strncmp( Buffer, "MiMzReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMzMin();
     }
-    sprintf( Buffer, "MiMz=%f#", TelescopeOrientation::Orient.GetMzMin());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MiMz", TelescopeOrientation::Orient.GetMzMin() );
 }
 
 /* Handler for MaxMagnetometerX
  */
-uint8_t TelescopeSocket::MaxMagnetometerXHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxMagnetometerXHandler( char* Buffer )
 {
 //    printf(" MaxMagnetometerXHandler ");
     if ( strncmp( Buffer, "MaMxReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMxMax();
     }
-    sprintf( Buffer, "MaMx=%f#", TelescopeOrientation::Orient.GetMxMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaMx", TelescopeOrientation::Orient.GetMxMax() );
 }
 
 /* Handler for MaxMagnetometerY
  */
-uint8_t TelescopeSocket::MaxMagnetometerYHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxMagnetometerYHandler( char* Buffer )
 {
 //    printf(" MaxMagnetometerYHandler ");
     if ( strncmp( Buffer, "MaMyReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMyMax();
     }
-    sprintf( Buffer, "MaMy=%f#", TelescopeOrientation::Orient.GetMyMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaMy", TelescopeOrientation::Orient.GetMyMax() );
 }
 
 /* Handler for MaxMagnetometerZ
  */
-uint8_t TelescopeSocket::MaxMagnetometerZHandler( char* Buffer )
+uint16_t TelescopeSocket::MaxMagnetometerZHandler( char* Buffer )
 {
 //    printf(" MaxMagnetometerZHandler ");
     if ( strncmp( Buffer, "MaMzReset", 9 ) == 0 )
     {
         TelescopeOrientation::Orient.ResetMzMax();
     }
-    sprintf( Buffer, "MaMz=%f#", TelescopeOrientation::Orient.GetMzMax());
-    return ( strcspn (Buffer, "#") + 1u );
+    return ReplyReal( Buffer, "MaMz", TelescopeOrientation::Orient.GetMzMax() );
 }
 
 /* Handler for Calibration Enable
  */
-uint8_t TelescopeSocket::CalibrationEnableHandler( char* Buffer )
+uint16_t TelescopeSocket::CalibrationEnableHandler( char* Buffer )
 {
 //    printf(" CalibrationEnableHandler ");
     if ( strncmp( Buffer, "CALE=Enable", 11 ) == 0 )
@@ -740,7 +1007,7 @@ uint8_t TelescopeSocket::CalibrationEnableHandler( char* Buffer )
 
 /* Handler for Magnetic Offset
  */
-uint8_t TelescopeSocket::MagneticOffsetHandler( char* Buffer )
+uint16_t TelescopeSocket::MagneticOffsetHandler( char* Buffer )
 {
 //    printf(" MagneticOffsetHandler ");
     if ( strncmp( Buffer, "MAGO=", 5 ) == 0 )
@@ -748,18 +1015,18 @@ uint8_t TelescopeSocket::MagneticOffsetHandler( char* Buffer )
         float Offset = 0.0f;
         scanf( Buffer, "MAGO=%f#", Offset );
         TelescopeManager::Telescope.SetMagneticOffset( Offset );
-        sprintf( Buffer, "MAGO=%f#", TelescopeManager::Telescope.GetMagneticOffset());
+        (void)ReplyReal( Buffer, "MAGO", TelescopeManager::Telescope.GetMagneticOffset() );
     }
     else
     {
-        sprintf( Buffer, "MAGO=%f#", TelescopeManager::Telescope.GetMagneticOffset());
+        (void)ReplyReal( Buffer, "MAGO", TelescopeManager::Telescope.GetMagneticOffset() );
     }
     return ( strcspn (Buffer, "#") + 1u );
 }
 
 /* Handler for Accel Offset
  */
-uint8_t TelescopeSocket::AccelOffsetHandler( char* Buffer )
+uint16_t TelescopeSocket::AccelOffsetHandler( char* Buffer )
 {
 //    printf(" AccelOffsetHandler ");
     if ( strncmp( Buffer, "ACCO=", 5 ) == 0 )
@@ -767,18 +1034,18 @@ uint8_t TelescopeSocket::AccelOffsetHandler( char* Buffer )
         float Offset = 0.0f;
         scanf( Buffer, "ACCO=%f#", Offset );
         TelescopeManager::Telescope.SetMagneticOffset( Offset );
-        sprintf( Buffer, "ACCO=%f#", TelescopeManager::Telescope.GetAccelOffset());
+        (void)ReplyReal( Buffer, "ACCO", TelescopeManager::Telescope.GetAccelOffset() );
     }
     else
     {
-        sprintf( Buffer, "ACCO=%f#", TelescopeManager::Telescope.GetAccelOffset());
+        (void)ReplyReal( Buffer, "ACCO", TelescopeManager::Telescope.GetAccelOffset() );
     }    
     return ( strcspn (Buffer, "#") + 1u );
 }
 
 /* Handler for an unknown message
  */
-uint8_t TelescopeSocket::DefaultHandler( char* Buffer )
+uint16_t TelescopeSocket::DefaultHandler( char* Buffer )
 {
 //    printf(" default handler ");
     sprintf( Buffer, "Not Supported#" );
@@ -22,210 +22,408 @@ Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
 #define TELESCOPESOCKET_H
 
 #include <stdint.h>
+#include "HalSocket.h"
+#include "TelemetryProtocol.h"
+
+/* Configuration */
+
+#define TELESCOPE_SOCKET_HANDLERS 61u   /**< entries in TelescopeData */
+#define TELESCOPE_SOCKET_VALUE_SIZE 64u /**< longest command or reply of a single handler */
+
+/** The commands, in the order of TelescopeData. Each header is four
+ *  characters and is matched as one uint32_t key, see TelescopeKey. The
+ *  table, the command ids and the dispatch switch are all built from this
+ *  list, so a repeated header is a duplicate case and does not compile.
+ *  DFLT must stay last, it handles anything that does not match.
+ */
+#define TELESCOPE_COMMANDS( COMMAND ) \
+    COMMAND( MultiItem,             "MULT", MultiHandler                  ) /**< any debug string                   */ \
+    COMMAND( Subscribe,             "SUB ", SubscribeHandler              ) /**< push updates to this client        */ \
+    COMMAND( RightAscension,        "RA  ", RightAscensionHandler         ) /**< Target Declination                 */ \
+    COMMAND( Declination,           "DEC ", DeclinationHandler            ) /**< Target Declination                 */ \
+    COMMAND( TargetRightAscension,  "TRA ", TargetRightAscensionHandler   ) /**< Target Declination                 */ \
+    COMMAND( TargetDeclination,     "TDEC", TargetDeclinationHandler      ) /**< Target Declination                 */ \
+    COMMAND( Unixtime,              "Unix", UnixTimeHandler               ) /**< UnixTime                           */ \
+    COMMAND( GreenwichMeanTimeDay,  "GMTD", GreenwichMeanTimeDayHandler   ) /**< gmt->tm_mday                       */ \
+    COMMAND( GreenwichMeanTimeMon,  "GMTM", GreenwichMeanTimeMonHandler   ) /**< gmt->tm_mon                        */ \
+    COMMAND( GreenwichMeanTimeYear, "GMTY", GreenwichMeanTimeYearHandler  ) /**< (gmt->tm_year + 1900)              */ \
+    COMMAND( GreenwichMeanTimeHour, "GMTH", GreenwichMeanTimeHourHandler  ) /**< gmt->tm_hour                       */ \
+    COMMAND( GreenwichMeanTimeMin,  "GMTm", GreenwichMeanTimeMinHandler   ) /**< gmt->tm_min                        */ \
+    COMMAND( GreenwichMeanTimeSec,  "GMTS", GreenwichMeanTimeSecHandler   ) /**< gmt->tm_sec                        */ \
+    COMMAND( BritishStandardTime,   "BST ", BritishStandardTimeHandler    ) /**< gmt->tm_isdst                      */ \
+    COMMAND( Altitude,              "Pitc", AltitudeHandler               ) /**< AltitudePitch in degrees           */ \
+    COMMAND( Azimuth,               "Azim", AzimuthHandler                ) /**< Azimuth/Heading in degrees         */ \
+    COMMAND( Roll,                  "Roll", RollHandler                   ) /**< Roll in degrees                    */ \
+    COMMAND( Height,                "High", HieghtAboveGroundHandler      ) /**< Hieght Above Ground (km)           */ \
+    COMMAND( MagneticDeclination,   "MagD", MagneticDeclinationHandler    ) /**< Magnetic Declination               */ \
+    COMMAND( MagneticHeading,       "MagH", MagneticHeadingHandler        ) /**< (180*(Heading/M_PI))               */ \
+    COMMAND( LocalSidrealTimehour,  "LSTH", LocalSidrealTimeHourHandler   ) /**< Local Sidereal Time Hours          */ \
+    COMMAND( LocalSidrealTimemin,   "LSTm", LocalSidrealTimeMinHandler    ) /**< Local Sidereal Time Minutes        */ \
+    COMMAND( LocalSidrealTimesec,   "LSTS", LocalSidrealTimeSecHandler    ) /**< Local Sidereal Time Seconds        */ \
+    COMMAND( RightAscensionHours,   "RAH ", RightAscensionHoursHandler    ) /**< Right Ascension Degrees            */ \
+    COMMAND( RightAscensionMin,     "RAm ", RightAscensionMinHandler      ) /**< Right Ascension Minutes            */ \
+    COMMAND( RightAscensionSec,     "RAS ", RightAscensionSecHandler      ) /**< Right Ascension Seconds            */ \
+    COMMAND( DeclinationHours,      "DECH", DeclinationHoursHandler       ) /**< Declination Hours                  */ \
+    COMMAND( DeclinationMinutes,    "DECm", DeclinationMinutesHandler     ) /**< Declination Minutes                */ \
+    COMMAND( DeclinationSeconds,    "DECS", DeclinationSecondsHandler     ) /**< Declination Seconds                */ \
+    COMMAND( Juliandate,            "JDAT", JuliandateHandler             ) /**< JulianDate                         */ \
+    COMMAND( Gpsmode,               "GPSM", GpsmodeHandler                ) /**< Gps Fix Mode                       */ \
+    COMMAND( Latitude,              "Lati", LatitudeHandler               ) /**< (180*(Angles.Latitude/M_PI))       */ \
+    COMMAND( Longitude,             "Long", LongitudeHandler              ) /**< (180*(Angles.LongitudeWest/M_PI))  */ \
+    COMMAND( GpsLatitudeHours,      "GLAH", GpsLatitudeHoursHandler       ) /**< Gps source latitude degrees        */ \
+    COMMAND( GpsLatitudeMinutes,    "GLAm", GpsLatitudeMinutesHandler     ) /**< Gps source latitude minutes        */ \
+    COMMAND( GpsLatitudeSeconds,    "GLAS", GpsLatitudeSecondsHandler     ) /**< Gps source latitude seconds        */ \
+    COMMAND( GpsLongitudeHours,     "GLOH", GpsLongitudeHoursHandler      ) /**< Gps source longitude hours         */ \
+    COMMAND( GpsLongitudeMinutes,   "GLOm", GpsLongitudeMinutesHandler    ) /**< Gps source longitude minutes       */ \
+    COMMAND( GpsLongitudeSeconds,   "GLOS", GpsLongitudeSecondsHandler    ) /**< Gps source longitude seconds       */ \
+    COMMAND( RawAccelerometerX,     "RwAx", RawAccelerometerXHandler      ) /**< Raw data from the Accelerometer    */ \
+    COMMAND( RawAccelerometerY,     "RwAy", RawAccelerometerYHandler      ) /**< Raw data from the Accelerometer    */ \
+    COMMAND( RawAccelerometerZ,     "RwAz", RawAccelerometerZHandler      ) /**< Raw data from the Accelerometer    */ \
+    COMMAND( MinAccelerometerX,     "MiAx", MinAccelerometerXHandler      ) /**< Min data from the Accelerometer    */ \
+    COMMAND( MinAccelerometerY,     "MiAy", MinAccelerometerYHandler      ) /**< Min data from the Accelerometer    */ \
+    COMMAND( MinAccelerometerZ,     "MiAz", MinAccelerometerZHandler      ) /**< Min data from the Accelerometer    */ \
+    COMMAND( MaxAccelerometerX,     "MaAx", MaxAccelerometerXHandler      ) /**< Max data from the Accelerometer    */ \
+    COMMAND( MaxAccelerometerY,     "MaAy", MaxAccelerometerYHandler      ) /**< Max data from the Accelerometer    */ \
+    COMMAND( MaxAccelerometerZ,     "MaAz", MaxAccelerometerZHandler      ) /**< Max data from the Accelerometer    */ \
+    COMMAND( RawMagnetometerX,      "RwMx", RawMagnetometerXHandler       ) /**< Raw data from the Magnetometer     */ \
+    COMMAND( RawMagnetometerY,      "RwMy", RawMagnetometerYHandler       ) /**< Raw data from the Magnetometer     */ \
+    COMMAND( RawMagnetometerZ,      "RwMz", RawMagnetometerZHandler       ) /**< Raw data from the Magnetometer     */ \
+    COMMAND( MinMagnetometerX,      "MiMx", MinMagnetometerXHandler       ) /**< Min data from the Magnetometer     */ \
+    COMMAND( MinMagnetometerY,      "MiMy", MinMagnetometerYHandler       ) /**< Min data from the Magnetometer     */ \
+    COMMAND( MinMagnetometerZ,      "MiMz", MinMagnetometerZHandler       ) /**< Min data from the Magnetometer     */ \
+    COMMAND( MaxMagnetometerX,      "MaMx", MaxMagnetometerXHandler       ) /**< Max data from the Magnetometer     */ \
+    COMMAND( MaxMagnetometerY,      "MaMy", MaxMagnetometerYHandler       ) /**< Max data from the Magnetometer     */ \
+    COMMAND( MaxMagnetometerZ,      "MaMz", MaxMagnetometerZHandler       ) /**< Max data from the Magnetometer     */ \
+    COMMAND( CalibrationEnable,     "CALE", CalibrationEnableHandler      ) /**< Calibration enable                 */ \
+    COMMAND( MagneticOffset,        "MAGO", MagneticOffsetHandler         ) /**< user offset to Azimuth             */ \
+    COMMAND( AccelOffset,           "ACCO", AccelOffsetHandler            ) /**< user offsset to Altitude           */ \
+    COMMAND( Default,               "DFLT", DefaultHandler                ) /**< any debug string                   */
+
+/** Command ids, the index of each command in TelescopeData
+ */
+#define TELESCOPE_COMMAND_ID( Name, Header, Handler ) Name##Command,
+typedef enum
+{
+    TELESCOPE_COMMANDS( TELESCOPE_COMMAND_ID )
+    TELESCOPE_COMMAND_COUNT
+} TELESCOPE_COMMAND_T;
+#undef TELESCOPE_COMMAND_ID
+
+static_assert( TELESCOPE_COMMAND_COUNT == TELESCOPE_SOCKET_HANDLERS, "TELESCOPE_SOCKET_HANDLERS does not match TELESCOPE_COMMANDS" );
+
+/** Key of a header, the four characters in the order they are received
+ */
+constexpr uint32_t TelescopeKey( const char* Header )
+{
+    return (uint32_t)(uint8_t)Header[0]
+        | ( (uint32_t)(uint8_t)Header[1] << 8 )
+        | ( (uint32_t)(uint8_t)Header[2] << 16 )
+        | ( (uint32_t)(uint8_t)Header[3] << 24 );
+}
+
+/** Key of the header at the start of a received message, a message
+ *  shorter than a header gets a key that matches no command
+ */
+inline uint32_t TelescopeMessageKey( const char* Message )
+{
+    uint32_t Key = 0u;
+    uint8_t Index = 0u;
+    for ( Index = 0u; ( Index < 4u ) && ( Message[Index] != '\0' ); Index++ )
+    {
+        Key |= ( (uint32_t)(uint8_t)Message[Index] << ( 8u * Index ) );
+    }
+    return Key;
+}
+
+/** One case of the dispatch switch, see TelescopeSocket::FindHandler
+ */
+#define TELESCOPE_COMMAND_CASE( Name, Header, Handler ) case TelescopeKey( Header ): Id = Name##Command; break;
 
 typedef struct
 {
     const char Header[5];
-    uint8_t (*handler)( char* );
+    uint16_t (*handler)( char* );   /**< writes the reply over the request, returns its length */
 } TELEDATA_T;
 
+/** Subscription of one HalSocket client, see SubscribeHandler
+ */
+typedef struct
+{
+    uint64_t Fields;        /**< one bit per TelescopeData entry */
+    uint64_t Pending;       /**< changed fields not sent yet */
+    uint32_t Period;        /**< milliseconds between updates, 0 to send on change */
+    uint64_t NextUpdate;    /**< time of the next update in milliseconds */
+} SUBSCRIPTION_T;
 
-class TelescopeSocket 
+class TelescopeSocket : public HalReactorHandler
 {
     public:
     /** Constructor
      */
         TelescopeSocket();
+    /** Initialise the subscriptions, call after HalSocket::Init
+     * @return bool true if successful
+     */
+        bool Init( void );
     /** callback to handle which message has been sent
      */
         static void SocketCallback ( char* Buffer );
+    /** Find the command at the start of a message
+     * @param Message received message, '\0' terminated
+     * @return uint8_t index in TelescopeData, TELESCOPE_COMMAND_COUNT if there is no match
+     */
+        static uint8_t FindHandler ( const char* Message );
+    /** binary message framing for HalSocket, see TelemetryProtocol.h
+     * @return uint32_t length of the first frame, 0 if incomplete
+     */
+        static uint32_t BinaryLength ( const uint8_t* Data, uint32_t Count );
+    /** callback for a binary request, writes the values asked for
+     * @param Request the request frame
+     * @param Length length of the request
+     * @param Reply buffer of HAL_SOCKET_BINARY_SIZE bytes for the reply
+     * @return uint32_t length of the reply
+     */
+        static uint32_t BinaryCallback ( const uint8_t* Request, uint32_t Length, uint8_t* Reply );
+    /** message framing for HalSocket, a MULT message holds several '#'
+     *  terminated commands and ends with a newline, or with the last '#'
+     *  received if the client sent no newline
+     * @return uint32_t length of the first message, 0 if incomplete
+     */
+        static uint32_t MessageLength ( const char* Buffer );
     /** only one instance of this class is required.
      */
         static TelescopeSocket TeleSocket;
 
-        static TELEDATA_T TelescopeData[60];
-    /** Handler for an multiple message
+        static TELEDATA_T TelescopeData[TELESCOPE_SOCKET_HANDLERS];
+    /** Handler for an multiple message, "MULT <command>#<command>#...",
+     *  each command's reply follows "MULT " in the order asked. The reply
+     *  may be up to HAL_SOCKET_REPLY_SIZE long, it is '\0' terminated
+     * @return uint16_t length of the reply
+     */
+        static uint16_t MultiHandler( char* Buffer );
+    /** Handler for a subscription, "SUB =<ms>,<headers>#" adds the headers
+     *  to the client's subscription and sets how often they are pushed,
+     *  0 ms pushes each value when it changes. "SUB #" ends the subscription.
+     */
+        static uint16_t SubscribeHandler( char* Buffer );
+    /** TelescopeManager publish hook, encodes each subscribed value once
+     *  and wakes the reactor to push it to the subscribers
+     */
+        static void Publish( void );
+    /** HalSocket close callback, forgets the client's subscription
+     */
+        static void ClientClosed( uint16_t Client );
+    /** Push the new values to the subscribers, on the reactor thread
+     * @param Events the epoll events
      */
-        static uint8_t MultiHandler( char* Buffer );
+        void HandleEvents( uint32_t Events );
     /** Handler for RightAscension
      */
-        static uint8_t RightAscensionHandler( char* Buffer );
+        static uint16_t RightAscensionHandler( char* Buffer );
     /** Handler for Declination
      */
-        static uint8_t DeclinationHandler( char* Buffer );
+        static uint16_t DeclinationHandler( char* Buffer );
     /** Handler for TargetRightAscension
      */
-        static uint8_t TargetRightAscensionHandler( char* Buffer );
+        static uint16_t TargetRightAscensionHandler( char* Buffer );
     /** Handler for TargetDeclination
      */
-        static uint8_t TargetDeclinationHandler( char* Buffer );
+        static uint16_t TargetDeclinationHandler( char* Buffer );
     /** Handler for UnixTime
      */
-        static uint8_t UnixTimeHandler( char* Buffer );
+        static uint16_t UnixTimeHandler( char* Buffer );
     /** Handler for GreenwichMeanTime
      */
-        static uint8_t GreenwichMeanTimeDayHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeDayHandler( char* Buffer );
     /** Handler for GreenwichMeanTimeMon
      */
-        static uint8_t GreenwichMeanTimeMonHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeMonHandler( char* Buffer );
     /** Handler for GreenwichMeanTimeYear
      */
-        static uint8_t GreenwichMeanTimeYearHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeYearHandler( char* Buffer );
     /** Handler for GreenwichMeanTimeHour
      */
-        static uint8_t GreenwichMeanTimeHourHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeHourHandler( char* Buffer );
     /** Handler for GreenwichMeanTimeMin
      */
-        static uint8_t GreenwichMeanTimeMinHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeMinHandler( char* Buffer );
     /** Handler for GreenwichMeanTimeSec
      */
-        static uint8_t GreenwichMeanTimeSecHandler( char* Buffer );
+        static uint16_t GreenwichMeanTimeSecHandler( char* Buffer );
     /** Handler for BritishStandardTime
      */
-        static uint8_t BritishStandardTimeHandler( char* Buffer );
+        static uint16_t BritishStandardTimeHandler( char* Buffer );
     /** Handler for Roll
      */
-        static uint8_t RollHandler( char* Buffer );
+        static uint16_t RollHandler( char* Buffer );
     /** Handler for Altitude/Pitch
      */
-        static uint8_t AltitudeHandler( char* Buffer );
+        static uint16_t AltitudeHandler( char* Buffer );
     /** Handler for AzimuthHandler
      */
-        static uint8_t AzimuthHandler( char* Buffer );
+        static uint16_t AzimuthHandler( char* Buffer );
     /** Handler for MagneticHeading
      */
-        static uint8_t MagneticHeadingHandler( char* Buffer );
+        static uint16_t MagneticHeadingHandler( char* Buffer );
     /** Handler for MagneticDeclination
      */
-        static uint8_t MagneticDeclinationHandler( char* Buffer );
+        static uint16_t MagneticDeclinationHandler( char* Buffer );
     /** Handler for HieghtAboveGround
      */
-        static uint8_t HieghtAboveGroundHandler( char* Buffer );
+        static uint16_t HieghtAboveGroundHandler( char* Buffer );
     /** Handler for LocalSidrealTimeHour
      */
-        static uint8_t LocalSidrealTimeHourHandler( char* Buffer );
+        static uint16_t LocalSidrealTimeHourHandler( char* Buffer );
     /** Handler for LocalSidrealTimeMin
      */
-        static uint8_t LocalSidrealTimeMinHandler( char* Buffer );
+        static uint16_t LocalSidrealTimeMinHandler( char* Buffer );
     /** Handler for LocalSidrealTimeSec
      */
-        static uint8_t LocalSidrealTimeSecHandler( char* Buffer );
+        static uint16_t LocalSidrealTimeSecHandler( char* Buffer );
     /** Handler for RightAscensionHours
      */
-        static uint8_t RightAscensionHoursHandler( char* Buffer );
+        static uint16_t RightAscensionHoursHandler( char* Buffer );
     /** Handler for RightAscensionMin
      */
-        static uint8_t RightAscensionMinHandler( char* Buffer );
+        static uint16_t RightAscensionMinHandler( char* Buffer );
     /** Handler for RightAscensionSec
      */
-        static uint8_t RightAscensionSecHandler( char* Buffer );
+        static uint16_t RightAscensionSecHandler( char* Buffer );
     /** Handler for DeclinationHours
      */
-        static uint8_t DeclinationHoursHandler( char* Buffer );
+        static uint16_t DeclinationHoursHandler( char* Buffer );
     /** Handler for DeclinationMinutes
      */
-        static uint8_t DeclinationMinutesHandler( char* Buffer );
+        static uint16_t DeclinationMinutesHandler( char* Buffer );
     /** Handler for DeclinationSeconds
      */
-        static uint8_t DeclinationSecondsHandler( char* Buffer );
+        static uint16_t DeclinationSecondsHandler( char* Buffer );
     /** Handler for Juliandate
      */
-        static uint8_t JuliandateHandler( char* Buffer );
+        static uint16_t JuliandateHandler( char* Buffer );
     /** Handler for Gpsmode
      */
-        static uint8_t GpsmodeHandler( char* Buffer );
+        static uint16_t GpsmodeHandler( char* Buffer );
     /** Handler for Latitude
      */
-        static uint8_t LatitudeHandler( char* Buffer );
+        static uint16_t LatitudeHandler( char* Buffer );
     /** Handler for LongitudeHandler
      */
-        static uint8_t LongitudeHandler( char* Buffer );
+        static uint16_t LongitudeHandler( char* Buffer );
     /** Handler for latitude hours  
      */
-        static uint8_t GpsLatitudeHoursHandler( char* Buffer );
+        static uint16_t GpsLatitudeHoursHandler( char* Buffer );
     /** Handler for GpsLatitudeMinutes
      */
-        static uint8_t GpsLatitudeMinutesHandler( char* Buffer );
+        static uint16_t GpsLatitudeMinutesHandler( char* Buffer );
     /** Handler for GpsLatitudeSeconds
      */
-        static uint8_t GpsLatitudeSecondsHandler( char* Buffer );
+        static uint16_t GpsLatitudeSecondsHandler( char* Buffer );
     /** Handler for GpsLongitudeHours
      */
-        static uint8_t GpsLongitudeHoursHandler( char* Buffer );
+        static uint16_t GpsLongitudeHoursHandler( char* Buffer );
     /** Handler for GpsLongitudeMinutes
      */
-        static uint8_t GpsLongitudeMinutesHandler( char* Buffer );
+        static uint16_t GpsLongitudeMinutesHandler( char* Buffer );
     /** Handler for GpsLongitudeMinutes
      */
-        static uint8_t GpsLongitudeSecondsHandler( char* Buffer );
+        static uint16_t GpsLongitudeSecondsHandler( char* Buffer );
     /** Handler for RawAccelerometerX
      */
-        static uint8_t RawAccelerometerXHandler( char* Buffer );
+        static uint16_t RawAccelerometerXHandler( char* Buffer );
     /** Handler for RawAccelerometerY
      */
-        static uint8_t RawAccelerometerYHandler( char* Buffer );
+        static uint16_t RawAccelerometerYHandler( char* Buffer );
     /** Handler for RawAccelerometerZ
      */
-        static uint8_t RawAccelerometerZHandler( char* Buffer );
+        static uint16_t RawAccelerometerZHandler( char* Buffer );
     /** Handler for MinAccelerometerX
      */
-        static uint8_t MinAccelerometerXHandler( char* Buffer );
+        static uint16_t MinAccelerometerXHandler( char* Buffer );
     /** Handler for MinAccelerometerY
      */
-        static uint8_t MinAccelerometerYHandler( char* Buffer );
+        static uint16_t MinAccelerometerYHandler( char* Buffer );
     /** Handler for MinAccelerometerZHandler
      */
-        static uint8_t MinAccelerometerZHandler( char* Buffer );
+        static uint16_t MinAccelerometerZHandler( char* Buffer );
     /** Handler for MaxAccelerometerX
      */
-        static uint8_t MaxAccelerometerXHandler( char* Buffer );
+        static uint16_t MaxAccelerometerXHandler( char* Buffer );
     /** Handler for MaxAccelerometerY
      */
-        static uint8_t MaxAccelerometerYHandler( char* Buffer );
+        static uint16_t MaxAccelerometerYHandler( char* Buffer );
     /** Handler for MaxAccelerometerZ
      */
-        static uint8_t MaxAccelerometerZHandler( char* Buffer );
+        static uint16_t MaxAccelerometerZHandler( char* Buffer );
     /** Handler for RawMagnetometerX
      */
-        static uint8_t RawMagnetometerXHandler( char* Buffer );
+        static uint16_t RawMagnetometerXHandler( char* Buffer );
     /** Handler for RawMagnetometerY
      */
-        static uint8_t RawMagnetometerYHandler( char* Buffer );
+        static uint16_t RawMagnetometerYHandler( char* Buffer );
     /** Handler for RawMagnetometerZ
      */
-        static uint8_t RawMagnetometerZHandler( char* Buffer );
+        static uint16_t RawMagnetometerZHandler( char* Buffer );
     /** Handler for MinMagnetometerX
      */
-        static uint8_t MinMagnetometerXHandler( char* Buffer );
+        static uint16_t MinMagnetometerXHandler( char* Buffer );
     /** Handler for MinMagnetometerY
      */
-        static uint8_t MinMagnetometerYHandler( char* Buffer );
+        static uint16_t MinMagnetometerYHandler( char* Buffer );
     /** Handler for MinMagnetometerZHandler
      */
-        static uint8_t MinMagnetometerZHandler( char* Buffer );
+        static uint16_t MinMagnetometerZHandler( char* Buffer );
     /** Handler for MaxMagnetometerX
      */
-        static uint8_t MaxMagnetometerXHandler( char* Buffer );
+        static uint16_t MaxMagnetometerXHandler( char* Buffer );
     /** Handler for MaxMagnetometerY
      */
-        static uint8_t MaxMagnetometerYHandler( char* Buffer );
+        static uint16_t MaxMagnetometerYHandler( char* Buffer );
     /** Handler for MaxMagnetometerZ
      */
-        static uint8_t MaxMagnetometerZHandler( char* Buffer );
+        static uint16_t MaxMagnetometerZHandler( char* Buffer );
     /** Handler for Calibration Enable
      */
-        static uint8_t CalibrationEnableHandler( char* Buffer );
+        static uint16_t CalibrationEnableHandler( char* Buffer );
     /** Handler for Magnetic Offset
      */
-        static uint8_t MagneticOffsetHandler( char* Buffer );
+        static uint16_t MagneticOffsetHandler( char* Buffer );
     /** Handler for Accel Offset
      */
-        static uint8_t AccelOffsetHandler( char* Buffer );
+        static uint16_t AccelOffsetHandler( char* Buffer );
     /** Handler for an unknown message
      */
-        static uint8_t DefaultHandler( char* Buffer );
+        static uint16_t DefaultHandler( char* Buffer );
+    /** Get the value of a binary field, the dispatch lock must be held
+     * @param Id TELEMETRY_FIELD_T
+     * @return bool false if there is no such field
+     */
+        static bool GetTelemetryValue( uint8_t Id, TELEMETRY_VALUE_T* Value );
         
     private:
+    /** Whether a command can be subscribed to, the commands with side effects can not
+     */
+        static bool IsSubscribable( uint8_t Id );
+    /** Recalculate SubscribedFields, the dispatch lock must be held
+     */
+        static void UpdateSubscribedFields( void );
+    /** Write a reply to Buffer, the value with six decimals
+     * @param Header the four characters of the command
+     * @return uint8_t length of the reply including the '#'
+     */
+        static uint8_t ReplyReal( char* Buffer, const char* Header, double Value );
+    /** Write a reply to Buffer, the value as an integer
+     * @return uint8_t length of the reply including the '#'
+     */
+        static uint8_t ReplyInteger( char* Buffer, const char* Header, int32_t Value );
+
+        static SUBSCRIPTION_T Subscriptions[HAL_SOCKET_MAX_CLIENTS];   /**< reactor thread only */
+        static uint64_t SubscribedFields;   /**< all the subscribed fields */
+        static uint64_t ChangedFields;      /**< fields changed since the last push */
+        static char Encoded[TELESCOPE_SOCKET_HANDLERS][TELESCOPE_SOCKET_VALUE_SIZE];   /**< latest value of each field */
+        static uint8_t EncodedLength[TELESCOPE_SOCKET_HANDLERS];                 /**< 0 if not encoded */
+        static int PublishFd;               /**< eventfd, written by Publish */
+        static uint32_t PublishedTraceId;   /**< LatencyTrace Id of the encoded values */
 
 };
 
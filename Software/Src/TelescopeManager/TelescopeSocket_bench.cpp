@@ -0,0 +1,127 @@
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "TelescopeSocket.h"
+/*
+ TelescopeSocket dispatch benchmark
+ Walks a MULT message holding every command but MULT, the way MultiHandler
+ does, and times finding each handler with the old strncmp scan of the
+ table and with the switch on the four byte key. Both are built from
+ TELESCOPE_COMMANDS, the switch is the one in TelescopeSocket::FindHandler.
+ Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/TelescopeManager -I./Src/Utils \
+     Src/TelescopeManager/TelescopeSocket_bench.cpp Src/Utils/Metrics.cpp \
+     -lpthread -latomic -o TelescopeSocket_bench
+ */
+
+#define BENCH_LOOPS     100000
+
+#define BENCH_HEADER( Name, Header, Handler ) Header,
+static const char* headers[TELESCOPE_COMMAND_COUNT] = { TELESCOPE_COMMANDS( BENCH_HEADER ) };
+#undef BENCH_HEADER
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* the lookup TelescopeSocket used before */
+static uint8_t findScan(const char* message)
+{
+    uint8_t id = 0u;
+    for (id = 0u; id < TELESCOPE_COMMAND_COUNT; id++)
+    {
+        if (strncmp(message, headers[id], 4) == 0)
+        {
+            break;
+        }
+    }
+    return id;
+}
+
+/* the same switch as TelescopeSocket::FindHandler */
+static uint8_t findSwitch(const char* message)
+{
+    uint8_t Id = TELESCOPE_COMMAND_COUNT;
+    switch (TelescopeMessageKey(message))
+    {
+        TELESCOPE_COMMANDS( TELESCOPE_COMMAND_CASE )
+        default: break;
+    }
+    return Id;
+}
+
+/* walk the commands of a MULT message, returns a checksum of the ids found */
+static uint32_t dispatch(const char* message, uint8_t (*find)(const char*), uint32_t* commands)
+{
+    uint32_t sum = 0u;
+    const char* command = message + 5;
+    while (*command != '\n')
+    {
+        const uint8_t id = find(command);
+        sum = (sum * 31u) + id;
+        (*commands)++;
+        command += strcspn(command, "#") + 1u;
+    }
+    return sum;
+}
+
+int main()
+{
+    static char message[5 + (TELESCOPE_COMMAND_COUNT * 5) + 2];
+    uint32_t length = 0u;
+    uint32_t scanCommands = 0u;
+    uint32_t switchCommands = 0u;
+    uint32_t scanSum = 0u;
+    uint32_t switchSum = 0u;
+    int failures = 0;
+
+    /* "MULT " and then every other command */
+    length = sprintf(message, "MULT ");
+    for (uint8_t id = 0u; id < TELESCOPE_COMMAND_COUNT; id++)
+    {
+        if (id != MultiItemCommand)
+        {
+            length += sprintf(&message[length], "%.4s#", headers[id]);
+        }
+        if (findSwitch(headers[id]) != id)
+        {
+            fprintf(stderr, "FAIL: %.4s dispatched to %u\n", headers[id], findSwitch(headers[id]));
+            failures++;
+        }
+    }
+    sprintf(&message[length], "\n");
+    if ((findSwitch("ZZZZ#") != TELESCOPE_COMMAND_COUNT) || (findSwitch("RA#") != TELESCOPE_COMMAND_COUNT))
+    {
+        fprintf(stderr, "FAIL: unknown command dispatched\n");
+        failures++;
+    }
+
+    double start = seconds();
+    for (uint32_t loop = 0u; loop < BENCH_LOOPS; loop++)
+    {
+        scanSum += dispatch(message, &findScan, &scanCommands);
+    }
+    const double scanTime = seconds() - start;
+    start = seconds();
+    for (uint32_t loop = 0u; loop < BENCH_LOOPS; loop++)
+    {
+        switchSum += dispatch(message, &findSwitch, &switchCommands);
+    }
+    const double switchTime = seconds() - start;
+    if ((scanSum != switchSum) || (scanCommands != switchCommands))
+    {
+        fprintf(stderr, "FAIL: the scan and the switch found different commands\n");
+        failures++;
+    }
+
+    printf("%u commands per MULT\n", scanCommands / BENCH_LOOPS);
+    printf("scan:   %.1f ns per command\n", (scanTime * 1.0e9) / scanCommands);
+    printf("switch: %.1f ns per command, %.1fx faster\n", (switchTime * 1.0e9) / switchCommands, scanTime / switchTime);
+    printf("%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
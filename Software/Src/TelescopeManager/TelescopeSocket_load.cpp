@@ -0,0 +1,507 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include "HalSocket.h"
+/*
+ TelescopeSocket load generator
+ Opens many clients to a running StarPi on this machine and measures how
+ many dashboard clients it can serve. The text clients send a mix of
+ single commands and MULT requests to the HalSocket port at a target
+ rate, the Stellarium clients send a goto now and then and count the
+ position messages pushed to them. It reports the replies per second,
+ the p50, p99 and p999 latency of each kind of request, the gaps between
+ position messages and every error. Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Hal -I./Src/Utils \
+     Src/TelescopeManager/TelescopeSocket_load.cpp -o TelescopeSocket_load
+
+ ./TelescopeSocket_load [-p port] [-s stellarium port] [-c clients] [-S stellarium clients]
+                        [-r requests/s] [-m MULT %] [-g gotos/s] [-d seconds]
+
+ With -r 0 each client sends its next request as soon as the reply comes.
+ Otherwise the requests are sent on a fixed schedule and a reply is timed
+ from when its request was due, so a slow reply also counts against the
+ requests queued behind it. The exit code is 1 if there were any errors.
+ */
+
+#define LOAD_MAX_CLIENTS        ( HAL_SOCKET_MAX_CLIENTS + 256 )
+#define LOAD_TIMEOUT_US         2000000     /* a reply later than this is an error and the client is closed */
+#define LOAD_POSITION_SIZE      24u         /* Stellarium position message */
+#define LOAD_GOTO_SIZE          20u         /* Stellarium goto message */
+#define LOAD_BUCKETS            1792u       /* see bucketOf */
+
+/* the getters a dashboard polls, and all of them in one MULT */
+static const char* const commands[] = { "RA  ", "DEC ", "Unix", "Pitc", "Azim", "Roll", "MagD", "GPSM", "Lati", "Long", "GMTH" };
+#define LOAD_COMMANDS   ( sizeof(commands) / sizeof(commands[0]) )
+
+typedef enum
+{
+    LOAD_SINGLE = 0,
+    LOAD_MULT,
+    LOAD_POSITION,
+    LOAD_KINDS
+} LOAD_KIND_T;
+
+typedef struct
+{
+    int fd;
+    bool stellarium;
+    int64_t due;            /* when the next request or goto is to be sent */
+    int64_t started;        /* when the outstanding request was due, 0 if none */
+    uint8_t kind;           /* of the outstanding request */
+    uint32_t expected;      /* replies, one '#' each, still to come */
+    uint32_t length;
+    char reply[HAL_SOCKET_REPLY_SIZE];
+    int64_t lastPosition;
+} LOAD_CLIENT_T;
+
+/* log-linear, exact below 128 us and within 1.6% above */
+typedef struct
+{
+    uint32_t counts[LOAD_BUCKETS];
+    uint64_t total;
+    int64_t max;
+} LOAD_HISTOGRAM_T;
+
+typedef struct
+{
+    uint64_t connect;
+    uint64_t disconnected;
+    uint64_t timeout;
+    uint64_t notSupported;
+    uint64_t send;
+    uint64_t malformed;
+} LOAD_ERRORS_T;
+
+static LOAD_CLIENT_T clients[LOAD_MAX_CLIENTS];
+static LOAD_HISTOGRAM_T histograms[LOAD_KINDS];
+static LOAD_ERRORS_T errors[2];     /* text, Stellarium */
+static uint64_t sent[LOAD_KINDS];
+static uint64_t positions;
+static char multRequest[8 + (LOAD_COMMANDS * 5)];
+
+static int64_t micros(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((int64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static uint32_t bucketOf(int64_t value)
+{
+    const uint64_t us = (value > 0) ? (uint64_t)value : 0u;
+    if (us < 128u)
+    {
+        return (uint32_t)us;
+    }
+    const uint32_t exponent = 63u - __builtin_clzll(us);
+    const uint32_t bucket = 128u + ((exponent - 7u) * 64u) + (uint32_t)((us >> (exponent - 6u)) - 64u);
+    return (bucket < LOAD_BUCKETS) ? bucket : (LOAD_BUCKETS - 1u);
+}
+
+/* the largest value in a bucket */
+static int64_t valueOf(uint32_t bucket)
+{
+    if (bucket < 128u)
+    {
+        return bucket;
+    }
+    const uint32_t exponent = 7u + ((bucket - 128u) / 64u);
+    const uint64_t mantissa = 64u + ((bucket - 128u) % 64u);
+    return (int64_t)(((mantissa + 1u) << (exponent - 6u)) - 1u);
+}
+
+static void observe(LOAD_HISTOGRAM_T* histogram, int64_t us)
+{
+    histogram->counts[bucketOf(us)]++;
+    histogram->total++;
+    histogram->max = (us > histogram->max) ? us : histogram->max;
+}
+
+static int64_t percentile(const LOAD_HISTOGRAM_T* histogram, double fraction)
+{
+    const uint64_t rank = (uint64_t)((fraction * histogram->total) + 0.999999);
+    uint64_t seen = 0u;
+    for (uint32_t bucket = 0u; bucket < LOAD_BUCKETS; bucket++)
+    {
+        seen += histogram->counts[bucket];
+        if ((seen >= rank) && (seen > 0u))
+        {
+            return (valueOf(bucket) < histogram->max) ? valueOf(bucket) : histogram->max;
+        }
+    }
+    return 0;
+}
+
+static int connectTo(uint16_t port)
+{
+    struct sockaddr_in address;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+    if ((fd >= 0) && (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0))
+    {
+        close(fd);
+        fd = -1;
+    }
+    if (fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd;
+}
+
+static void closeClient(LOAD_CLIENT_T* client)
+{
+    close(client->fd);
+    client->fd = -1;
+    client->started = 0;
+}
+
+static bool sendAll(LOAD_CLIENT_T* client, const void* data, uint32_t length)
+{
+    if (write(client->fd, data, length) != (ssize_t)length)
+    {
+        /* the requests are far smaller than the socket buffer, so a short write is the server not reading */
+        errors[client->stellarium ? 1 : 0].send++;
+        closeClient(client);
+        return false;
+    }
+    return true;
+}
+
+/* send the next request, a MULT multPercent times in a hundred */
+static void sendRequest(LOAD_CLIENT_T* client, uint32_t sequence, uint32_t multPercent, int64_t started)
+{
+    char request[8];
+    client->length = 0u;
+    if ((sequence % 100u) < multPercent)
+    {
+        client->kind = LOAD_MULT;
+        client->expected = LOAD_COMMANDS;
+        if (!sendAll(client, multRequest, strlen(multRequest)))
+        {
+            return;
+        }
+    }
+    else
+    {
+        client->kind = LOAD_SINGLE;
+        client->expected = 1u;
+        sprintf(request, "%s#", commands[sequence % LOAD_COMMANDS]);
+        if (!sendAll(client, request, 5u))
+        {
+            return;
+        }
+    }
+    client->started = started;
+    sent[client->kind]++;
+}
+
+/* a goto somewhere in the sky, as Stellarium sends it */
+static void sendGoto(LOAD_CLIENT_T* client)
+{
+    uint8_t message[LOAD_GOTO_SIZE];
+    const uint32_t ra = (uint32_t)rand() * 2654435761u;
+    const int32_t dec = (rand() % 0x40000000) - 0x20000000;
+    const int64_t now = micros();
+    memset(message, 0, sizeof(message));
+    message[0] = LOAD_GOTO_SIZE;
+    for (uint8_t byte = 0u; byte < 8u; byte++)
+    {
+        message[4u + byte] = (uint8_t)((uint64_t)now >> (8u * byte));
+    }
+    for (uint8_t byte = 0u; byte < 4u; byte++)
+    {
+        message[12u + byte] = (uint8_t)(ra >> (8u * byte));
+        message[16u + byte] = (uint8_t)((uint32_t)dec >> (8u * byte));
+    }
+    if (sendAll(client, message, sizeof(message)))
+    {
+        sent[LOAD_POSITION]++;
+    }
+}
+
+/* read what has arrived, false if the client was closed */
+static bool receive(LOAD_CLIENT_T* client)
+{
+    LOAD_ERRORS_T* error = &errors[client->stellarium ? 1 : 0];
+    for (;;)
+    {
+        const ssize_t got = read(client->fd, &client->reply[client->length], sizeof(client->reply) - 1u - client->length);
+        if (got <= 0)
+        {
+            if ((got < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+            {
+                return true;
+            }
+            error->disconnected++;
+            closeClient(client);
+            return false;
+        }
+        const int64_t now = micros();
+        if (client->stellarium)
+        {
+            /* whole position messages, each is size, type, time, RA, Dec, status */
+            client->length += (uint32_t)got;
+            uint32_t used = 0u;
+            while ((client->length - used) >= 2u)
+            {
+                const uint8_t* message = (const uint8_t*)&client->reply[used];
+                const uint16_t size = (uint16_t)(message[0] | (message[1] << 8));
+                if ((size != LOAD_POSITION_SIZE) || (((client->length - used) >= 4u) && ((message[2] | message[3]) != 0u)))
+                {
+                    error->malformed++;
+                    closeClient(client);
+                    return false;
+                }
+                if ((client->length - used) < LOAD_POSITION_SIZE)
+                {
+                    break;
+                }
+                if (client->lastPosition != 0)
+                {
+                    observe(&histograms[LOAD_POSITION], now - client->lastPosition);
+                }
+                client->lastPosition = now;
+                positions++;
+                used += LOAD_POSITION_SIZE;
+            }
+            memmove(client->reply, &client->reply[used], client->length - used);
+            client->length -= used;
+        }
+        else
+        {
+            for (ssize_t index = 0; index < got; index++)
+            {
+                if ((client->reply[client->length + index] == '#') && (client->expected > 0u))
+                {
+                    client->expected--;
+                }
+            }
+            client->length += (uint32_t)got;
+            if ((client->started == 0) || (client->length >= (sizeof(client->reply) - 1u)))
+            {
+                /* more than was asked for */
+                error->malformed++;
+                closeClient(client);
+                return false;
+            }
+            if (client->expected == 0u)
+            {
+                client->reply[client->length] = '\0';
+                if (strstr(client->reply, "Not Supported") != NULL)
+                {
+                    error->notSupported++;
+                }
+                observe(&histograms[client->kind], now - client->started);
+                client->started = 0;
+                client->length = 0u;
+            }
+        }
+    }
+}
+
+static void printLatency(const char* name, const LOAD_HISTOGRAM_T* histogram, double divisor, const char* unit)
+{
+    printf("%-10s %8llu, p50 %.1f %s, p99 %.1f %s, p999 %.1f %s, max %.1f %s\n", name,
+           (unsigned long long)histogram->total, percentile(histogram, 0.50) / divisor, unit,
+           percentile(histogram, 0.99) / divisor, unit, percentile(histogram, 0.999) / divisor, unit,
+           histogram->max / divisor, unit);
+}
+
+int main(int argc, char* argv[])
+{
+    uint16_t port = 9999;
+    uint16_t stellariumPort = 10001;
+    uint32_t socketClients = 16u;
+    uint32_t stellariumClients = 4u;
+    double rate = 1000.0;
+    uint32_t multPercent = 50u;
+    double gotoRate = 1.0;
+    double duration = 10.0;
+    int option = 0;
+
+    while ((option = getopt(argc, argv, "p:s:c:S:r:m:g:d:")) != -1)
+    {
+        switch (option)
+        {
+            case 'p': port = (uint16_t)atoi(optarg); break;
+            case 's': stellariumPort = (uint16_t)atoi(optarg); break;
+            case 'c': socketClients = (uint32_t)atoi(optarg); break;
+            case 'S': stellariumClients = (uint32_t)atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 'm': multPercent = (uint32_t)atoi(optarg); break;
+            case 'g': gotoRate = atof(optarg); break;
+            case 'd': duration = atof(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-p port] [-s stellarium port] [-c clients] [-S stellarium clients] "
+                                "[-r requests/s] [-m MULT %%] [-g gotos/s] [-d seconds]\n", argv[0]);
+                return 126;
+        }
+    }
+    if (((socketClients + stellariumClients) > LOAD_MAX_CLIENTS) || (multPercent > 100u) || (duration <= 0.0))
+    {
+        fprintf(stderr, "at most %u clients, MULT 0 to 100%%, a positive duration\n", (unsigned)LOAD_MAX_CLIENTS);
+        return 126;
+    }
+
+    uint32_t length = sprintf(multRequest, "MULT ");
+    for (uint32_t index = 0u; index < LOAD_COMMANDS; index++)
+    {
+        length += sprintf(&multRequest[length], "%s#", commands[index]);
+    }
+    sprintf(&multRequest[length], "\n");
+
+    const int epoll = epoll_create1(EPOLL_CLOEXEC);
+    const int timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u32 = LOAD_MAX_CLIENTS;
+    if ((epoll < 0) || (timer < 0) || (epoll_ctl(epoll, EPOLL_CTL_ADD, timer, &event) != 0))
+    {
+        perror("TelescopeSocket_load");
+        return 1;
+    }
+
+    /* each client has its share of the rate, the clients spread across one interval */
+    const uint32_t total = socketClients + stellariumClients;
+    const int64_t interval = (rate > 0.0) ? (int64_t)((1.0e6 * socketClients) / rate) : 0;
+    const int64_t gotoInterval = (gotoRate > 0.0) ? (int64_t)((1.0e6 * stellariumClients) / gotoRate) : 0;
+    const int64_t start = micros();
+    const int64_t end = start + (int64_t)(duration * 1.0e6);
+    for (uint32_t index = 0u; index < total; index++)
+    {
+        LOAD_CLIENT_T* client = &clients[index];
+        client->stellarium = (index >= socketClients);
+        client->fd = connectTo(client->stellarium ? stellariumPort : port);
+        if (client->fd < 0)
+        {
+            errors[client->stellarium ? 1 : 0].connect++;
+            continue;
+        }
+        if (client->stellarium)
+        {
+            client->due = (gotoInterval > 0) ? (start + ((gotoInterval * (index - socketClients)) / stellariumClients)) : end;
+        }
+        else
+        {
+            client->due = start + ((interval * index) / socketClients);
+        }
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.u32 = index;
+        (void)epoll_ctl(epoll, EPOLL_CTL_ADD, client->fd, &event);
+    }
+    if ((errors[0].connect == socketClients) && (errors[1].connect == stellariumClients))
+    {
+        fprintf(stderr, "nothing listening on ports %u and %u, is StarPi running?\n", port, stellariumPort);
+        return 1;
+    }
+
+    uint32_t sequence = 0u;
+    int64_t now = micros();
+    while (now < end)
+    {
+        struct epoll_event events[64];
+        int64_t next = end;
+        for (uint32_t index = 0u; index < total; index++)
+        {
+            LOAD_CLIENT_T* client = &clients[index];
+            if (client->fd < 0)
+            {
+                continue;
+            }
+            if (!client->stellarium && (client->started != 0) && ((now - client->started) > LOAD_TIMEOUT_US))
+            {
+                errors[0].timeout++;
+                closeClient(client);
+                continue;
+            }
+            if (client->due <= now)
+            {
+                if (client->stellarium)
+                {
+                    sendGoto(client);
+                    client->due += gotoInterval;
+                }
+                else if (client->started == 0)
+                {
+                    /* flat out a reply is timed from its request, otherwise from when it was due */
+                    sendRequest(client, sequence++, multPercent, (interval > 0) ? client->due : now);
+                    client->due = (interval > 0) ? (client->due + interval) : now;
+                }
+            }
+            if ((client->fd >= 0) && (client->stellarium || (client->started == 0)))
+            {
+                next = (client->due < next) ? client->due : next;
+            }
+            else if ((client->fd >= 0) && ((client->started + LOAD_TIMEOUT_US) < next))
+            {
+                next = client->started + LOAD_TIMEOUT_US;
+            }
+        }
+        /* wait for a reply or the next request to be due */
+        struct itimerspec wake;
+        memset(&wake, 0, sizeof(wake));
+        next = (next > now) ? next : (now + 1);
+        wake.it_value.tv_sec = next / 1000000;
+        wake.it_value.tv_nsec = (next % 1000000) * 1000;
+        (void)timerfd_settime(timer, TFD_TIMER_ABSTIME, &wake, NULL);
+        const int ready = epoll_wait(epoll, events, 64, -1);
+        for (int index = 0; index < ready; index++)
+        {
+            const uint32_t id = events[index].data.u32;
+            if (id == LOAD_MAX_CLIENTS)
+            {
+                uint64_t expirations = 0u;
+                (void)read(timer, &expirations, sizeof(expirations));
+            }
+            else if (clients[id].fd >= 0)
+            {
+                (void)receive(&clients[id]);
+            }
+        }
+        now = micros();
+    }
+    const double elapsed = (now - start) / 1.0e6;
+
+    printf("%u text clients on port %u, %.0f requests/s %s, %u%% MULT of %u commands, %.1f s\n",
+           socketClients, port, rate, (rate > 0.0) ? "target" : "(flat out)", multPercent, (unsigned)LOAD_COMMANDS, elapsed);
+    printf("sent %llu single, %llu MULT; %.0f replies/s, %.0f commands/s\n",
+           (unsigned long long)sent[LOAD_SINGLE], (unsigned long long)sent[LOAD_MULT],
+           (histograms[LOAD_SINGLE].total + histograms[LOAD_MULT].total) / elapsed,
+           (histograms[LOAD_SINGLE].total + (histograms[LOAD_MULT].total * LOAD_COMMANDS)) / elapsed);
+    printLatency("single", &histograms[LOAD_SINGLE], 1.0, "us");
+    printLatency("MULT", &histograms[LOAD_MULT], 1.0, "us");
+    printf("errors: connect %llu, disconnected %llu, timeout %llu, not supported %llu, send %llu, malformed %llu\n",
+           (unsigned long long)errors[0].connect, (unsigned long long)errors[0].disconnected,
+           (unsigned long long)errors[0].timeout, (unsigned long long)errors[0].notSupported,
+           (unsigned long long)errors[0].send, (unsigned long long)errors[0].malformed);
+    printf("%u Stellarium clients on port %u, %llu gotos, %.1f positions/s\n", stellariumClients, stellariumPort,
+           (unsigned long long)sent[LOAD_POSITION], positions / elapsed);
+    printLatency("gap", &histograms[LOAD_POSITION], 1000.0, "ms");
+    printf("errors: connect %llu, disconnected %llu, send %llu, malformed %llu\n",
+           (unsigned long long)errors[1].connect, (unsigned long long)errors[1].disconnected,
+           (unsigned long long)errors[1].send, (unsigned long long)errors[1].malformed);
+
+    const uint64_t failures = errors[0].connect + errors[0].disconnected + errors[0].timeout + errors[0].notSupported
+                            + errors[0].send + errors[0].malformed + errors[1].connect + errors[1].disconnected
+                            + errors[1].send + errors[1].malformed;
+    return (failures == 0u) ? 0 : 1;
+}
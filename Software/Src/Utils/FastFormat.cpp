@@ -0,0 +1,526 @@
+/*
+FastFormat writes numbers as text straight into a caller's buffer.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include <math.h>
+#include "FastFormat.h"
+
+/* "00" to "99", so two digits are written per division */
+static const char DigitPairs[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const uint32_t PowersOfTen[] =
+{
+    1u, 10u, 100u, 1000u, 10000u, 100000u, 1000000u, 10000000u, 100000000u, 1000000000u
+};
+
+/* Grisu2, see Florian Loitsch "Printing Floating-Point Numbers Quickly and
+   Accurately with Integers". A DIY_FP_T is F * 2^E with a 64 bit F. */
+typedef struct
+{
+    uint64_t F;
+    int      E;
+} DIY_FP_T;
+
+/* the normalised powers of ten 10^-348, 10^-340 ... 10^340 */
+static const uint64_t CachedPowersF[] =
+{
+    0xFA8FD5A0081C0288ULL, 0xBAAEE17FA23EBF76ULL, 0x8B16FB203055AC76ULL, 0xCF42894A5DCE35EAULL,
+    0x9A6BB0AA55653B2DULL, 0xE61ACF033D1A45DFULL, 0xAB70FE17C79AC6CAULL, 0xFF77B1FCBEBCDC4FULL,
+    0xBE5691EF416BD60CULL, 0x8DD01FAD907FFC3CULL, 0xD3515C2831559A83ULL, 0x9D71AC8FADA6C9B5ULL,
+    0xEA9C227723EE8BCBULL, 0xAECC49914078536DULL, 0x823C12795DB6CE57ULL, 0xC21094364DFB5637ULL,
+    0x9096EA6F3848984FULL, 0xD77485CB25823AC7ULL, 0xA086CFCD97BF97F4ULL, 0xEF340A98172AACE5ULL,
+    0xB23867FB2A35B28EULL, 0x84C8D4DFD2C63F3BULL, 0xC5DD44271AD3CDBAULL, 0x936B9FCEBB25C996ULL,
+    0xDBAC6C247D62A584ULL, 0xA3AB66580D5FDAF6ULL, 0xF3E2F893DEC3F126ULL, 0xB5B5ADA8AAFF80B8ULL,
+    0x87625F056C7C4A8BULL, 0xC9BCFF6034C13053ULL, 0x964E858C91BA2655ULL, 0xDFF9772470297EBDULL,
+    0xA6DFBD9FB8E5B88FULL, 0xF8A95FCF88747D94ULL, 0xB94470938FA89BCFULL, 0x8A08F0F8BF0F156BULL,
+    0xCDB02555653131B6ULL, 0x993FE2C6D07B7FACULL, 0xE45C10C42A2B3B06ULL, 0xAA242499697392D3ULL,
+    0xFD87B5F28300CA0EULL, 0xBCE5086492111AEBULL, 0x8CBCCC096F5088CCULL, 0xD1B71758E219652CULL,
+    0x9C40000000000000ULL, 0xE8D4A51000000000ULL, 0xAD78EBC5AC620000ULL, 0x813F3978F8940984ULL,
+    0xC097CE7BC90715B3ULL, 0x8F7E32CE7BEA5C70ULL, 0xD5D238A4ABE98068ULL, 0x9F4F2726179A2245ULL,
+    0xED63A231D4C4FB27ULL, 0xB0DE65388CC8ADA8ULL, 0x83C7088E1AAB65DBULL, 0xC45D1DF942711D9AULL,
+    0x924D692CA61BE758ULL, 0xDA01EE641A708DEAULL, 0xA26DA3999AEF774AULL, 0xF209787BB47D6B85ULL,
+    0xB454E4A179DD1877ULL, 0x865B86925B9BC5C2ULL, 0xC83553C5C8965D3DULL, 0x952AB45CFA97A0B3ULL,
+    0xDE469FBD99A05FE3ULL, 0xA59BC234DB398C25ULL, 0xF6C69A72A3989F5CULL, 0xB7DCBF5354E9BECEULL,
+    0x88FCF317F22241E2ULL, 0xCC20CE9BD35C78A5ULL, 0x98165AF37B2153DFULL, 0xE2A0B5DC971F303AULL,
+    0xA8D9D1535CE3B396ULL, 0xFB9B7CD9A4A7443CULL, 0xBB764C4CA7A44410ULL, 0x8BAB8EEFB6409C1AULL,
+    0xD01FEF10A657842CULL, 0x9B10A4E5E9913129ULL, 0xE7109BFBA19C0C9DULL, 0xAC2820D9623BF429ULL,
+    0x80444B5E7AA7CF85ULL, 0xBF21E44003ACDD2DULL, 0x8E679C2F5E44FF8FULL, 0xD433179D9C8CB841ULL,
+    0x9E19DB92B4E31BA9ULL, 0xEB96BF6EBADF77D9ULL, 0xAF87023B9BF0EE6BULL
+};
+static const int16_t CachedPowersE[] =
+{
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+    -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+    -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+    -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+    56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+    694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+    1013, 1039, 1066
+};
+
+#define DP_SIGNIFICAND_MASK  0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT        0x0010000000000000ULL
+#define DP_EXPONENT_BIAS     1075
+
+/* Split a double into F * 2^E */
+static DIY_FP_T DiyFpFromDouble( double Value )
+{
+    DIY_FP_T Result;
+    uint64_t Bits;
+    memcpy( &Bits, &Value, sizeof( Bits ) );
+    const int BiasedExponent = (int)( ( Bits >> 52 ) & 0x7FFu );
+    Result.F = Bits & DP_SIGNIFICAND_MASK;
+    if ( BiasedExponent != 0 )
+    {
+        Result.F += DP_HIDDEN_BIT;
+        Result.E = BiasedExponent - DP_EXPONENT_BIAS;
+    }
+    else
+    {
+        Result.E = 1 - DP_EXPONENT_BIAS;
+    }
+    return Result;
+}
+
+/* The top 64 bits of the product, rounded */
+static DIY_FP_T DiyFpMultiply( DIY_FP_T Left, DIY_FP_T Right )
+{
+    const uint64_t M32 = 0xFFFFFFFFu;
+    const uint64_t A = Left.F >> 32;
+    const uint64_t B = Left.F & M32;
+    const uint64_t C = Right.F >> 32;
+    const uint64_t D = Right.F & M32;
+    const uint64_t AC = A * C;
+    const uint64_t BC = B * C;
+    const uint64_t AD = A * D;
+    const uint64_t BD = B * D;
+    uint64_t Middle = ( BD >> 32 ) + ( AD & M32 ) + ( BC & M32 );
+    Middle += ( 1u << 31 );
+    DIY_FP_T Result;
+    Result.F = AC + ( AD >> 32 ) + ( BC >> 32 ) + ( Middle >> 32 );
+    Result.E = Left.E + Right.E + 64;
+    return Result;
+}
+
+/* Shift until the top bit is set */
+static DIY_FP_T DiyFpNormalize( DIY_FP_T Value )
+{
+    while ( ( Value.F & ( 1ULL << 63 ) ) == 0u )
+    {
+        Value.F <<= 1;
+        Value.E--;
+    }
+    return Value;
+}
+
+/* Round the last digit towards the value while it stays inside the bounds */
+static void GrisuRound( char* Digits, uint8_t Length, uint64_t Delta, uint64_t Rest, uint64_t TenKappa, uint64_t Distance )
+{
+    while ( ( Rest < Distance ) && ( ( Delta - Rest ) >= TenKappa )
+         && ( ( ( Rest + TenKappa ) < Distance ) || ( ( Distance - Rest ) > ( ( Rest + TenKappa ) - Distance ) ) ) )
+    {
+        Digits[Length - 1u]--;
+        Rest += TenKappa;
+    }
+}
+
+/* Grisu2, the shortest digits of a positive finite Value
+ */
+uint8_t FastFormat::Grisu( double Value, char* Digits, int* Exponent )
+{
+    static const uint64_t Pow10[] =
+    {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+        1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+        100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+        1000000000000000000ULL, 10000000000000000000ULL
+    };
+    const DIY_FP_T V = DiyFpFromDouble( Value );
+    DIY_FP_T Plus;
+    DIY_FP_T Minus;
+    DIY_FP_T Power;
+    uint8_t Length = 0u;
+
+    /* the boundaries halfway to the neighbouring doubles */
+    Plus.F = ( V.F << 1 ) + 1u;
+    Plus.E = V.E - 1;
+    while ( ( Plus.F & ( DP_HIDDEN_BIT << 1 ) ) == 0u )
+    {
+        Plus.F <<= 1;
+        Plus.E--;
+    }
+    Plus.F <<= 10;
+    Plus.E -= 10;
+    if ( V.F == DP_HIDDEN_BIT )
+    {
+        Minus.F = ( V.F << 2 ) - 1u;
+        Minus.E = V.E - 2;
+    }
+    else
+    {
+        Minus.F = ( V.F << 1 ) - 1u;
+        Minus.E = V.E - 1;
+    }
+    Minus.F <<= ( Minus.E - Plus.E );
+    Minus.E = Plus.E;
+
+    /* a power of ten that brings the exponent into -60 to -32 */
+    const double Dk = ( ( -61 - Plus.E ) * 0.30102999566398114 ) + 347;
+    int K = (int)Dk;
+    if ( K != Dk )
+    {
+        K++;
+    }
+    const unsigned Index = (unsigned)( ( K >> 3 ) + 1 );
+    *Exponent = -( -348 + (int)( Index << 3 ) );
+    Power.F = CachedPowersF[Index];
+    Power.E = CachedPowersE[Index];
+
+    const DIY_FP_T W = DiyFpMultiply( DiyFpNormalize( V ), Power );
+    DIY_FP_T Upper = DiyFpMultiply( Plus, Power );
+    DIY_FP_T Lower = DiyFpMultiply( Minus, Power );
+    Lower.F++;
+    Upper.F--;
+
+    /* generate the digits of Upper until they are inside the bounds */
+    const int Shift = -Upper.E;
+    const uint64_t One = 1ULL << Shift;
+    const uint64_t Distance = Upper.F - W.F;
+    uint64_t Delta = Upper.F - Lower.F;
+    uint32_t P1 = (uint32_t)( Upper.F >> Shift );
+    uint64_t P2 = Upper.F & ( One - 1u );
+    int Kappa = 10;
+    while ( ( Kappa > 1 ) && ( P1 < PowersOfTen[Kappa - 1] ) )
+    {
+        Kappa--;
+    }
+    while ( Kappa > 0 )
+    {
+        const uint32_t Digit = P1 / PowersOfTen[Kappa - 1];
+        P1 %= PowersOfTen[Kappa - 1];
+        if ( ( Digit != 0u ) || ( Length != 0u ) )
+        {
+            Digits[Length++] = (char)( '0' + Digit );
+        }
+        Kappa--;
+        const uint64_t Rest = ( (uint64_t)P1 << Shift ) + P2;
+        if ( Rest <= Delta )
+        {
+            *Exponent += Kappa;
+            GrisuRound( Digits, Length, Delta, Rest, (uint64_t)PowersOfTen[Kappa] << Shift, Distance );
+            return Length;
+        }
+    }
+    for ( ;; )
+    {
+        P2 *= 10u;
+        Delta *= 10u;
+        const char Digit = (char)( P2 >> Shift );
+        if ( ( Digit != 0 ) || ( Length != 0u ) )
+        {
+            Digits[Length++] = (char)( '0' + Digit );
+        }
+        P2 &= One - 1u;
+        Kappa--;
+        if ( P2 < Delta )
+        {
+            *Exponent += Kappa;
+            GrisuRound( Digits, Length, Delta, P2, One, ( -Kappa < 20 ) ? Distance * Pow10[-Kappa] : 0u );
+            return Length;
+        }
+    }
+}
+
+/* Write the digits of Value with no padding
+ */
+uint8_t FastFormat::Digits( char* Buffer, uint64_t Value )
+{
+    char Reversed[20];
+    uint8_t Position = sizeof( Reversed );
+    /* 64 bit division is a library call on the Pi, so only use it for the top digits */
+    while ( Value > 0xFFFFFFFFu )
+    {
+        const uint32_t Pair = (uint32_t)( Value % 100u );
+        Value /= 100u;
+        Position -= 2u;
+        memcpy( &Reversed[Position], &DigitPairs[Pair * 2u], 2u );
+    }
+    uint32_t Small = (uint32_t)Value;
+    while ( Small >= 100u )
+    {
+        const uint32_t Pair = Small % 100u;
+        Small /= 100u;
+        Position -= 2u;
+        memcpy( &Reversed[Position], &DigitPairs[Pair * 2u], 2u );
+    }
+    if ( Small >= 10u )
+    {
+        Position -= 2u;
+        memcpy( &Reversed[Position], &DigitPairs[Small * 2u], 2u );
+    }
+    else
+    {
+        Reversed[--Position] = (char)( '0' + Small );
+    }
+    const uint8_t Length = sizeof( Reversed ) - Position;
+    memcpy( Buffer, &Reversed[Position], Length );
+    Buffer[Length] = '\0';
+    return Length;
+}
+
+/* Write two digits
+ */
+void FastFormat::TwoDigits( char* Buffer, uint32_t Value )
+{
+    memcpy( Buffer, &DigitPairs[( Value % 100u ) * 2u], 2u );
+}
+
+/* Move the text right to pad it to Width with spaces
+ */
+uint8_t FastFormat::Pad( char* Buffer, uint8_t Length, uint8_t Width )
+{
+    if ( Width >= FAST_FORMAT_SIZE )
+    {
+        Width = FAST_FORMAT_SIZE - 1u;
+    }
+    if ( Length < Width )
+    {
+        memmove( &Buffer[Width - Length], Buffer, Length + 1u );
+        memset( Buffer, ' ', Width - Length );
+        Length = Width;
+    }
+    return Length;
+}
+
+/* Write a signed integer
+ */
+uint8_t FastFormat::Integer( char* Buffer, int32_t Value, uint8_t Width )
+{
+    uint8_t Length = 0u;
+    if ( Value < 0 )
+    {
+        Buffer[Length++] = '-';
+    }
+    Length += Digits( &Buffer[Length], ( Value < 0 ) ? ( 0u - (uint32_t)Value ) : (uint32_t)Value );
+    return Pad( Buffer, Length, Width );
+}
+
+/* Write an unsigned integer
+ */
+uint8_t FastFormat::Unsigned( char* Buffer, uint32_t Value, uint8_t Width )
+{
+    return Pad( Buffer, Digits( Buffer, Value ), Width );
+}
+
+/* Write a value with a fixed number of decimals
+ */
+uint8_t FastFormat::Fixed( char* Buffer, double Value, uint8_t Decimals, uint8_t Width )
+{
+    uint8_t Length = 0u;
+    if ( signbit( Value ) )
+    {
+        Buffer[Length++] = '-';
+        Value = -Value;
+    }
+    const double Whole = floor( Value );
+    if ( !( Whole < 18446744073709551616.0 ) )
+    {
+        /* too large for a uint64_t, or not a number */
+        Length = Shortest( Buffer, ( Length > 0u ) ? -Value : Value );
+    }
+    else
+    {
+        if ( Decimals > FAST_FORMAT_MAX_DECIMALS )
+        {
+            Decimals = FAST_FORMAT_MAX_DECIMALS;
+        }
+        uint64_t Integral = (uint64_t)Whole;
+        /* both subtractions are exact, and for a float so is the multiply */
+        const double Scaled = ( Value - Whole ) * PowersOfTen[Decimals];
+        uint32_t Fraction = (uint32_t)Scaled;
+        const double Rest = Scaled - Fraction;
+        /* round half to even, as printf does */
+        const bool Odd = ( Decimals > 0u ) ? ( ( Fraction & 1u ) != 0u ) : ( ( Integral & 1u ) != 0u );
+        if ( ( Rest > 0.5 ) || ( ( Rest == 0.5 ) && Odd ) )
+        {
+            Fraction++;
+            if ( Fraction >= PowersOfTen[Decimals] )
+            {
+                Fraction = 0u;
+                Integral++;
+            }
+        }
+        Length += Digits( &Buffer[Length], Integral );
+        if ( Decimals > 0u )
+        {
+            uint8_t Index = Decimals;
+            Buffer[Length] = '.';
+            while ( Index > 0u )
+            {
+                Buffer[Length + Index] = (char)( '0' + ( Fraction % 10u ) );
+                Fraction /= 10u;
+                Index--;
+            }
+            Length += Decimals + 1u;
+            Buffer[Length] = '\0';
+        }
+    }
+    return Pad( Buffer, Length, Width );
+}
+
+/* Write the shortest text that reads back as the same double
+ */
+uint8_t FastFormat::Shortest( char* Buffer, double Value )
+{
+    char Digits[20];
+    uint8_t Length = 0u;
+    if ( signbit( Value ) && !isnan( Value ) )
+    {
+        Buffer[Length++] = '-';
+        Value = -Value;
+    }
+    if ( isnan( Value ) )
+    {
+        memcpy( &Buffer[Length], "nan", 4u );
+        Length += 3u;
+    }
+    else if ( isinf( Value ) )
+    {
+        memcpy( &Buffer[Length], "inf", 4u );
+        Length += 3u;
+    }
+    else if ( Value == 0.0 )
+    {
+        memcpy( &Buffer[Length], "0", 2u );
+        Length += 1u;
+    }
+    else
+    {
+        int Exponent = 0;
+        const int Count = Grisu( Value, Digits, &Exponent );
+        /* the value is 0.Digits times 10^Point */
+        const int Point = Count + Exponent;
+        if ( ( Exponent >= 0 ) && ( Point <= 21 ) )
+        {
+            /* an integer, 1e21 and above have too many zeros */
+            memcpy( &Buffer[Length], Digits, Count );
+            memset( &Buffer[Length + Count], '0', Exponent );
+            Length += Point;
+        }
+        else if ( ( Point > 0 ) && ( Point <= 21 ) )
+        {
+            memcpy( &Buffer[Length], Digits, Point );
+            Buffer[Length + Point] = '.';
+            memcpy( &Buffer[Length + Point + 1], &Digits[Point], Count - Point );
+            Length += Count + 1;
+        }
+        else if ( ( Point > -6 ) && ( Point <= 0 ) )
+        {
+            Buffer[Length] = '0';
+            Buffer[Length + 1u] = '.';
+            memset( &Buffer[Length + 2u], '0', -Point );
+            memcpy( &Buffer[Length + 2 - Point], Digits, Count );
+            Length += 2 - Point + Count;
+        }
+        else
+        {
+            int Power = Point - 1;
+            Buffer[Length++] = Digits[0];
+            if ( Count > 1 )
+            {
+                Buffer[Length++] = '.';
+                memcpy( &Buffer[Length], &Digits[1], Count - 1 );
+                Length += Count - 1;
+            }
+            Buffer[Length++] = 'e';
+            Buffer[Length++] = ( Power < 0 ) ? '-' : '+';
+            Power = ( Power < 0 ) ? -Power : Power;
+            if ( Power >= 100 )
+            {
+                Buffer[Length++] = (char)( '0' + ( Power / 100 ) );
+            }
+            TwoDigits( &Buffer[Length], Power );
+            Length += 2u;
+        }
+        Buffer[Length] = '\0';
+    }
+    return Length;
+}
+
+/* Write hours as "HH:MM:SS"
+ */
+uint8_t FastFormat::Hours( char* Buffer, double Hours )
+{
+    double Seconds = fmod( Hours * 3600.0, 86400.0 );
+    uint32_t Total = 0u;
+    if ( Seconds < 0.0 )
+    {
+        Seconds += 86400.0;
+    }
+    if ( Seconds >= 0.0 )
+    {
+        Total = (uint32_t)( Seconds + 0.5 ) % 86400u;
+    }
+    TwoDigits( &Buffer[0], Total / 3600u );
+    Buffer[2] = ':';
+    TwoDigits( &Buffer[3], ( Total / 60u ) % 60u );
+    Buffer[5] = ':';
+    TwoDigits( &Buffer[6], Total % 60u );
+    Buffer[8] = '\0';
+    return 8u;
+}
+
+/* Write signed degrees as "+DD:MM:SS"
+ */
+uint8_t FastFormat::Degrees( char* Buffer, double Degrees, char DegreeMark, char MinuteMark )
+{
+    const double Seconds = fabs( Degrees ) * 3600.0;
+    uint32_t Total = 0u;
+    uint8_t Length = 1u;
+    if ( Seconds < 3600000.0 )
+    {
+        Total = (uint32_t)( Seconds + 0.5 );
+    }
+    Buffer[0] = ( ( Degrees < 0.0 ) && ( Total > 0u ) ) ? '-' : '+';
+    const uint32_t Whole = Total / 3600u;
+    if ( Whole >= 100u )
+    {
+        Buffer[Length++] = (char)( '0' + ( Whole / 100u ) );
+    }
+    TwoDigits( &Buffer[Length], Whole );
+    Buffer[Length + 2u] = DegreeMark;
+    TwoDigits( &Buffer[Length + 3u], ( Total / 60u ) % 60u );
+    Buffer[Length + 5u] = MinuteMark;
+    TwoDigits( &Buffer[Length + 6u], Total % 60u );
+    Length += 8u;
+    Buffer[Length] = '\0';
+    return Length;
+}
@@ -0,0 +1,98 @@
+/**
+FastFormat writes numbers as text straight into a caller's buffer, for
+the replies that are sent many times a second. Nothing is allocated, the
+locale is not looked at and every function returns the number of
+characters written, the text is also '\0' terminated.
+
+Fixed gives the same text as printf's "%.*f" for any float value, and
+for a double unless it is within a rounding error of halfway between
+two outputs. Shortest gives the fewest digits that read back to the same
+double (Grisu2, occasionally a digit more than the minimum).
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef FASTFORMAT_H
+#define FASTFORMAT_H
+
+#include <stdint.h>
+
+/* Configuration */
+
+#define FAST_FORMAT_SIZE          32u   /**< a buffer this size holds the output of any function */
+#define FAST_FORMAT_MAX_DECIMALS  9u    /**< most decimals Fixed will write */
+
+/** FastFormat
+ * - Number to text conversion for the socket and websocket replies
+ */
+class FastFormat
+{
+    public:
+    /** Write a signed integer, as "%*d"
+     * @param Buffer at least FAST_FORMAT_SIZE bytes
+     * @param Width the text is padded on the left with spaces to this width
+     * @return uint8_t characters written
+     */
+        static uint8_t Integer( char* Buffer, int32_t Value, uint8_t Width = 0u );
+    /** Write an unsigned integer, as "%*u"
+     * @return uint8_t characters written
+     */
+        static uint8_t Unsigned( char* Buffer, uint32_t Value, uint8_t Width = 0u );
+    /** Write a value with a fixed number of decimals, as "%*.*f". A value
+     *  too large for the fixed form is written as Shortest
+     * @param Decimals 0 to FAST_FORMAT_MAX_DECIMALS
+     * @return uint8_t characters written
+     */
+        static uint8_t Fixed( char* Buffer, double Value, uint8_t Decimals, uint8_t Width = 0u );
+    /** Write the shortest text that reads back as the same double, in the
+     *  fixed form for moderate values and as "1.5e-07" otherwise
+     * @return uint8_t characters written
+     */
+        static uint8_t Shortest( char* Buffer, double Value );
+    /** Write hours as "HH:MM:SS", rounded to the second and wrapped to 0-24
+     * @return uint8_t characters written
+     */
+        static uint8_t Hours( char* Buffer, double Hours );
+    /** Write signed degrees as "+DD:MM:SS", rounded to the second, with a
+     *  third digit of degrees when needed
+     * @param DegreeMark character after the degrees
+     * @param MinuteMark character after the minutes
+     * @return uint8_t characters written
+     */
+        static uint8_t Degrees( char* Buffer, double Degrees, char DegreeMark = ':', char MinuteMark = ':' );
+
+    private:
+    /** Write the digits of Value with no padding
+     * @return uint8_t characters written
+     */
+        static uint8_t Digits( char* Buffer, uint64_t Value );
+    /** Write two digits
+     */
+        static void TwoDigits( char* Buffer, uint32_t Value );
+    /** Move the text right to pad it to Width with spaces
+     * @return uint8_t the new length
+     */
+        static uint8_t Pad( char* Buffer, uint8_t Length, uint8_t Width );
+    /** Grisu2, the shortest digits of a positive finite Value
+     * @param Digits receives up to 17 digits
+     * @param Exponent receives the power of ten of the last digit
+     * @return uint8_t number of digits
+     */
+        static uint8_t Grisu( double Value, char* Digits, int* Exponent );
+};
+
+#endif /* FASTFORMAT_H */
@@ -0,0 +1,171 @@
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "FastFormat.h"
+/*
+ FastFormat benchmark
+ Checks each function against snprintf on random values of the kinds the
+ replies hold, then times both. Run it on the Pi, the difference there is
+ larger than on a PC. Build from Software/:
+
+ g++ -O2 -I./Src/Utils Src/Utils/FastFormat_bench.cpp Src/Utils/FastFormat.cpp -o FastFormat_bench
+ */
+
+#define BENCH_VALUES    4096u
+#define BENCH_LOOPS     200u
+#define BENCH_CHECKS    500000u
+
+static float floats[BENCH_VALUES];
+static double doubles[BENCH_VALUES];
+static int32_t integers[BENCH_VALUES];
+static int failures = 0;
+static volatile uint32_t sink = 0u;   /**< keeps the calls from being optimised away */
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* a random double from its bits, so every exponent is covered */
+static double randomBits(void)
+{
+    uint64_t bits = 0u;
+    double value = NAN;
+    while (!isfinite(value))
+    {
+        bits = ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+        memcpy(&value, &bits, sizeof(value));
+    }
+    return value;
+}
+
+/* a random angle in degrees */
+static double randomAngle(void)
+{
+    return ((rand() / (double)RAND_MAX) * 720.0) - 360.0;
+}
+
+static void check(bool ok, const char* what, const char* expected, const char* got)
+{
+    if (!ok && (failures++ < 10))
+    {
+        fprintf(stderr, "FAIL: %s expected \"%s\" got \"%s\"\n", what, expected, got);
+    }
+}
+
+static void checkAll(void)
+{
+    char expected[512];
+    char got[FAST_FORMAT_SIZE];
+    uint32_t longer = 0u;
+
+    for (uint32_t index = 0u; index < BENCH_CHECKS; index++)
+    {
+        /* floats of every size are exact */
+        const float single = (index & 1u) ? (float)randomAngle() : (float)randomBits();
+        if (fabsf(single) < 1.0e15f)
+        {
+            snprintf(expected, sizeof(expected), "%f", single);
+            const uint8_t length = FastFormat::Fixed(got, single, 6u);
+            check((strcmp(expected, got) == 0) && (length == strlen(got)), "Fixed float", expected, got);
+        }
+
+        /* and the padded forms TelescopeIO uses */
+        const int32_t integer = (int32_t)(rand() - (RAND_MAX / 2)) >> (index % 31u);
+        snprintf(expected, sizeof(expected), "%4d", integer);
+        FastFormat::Integer(got, integer, 4u);
+        check(strcmp(expected, got) == 0, "Integer", expected, got);
+        snprintf(expected, sizeof(expected), "%4f", (float)(integer % 1000) / 8.0f);
+        FastFormat::Fixed(got, (float)(integer % 1000) / 8.0f, 6u, 4u);
+        check(strcmp(expected, got) == 0, "Fixed ties", expected, got);
+
+        /* every double reads back the same, and is rarely longer than needed */
+        const double value = (index & 1u) ? randomAngle() / 57.29577951308232 : randomBits();
+        const uint8_t length = FastFormat::Shortest(got, value);
+        check((strtod(got, NULL) == value) && (length == strlen(got)), "Shortest round trip", "", got);
+        for (int precision = 1; precision <= 17; precision++)
+        {
+            snprintf(expected, sizeof(expected), "%.*g", precision, value);
+            if (strtod(expected, NULL) == value)
+            {
+                longer += (precision < (int)strcspn(got, "e") - (int)strspn(got, "-0.") - ((strchr(got, '.') != NULL) ? 1 : 0)) ? 1u : 0u;
+                break;
+            }
+        }
+
+        /* sexagesimal, from the same whole seconds as snprintf is given */
+        const double angle = randomAngle();
+        const uint32_t total = (uint32_t)((fabs(angle) * 3600.0) + 0.5);
+        snprintf(expected, sizeof(expected), "%c%02u:%02u:%02u", ((angle < 0.0) && (total > 0u)) ? '-' : '+',
+                 total / 3600u, (total / 60u) % 60u, total % 60u);
+        FastFormat::Degrees(got, angle);
+        check(strcmp(expected, got) == 0, "Degrees", expected, got);
+    }
+    FastFormat::Hours(got, 23.9999);
+    check(strcmp(got, "00:00:00") == 0, "Hours wrap", "00:00:00", got);
+    FastFormat::Hours(got, -1.5);
+    check(strcmp(got, "22:30:00") == 0, "Hours negative", "22:30:00", got);
+    FastFormat::Shortest(got, 0.1);
+    check(strcmp(got, "0.1") == 0, "Shortest 0.1", "0.1", got);
+    FastFormat::Shortest(got, 1.5e-7);
+    check(strcmp(got, "1.5e-07") == 0, "Shortest exponent", "1.5e-07", got);
+    FastFormat::Fixed(got, 0.125, 2u);
+    check(strcmp(got, "0.12") == 0, "Fixed half even", "0.12", got);
+    fprintf(stderr, "Shortest was longer than needed for %u of %u doubles\n", longer, BENCH_CHECKS);
+}
+
+/* time Count calls of each formatter over the values */
+static void benchmark(const char* name, double snprintfTime, double fastTime)
+{
+    const double calls = (double)BENCH_VALUES * BENCH_LOOPS;
+    fprintf(stderr, "%-10s snprintf %6.1f ns  FastFormat %6.1f ns  %.1fx faster\n",
+            name, (snprintfTime * 1.0e9) / calls, (fastTime * 1.0e9) / calls, snprintfTime / fastTime);
+}
+
+int main()
+{
+    static char text[BENCH_VALUES][FAST_FORMAT_SIZE];
+    uint32_t sum = 0u;
+    double start = 0.0;
+    double slow = 0.0;
+
+    srand(1);
+    checkAll();
+    for (uint32_t index = 0u; index < BENCH_VALUES; index++)
+    {
+        floats[index] = (float)randomAngle();
+        doubles[index] = randomAngle() / 57.29577951308232;
+        integers[index] = rand() % 100000;
+    }
+
+#define TIME_BOTH(name, slowCall, fastCall) \
+    start = seconds(); \
+    for (uint32_t loop = 0u; loop < BENCH_LOOPS; loop++) \
+        for (uint32_t index = 0u; index < BENCH_VALUES; index++) \
+            sum += slowCall; \
+    slow = seconds() - start; \
+    start = seconds(); \
+    for (uint32_t loop = 0u; loop < BENCH_LOOPS; loop++) \
+        for (uint32_t index = 0u; index < BENCH_VALUES; index++) \
+            sum += fastCall; \
+    benchmark(name, slow, seconds() - start);
+
+    TIME_BOTH("%f", snprintf(text[index], FAST_FORMAT_SIZE, "%f", floats[index]),
+              FastFormat::Fixed(text[index], floats[index], 6u))
+    TIME_BOTH("%d", snprintf(text[index], FAST_FORMAT_SIZE, "%d", integers[index]),
+              FastFormat::Integer(text[index], integers[index]))
+    TIME_BOTH("%.17g", snprintf(text[index], FAST_FORMAT_SIZE, "%.17g", doubles[index]),
+              FastFormat::Shortest(text[index], doubles[index]))
+    TIME_BOTH("DMS", snprintf(text[index], FAST_FORMAT_SIZE, "%+03d:%02d:%02d", (int)floats[index],
+                              abs((int)(floats[index] * 60.0f)) % 60, abs((int)(floats[index] * 3600.0f)) % 60),
+              FastFormat::Degrees(text[index], floats[index]))
+
+    sink = sum;
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
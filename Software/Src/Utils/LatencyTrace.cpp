@@ -0,0 +1,216 @@
+/*
+LatencyTrace follows each sensor sample to the clients. The orientation
+task gives every sample an Id when it reads the sensors, the Id goes
+along with the values through the fusion in TelescopeManager::Run, the
+publish hooks and the servers, and each marks the time it got there.
+The time from the stage before and from the sample are kept in Metrics
+histograms, and the last LATENCY_TRACE_SAMPLES samples can be written as
+Chrome trace JSON, which HalMetrics serves at /trace.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include "LatencyTrace.h"
+
+static_assert( ( LATENCY_TRACE_SAMPLES & ( LATENCY_TRACE_SAMPLES - 1u ) ) == 0u, "the samples are indexed by the low bits of the Id" );
+
+#define LATENCY_TRACE_MASK ( LATENCY_TRACE_SAMPLES - 1u )
+
+LATENCY_SAMPLE_T LatencyTrace::Samples[LATENCY_TRACE_SAMPLES];
+uint32_t         LatencyTrace::LastId = 0u;
+MetricHistogram  LatencyTrace::StageLatency[LATENCY_STAGES];
+MetricHistogram  LatencyTrace::TotalLatency[LATENCY_STAGES];
+
+/* the servers all send what was published */
+const uint8_t LatencyTrace::Previous[LATENCY_STAGES] =
+{
+    LATENCY_SAMPLED,
+    LATENCY_SAMPLED,
+    LATENCY_FUSED,
+    LATENCY_PUBLISHED,
+    LATENCY_PUBLISHED,
+    LATENCY_PUBLISHED
+};
+const char* const LatencyTrace::Names[LATENCY_STAGES] =
+{
+    "sampled", "fused", "published", "sent_socket", "sent_stellarium", "sent_lx200"
+};
+const char* const LatencyTrace::Labels[LATENCY_STAGES] =
+{
+    "stage=\"sampled\"", "stage=\"fused\"", "stage=\"published\"",
+    "stage=\"sent_socket\"", "stage=\"sent_stellarium\"", "stage=\"sent_lx200\""
+};
+
+/* Begin
+ * Start a new sample, its slot is cleared with the Id at 0 so a late
+ * Mark for the sample that was there does not land in this one
+ */
+uint32_t LatencyTrace::Begin( void )
+{
+    uint32_t Id = LastId + 1u;
+    if ( Id == 0u )
+    {
+        Id = 1u;
+    }
+    LATENCY_SAMPLE_T* Sample = &Samples[Id & LATENCY_TRACE_MASK];
+    __atomic_store_n( &Sample->Id, 0u, __ATOMIC_RELEASE );
+    for ( uint8_t Stage = 1u; Stage < LATENCY_STAGES; Stage++ )
+    {
+        __atomic_store_n( &Sample->Time[Stage], 0, __ATOMIC_RELAXED );
+    }
+    __atomic_store_n( &Sample->Time[LATENCY_SAMPLED], Metrics::NowMicros(), __ATOMIC_RELAXED );
+    __atomic_store_n( &Sample->Id, Id, __ATOMIC_RELEASE );
+    __atomic_store_n( &LastId, Id, __ATOMIC_RELEASE );
+    return Id;
+}
+
+/* Mark
+ * Mark a sample reaching a stage, the first time only
+ */
+void LatencyTrace::Mark( uint32_t Id, uint8_t Stage )
+{
+    LATENCY_SAMPLE_T* Sample = &Samples[Id & LATENCY_TRACE_MASK];
+    int64_t Unset = 0;
+    if ( ( Id == 0u ) || ( Stage == LATENCY_SAMPLED ) || ( Stage >= LATENCY_STAGES )
+      || ( __atomic_load_n( &Sample->Id, __ATOMIC_ACQUIRE ) != Id )
+      || ( __atomic_load_n( &Sample->Time[Stage], __ATOMIC_RELAXED ) != 0 ) )
+    {
+        return;
+    }
+    const int64_t Now = Metrics::NowMicros();
+    if ( __atomic_compare_exchange_n( &Sample->Time[Stage], &Unset, Now, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED ) )
+    {
+        const int64_t Sampled = __atomic_load_n( &Sample->Time[LATENCY_SAMPLED], __ATOMIC_RELAXED );
+        const int64_t Before = __atomic_load_n( &Sample->Time[Previous[Stage]], __ATOMIC_RELAXED );
+        /* the slot may have been reused since the Id was checked */
+        if ( __atomic_load_n( &Sample->Id, __ATOMIC_ACQUIRE ) == Id )
+        {
+            TotalLatency[Stage].Observe( Now - Sampled );
+            if ( Before != 0 )
+            {
+                StageLatency[Stage].Observe( Now - Before );
+            }
+        }
+    }
+}
+
+/* RegisterMetrics
+ * Register the latency histograms with Metrics
+ */
+void LatencyTrace::RegisterMetrics( void )
+{
+    for ( uint8_t Stage = LATENCY_FUSED; Stage < LATENCY_STAGES; Stage++ )
+    {
+        (void)Metrics::Register( "starpi_latency_stage_seconds", Labels[Stage],
+                                 "Time for a sample to get from the stage before to each stage", &StageLatency[Stage] );
+    }
+    for ( uint8_t Stage = LATENCY_FUSED; Stage < LATENCY_STAGES; Stage++ )
+    {
+        (void)Metrics::Register( "starpi_latency_total_seconds", Labels[Stage],
+                                 "Time for a sample to get from the sensors to each stage", &TotalLatency[Stage] );
+    }
+}
+
+/* WriteChromeTrace
+ * Write the kept samples as Chrome trace JSON, each stage is a thread so
+ * the samples line up, and each step of a sample is a complete event
+ * from the stage before
+ */
+uint32_t LatencyTrace::WriteChromeTrace( char* Buffer, uint32_t Size )
+{
+    static const char Closing[] = "\n]}\n";
+    char Event[192];
+    uint32_t Length = 0u;
+    int Rc = 0;
+    const uint32_t Newest = __atomic_load_n( &LastId, __ATOMIC_ACQUIRE );
+    Rc = snprintf( Buffer, Size, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"StarPi sample latency\"}}" );
+    if ( ( Rc < 0 ) || ( ( (uint32_t)Rc + sizeof( Closing ) ) > Size ) )
+    {
+        return 0u;
+    }
+    Length = (uint32_t)Rc;
+    for ( uint8_t Stage = LATENCY_FUSED; Stage < LATENCY_STAGES; Stage++ )
+    {
+        Rc = snprintf( Event, sizeof( Event ), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                       (unsigned)Stage, Names[Stage] );
+        if ( ( Length + (uint32_t)Rc + sizeof( Closing ) ) <= Size )
+        {
+            memcpy( &Buffer[Length], Event, Rc );
+            Length += Rc;
+        }
+    }
+    /* newest first, so a full buffer has the latest */
+    for ( uint32_t Count = 0u; Count < LATENCY_TRACE_SAMPLES; Count++ )
+    {
+        const uint32_t Id = Newest - Count;
+        const LATENCY_SAMPLE_T* Sample = &Samples[Id & LATENCY_TRACE_MASK];
+        int64_t Time[LATENCY_STAGES];
+        if ( ( Id == 0u ) || ( __atomic_load_n( &Sample->Id, __ATOMIC_ACQUIRE ) != Id ) )
+        {
+            continue;
+        }
+        for ( uint8_t Stage = 0u; Stage < LATENCY_STAGES; Stage++ )
+        {
+            Time[Stage] = __atomic_load_n( &Sample->Time[Stage], __ATOMIC_RELAXED );
+        }
+        if ( __atomic_load_n( &Sample->Id, __ATOMIC_ACQUIRE ) != Id )
+        {
+            continue;
+        }
+        for ( uint8_t Stage = LATENCY_FUSED; Stage < LATENCY_STAGES; Stage++ )
+        {
+            const int64_t Before = Time[Previous[Stage]];
+            if ( ( Time[Stage] == 0 ) || ( Before == 0 ) )
+            {
+                continue;
+            }
+            Rc = snprintf( Event, sizeof( Event ),
+                           ",\n{\"name\":\"%s\",\"cat\":\"latency\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                           "\"ts\":%lld,\"dur\":%lld,\"args\":{\"sample\":%u,\"total_us\":%lld}}",
+                           Names[Stage], (unsigned)Stage, (long long)Before, (long long)( Time[Stage] - Before ),
+                           (unsigned)Id, (long long)( Time[Stage] - Time[LATENCY_SAMPLED] ) );
+            if ( ( Length + (uint32_t)Rc + sizeof( Closing ) ) > Size )
+            {
+                Count = LATENCY_TRACE_SAMPLES;
+                break;
+            }
+            memcpy( &Buffer[Length], Event, Rc );
+            Length += Rc;
+        }
+    }
+    memcpy( &Buffer[Length], Closing, sizeof( Closing ) );
+    return Length + sizeof( Closing ) - 1u;
+}
+
+/* GetStageLatency
+ * Get the times from the stage before
+ */
+const MetricHistogram* LatencyTrace::GetStageLatency( uint8_t Stage )
+{
+    return ( Stage < LATENCY_STAGES ) ? &StageLatency[Stage] : NULL;
+}
+
+/* GetTotalLatency
+ * Get the times from the sensors being read
+ */
+const MetricHistogram* LatencyTrace::GetTotalLatency( uint8_t Stage )
+{
+    return ( Stage < LATENCY_STAGES ) ? &TotalLatency[Stage] : NULL;
+}
@@ -0,0 +1,107 @@
+/**
+LatencyTrace follows each sensor sample to the clients. The orientation
+task gives every sample an Id when it reads the sensors, the Id goes
+along with the values through the fusion in TelescopeManager::Run, the
+publish hooks and the servers, and each marks the time it got there.
+The time from the stage before and from the sample are kept in Metrics
+histograms, and the last LATENCY_TRACE_SAMPLES samples can be written as
+Chrome trace JSON, which HalMetrics serves at /trace.
+
+Only the latest sample goes on at each stage, so most samples stop at
+the fusion, and each sample is counted the first time it reaches a
+client of each server.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef LATENCY_TRACE_H
+#define LATENCY_TRACE_H
+
+#include <stdint.h>
+#include "Metrics.h"
+
+/* Configuration */
+
+#define LATENCY_TRACE_SAMPLES  1024u    /**< samples kept, a power of 2, 2 s at the orientation rate */
+
+/** The stages a sample goes through
+ */
+typedef enum
+{
+    LATENCY_SAMPLED = 0,        /**< the sensors were read, TelescopeOrientation::Run */
+    LATENCY_FUSED,              /**< the orientation was calculated, TelescopeManager::Run */
+    LATENCY_PUBLISHED,          /**< RA/Dec calculated and every publish hook run */
+    LATENCY_SENT_SOCKET,        /**< written to a TelescopeSocket subscriber */
+    LATENCY_SENT_STELLARIUM,    /**< queued for the Stellarium clients */
+    LATENCY_SENT_LX200,         /**< asked for by an LX200 client */
+    LATENCY_STAGES
+} LATENCY_STAGE_T;
+
+/** One sample
+ */
+typedef struct
+{
+    uint32_t Id;                        /**< 0 while the slot is being reused */
+    int64_t Time[LATENCY_STAGES];       /**< Metrics::NowMicros at each stage, 0 if not reached */
+} LATENCY_SAMPLE_T;
+
+/** LatencyTrace
+ * - The samples on their way to the clients
+ */
+class LatencyTrace
+{
+    public:
+    /** Start a new sample, the orientation task only
+     * @return uint32_t its Id, never 0
+     */
+        static uint32_t Begin( void );
+    /** Mark a sample reaching a stage, from any thread. It is ignored if
+     *  the sample has already reached the stage or is no longer kept.
+     * @param Id from Begin, 0 is ignored
+     * @param Stage LATENCY_STAGE_T
+     */
+        static void Mark( uint32_t Id, uint8_t Stage );
+    /** Register the latency histograms with Metrics
+     */
+        static void RegisterMetrics( void );
+    /** Write the kept samples as Chrome trace JSON, the newest first, as
+     *  many as fit
+     * @param Buffer where to write them
+     * @param Size size of the buffer
+     * @return uint32_t length written, 0 if not even the framing fits
+     */
+        static uint32_t WriteChromeTrace( char* Buffer, uint32_t Size );
+    /** Get the times from the stage before
+     * @param Stage LATENCY_FUSED onwards
+     */
+        static const MetricHistogram* GetStageLatency( uint8_t Stage );
+    /** Get the times from the sensors being read
+     * @param Stage LATENCY_FUSED onwards
+     */
+        static const MetricHistogram* GetTotalLatency( uint8_t Stage );
+
+    private:
+        static LATENCY_SAMPLE_T Samples[LATENCY_TRACE_SAMPLES];    /**< ring, indexed by Id */
+        static uint32_t LastId;                                    /**< Id of the newest sample */
+        static MetricHistogram StageLatency[LATENCY_STAGES];       /**< from the stage before */
+        static MetricHistogram TotalLatency[LATENCY_STAGES];       /**< from LATENCY_SAMPLED */
+        static const uint8_t Previous[LATENCY_STAGES];             /**< the stage before each */
+        static const char* const Names[LATENCY_STAGES];            /**< for the labels and the trace */
+        static const char* const Labels[LATENCY_STAGES];           /**< stage="..." */
+};
+
+#endif /* LATENCY_TRACE_H */
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "LatencyTrace.h"
+/*
+ LatencyTrace test
+ Samples go through the stages the way the tasks and the servers mark
+ them, each stage must be counted once per sample and a sample that has
+ been overwritten must not be counted. Threads mark the same samples at
+ once, then the Chrome trace is checked and the cost of a Mark is timed.
+ Build on any machine from Software/:
+
+ g++ -O2 -I./Src/Utils Src/Utils/LatencyTrace_test.cpp Src/Utils/LatencyTrace.cpp \
+     Src/Utils/Metrics.cpp -lpthread -latomic -o LatencyTrace_test
+ ./LatencyTrace_test
+ */
+
+#define TEST_THREADS     4
+#define TEST_MARKS       1000000
+
+static int failures = 0;
+static uint32_t ids[LATENCY_TRACE_SAMPLES];
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+static uint64_t count(const MetricHistogram* histogram)
+{
+    uint64_t total = 0u;
+    for (uint8_t bucket = 0u; bucket <= METRICS_BUCKETS; bucket++)
+    {
+        total += histogram->GetBucket(bucket);
+    }
+    return total;
+}
+
+/* every server thread sends the same samples */
+static void* sender(void* arg)
+{
+    (void)arg;
+    for (uint32_t i = 0u; i < LATENCY_TRACE_SAMPLES; i++)
+    {
+        LatencyTrace::Mark(ids[i], LATENCY_SENT_SOCKET);
+    }
+    return NULL;
+}
+
+int main()
+{
+    static char trace[1u << 20];
+
+    /* each stage once per sample */
+    {
+        const uint32_t id = LatencyTrace::Begin();
+        check(id != 0u, "a sample has an Id");
+        LatencyTrace::Mark(id, LATENCY_FUSED);
+        LatencyTrace::Mark(id, LATENCY_FUSED);
+        LatencyTrace::Mark(id, LATENCY_PUBLISHED);
+        LatencyTrace::Mark(id, LATENCY_SENT_STELLARIUM);
+        LatencyTrace::Mark(id, LATENCY_SENT_STELLARIUM);
+        LatencyTrace::Mark(0u, LATENCY_SENT_LX200);
+        LatencyTrace::Mark(id, LATENCY_STAGES);
+        check((count(LatencyTrace::GetStageLatency(LATENCY_FUSED)) == 1u)
+              && (count(LatencyTrace::GetTotalLatency(LATENCY_FUSED)) == 1u), "a stage is counted the first time");
+        check((count(LatencyTrace::GetStageLatency(LATENCY_SENT_STELLARIUM)) == 1u)
+              && (count(LatencyTrace::GetTotalLatency(LATENCY_SENT_STELLARIUM)) == 1u), "a client stage is counted once");
+        check(count(LatencyTrace::GetTotalLatency(LATENCY_SENT_LX200)) == 0u, "Id 0 is not counted");
+        check(LatencyTrace::GetStageLatency(LATENCY_STAGES) == NULL, "there is no stage after the last");
+    }
+
+    /* a sample skipped at a stage has no time from the stage before */
+    {
+        const uint32_t id = LatencyTrace::Begin();
+        LatencyTrace::Mark(id, LATENCY_PUBLISHED);
+        check((count(LatencyTrace::GetStageLatency(LATENCY_PUBLISHED)) == 1u)
+              && (count(LatencyTrace::GetTotalLatency(LATENCY_PUBLISHED)) == 2u), "a skipped stage only counts the total");
+    }
+
+    /* an overwritten sample is not counted */
+    {
+        const uint32_t old = LatencyTrace::Begin();
+        for (uint32_t i = 0u; i < LATENCY_TRACE_SAMPLES; i++)
+        {
+            (void)LatencyTrace::Begin();
+        }
+        LatencyTrace::Mark(old, LATENCY_SENT_LX200);
+        check(count(LatencyTrace::GetTotalLatency(LATENCY_SENT_LX200)) == 0u, "a sample no longer kept is not counted");
+    }
+
+    /* samples sent by several threads at once are counted once each */
+    {
+        pthread_t threads[TEST_THREADS];
+        const uint64_t before = count(LatencyTrace::GetTotalLatency(LATENCY_SENT_SOCKET));
+        for (uint32_t i = 0u; i < LATENCY_TRACE_SAMPLES; i++)
+        {
+            ids[i] = LatencyTrace::Begin();
+            LatencyTrace::Mark(ids[i], LATENCY_FUSED);
+            LatencyTrace::Mark(ids[i], LATENCY_PUBLISHED);
+        }
+        for (int i = 0; i < TEST_THREADS; i++)
+        {
+            pthread_create(&threads[i], NULL, sender, NULL);
+        }
+        for (int i = 0; i < TEST_THREADS; i++)
+        {
+            pthread_join(threads[i], NULL);
+        }
+        check(count(LatencyTrace::GetTotalLatency(LATENCY_SENT_SOCKET)) - before == LATENCY_TRACE_SAMPLES,
+              "each sample is counted once by one of the threads");
+    }
+
+    /* the Chrome trace */
+    {
+        char event[64];
+        uint32_t length = LatencyTrace::WriteChromeTrace(trace, sizeof(trace));
+        check((length > 0u) && (length == strlen(trace)), "the trace is written");
+        check(strncmp(trace, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", 40) == 0, "the trace opens the events");
+        check(strcmp(&trace[length - 4u], "\n]}\n") == 0, "the trace closes the events");
+        check(strstr(trace, "\"args\":{\"name\":\"sent_socket\"}") != NULL, "each stage is named");
+        snprintf(event, sizeof(event), "\"sample\":%u,", (unsigned)ids[LATENCY_TRACE_SAMPLES - 1u]);
+        check(strstr(trace, event) != NULL, "the newest sample is there");
+        snprintf(event, sizeof(event), "\"sample\":%u,", (unsigned)(ids[0] - 1u));
+        check(strstr(trace, event) == NULL, "a sample no longer kept is not there");
+        length = LatencyTrace::WriteChromeTrace(trace, 2048u);
+        check((length > 0u) && (length < 2048u) && (strcmp(&trace[length - 4u], "\n]}\n") == 0),
+              "a short buffer has the newest that fit");
+        snprintf(event, sizeof(event), "\"sample\":%u,", (unsigned)ids[LATENCY_TRACE_SAMPLES - 1u]);
+        check(strstr(trace, event) != NULL, "and they start with the newest");
+        check(LatencyTrace::WriteChromeTrace(trace, 40u) == 0u, "a trace that does not fit is not written");
+    }
+
+    /* the cost of a Begin and the Marks of a sample */
+    {
+        double start = seconds();
+        for (int i = 0; i < TEST_MARKS; i++)
+        {
+            const uint32_t id = LatencyTrace::Begin();
+            LatencyTrace::Mark(id, LATENCY_FUSED);
+            LatencyTrace::Mark(id, LATENCY_PUBLISHED);
+        }
+        const double sample = (seconds() - start) * 1.0e9 / TEST_MARKS;
+        const uint32_t id = LatencyTrace::Begin();
+        start = seconds();
+        for (int i = 0; i < TEST_MARKS; i++)
+        {
+            LatencyTrace::Mark(id, LATENCY_SENT_SOCKET);
+        }
+        const double again = (seconds() - start) * 1.0e9 / TEST_MARKS;
+        fprintf(stderr, "%.1f ns per Begin and two Marks, %.1f ns per Mark of a stage already reached\n", sample, again);
+    }
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,245 @@
+/*
+Metrics are counters, gauges and latency histograms that the code updates
+as it runs and HalMetrics serves in the Prometheus text format. An update
+is one relaxed atomic add or store to a value owned by the code that
+updates it, with no lock and no system call. The metrics are registered
+at start up with their name, labels and help, and are read when they are
+served.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include "Metrics.h"
+
+METRIC_T Metrics::Table[METRICS_MAX];
+uint8_t  Metrics::Count = 0u;
+void (*Metrics::SampleLock)( void ) = 0;
+void (*Metrics::SampleUnlock)( void ) = 0;
+
+/* Names of the types for the TYPE lines */
+static const char* const TypeNames[] = { "counter", "gauge", "histogram" };
+
+/* Append
+ * Append formatted text, false if it did not fit
+ */
+static bool Append( char* Buffer, uint32_t Size, uint32_t* Length, const char* Format, ... )
+{
+    va_list Args;
+    va_start( Args, Format );
+    const int Rc = vsnprintf( Buffer + *Length, Size - *Length, Format, Args );
+    va_end( Args );
+    if ( ( Rc < 0 ) || ( (uint32_t)Rc >= ( Size - *Length ) ) )
+    {
+        return false;
+    }
+    *Length += (uint32_t)Rc;
+    return true;
+}
+
+/* Constructor
+ */
+MetricHistogram::MetricHistogram( void )
+{
+    memset( Buckets, 0, sizeof( Buckets ) );
+    Sum = 0u;
+}
+
+/* Register
+ * Register a counter
+ */
+bool Metrics::Register( const char* Name, const char* Labels, const char* Help, const MetricCounter* Counter )
+{
+    METRIC_T* Metric = Add( Name, Labels, Help, METRIC_COUNTER );
+    if ( Metric != NULL )
+    {
+        Metric->Counter = Counter;
+    }
+    return ( Metric != NULL );
+}
+
+/* Register
+ * Register a gauge
+ */
+bool Metrics::Register( const char* Name, const char* Labels, const char* Help, const MetricGauge* Gauge )
+{
+    METRIC_T* Metric = Add( Name, Labels, Help, METRIC_GAUGE );
+    if ( Metric != NULL )
+    {
+        Metric->Gauge = Gauge;
+    }
+    return ( Metric != NULL );
+}
+
+/* Register
+ * Register a histogram
+ */
+bool Metrics::Register( const char* Name, const char* Labels, const char* Help, const MetricHistogram* Histogram )
+{
+    METRIC_T* Metric = Add( Name, Labels, Help, METRIC_HISTOGRAM );
+    if ( Metric != NULL )
+    {
+        Metric->Histogram = Histogram;
+    }
+    return ( Metric != NULL );
+}
+
+/* RegisterSampled
+ * Register a sampled counter or gauge
+ */
+bool Metrics::RegisterSampled( const char* Name, const char* Labels, const char* Help, uint8_t Type,
+                               METRIC_SAMPLE_T Sample, void* Context )
+{
+    METRIC_T* Metric = ( Type == METRIC_HISTOGRAM ) ? NULL : Add( Name, Labels, Help, Type );
+    if ( Metric != NULL )
+    {
+        Metric->Sample = Sample;
+        Metric->Context = Context;
+    }
+    return ( Metric != NULL );
+}
+
+/* SetSampleLock
+ * Set the lock held while a sampled metric is read
+ */
+void Metrics::SetSampleLock( void (*Lock)( void ), void (*Unlock)( void ) )
+{
+    SampleLock = Lock;
+    SampleUnlock = Unlock;
+}
+
+/* Render
+ * Write all the metrics in the Prometheus text format, the ones with the
+ * same name together under one HELP and TYPE
+ */
+uint32_t Metrics::Render( char* Buffer, uint32_t Size )
+{
+    bool Done[METRICS_MAX];
+    uint32_t Length = 0u;
+    uint8_t Index = 0u;
+    uint8_t Other = 0u;
+    memset( Done, 0, sizeof( Done ) );
+    if ( Size == 0u )
+    {
+        return 0u;
+    }
+    Buffer[0] = '\0';
+    for ( Index = 0u; Index < Count; Index++ )
+    {
+        if ( Done[Index] )
+        {
+            continue;
+        }
+        if ( !Append( Buffer, Size, &Length, "# HELP %s %s\n# TYPE %s %s\n", Table[Index].Name, Table[Index].Help,
+                      Table[Index].Name, TypeNames[Table[Index].Type] ) )
+        {
+            return 0u;
+        }
+        for ( Other = Index; Other < Count; Other++ )
+        {
+            if ( !Done[Other] && ( strcmp( Table[Other].Name, Table[Index].Name ) == 0 ) )
+            {
+                Done[Other] = true;
+                if ( !RenderMetric( &Table[Other], Buffer, Size, &Length ) )
+                {
+                    return 0u;
+                }
+            }
+        }
+    }
+    return Length;
+}
+
+/* Add
+ * Add an entry to the table
+ */
+METRIC_T* Metrics::Add( const char* Name, const char* Labels, const char* Help, uint8_t Type )
+{
+    METRIC_T* Metric = NULL;
+    if ( Count >= METRICS_MAX )
+    {
+        printf( "Metrics: no room for %s\n", Name );
+        return NULL;
+    }
+    Metric = &Table[Count];
+    memset( Metric, 0, sizeof( *Metric ) );
+    Metric->Name = Name;
+    Metric->Labels = ( Labels != NULL ) ? Labels : "";
+    Metric->Help = Help;
+    Metric->Type = Type;
+    Count++;
+    return Metric;
+}
+
+/* RenderMetric
+ * Write the lines of one metric, a histogram's buckets are cumulative and
+ * in seconds as Prometheus expects
+ */
+bool Metrics::RenderMetric( const METRIC_T* Metric, char* Buffer, uint32_t Size, uint32_t* Length )
+{
+    const char* Open = ( Metric->Labels[0] != '\0' ) ? "{" : "";
+    const char* Close = ( Metric->Labels[0] != '\0' ) ? "}" : "";
+    const char* Comma = ( Metric->Labels[0] != '\0' ) ? "," : "";
+    if ( Metric->Histogram != NULL )
+    {
+        const MetricHistogram* Histogram = Metric->Histogram;
+        uint64_t Total = 0u;
+        uint8_t Bucket = 0u;
+        for ( Bucket = 0u; Bucket < METRICS_BUCKETS; Bucket++ )
+        {
+            Total += Histogram->GetBucket( Bucket );
+            if ( !Append( Buffer, Size, Length, "%s_bucket{%s%sle=\"%.6f\"} %llu\n", Metric->Name, Metric->Labels, Comma,
+                          (double)( 1u << Bucket ) * 1.0e-6, (unsigned long long)Total ) )
+            {
+                return false;
+            }
+        }
+        Total += Histogram->GetBucket( METRICS_BUCKETS );
+        return Append( Buffer, Size, Length, "%s_bucket{%s%sle=\"+Inf\"} %llu\n%s_sum%s%s%s %.6f\n%s_count%s%s%s %llu\n",
+                       Metric->Name, Metric->Labels, Comma, (unsigned long long)Total,
+                       Metric->Name, Open, Metric->Labels, Close, (double)Histogram->GetSum() * 1.0e-6,
+                       Metric->Name, Open, Metric->Labels, Close, (unsigned long long)Total );
+    }
+    if ( Metric->Sample != NULL )
+    {
+        double Value = 0.0;
+        if ( SampleLock != 0 )
+        {
+            SampleLock();
+        }
+        Value = Metric->Sample( Metric->Context );
+        if ( SampleUnlock != 0 )
+        {
+            SampleUnlock();
+        }
+        if ( isnan( Value ) )
+        {
+            return Append( Buffer, Size, Length, "%s%s%s%s NaN\n", Metric->Name, Open, Metric->Labels, Close );
+        }
+        return Append( Buffer, Size, Length, "%s%s%s%s %.17g\n", Metric->Name, Open, Metric->Labels, Close, Value );
+    }
+    if ( Metric->Counter != NULL )
+    {
+        return Append( Buffer, Size, Length, "%s%s%s%s %llu\n", Metric->Name, Open, Metric->Labels, Close,
+                       (unsigned long long)Metric->Counter->Get() );
+    }
+    return Append( Buffer, Size, Length, "%s%s%s%s %lld\n", Metric->Name, Open, Metric->Labels, Close,
+                   (long long)Metric->Gauge->Get() );
+}
@@ -0,0 +1,221 @@
+/**
+Metrics are counters, gauges and latency histograms that the code updates
+as it runs and HalMetrics serves in the Prometheus text format. An update
+is one relaxed atomic add or store to a value owned by the code that
+updates it, with no lock and no system call. The metrics are registered
+at start up with their name, labels and help, and are read when they are
+served.
+
+A sampled metric is a function called when the metrics are served, for a
+value that is already kept somewhere, such as a queue's fill level. It is
+called with the sample lock held, the dispatch lock in StarPi, so it may
+read the task data.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+/* Configuration */
+
+#define METRICS_MAX      64u    /**< metrics that can be registered */
+#define METRICS_BUCKETS  20u    /**< histogram buckets, bucket n is up to 2^n microseconds, the last 0.52 s */
+
+/** Metric types, as Prometheus names them
+ */
+typedef enum
+{
+    METRIC_COUNTER = 0,     /**< only goes up */
+    METRIC_GAUGE,           /**< goes up and down */
+    METRIC_HISTOGRAM        /**< counts of durations in buckets */
+} METRIC_TYPE_T;
+
+/** MetricCounter
+ * - A count that only goes up, such as bytes sent
+ */
+class MetricCounter
+{
+    public:
+    /** Constructor
+     */
+        MetricCounter( void ) : Value( 0u ) {}
+    /** Add to the count, from any thread
+     */
+        void Add( uint64_t Count ) { (void)__atomic_fetch_add( &Value, Count, __ATOMIC_RELAXED ); }
+    /** Get the count
+     */
+        uint64_t Get( void ) const { return __atomic_load_n( &Value, __ATOMIC_RELAXED ); }
+
+    private:
+        uint64_t Value;     /**< the count */
+};
+
+/** MetricGauge
+ * - A value that goes up and down, such as the clients connected
+ */
+class MetricGauge
+{
+    public:
+    /** Constructor
+     */
+        MetricGauge( void ) : Value( 0 ) {}
+    /** Set the value
+     */
+        void Set( int64_t NewValue ) { __atomic_store_n( &Value, NewValue, __ATOMIC_RELAXED ); }
+    /** Add to the value, negative to take away, from any thread
+     */
+        void Add( int64_t Change ) { (void)__atomic_fetch_add( &Value, Change, __ATOMIC_RELAXED ); }
+    /** Get the value
+     */
+        int64_t Get( void ) const { return __atomic_load_n( &Value, __ATOMIC_RELAXED ); }
+
+    private:
+        int64_t Value;      /**< the value */
+};
+
+/** MetricHistogram
+ * - Counts of durations in buckets that double in size
+ */
+class MetricHistogram
+{
+    public:
+    /** Constructor
+     */
+        MetricHistogram( void );
+    /** Count a duration, from any thread
+     * @param Microseconds the duration, a negative one counts as 0
+     */
+        void Observe( int64_t Microseconds )
+        {
+            const uint32_t Value = ( Microseconds <= 0 ) ? 0u
+                                 : ( Microseconds > 0xFFFFFFFFll ) ? 0xFFFFFFFFu : (uint32_t)Microseconds;
+            /* the smallest n with Value <= 2^n */
+            uint32_t Bucket = ( Value <= 1u ) ? 0u : ( 32u - (uint32_t)__builtin_clz( Value - 1u ) );
+            if ( Bucket > METRICS_BUCKETS )
+            {
+                Bucket = METRICS_BUCKETS;
+            }
+            (void)__atomic_fetch_add( &Buckets[Bucket], 1u, __ATOMIC_RELAXED );
+            (void)__atomic_fetch_add( &Sum, (uint64_t)Value, __ATOMIC_RELAXED );
+        }
+    /** Get the count in a bucket, not including the ones below
+     * @param Bucket 0 to METRICS_BUCKETS, which is the one above the largest bound
+     */
+        uint64_t GetBucket( uint8_t Bucket ) const { return __atomic_load_n( &Buckets[Bucket], __ATOMIC_RELAXED ); }
+    /** Get the total of the durations
+     * @return uint64_t microseconds
+     */
+        uint64_t GetSum( void ) const { return __atomic_load_n( &Sum, __ATOMIC_RELAXED ); }
+
+    private:
+        uint64_t Buckets[METRICS_BUCKETS + 1u];    /**< counts, bucket n holds above 2^(n-1) up to 2^n us */
+        uint64_t Sum;                              /**< microseconds */
+};
+
+/** Function for a sampled metric
+ * @param Context given when it was registered
+ * @return double the value, NAN if there is none
+ */
+typedef double (*METRIC_SAMPLE_T)( void* Context );
+
+/** A registered metric
+ */
+typedef struct
+{
+    const char* Name;               /**< Prometheus name, metrics with the same name are served together */
+    const char* Labels;             /**< e.g. server="lx200", "" for none */
+    const char* Help;               /**< one line */
+    uint8_t Type;                   /**< METRIC_TYPE_T */
+    const MetricCounter* Counter;   /**< one of these four is set */
+    const MetricGauge* Gauge;
+    const MetricHistogram* Histogram;
+    METRIC_SAMPLE_T Sample;
+    void* Context;                  /**< for Sample */
+} METRIC_T;
+
+/** Metrics
+ * - The registered metrics
+ */
+class Metrics
+{
+    public:
+    /** Register a counter, at start up. The strings and the counter must
+     *  stay for as long as the metrics are served.
+     * @param Name e.g. "starpi_bytes_received_total"
+     * @param Labels e.g. "server=\"lx200\"", "" for none
+     * @param Help one line
+     * @return bool false if there are already METRICS_MAX
+     */
+        static bool Register( const char* Name, const char* Labels, const char* Help, const MetricCounter* Counter );
+    /** Register a gauge, at start up
+     * @return bool false if there are already METRICS_MAX
+     */
+        static bool Register( const char* Name, const char* Labels, const char* Help, const MetricGauge* Gauge );
+    /** Register a histogram, at start up, the name is in seconds
+     * @return bool false if there are already METRICS_MAX
+     */
+        static bool Register( const char* Name, const char* Labels, const char* Help, const MetricHistogram* Histogram );
+    /** Register a sampled counter or gauge, at start up
+     * @param Type METRIC_COUNTER or METRIC_GAUGE
+     * @param Sample called with the sample lock held when the metrics are served
+     * @param Context passed to Sample
+     * @return bool false if there are already METRICS_MAX
+     */
+        static bool RegisterSampled( const char* Name, const char* Labels, const char* Help, uint8_t Type,
+                                     METRIC_SAMPLE_T Sample, void* Context );
+    /** Set the lock held while a sampled metric is read
+     * @param Lock takes the lock, 0 for none
+     * @param Unlock releases it
+     */
+        static void SetSampleLock( void (*Lock)( void ), void (*Unlock)( void ) );
+    /** Write all the metrics in the Prometheus text format
+     * @param Buffer where to write them
+     * @param Size size of the buffer
+     * @return uint32_t length written, 0 if they did not fit
+     */
+        static uint32_t Render( char* Buffer, uint32_t Size );
+    /** Get the time for measuring durations
+     * @return int64_t microseconds, monotonic
+     */
+        static int64_t NowMicros( void )
+        {
+            struct timespec Now;
+            clock_gettime( CLOCK_MONOTONIC, &Now );
+            return ( (int64_t)Now.tv_sec * 1000000 ) + ( Now.tv_nsec / 1000 );
+        }
+
+    private:
+    /** Add an entry to the table
+     * @return METRIC_T* the entry, NULL if the table is full
+     */
+        static METRIC_T* Add( const char* Name, const char* Labels, const char* Help, uint8_t Type );
+    /** Write the lines of one metric
+     * @return bool false if they did not fit
+     */
+        static bool RenderMetric( const METRIC_T* Metric, char* Buffer, uint32_t Size, uint32_t* Length );
+
+        static METRIC_T Table[METRICS_MAX];     /**< registered metrics */
+        static uint8_t Count;                   /**< entries in Table */
+        static void (*SampleLock)( void );      /**< taken around each sample */
+        static void (*SampleUnlock)( void );    /**< released after each sample */
+};
+
+#endif /* METRICS_H */
@@ -0,0 +1,148 @@
+/*
+Sha1 is the SHA-1 hash of a short message and its base64 encoding.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <string.h>
+#include "Sha1.h"
+
+static const char Base64Characters[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static inline uint32_t Rotate( uint32_t Value, uint32_t Bits )
+{
+    return ( Value << Bits ) | ( Value >> ( 32u - Bits ) );
+}
+
+/* Digest
+ *  Hash a message
+ */
+void Sha1::Digest( const uint8_t* Message, uint32_t Length, uint8_t* Digest )
+{
+    uint32_t State[5] = { 0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u };
+    uint8_t Last[128];
+    const uint64_t Bits = (uint64_t)Length * 8u;
+    uint32_t Index = 0u;
+    uint32_t Padded = 0u;
+
+    for ( Index = 0u; ( Index + 64u ) <= Length; Index += 64u )
+    {
+        Block( &Message[Index], State );
+    }
+    /* the rest, a 1 bit, zeros and the length in bits, in one or two blocks */
+    Padded = Length - Index;
+    memcpy( Last, &Message[Index], Padded );
+    Last[Padded++] = 0x80u;
+    while ( ( Padded % 64u ) != 56u )
+    {
+        Last[Padded++] = 0u;
+    }
+    for ( Index = 0u; Index < 8u; Index++ )
+    {
+        Last[Padded++] = (uint8_t)( Bits >> ( 56u - ( Index * 8u ) ) );
+    }
+    for ( Index = 0u; Index < Padded; Index += 64u )
+    {
+        Block( &Last[Index], State );
+    }
+    for ( Index = 0u; Index < SHA1_DIGEST_SIZE; Index++ )
+    {
+        Digest[Index] = (uint8_t)( State[Index / 4u] >> ( 24u - ( ( Index % 4u ) * 8u ) ) );
+    }
+}
+
+/* Base64
+ *  Write data as base64 with padding
+ */
+uint32_t Sha1::Base64( const uint8_t* Data, uint32_t Length, char* Text )
+{
+    uint32_t Written = 0u;
+    uint32_t Index = 0u;
+    for ( Index = 0u; Index < Length; Index += 3u )
+    {
+        const uint32_t Remaining = Length - Index;
+        const uint32_t Group = ( (uint32_t)Data[Index] << 16 )
+                             | ( ( Remaining > 1u ) ? ( (uint32_t)Data[Index + 1u] << 8 ) : 0u )
+                             | ( ( Remaining > 2u ) ? (uint32_t)Data[Index + 2u] : 0u );
+        Text[Written++] = Base64Characters[( Group >> 18 ) & 0x3Fu];
+        Text[Written++] = Base64Characters[( Group >> 12 ) & 0x3Fu];
+        Text[Written++] = ( Remaining > 1u ) ? Base64Characters[( Group >> 6 ) & 0x3Fu] : '=';
+        Text[Written++] = ( Remaining > 2u ) ? Base64Characters[Group & 0x3Fu] : '=';
+    }
+    Text[Written] = '\0';
+    return Written;
+}
+
+/* Block
+ *  Add a 64 byte block to the hash state
+ */
+void Sha1::Block( const uint8_t* Data, uint32_t* State )
+{
+    uint32_t W[80];
+    uint32_t A = State[0];
+    uint32_t B = State[1];
+    uint32_t C = State[2];
+    uint32_t D = State[3];
+    uint32_t E = State[4];
+    uint32_t Index = 0u;
+
+    for ( Index = 0u; Index < 16u; Index++ )
+    {
+        W[Index] = ( (uint32_t)Data[Index * 4u] << 24 ) | ( (uint32_t)Data[( Index * 4u ) + 1u] << 16 )
+                 | ( (uint32_t)Data[( Index * 4u ) + 2u] << 8 ) | (uint32_t)Data[( Index * 4u ) + 3u];
+    }
+    for ( Index = 16u; Index < 80u; Index++ )
+    {
+        W[Index] = Rotate( W[Index - 3u] ^ W[Index - 8u] ^ W[Index - 14u] ^ W[Index - 16u], 1u );
+    }
+    for ( Index = 0u; Index < 80u; Index++ )
+    {
+        uint32_t F = 0u;
+        uint32_t K = 0u;
+        if ( Index < 20u )
+        {
+            F = ( B & C ) | ( ~B & D );
+            K = 0x5A827999u;
+        }
+        else if ( Index < 40u )
+        {
+            F = B ^ C ^ D;
+            K = 0x6ED9EBA1u;
+        }
+        else if ( Index < 60u )
+        {
+            F = ( B & C ) | ( B & D ) | ( C & D );
+            K = 0x8F1BBCDCu;
+        }
+        else
+        {
+            F = B ^ C ^ D;
+            K = 0xCA62C1D6u;
+        }
+        const uint32_t Temp = Rotate( A, 5u ) + F + E + K + W[Index];
+        E = D;
+        D = C;
+        C = Rotate( B, 30u );
+        B = A;
+        A = Temp;
+    }
+    State[0] += A;
+    State[1] += B;
+    State[2] += C;
+    State[3] += D;
+    State[4] += E;
+}
@@ -0,0 +1,55 @@
+/**
+Sha1 is the SHA-1 hash (FIPS 180-4) of a short message and the base64
+encoding of the result, which is all the WebSocket opening handshake
+needs. SHA-1 is not used for anything that has to be secure.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef SHA1_H
+#define SHA1_H
+
+#include <stdint.h>
+
+/* Configuration */
+
+#define SHA1_DIGEST_SIZE  20u   /**< bytes in a digest */
+#define SHA1_BASE64_SIZE  29u   /**< a base64 digest and its terminator */
+
+/** Sha1
+ * - SHA-1 digest of a buffer held in memory
+ */
+class Sha1
+{
+    public:
+    /** Hash a message
+     * @param Digest receives SHA1_DIGEST_SIZE bytes
+     */
+        static void Digest( const uint8_t* Message, uint32_t Length, uint8_t* Digest );
+    /** Write data as base64 with padding, '\0' terminated
+     * @param Text at least 4 * ( ( Length + 2 ) / 3 ) + 1 bytes
+     * @return uint32_t characters written
+     */
+        static uint32_t Base64( const uint8_t* Data, uint32_t Length, char* Text );
+
+    private:
+    /** Add a 64 byte block to the hash state
+     */
+        static void Block( const uint8_t* Data, uint32_t* State );
+};
+
+#endif /* SHA1_H */
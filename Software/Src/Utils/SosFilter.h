@@ -0,0 +1,218 @@
+/**
+A cascade of second order IIR sections (biquads) filtering up to four
+channels at once. The per channel state of each section is stored
+contiguously so the channels are processed together with NEON on the Pi
+or SSE on x86, with a plain C++ fallback for anything else.
+Sections use the transposed direct form II.
+
+Author and copyright of this file:
+Chris Dick, 2015
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef SOS_FILTER_H
+#define SOS_FILTER_H
+
+#include <stdint.h>
+#include <math.h>
+
+#if ( defined __ARM_NEON ) || ( defined __ARM_NEON__ )
+#include <arm_neon.h>
+#define SOS_FILTER_NEON
+#elif defined __SSE__
+#include <xmmintrin.h>
+#define SOS_FILTER_SSE
+#endif
+
+#define SOS_FILTER_CHANNELS 4u /**< channels filtered at once, one SIMD register */
+
+/** SosFilter
+ * - Class to filter SOS_FILTER_CHANNELS channels through a cascade of biquads
+ * @param Sections number of second order sections in the cascade
+ */
+template <uint8_t Sections>
+class SosFilter
+{
+    public:
+    /** Constructor
+     * All sections start as a pass through.
+     */
+        SosFilter( void )
+        {
+            for ( uint8_t Section = 0u; Section < Sections; Section++ )
+            {
+                SetSection( Section, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f );
+            }
+            Reset();
+        }
+
+    /** Set the coefficients of one section
+     * The coefficients are normalised by a0.
+     * @param Section section to set
+     * @return bool false if the section does not exist or a0 is zero
+     */
+        bool SetSection( uint8_t Section, float b0, float b1, float b2, float a0, float a1, float a2 )
+        {
+            bool Result = false;
+            if ( ( Section < Sections ) && ( a0 != 0.0f ) )
+            {
+                Coefficients[Section].b0 = b0 / a0;
+                Coefficients[Section].b1 = b1 / a0;
+                Coefficients[Section].b2 = b2 / a0;
+                Coefficients[Section].a1 = a1 / a0;
+                Coefficients[Section].a2 = a2 / a0;
+                Result = true;
+            }
+            return Result;
+        }
+
+    /** Design a Butterworth low pass filter of order 2 * Sections
+     * Each section is a bilinear transform of one pole pair, prewarped
+     * so the -3dB point of the cascade is at Cutoff.
+     * @param Cutoff cutoff frequency in Hz
+     * @param SampleRate rate Filter is called at in Hz
+     * @return bool false if the cutoff is not below the Nyquist frequency
+     */
+        bool DesignLowPass( float Cutoff, float SampleRate )
+        {
+            bool Result = false;
+            if ( ( Cutoff > 0.0f ) && ( Cutoff < ( SampleRate / 2.0f ) ) )
+            {
+                const double W0 = ( 2.0 * M_PI * Cutoff ) / SampleRate;
+                const double CosW0 = cos( W0 );
+                const double SinW0 = sin( W0 );
+                for ( uint8_t Section = 0u; Section < Sections; Section++ )
+                {
+                    /* Q of the pole pair of an order 2 * Sections Butterworth filter */
+                    const double Q = 1.0 / ( 2.0 * cos( ( M_PI * ( ( 2.0 * Section ) + 1.0 ) ) / ( 4.0 * Sections ) ) );
+                    const double Alpha = SinW0 / ( 2.0 * Q );
+                    SetSection( Section,
+                                (float)( ( 1.0 - CosW0 ) / 2.0 ), (float)( 1.0 - CosW0 ), (float)( ( 1.0 - CosW0 ) / 2.0 ),
+                                (float)( 1.0 + Alpha ), (float)( -2.0 * CosW0 ), (float)( 1.0 - Alpha ) );
+                }
+                Result = true;
+            }
+            return Result;
+        }
+
+    /** Clear the filter state of every channel
+     */
+        void Reset( void )
+        {
+            for ( uint8_t Section = 0u; Section < Sections; Section++ )
+            {
+                for ( uint8_t Channel = 0u; Channel < SOS_FILTER_CHANNELS; Channel++ )
+                {
+                    State[Section].z1[Channel] = 0.0f;
+                    State[Section].z2[Channel] = 0.0f;
+                }
+            }
+        }
+
+    /** Filter one sample of every channel
+     * @param In input sample for each channel
+     * @param Out filtered sample for each channel, may be the same as In
+     */
+        void Filter( const float In[SOS_FILTER_CHANNELS], float Out[SOS_FILTER_CHANNELS] )
+        {
+#ifdef SOS_FILTER_NEON
+            float32x4_t x = vld1q_f32( In );
+            for ( uint8_t Section = 0u; Section < Sections; Section++ )
+            {
+                const COEFFICIENTS_T& c = Coefficients[Section];
+                float32x4_t z1 = vld1q_f32( State[Section].z1 );
+                float32x4_t z2 = vld1q_f32( State[Section].z2 );
+                float32x4_t y = vmlaq_n_f32( z1, x, c.b0 );
+                z1 = vmlsq_n_f32( vmlaq_n_f32( z2, x, c.b1 ), y, c.a1 );
+                z2 = vmlsq_n_f32( vmulq_n_f32( x, c.b2 ), y, c.a2 );
+                vst1q_f32( State[Section].z1, z1 );
+                vst1q_f32( State[Section].z2, z2 );
+                x = y;
+            }
+            vst1q_f32( Out, x );
+#elif defined SOS_FILTER_SSE
+            __m128 x = _mm_loadu_ps( In );
+            for ( uint8_t Section = 0u; Section < Sections; Section++ )
+            {
+                const COEFFICIENTS_T& c = Coefficients[Section];
+                __m128 z1 = _mm_load_ps( State[Section].z1 );
+                __m128 z2 = _mm_load_ps( State[Section].z2 );
+                __m128 y = _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( c.b0 ) ), z1 );
+                z1 = _mm_sub_ps( _mm_add_ps( _mm_mul_ps( x, _mm_set1_ps( c.b1 ) ), z2 ), _mm_mul_ps( y, _mm_set1_ps( c.a1 ) ) );
+                z2 = _mm_sub_ps( _mm_mul_ps( x, _mm_set1_ps( c.b2 ) ), _mm_mul_ps( y, _mm_set1_ps( c.a2 ) ) );
+                _mm_store_ps( State[Section].z1, z1 );
+                _mm_store_ps( State[Section].z2, z2 );
+                x = y;
+            }
+            _mm_storeu_ps( Out, x );
+#else
+            float x[SOS_FILTER_CHANNELS];
+            uint8_t Channel = 0u;
+            for ( Channel = 0u; Channel < SOS_FILTER_CHANNELS; Channel++ )
+            {
+                x[Channel] = In[Channel];
+            }
+            for ( uint8_t Section = 0u; Section < Sections; Section++ )
+            {
+                const COEFFICIENTS_T& c = Coefficients[Section];
+                for ( Channel = 0u; Channel < SOS_FILTER_CHANNELS; Channel++ )
+                {
+                    float y = ( c.b0 * x[Channel] ) + State[Section].z1[Channel];
+                    State[Section].z1[Channel] = ( ( c.b1 * x[Channel] ) + State[Section].z2[Channel] ) - ( c.a1 * y );
+                    State[Section].z2[Channel] = ( c.b2 * x[Channel] ) - ( c.a2 * y );
+                    x[Channel] = y;
+                }
+            }
+            for ( Channel = 0u; Channel < SOS_FILTER_CHANNELS; Channel++ )
+            {
+                Out[Channel] = x[Channel];
+            }
+#endif
+        }
+
+    /** Filter one sample of three channels, e.g. the X, Y and Z axes of a sensor
+     */
+        void Filter( float X, float Y, float Z, float* Fx, float* Fy, float* Fz )
+        {
+            float Samples[SOS_FILTER_CHANNELS] = { X, Y, Z, 0.0f };
+            Filter( Samples, Samples );
+            *Fx = Samples[0];
+            *Fy = Samples[1];
+            *Fz = Samples[2];
+        }
+
+    private:
+        /** Coefficients of one section, normalised so a0 is 1 */
+        typedef struct
+        {
+            float b0;
+            float b1;
+            float b2;
+            float a1;
+            float a2;
+        } COEFFICIENTS_T;
+
+        /** State of one section for every channel */
+        typedef struct
+        {
+            float z1[SOS_FILTER_CHANNELS] __attribute__ ((aligned (16)));
+            float z2[SOS_FILTER_CHANNELS] __attribute__ ((aligned (16)));
+        } STATE_T;
+
+        STATE_T State[Sections];               /**< filter state, section by section */
+        COEFFICIENTS_T Coefficients[Sections]; /**< filter coefficients */
+};
+
+#endif /* SOS_FILTER_H */
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "SosFilter.h"
+#include "Config.h"
+/*
+ SosFilter test
+ The section from Config.h must filter each axis exactly as the iirfilter
+ the sensor HALs used before, and the SIMD path (SSE on x86, NEON on the
+ Pi) must match a plain loop on every channel. The Butterworth design
+ must pass DC, be 3dB down at the cutoff and refuse a cutoff at or above
+ Nyquist. Build on any machine from Software/:
+
+ g++ -O2 -I./Src -I./Src/Utils Src/Utils/SosFilter_test.cpp -o SosFilter_test
+ ./SosFilter_test
+ */
+
+#define TEST_SAMPLES    10000u
+#define TEST_RATE       500.0f
+#define TEST_CUTOFF     5.0f
+
+static int failures = 0;
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+/* the filter HalAccelerometer and HalMagnetometer had before SosFilter */
+static float b[] = { 1, -1.4, 1 };
+static float a[] = { 1, -1.3, 0.5 };
+static float iirfilter(float x1, float* v1m1, float* v2m1)
+{
+    float y1 = 0;
+    y1 = ((b[0] * x1) + *v1m1) / a[0];
+    *v1m1 = ((b[1] * x1) + *v2m1) - (a[1] * y1);
+    *v2m1 = (b[2] * x1) - (a[2] * y1);
+    return y1;
+}
+
+/* a sample like a raw sensor reading, different on each channel */
+static float sample(uint32_t n, uint8_t channel)
+{
+    return (float)((1000.0 * sin((n * 0.01) * (channel + 1))) + (rand() % 200) - 100);
+}
+
+/* amplitude of a sine at Frequency once the filter has settled, from its RMS */
+template <uint8_t Sections>
+static double amplitude(SosFilter<Sections>* filter, float frequency)
+{
+    float in[SOS_FILTER_CHANNELS];
+    float out[SOS_FILTER_CHANNELS];
+    double sum = 0.0;
+    uint32_t n = 0u;
+    filter->Reset();
+    for (n = 0u; n < TEST_SAMPLES; n++)
+    {
+        for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+        {
+            in[channel] = (float)sin((2.0 * M_PI * frequency * n) / TEST_RATE);
+        }
+        filter->Filter(in, out);
+        /* the last half is a whole number of periods */
+        if (n >= (TEST_SAMPLES / 2u))
+        {
+            sum += out[0] * out[0];
+        }
+    }
+    return sqrt((2.0 * sum) / (TEST_SAMPLES / 2u));
+}
+
+/* the output for a constant input once the filter has settled */
+template <uint8_t Sections>
+static double dcGain(SosFilter<Sections>* filter)
+{
+    float in[SOS_FILTER_CHANNELS] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    float out[SOS_FILTER_CHANNELS];
+    filter->Reset();
+    for (uint32_t n = 0u; n < TEST_SAMPLES; n++)
+    {
+        filter->Filter(in, out);
+    }
+    return out[0];
+}
+
+int main()
+{
+    float in[SOS_FILTER_CHANNELS];
+    float out[SOS_FILTER_CHANNELS];
+    uint32_t n = 0u;
+
+#if defined SOS_FILTER_NEON
+    fprintf(stderr, "SosFilter path: NEON\n");
+#elif defined SOS_FILTER_SSE
+    fprintf(stderr, "SosFilter path: SSE\n");
+#else
+    fprintf(stderr, "SosFilter path: scalar\n");
+#endif
+
+    /* a new filter passes the input through */
+    {
+        SosFilter<2> filter;
+        bool same = true;
+        for (n = 0u; n < 100u; n++)
+        {
+            for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+            {
+                in[channel] = sample(n, channel);
+            }
+            filter.Filter(in, out);
+            for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+            {
+                same = same && (out[channel] == in[channel]);
+            }
+        }
+        check(same, "a new filter passes the input through");
+    }
+
+    /* the section from Config.h against the old iirfilter, axis by axis */
+    {
+        SosFilter<1> filter;
+        float v1[3] = { 0.0f, 0.0f, 0.0f };
+        float v2[3] = { 0.0f, 0.0f, 0.0f };
+        float worst = 0.0f;
+        check(filter.SetSection(0u, CONFIG_SENSOR_FILTER_B0, CONFIG_SENSOR_FILTER_B1, CONFIG_SENSOR_FILTER_B2,
+                                CONFIG_SENSOR_FILTER_A0, CONFIG_SENSOR_FILTER_A1, CONFIG_SENSOR_FILTER_A2),
+              "the Config.h section is set");
+        for (n = 0u; n < TEST_SAMPLES; n++)
+        {
+            float x = sample(n, 0u);
+            float y = sample(n, 1u);
+            float z = sample(n, 2u);
+            float fx = 0.0f;
+            float fy = 0.0f;
+            float fz = 0.0f;
+            filter.Filter(x, y, z, &fx, &fy, &fz);
+            worst = fmaxf(worst, fabsf(fx - iirfilter(x, &v1[0], &v2[0])));
+            worst = fmaxf(worst, fabsf(fy - iirfilter(y, &v1[1], &v2[1])));
+            worst = fmaxf(worst, fabsf(fz - iirfilter(z, &v1[2], &v2[2])));
+        }
+        fprintf(stderr, "Config.h section against iirfilter: worst difference %g\n", worst);
+        check(worst <= 1.0e-3f, "the Config.h section filters as iirfilter did");
+    }
+
+    /* the SIMD path against a plain transposed direct form II loop, in floats */
+    {
+        SosFilter<2> filter;
+        float coefficients[2][5];
+        float z1[2][SOS_FILTER_CHANNELS] = { { 0.0f } };
+        float z2[2][SOS_FILTER_CHANNELS] = { { 0.0f } };
+        float worst[SOS_FILTER_CHANNELS] = { 0.0f };
+        bool same = true;
+        for (uint8_t section = 0u; section < 2u; section++)
+        {
+            /* a different low pass for each section */
+            const double w0 = (2.0 * M_PI * (10.0 + (20.0 * section))) / TEST_RATE;
+            const double alpha = sin(w0) / (2.0 * (0.6 + section));
+            const double a0 = 1.0 + alpha;
+            coefficients[section][0] = (float)(((1.0 - cos(w0)) / 2.0) / a0);
+            coefficients[section][1] = (float)((1.0 - cos(w0)) / a0);
+            coefficients[section][2] = (float)(((1.0 - cos(w0)) / 2.0) / a0);
+            coefficients[section][3] = (float)((-2.0 * cos(w0)) / a0);
+            coefficients[section][4] = (float)((1.0 - alpha) / a0);
+            filter.SetSection(section, coefficients[section][0], coefficients[section][1], coefficients[section][2],
+                              1.0f, coefficients[section][3], coefficients[section][4]);
+        }
+        for (n = 0u; n < TEST_SAMPLES; n++)
+        {
+            for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+            {
+                in[channel] = sample(n, channel);
+            }
+            filter.Filter(in, out);
+            for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+            {
+                float x = in[channel];
+                for (uint8_t section = 0u; section < 2u; section++)
+                {
+                    const float* c = coefficients[section];
+                    float y = (c[0] * x) + z1[section][channel];
+                    z1[section][channel] = ((c[1] * x) + z2[section][channel]) - (c[3] * y);
+                    z2[section][channel] = (c[2] * x) - (c[4] * y);
+                    x = y;
+                }
+                worst[channel] = fmaxf(worst[channel], fabsf(out[channel] - x));
+            }
+        }
+        for (uint8_t channel = 0u; channel < SOS_FILTER_CHANNELS; channel++)
+        {
+            fprintf(stderr, "channel %u: worst difference %g\n", channel, worst[channel]);
+            same = same && (worst[channel] <= 1.0e-3f);
+        }
+        check(same, "every channel matches the plain loop");
+    }
+
+    /* Butterworth design */
+    {
+        SosFilter<1> filter;
+        check(filter.DesignLowPass(TEST_CUTOFF, TEST_RATE), "one section designed");
+        check(fabs(dcGain(&filter) - 1.0) < 1.0e-3, "one section passes DC");
+        check(fabs((20.0 * log10(amplitude(&filter, TEST_CUTOFF))) + 3.01) < 0.1, "one section is 3dB down at the cutoff");
+        check(!filter.DesignLowPass(TEST_RATE / 2.0f, TEST_RATE), "a cutoff at Nyquist is refused");
+        check(!filter.DesignLowPass(TEST_RATE, TEST_RATE), "a cutoff above Nyquist is refused");
+        check(!filter.DesignLowPass(0.0f, TEST_RATE), "a cutoff of 0 is refused");
+    }
+    {
+        SosFilter<2> filter;
+        double passband = 0.0;
+        double stopband = 0.0;
+        check(filter.DesignLowPass(TEST_CUTOFF, TEST_RATE), "two sections designed");
+        check(fabs(dcGain(&filter) - 1.0) < 1.0e-3, "two sections pass DC");
+        check(fabs((20.0 * log10(amplitude(&filter, TEST_CUTOFF))) + 3.01) < 0.1, "two sections are 3dB down at the cutoff");
+        passband = amplitude(&filter, TEST_CUTOFF / 5.0f);
+        stopband = amplitude(&filter, TEST_CUTOFF * 5.0f);
+        fprintf(stderr, "two sections: %.4f at cutoff/5, %.6f at cutoff*5\n", passband, stopband);
+        check(passband > 0.999, "two sections are flat below the cutoff");
+        check(stopband < 0.002, "two sections are 56dB down at five times the cutoff");
+    }
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
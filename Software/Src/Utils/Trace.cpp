@@ -0,0 +1,161 @@
+/*
+Trace records when the tasks and handlers start and end, to see their
+timing in the field without a scope on the GPIO pins. Each thread writes
+(time, event, argument) records to its own ring with no lock and no
+system call other than reading the clock, and the rings are written out
+as Chrome trace JSON on request, for chrome://tracing or
+ui.perfetto.dev. Without TRACE defined in Config.h the TRACE_BEGIN and
+TRACE_END macros are empty and nothing is recorded.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "Trace.h"
+
+static_assert( ( TRACE_RECORDS & ( TRACE_RECORDS - 1u ) ) == 0u, "the records are indexed by the low bits of Head" );
+
+TRACE_RING_T          Trace::Rings[TRACE_THREADS];
+TRACE_RING_T          Trace::Dropped;
+uint32_t              Trace::RingCount = 0u;
+__thread TRACE_RING_T* Trace::ThreadRing = NULL;
+
+const char* const Trace::Names[TRACE_EVENTS] =
+{
+    "TelescopeManager", "TelescopeOrientation", "HalWebsocketd", "HalGps", "ServerPi", "Dump"
+};
+
+/* Claim
+ * Give this thread a ring, the first time it records
+ */
+TRACE_RING_T* Trace::Claim( void )
+{
+    const uint32_t Index = __atomic_fetch_add( &RingCount, 1u, __ATOMIC_RELAXED );
+    if ( Index >= TRACE_THREADS )
+    {
+        ThreadRing = &Dropped;
+    }
+    else
+    {
+        ThreadRing = &Rings[Index];
+        if ( pthread_getname_np( pthread_self(), ThreadRing->Name, sizeof( ThreadRing->Name ) ) != 0 )
+        {
+            snprintf( ThreadRing->Name, sizeof( ThreadRing->Name ), "thread %u", (unsigned)Index );
+        }
+    }
+    return ThreadRing;
+}
+
+/* Dump
+ * Write the records of every thread to a file as Chrome trace JSON. The
+ * records are copied while the threads write, so those that may have
+ * been overwritten during the copy are left out.
+ */
+bool Trace::Dump( const char* Path )
+{
+    static TRACE_RECORD_T Copy[TRACE_RECORDS];    /* too big for the stack */
+    uint32_t Written = 0u;
+    uint32_t Claimed = 0u;
+    uint32_t Index = 0u;
+    FILE* File = NULL;
+
+    TRACE_BEGIN( TRACE_DUMP, 0u );
+    File = fopen( Path, "w" );
+    if ( File == NULL )
+    {
+        perror( "Trace" );
+        TRACE_END( TRACE_DUMP, 0u );
+        return false;
+    }
+    fprintf( File, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n"
+                   "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"StarPi\"}}" );
+    Claimed = __atomic_load_n( &RingCount, __ATOMIC_ACQUIRE );
+    Claimed = ( Claimed < TRACE_THREADS ) ? Claimed : TRACE_THREADS;
+    for ( Index = 0u; Index < Claimed; Index++ )
+    {
+        const TRACE_RING_T* Ring = &Rings[Index];
+        const uint32_t Head = __atomic_load_n( &Ring->Head, __ATOMIC_ACQUIRE );
+        uint32_t First = ( Head > TRACE_RECORDS ) ? ( Head - TRACE_RECORDS ) : 0u;
+        uint32_t Count = 0u;
+        if ( Head == 0u )
+        {
+            /* the thread has not finished its first record, or named its ring */
+            continue;
+        }
+        for ( Count = First; Count != Head; Count++ )
+        {
+            const TRACE_RECORD_T* Entry = &Ring->Records[Count & ( TRACE_RECORDS - 1u )];
+            TRACE_RECORD_T* Record = &Copy[Count & ( TRACE_RECORDS - 1u )];
+            Record->Time = __atomic_load_n( &Entry->Time, __ATOMIC_RELAXED );
+            Record->Arg = __atomic_load_n( &Entry->Arg, __ATOMIC_RELAXED );
+            Record->Event = __atomic_load_n( &Entry->Event, __ATOMIC_RELAXED );
+            Record->Phase = __atomic_load_n( &Entry->Phase, __ATOMIC_RELAXED );
+        }
+        /* the thread may have gone round onto the first records copied,
+           and onto one more that it has started but not finished */
+        __atomic_thread_fence( __ATOMIC_ACQUIRE );
+        const uint32_t After = __atomic_load_n( &Ring->Head, __ATOMIC_RELAXED );
+        if ( ( After - Head ) >= ( TRACE_RECORDS - 1u ) )
+        {
+            First = Head;
+        }
+        else if ( ( After - First ) >= ( TRACE_RECORDS - 1u ) )
+        {
+            First = After - TRACE_RECORDS + 1u;
+        }
+        fprintf( File, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                 (unsigned)( Index + 1u ), Ring->Name );
+        for ( Count = First; Count != Head; Count++ )
+        {
+            const TRACE_RECORD_T* Record = &Copy[Count & ( TRACE_RECORDS - 1u )];
+            if ( Record->Event >= TRACE_EVENTS )
+            {
+                continue;
+            }
+            fprintf( File, ",\n{\"name\":\"%s\",\"ph\":\"%s\",\"pid\":1,\"tid\":%u,\"ts\":%lld.%03u,\"args\":{\"arg\":%u}}",
+                     Names[Record->Event], ( Record->Phase == TRACE_PHASE_BEGIN ) ? "B" : "E", (unsigned)( Index + 1u ),
+                     (long long)( Record->Time / 1000 ), (unsigned)( Record->Time % 1000 ), (unsigned)Record->Arg );
+            Written++;
+        }
+    }
+    fprintf( File, "\n]}\n" );
+    if ( fclose( File ) != 0 )
+    {
+        perror( "Trace" );
+        TRACE_END( TRACE_DUMP, Written );
+        return false;
+    }
+    TRACE_END( TRACE_DUMP, Written );
+    return true;
+}
+
+/* GetRecordCount
+ * Get the records written by all the threads so far
+ */
+uint64_t Trace::GetRecordCount( void )
+{
+    uint64_t Total = 0u;
+    uint32_t Claimed = __atomic_load_n( &RingCount, __ATOMIC_ACQUIRE );
+    Claimed = ( Claimed < TRACE_THREADS ) ? Claimed : TRACE_THREADS;
+    for ( uint32_t Index = 0u; Index < Claimed; Index++ )
+    {
+        Total += __atomic_load_n( &Rings[Index].Head, __ATOMIC_ACQUIRE );
+    }
+    return Total;
+}
@@ -0,0 +1,142 @@
+/**
+Trace records when the tasks and handlers start and end, to see their
+timing in the field without a scope on the GPIO pins. Each thread writes
+(time, event, argument) records to its own ring with no lock and no
+system call other than reading the clock, and the rings are written out
+as Chrome trace JSON on request, for chrome://tracing or
+ui.perfetto.dev. Without TRACE defined in Config.h the TRACE_BEGIN and
+TRACE_END macros are empty and nothing is recorded.
+
+Author and copyright of this file:
+Chris Dick, 2018
+
+This library is free software; you can redistribute it and/or
+modify it under the terms of the GNU Lesser General Public
+License as published by the Free Software Foundation; either
+version 2.1 of the License, or (at your option) any later version.
+
+This library is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+Lesser General Public License for more details.
+
+You should have received a copy of the GNU Lesser General Public
+License along with this library; if not, write to the Free Software
+Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <time.h>
+#include "Config.h"
+
+/* Configuration */
+
+#define TRACE_THREADS    4u       /**< threads that can record, records from any more are dropped */
+#define TRACE_RECORDS    8192u    /**< records kept per thread, a power of 2, 4 s of the scheduler tasks */
+
+#ifdef TRACE
+#define TRACE_BEGIN( Event, Arg )    Trace::Record( ( Event ), TRACE_PHASE_BEGIN, ( Arg ) )
+#define TRACE_END( Event, Arg )      Trace::Record( ( Event ), TRACE_PHASE_END, ( Arg ) )
+#else
+#define TRACE_BEGIN( Event, Arg )    do { } while ( 0 )
+#define TRACE_END( Event, Arg )      do { } while ( 0 )
+#endif
+
+/** What is being traced, the names are in Trace::Names
+ */
+typedef enum
+{
+    TRACE_TELESCOPE_MANAGER = 0,    /**< TelescopeManager::Run, the argument is the LatencyTrace Id */
+    TRACE_TELESCOPE_ORIENTATION,    /**< TelescopeOrientation::Run, the argument is the LatencyTrace Id */
+    TRACE_HAL_WEBSOCKETD,           /**< HalWebsocketd::Run, the argument is the changed messages */
+    TRACE_HAL_GPS,                  /**< HalGps::Run */
+    TRACE_SERVER_PI,                /**< ServerPi::HandleEvents, the argument is the connections */
+    TRACE_DUMP,                     /**< Trace::Dump, the argument is the records written */
+    TRACE_EVENTS
+} TRACE_EVENT_T;
+
+/** Chrome trace phases
+ */
+typedef enum
+{
+    TRACE_PHASE_BEGIN = 0,      /**< "B" */
+    TRACE_PHASE_END             /**< "E" */
+} TRACE_PHASE_T;
+
+/** One record, 16 bytes
+ */
+typedef struct
+{
+    int64_t Time;       /**< CLOCK_MONOTONIC nanoseconds */
+    uint32_t Arg;       /**< meaning depends on the event */
+    uint16_t Event;     /**< TRACE_EVENT_T */
+    uint8_t Phase;      /**< TRACE_PHASE_T */
+    uint8_t Spare;
+} TRACE_RECORD_T;
+
+/** The records of one thread, only it writes them
+ */
+typedef struct
+{
+    TRACE_RECORD_T Records[TRACE_RECORDS];
+    uint32_t Head;      /**< records ever written, the next goes at Head % TRACE_RECORDS */
+    char Name[16];      /**< the thread name when it first recorded */
+} TRACE_RING_T;
+
+/** Trace
+ * - The rings and writing them out
+ */
+class Trace
+{
+    public:
+    /** Record an event on this thread's ring, use TRACE_BEGIN and TRACE_END
+     * @param Event TRACE_EVENT_T
+     * @param Phase TRACE_PHASE_T
+     * @param Arg shown with the event
+     */
+        static void Record( uint16_t Event, uint8_t Phase, uint32_t Arg )
+        {
+            struct timespec Now;
+            TRACE_RING_T* Ring = ThreadRing;
+            if ( Ring == NULL )
+            {
+                Ring = Claim();
+            }
+            if ( Ring != &Dropped )
+            {
+                const uint32_t Head = Ring->Head;
+                TRACE_RECORD_T* Entry = &Ring->Records[Head & ( TRACE_RECORDS - 1u )];
+                clock_gettime( CLOCK_MONOTONIC, &Now );
+                __atomic_store_n( &Entry->Time, ( (int64_t)Now.tv_sec * 1000000000 ) + Now.tv_nsec, __ATOMIC_RELAXED );
+                __atomic_store_n( &Entry->Arg, Arg, __ATOMIC_RELAXED );
+                __atomic_store_n( &Entry->Event, Event, __ATOMIC_RELAXED );
+                __atomic_store_n( &Entry->Phase, Phase, __ATOMIC_RELAXED );
+                /* the record is complete before Dump can see it */
+                __atomic_store_n( &Ring->Head, Head + 1u, __ATOMIC_RELEASE );
+            }
+        }
+    /** Write the records of every thread to a file as Chrome trace JSON,
+     *  the threads carry on recording while it is written
+     * @param Path file to write
+     * @return bool true if successful
+     */
+        static bool Dump( const char* Path );
+    /** Get the records written by all the threads so far
+     */
+        static uint64_t GetRecordCount( void );
+
+    private:
+    /** Give this thread a ring, or Dropped if there are none left
+     */
+        static TRACE_RING_T* Claim( void );
+
+        static TRACE_RING_T Rings[TRACE_THREADS];          /**< one per thread */
+        static TRACE_RING_T Dropped;                       /**< for the threads without a ring, never written */
+        static uint32_t RingCount;                         /**< rings claimed */
+        static __thread TRACE_RING_T* ThreadRing;          /**< this thread's ring, NULL until it first records */
+        static const char* const Names[TRACE_EVENTS];      /**< for the trace */
+};
+
+#endif /* TRACE_H */
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "Trace.h"
+/*
+ Trace test
+ Threads record as fast as they can while the trace is dumped, each
+ record's argument is its sequence number and its event and phase follow
+ from it, so a record torn by the dump or out of order shows up when the
+ file is read back. A thread after the last ring must not record. Then
+ the cost of a record is timed. Build on any machine from Software/:
+
+ g++ -O2 -I./Src -I./Src/Utils Src/Utils/Trace_test.cpp Src/Utils/Trace.cpp \
+     -lpthread -latomic -o Trace_test
+ ./Trace_test
+ */
+
+#define TEST_FILE       "/tmp/Trace_test.json"
+#define TEST_DUMPS      20
+#define TEST_RECORDS    10000000
+
+static int failures = 0;
+static volatile bool running = true;
+
+static void check(bool condition, const char* what)
+{
+    fprintf(stderr, "%s: %s\n", condition ? "pass" : "FAIL", what);
+    if (!condition)
+    {
+        failures++;
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + (now.tv_nsec / 1.0e9);
+}
+
+/* the event and phase a sequence number is recorded with */
+static uint16_t eventOf(uint32_t sequence)
+{
+    return (uint16_t)((sequence >> 1) % TRACE_DUMP);
+}
+
+static void* recorder(void* arg)
+{
+    (void)arg;
+    for (uint32_t sequence = 0u; running; sequence++)
+    {
+        Trace::Record(eventOf(sequence), (uint8_t)(sequence & 1u), sequence);
+    }
+    return NULL;
+}
+
+/* read a dump back, every thread's records must follow on from each
+   other and match their sequence number, the records counted */
+static bool readBack(const char* path, uint32_t* records, uint32_t* threads)
+{
+    static const char* names[TRACE_DUMP] = { "TelescopeManager", "TelescopeOrientation", "HalWebsocketd", "HalGps", "ServerPi" };
+    char line[256];
+    long long last[TRACE_THREADS + 1u];
+    bool good = true;
+    FILE* file = fopen(path, "r");
+    *records = 0u;
+    *threads = 0u;
+    if (file == NULL)
+    {
+        return false;
+    }
+    for (uint32_t i = 0u; i <= TRACE_THREADS; i++)
+    {
+        last[i] = -1;
+    }
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char name[32];
+        char phase = 0;
+        unsigned tid = 0u;
+        double ts = 0.0;
+        unsigned sequence = 0u;
+        if (strstr(line, "\"thread_name\"") != NULL)
+        {
+            (*threads)++;
+            continue;
+        }
+        if (sscanf(line, "{\"name\":\"%31[^\"]\",\"ph\":\"%c\",\"pid\":1,\"tid\":%u,\"ts\":%lf,\"args\":{\"arg\":%u}}",
+                   name, &phase, &tid, &ts, &sequence) != 5)
+        {
+            continue;
+        }
+        if ((tid == 0u) || (tid > TRACE_THREADS))
+        {
+            good = false;
+            continue;
+        }
+        (*records)++;
+        if (strcmp(name, "Dump") == 0)
+        {
+            continue;
+        }
+        good = good && (strcmp(name, names[eventOf(sequence)]) == 0) && (phase == ((sequence & 1u) ? 'E' : 'B'))
+               && ((last[tid] < 0) || (last[tid] + 1 == (long long)sequence));
+        last[tid] = sequence;
+    }
+    fclose(file);
+    return good;
+}
+
+int main()
+{
+    uint32_t records = 0u;
+    uint32_t threads = 0u;
+
+    /* dumped while the threads record */
+    {
+        pthread_t recorders[TRACE_THREADS - 1u];
+        bool good = true;
+        uint32_t most = 0u;
+        Trace::Record(TRACE_DUMP, TRACE_PHASE_BEGIN, 0u);    /* the main thread has the first ring */
+        for (uint32_t i = 0u; i < (TRACE_THREADS - 1u); i++)
+        {
+            pthread_create(&recorders[i], NULL, recorder, NULL);
+        }
+        while (Trace::GetRecordCount() < (TRACE_THREADS * TRACE_RECORDS))
+        {
+            usleep(1000);
+        }
+        for (int dump = 0; dump < TEST_DUMPS; dump++)
+        {
+            good = good && Trace::Dump(TEST_FILE) && readBack(TEST_FILE, &records, &threads);
+            most = (records > most) ? records : most;
+        }
+        running = false;
+        for (uint32_t i = 0u; i < (TRACE_THREADS - 1u); i++)
+        {
+            pthread_join(recorders[i], NULL);
+        }
+        check(good, "every record dumped is whole and in order");
+        check(threads == TRACE_THREADS, "each thread is named");
+        check((most > (TRACE_THREADS - 1u) * (TRACE_RECORDS / 2u)) && (most <= TRACE_THREADS * TRACE_RECORDS),
+              "up to a ring of records per thread is dumped");
+    }
+
+    /* with every ring taken another thread is not recorded */
+    {
+        const uint64_t before = Trace::GetRecordCount();
+        pthread_t extra;
+        running = true;
+        pthread_create(&extra, NULL, recorder, NULL);
+        usleep(10000);
+        running = false;
+        pthread_join(extra, NULL);
+        check(Trace::GetRecordCount() == before, "a thread without a ring is dropped");
+    }
+
+    /* the dump is valid JSON in outline and ends the events */
+    {
+        char tail[8];
+        FILE* file = NULL;
+        check(Trace::Dump(TEST_FILE), "the trace is written");
+        file = fopen(TEST_FILE, "r");
+        check((file != NULL) && (fseek(file, -4, SEEK_END) == 0) && (fread(tail, 1, 4, file) == 4u)
+              && (memcmp(tail, "\n]}\n", 4) == 0), "the trace closes the events");
+        if (file != NULL)
+        {
+            fclose(file);
+        }
+        check(!Trace::Dump("/nonexistent/Trace_test.json"), "a file that can not be written fails");
+        remove(TEST_FILE);
+    }
+
+    /* the cost of a record, most of it is reading the clock */
+    {
+        struct timespec now;
+        long long sum = 0;
+        double start = seconds();
+        for (uint32_t i = 0u; i < TEST_RECORDS; i++)
+        {
+            TRACE_BEGIN(TRACE_TELESCOPE_MANAGER, i);
+        }
+        const double record = (seconds() - start) * 1.0e9 / TEST_RECORDS;
+        start = seconds();
+        for (uint32_t i = 0u; i < TEST_RECORDS; i++)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            sum += now.tv_nsec;
+        }
+        const double clock = (seconds() - start) * 1.0e9 / TEST_RECORDS;
+        fprintf(stderr, "%.1f ns per record, %.1f ns of it reading the clock (%lld)\n", record, clock, sum & 1);
+    }
+
+    fprintf(stderr, "%d failures\n", failures);
+    return (failures == 0) ? 0 : 1;
+}
@@ -43,9 +43,7 @@
 # on it's own
 #     cd ~/StarPi/Software
 #     ./Out/StarPi 10001
-# with website
-#     cd ~/StarPi/Software
-#     ./websocketd port=1234 Out/StarPi 10001
+# the website connects to the WebSocket server on port 1234 of the same process
 
 #Assume we have a jessie based install
 sudo apt-get -y install scons libncurses5-dev python-dev pps-tools git-core python-smbus i2c-tools